@@ -31,9 +31,9 @@
 int hello(void *p, onion_request * req, onion_response * res) {
   //onion_response_set_length(res, 11);
   onion_response_write0(res, "Hello world");
-  if (onion_request_get_query(req, "1")) {
+  if (onion_request_get_path_param(req, "1")) {
     onion_response_printf(res, "<p>Path: %s",
-                          onion_request_get_query(req, "1"));
+                          onion_request_get_path_param(req, "1"));
   }
   onion_response_printf(res, "<p>Client description: %s",
                         onion_request_get_client_description(req));
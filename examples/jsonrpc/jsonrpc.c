@@ -44,10 +44,7 @@ bool safe_strcmp(const char *a, const char *b) {
 
 onion_connection_status strip_rpc(void *_, onion_request * req,
                                   onion_response * res) {
-  const onion_block *dreq = onion_request_get_data(req);
-  onion_dict *jreq = NULL;
-  if (dreq)
-    jreq = onion_dict_from_json(onion_block_data(dreq));
+  onion_dict *jreq = onion_request_get_json(req);
   if (jreq) {                   // safe_strcmp(onion_request_get_header(req, "content-type"), "application/json") // Not used in tinyrpc, not really mandatory
     //onion_dict_print_dot(jreq);
 
@@ -64,7 +61,16 @@ onion_connection_status strip_rpc(void *_, onion_request * req,
           );
       return OCS_PROCESSED;
     }
-    char *str = onion_low_strdup(onion_dict_rget(jreq, "params", "str", NULL));
+    /// Params by name, or by position
+    const char *param = onion_dict_rget(jreq, "params", "str", NULL);
+    if (!param)
+      param = onion_dict_rget(jreq, "params", "0", NULL);
+    if (!param) {
+      onion_response_write0(res,
+                            "{\"jsonrpc\": \"2.0\", \"error\": {\"code\": -32602, \"message\": \"Invalid params\"}, \"id\": null}");
+      return OCS_PROCESSED;
+    }
+    char *str = onion_low_strdup(param);
 
     /// check real start and end. To prepare to write back the stripped string.
     int start = 0, end = strlen(str);
@@ -90,7 +96,6 @@ onion_connection_status strip_rpc(void *_, onion_request * req,
     onion_block_free(jresb);
     onion_dict_free(jres);
     onion_low_free(str);
-    onion_dict_free(jreq);
 
     return OCS_PROCESSED;
   } else {
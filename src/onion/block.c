@@ -28,31 +28,124 @@
 
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #define ONION_BLOCK_GROW_MIN_BLOCK 16
-#define ONION_BLOCK_GROW_EXPONENTIAL_LIMIT 1024
+/// Allocation size of each chunk of segmented blocks, header included.
+#define ONION_BLOCK_CHUNK_ALLOC 16384
+/// Free chunks kept for reuse.
+#define ONION_BLOCK_CHUNK_POOL_MAX 64
 
 /// @defgroup block Block. Variable size bytes blocks. Used for some internal string representation.
 
+/**
+ * @short A chunk of a segmented block.
+ * @memberof onion_block_t
+ * @ingroup block
+ */
+typedef struct onion_block_chunk_t {
+  struct onion_block_chunk_t *next;
+  size_t size;                  ///< Used bytes at data
+  char data[];
+} onion_block_chunk;
+
+#define ONION_BLOCK_CHUNK_DATA (ONION_BLOCK_CHUNK_ALLOC - sizeof(onion_block_chunk))
+
+/// Free chunks, to reuse them without going to the allocator.
+static struct {
+  onion_block_chunk *free;
+  int count;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;
+#endif
+} onion_block_chunk_pool = {
+  NULL, 0
+#ifdef HAVE_PTHREADS
+      , PTHREAD_MUTEX_INITIALIZER
+#endif
+};
+
+static onion_block_chunk *onion_block_chunk_new() {
+  onion_block_chunk *chunk = NULL;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&onion_block_chunk_pool.mutex);
+#endif
+  if (onion_block_chunk_pool.free) {
+    chunk = onion_block_chunk_pool.free;
+    onion_block_chunk_pool.free = chunk->next;
+    onion_block_chunk_pool.count--;
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&onion_block_chunk_pool.mutex);
+#endif
+  if (!chunk)
+    chunk = onion_low_scalar_malloc(ONION_BLOCK_CHUNK_ALLOC);
+  chunk->next = NULL;
+  chunk->size = 0;
+  return chunk;
+}
+
+/// Returns this chunk and all the next ones to the pool.
+static void onion_block_chunk_free(onion_block_chunk * chunk) {
+  while (chunk) {
+    onion_block_chunk *next = chunk->next;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&onion_block_chunk_pool.mutex);
+#endif
+    if (onion_block_chunk_pool.count < ONION_BLOCK_CHUNK_POOL_MAX) {
+      chunk->next = onion_block_chunk_pool.free;
+      onion_block_chunk_pool.free = chunk;
+      onion_block_chunk_pool.count++;
+      chunk = NULL;
+    }
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&onion_block_chunk_pool.mutex);
+#endif
+    if (chunk)
+      onion_low_free(chunk);
+    chunk = next;
+  }
+}
+
 /**
  * @short Creates a new block
  * @memberof onion_block_t
  * @ingroup block
  */
 onion_block *onion_block_new() {
-  onion_block *ret = onion_low_malloc(sizeof(onion_block));
+  onion_block *ret = onion_low_calloc(1, sizeof(onion_block));
   ret->data = onion_low_scalar_malloc(ONION_BLOCK_GROW_MIN_BLOCK);
   ret->maxsize = ONION_BLOCK_GROW_MIN_BLOCK;
   ret->size = 0;
   return ret;
 }
 
+/**
+ * @short Creates a new segmented block
+ * @memberof onion_block_t
+ * @ingroup block
+ *
+ * Data is kept at a list of fixed size chunks, so appending never moves the data already there,
+ * and the size is only limited by memory. It is meant for big outputs, that can be written
+ * with onion_response_write_block, or iterated with onion_block_iovec.
+ *
+ * onion_block_data makes it contiguous, copying all the data once.
+ */
+onion_block *onion_block_new_segmented() {
+  onion_block *ret = onion_low_calloc(1, sizeof(onion_block));
+  ret->segmented = true;
+  return ret;
+}
+
 /**
  * @short Removes the current block
  * @memberof onion_block_t
  * @ingroup block
  */
 void onion_block_free(onion_block * bl) {
+  onion_block_chunk_free(bl->first);
   onion_low_free(bl->data);
   onion_low_free(bl);
 }
@@ -65,22 +158,51 @@ void onion_block_free(onion_block * bl) {
  * This is usefull to reuse existing blocks
  */
 void onion_block_clear(onion_block * b) {
+  if (b->segmented) {
+    onion_block_chunk_free(b->first);
+    b->first = b->last = NULL;
+  }
   b->size = 0;
 }
 
+/// Grows the contiguous data to fit at least size bytes. Doubles, so appends are amortized O(1).
+static void onion_block_grow(onion_block * bl, size_t size) {
+  size_t maxsize = bl->maxsize * 2;
+  if (maxsize < size)
+    maxsize = size;
+  if (maxsize < ONION_BLOCK_GROW_MIN_BLOCK)
+    maxsize = ONION_BLOCK_GROW_MIN_BLOCK;
+  bl->data = onion_low_realloc(bl->data, maxsize);
+  bl->maxsize = maxsize;
+}
+
 /**
  * @short Ensures the block has at least this reserved memory space.
  * @memberof onion_block_t
  * @ingroup block
  *
  * This is usefull for some speedups, and prevent sucessive mallocs
- * if you know beforehand the size.
+ * if you know beforehand the size. Segmented blocks do not need it.
  */
-void onion_block_min_maxsize(onion_block * b, int minsize) {
-  if (b->maxsize < minsize) {
-    b->data = onion_low_realloc(b->data, minsize);
-    b->maxsize = minsize;
+void onion_block_min_maxsize(onion_block * b, size_t minsize) {
+  if (!b->segmented && b->maxsize < minsize)
+    onion_block_grow(b, minsize);
+}
+
+/// Copies all the chunks to a contiguous buffer, and stops being segmented.
+static void onion_block_flatten(onion_block * b) {
+  size_t pos = 0;
+  onion_block_chunk *chunk;
+  onion_low_free(b->data);
+  b->maxsize = b->size + 1;
+  b->data = onion_low_scalar_malloc(b->maxsize);
+  for (chunk = b->first; chunk; chunk = chunk->next) {
+    memcpy(b->data + pos, chunk->data, chunk->size);
+    pos += chunk->size;
   }
+  onion_block_chunk_free(b->first);
+  b->first = b->last = NULL;
+  b->segmented = false;
 }
 
 /**
@@ -89,9 +211,13 @@ void onion_block_min_maxsize(onion_block * b, int minsize) {
  * @ingroup block
  *
  * It will be finished with a \0 (if not already, to ensure is printable.
+ *
+ * Segmented blocks are made contiguous now, and stay so.
  */
 const char *onion_block_data(const onion_block * b) {
   // It can really modify the size, as it ensures a \0 at the end, but its ok
+  if (b->segmented)
+    onion_block_flatten((onion_block *) b);
   if (b->size == b->maxsize) {
     onion_block_add_char((onion_block *) b, 0);
     ((onion_block *) b)->size--;
@@ -115,10 +241,53 @@ off_t onion_block_size(const onion_block * b) {
  * @ingroup block
  */
 void onion_block_rewind(onion_block * b, off_t n) {
-  if (b->size < n)
+  if (b->size < (size_t) n)
     b->size = 0;
   else
     b->size -= n;
+  if (b->segmented) {           // Keep the chunks that still have data
+    size_t left = b->size;
+    onion_block_chunk *chunk = b->first, *last = NULL;
+    while (chunk && left) {
+      if (chunk->size > left)
+        chunk->size = left;
+      left -= chunk->size;
+      last = chunk;
+      chunk = chunk->next;
+    }
+    if (last) {
+      onion_block_chunk_free(last->next);
+      last->next = NULL;
+    } else {
+      onion_block_chunk_free(b->first);
+      b->first = NULL;
+    }
+    b->last = last;
+  }
+}
+
+/// Appends to the chunks of a segmented block.
+static void onion_block_add_segmented(onion_block * bl, const char *data,
+                                      size_t l) {
+  bl->size += l;
+  while (l) {
+    onion_block_chunk *chunk = bl->last;
+    if (!chunk || chunk->size == ONION_BLOCK_CHUNK_DATA) {
+      chunk = onion_block_chunk_new();
+      if (bl->last)
+        bl->last->next = chunk;
+      else
+        bl->first = chunk;
+      bl->last = chunk;
+    }
+    size_t w = ONION_BLOCK_CHUNK_DATA - chunk->size;
+    if (w > l)
+      w = l;
+    memcpy(chunk->data + chunk->size, data, w);
+    chunk->size += w;
+    data += w;
+    l -= w;
+  }
 }
 
 /**
@@ -126,13 +295,12 @@ void onion_block_rewind(onion_block * b, off_t n) {
  * @memberof onion_block_t
  */
 int onion_block_add_char(onion_block * bl, char c) {
-  if (bl->size >= bl->maxsize) {        // Grows ^2, until 1024, and then on 1024 chunks.
-    int grow = bl->maxsize;
-    if (grow > ONION_BLOCK_GROW_EXPONENTIAL_LIMIT)
-      grow = ONION_BLOCK_GROW_EXPONENTIAL_LIMIT;
-    bl->maxsize += grow;
-    bl->data = onion_low_realloc(bl->data, bl->maxsize);
+  if (bl->segmented) {
+    onion_block_add_segmented(bl, &c, 1);
+    return 1;
   }
+  if (bl->size >= bl->maxsize)
+    onion_block_grow(bl, bl->size + 1);
   bl->data[bl->size++] = c;
   return 1;
 }
@@ -142,10 +310,9 @@ int onion_block_add_char(onion_block * bl, char c) {
  * @memberof onion_block_t
  */
 int onion_block_add_str(onion_block * b, const char *str) {
-  int l = strlen(str) + 1;
+  int l = strlen(str);
   onion_block_add_data(b, str, l);
-  b->size--;
-  return l;
+  return l + 1;
 }
 
 /**
@@ -153,13 +320,17 @@ int onion_block_add_str(onion_block * b, const char *str) {
  * @memberof onion_block_t
  */
 int onion_block_add_data(onion_block * bl, const char *data, size_t l) {
+  if (bl->segmented) {
+    onion_block_add_segmented(bl, data, l);
+    return l;
+  }
   // I have to perform manual realloc as if I append same block, realloc may free the data, so I do it manually.
   char *manualrealloc = NULL;
   if (bl->size + l > bl->maxsize) {
-    int grow = l;
-    if (grow < ONION_BLOCK_GROW_MIN_BLOCK)
-      grow = ONION_BLOCK_GROW_MIN_BLOCK;
-    bl->maxsize = bl->size + grow;
+    size_t maxsize = bl->maxsize * 2;
+    if (maxsize < bl->size + l)
+      maxsize = bl->size + l;
+    bl->maxsize = maxsize;
     manualrealloc = bl->data;
     bl->data = onion_low_scalar_malloc(bl->maxsize);
     memcpy(bl->data, manualrealloc, bl->size);
@@ -177,5 +348,47 @@ int onion_block_add_data(onion_block * bl, const char *data, size_t l) {
  * @memberof onion_block_t
  */
 int onion_block_add_block(onion_block * b, onion_block * toadd) {
-  return onion_block_add_data(b, toadd->data, toadd->size);
+  if (b == toadd && toadd->segmented)  // Chunks would change while reading them
+    onion_block_flatten(toadd);
+  if (!toadd->segmented)
+    return onion_block_add_data(b, toadd->data, toadd->size);
+  onion_block_chunk *chunk;
+  size_t size = toadd->size;
+  for (chunk = toadd->first; chunk; chunk = chunk->next)
+    onion_block_add_data(b, chunk->data, chunk->size);
+  return size;
+}
+
+/**
+ * @short Exports the block data as iovecs, with no copies, for example for writev.
+ * @memberof onion_block_t
+ * @ingroup block
+ *
+ * Starts at the given offset, so after a partial write it can continue where it was.
+ *
+ * @returns the number of iovecs filled, up to iovcnt. 0 if offset is at the end.
+ */
+int onion_block_iovec(const onion_block * b, size_t offset,
+                      struct iovec *iov, int iovcnt) {
+  int n = 0;
+  if (!b->segmented) {
+    if (offset < b->size && iovcnt > 0) {
+      iov[0].iov_base = b->data + offset;
+      iov[0].iov_len = b->size - offset;
+      n = 1;
+    }
+    return n;
+  }
+  onion_block_chunk *chunk = b->first;
+  while (chunk && offset >= chunk->size) {
+    offset -= chunk->size;
+    chunk = chunk->next;
+  }
+  for (; chunk && n < iovcnt; chunk = chunk->next) {
+    iov[n].iov_base = chunk->data + offset;
+    iov[n].iov_len = chunk->size - offset;
+    offset = 0;
+    n++;
+  }
+  return n;
 }
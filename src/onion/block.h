@@ -31,12 +31,14 @@ extern "C" {
 #include "types.h"
 #include <stddef.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
   onion_block *onion_block_new();
+  onion_block *onion_block_new_segmented();
   void onion_block_free(onion_block * b);
   void onion_block_clear(onion_block * b);
 
-  void onion_block_min_maxsize(onion_block * b, int minsize);
+  void onion_block_min_maxsize(onion_block * b, size_t minsize);
   off_t onion_block_size(const onion_block * b);
   const char *onion_block_data(const onion_block * b);
 
@@ -47,6 +49,9 @@ extern "C" {
   int onion_block_add_data(onion_block * b, const char *data, size_t length);
   int onion_block_add_block(onion_block * b, onion_block * toadd);
 
+  int onion_block_iovec(const onion_block * b, size_t offset,
+                        struct iovec *iov, int iovcnt);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,6 +24,14 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define ONION_CODECS_AVX2 1
+#endif
 #ifdef HAVE_GNUTLS
 #include <gnutls/gnutls.h>
 #include <gnutls/crypto.h>
@@ -40,8 +48,8 @@
 
 /// @defgroup codecs Codecs. Some basic web codecs support: base64, url encoding...
 
-/// Decode table. Its the inverse of the code table. (cb64).
-static const char db64[] = {    // 16 bytes each line, 8 lines. Only 128 registers
+/// Decode table. Its the inverse of the code table. (cb64). Bytes over 127 are invalid too.
+static const unsigned char db64[256] = {        // 16 bytes each line, 16 lines
   255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 16
   255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 32
   255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 62, 255, 255, 255, 63, // 48
@@ -49,13 +57,146 @@ static const char db64[] = {    // 16 bytes each line, 8 lines. Only 128 registe
   255, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,        // 80
   15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 255, 255, 255, 255, 255,  // 96
   255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,      // 112
-  41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 255, 255, 255, 255, 255   // 128
+  41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 255, 255, 255, 255, 255,  // 128
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 144
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 160
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 176
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 192
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 208
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 224
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,       // 240
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255        // 256
 };
 
 /// Coding table.
 static const char cb64[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+/**
+ * @short Bytes that stop a scan.
+ * @ingroup codecs
+ *
+ * Up to 5 chars, and if ctrl, all below 0x20. The last char is always \0, so scans stop at
+ * the end of the string.
+ */
+typedef struct onion_codecs_stopset_t {
+  char c[6];
+  char ctrl;
+} onion_codecs_stopset;
+
+static const onion_codecs_stopset onion_codecs_html_stop =
+    { {'<', '>', '&', '"', '\'', 0}, 0 };
+static const onion_codecs_stopset onion_codecs_json_stop =
+    { {'"', '\\', 127, 0, 0, 0}, 1 };
+static const onion_codecs_stopset onion_codecs_url_stop =
+    { {'%', '+', 0, 0, 0, 0}, 0 };
+
+typedef const char *(*onion_codecs_find_f) (const char *p,
+                                            const onion_codecs_stopset * s);
+
+static const char *onion_codecs_find_scalar(const char *p,
+                                            const onion_codecs_stopset * s) {
+  for (;; p++) {
+    char c = *p;
+    if (c == s->c[0] || c == s->c[1] || c == s->c[2] || c == s->c[3]
+        || c == s->c[4] || c == s->c[5])
+      return p;
+    if (s->ctrl && (unsigned char)c < 0x20)
+      return p;
+  }
+}
+
+/*
+ * The vector versions read whole aligned blocks, so they never cross a page boundary, but may
+ * read some bytes after the final \0. That is safe, but not for the address sanitizer.
+ */
+#if defined(__SSE2__)
+__attribute__((no_sanitize_address))
+static const char *onion_codecs_find_sse2(const char *p,
+                                          const onion_codecs_stopset * s) {
+  const char *a = (const char *)((uintptr_t) p & ~(uintptr_t) 15);
+  const __m128i c0 = _mm_set1_epi8(s->c[0]), c1 = _mm_set1_epi8(s->c[1]);
+  const __m128i c2 = _mm_set1_epi8(s->c[2]), c3 = _mm_set1_epi8(s->c[3]);
+  const __m128i c4 = _mm_set1_epi8(s->c[4]), c5 = _mm_set1_epi8(s->c[5]);
+  // Signed compare, moved so 0x00 is the minimum: below 0x20, or nothing
+  const __m128i flip = _mm_set1_epi8((char)0x80);
+  const __m128i ctrl = _mm_set1_epi8((char)(s->ctrl ? 0xA0 : 0x80));
+  unsigned int mask = 0xFFFFu << (p - a);
+  for (;;) {
+    __m128i x = _mm_load_si128((const __m128i *)a);
+    __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, c0),
+                                          _mm_cmpeq_epi8(x, c1)),
+                             _mm_or_si128(_mm_cmpeq_epi8(x, c2),
+                                          _mm_cmpeq_epi8(x, c3)));
+    m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(x, c4),
+                                     _mm_cmpeq_epi8(x, c5)));
+    m = _mm_or_si128(m, _mm_cmplt_epi8(_mm_xor_si128(x, flip), ctrl));
+    mask &= _mm_movemask_epi8(m);
+    if (mask)
+      return a + __builtin_ctz(mask);
+    mask = 0xFFFFu;
+    a += 16;
+  }
+}
+#endif
+
+#ifdef ONION_CODECS_AVX2
+__attribute__((target("avx2"), no_sanitize_address))
+static const char *onion_codecs_find_avx2(const char *p,
+                                          const onion_codecs_stopset * s) {
+  const char *a = (const char *)((uintptr_t) p & ~(uintptr_t) 31);
+  const __m256i c0 = _mm256_set1_epi8(s->c[0]), c1 = _mm256_set1_epi8(s->c[1]);
+  const __m256i c2 = _mm256_set1_epi8(s->c[2]), c3 = _mm256_set1_epi8(s->c[3]);
+  const __m256i c4 = _mm256_set1_epi8(s->c[4]), c5 = _mm256_set1_epi8(s->c[5]);
+  const __m256i flip = _mm256_set1_epi8((char)0x80);
+  const __m256i ctrl = _mm256_set1_epi8((char)(s->ctrl ? 0xA0 : 0x80));
+  uint32_t mask = 0xFFFFFFFFu << (p - a);
+  for (;;) {
+    __m256i x = _mm256_load_si256((const __m256i *)a);
+    __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, c0),
+                                                _mm256_cmpeq_epi8(x, c1)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(x, c2),
+                                                _mm256_cmpeq_epi8(x, c3)));
+    m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(x, c4),
+                                           _mm256_cmpeq_epi8(x, c5)));
+    m = _mm256_or_si256(m,
+                        _mm256_cmpgt_epi8(ctrl, _mm256_xor_si256(x, flip)));
+    mask &= (uint32_t) _mm256_movemask_epi8(m);
+    if (mask)
+      return a + __builtin_ctz(mask);
+    mask = 0xFFFFFFFFu;
+    a += 32;
+  }
+}
+#endif
+
+static onion_codecs_find_f onion_codecs_find_impl = NULL;
+
+/**
+ * @short Returns the first char of p in the stop set, or the final \0.
+ * @ingroup codecs
+ *
+ * Uses the best implementation for this CPU, checked on first use: AVX2, SSE2 or plain C.
+ */
+static const char *onion_codecs_find(const char *p,
+                                     const onion_codecs_stopset * s) {
+  onion_codecs_find_f f =
+      __atomic_load_n(&onion_codecs_find_impl, __ATOMIC_RELAXED);
+  if (!f) {
+    f = onion_codecs_find_scalar;
+#if defined(__SSE2__)
+    f = onion_codecs_find_sse2;
+#endif
+#ifdef ONION_CODECS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      f = onion_codecs_find_avx2;
+#endif
+    __atomic_store_n(&onion_codecs_find_impl, f, __ATOMIC_RELAXED);
+  }
+  return f(p, s);
+}
+
 void printf_bin(const char c, int n) {
   int i;
   //fprintf(stderr, "%c %-3d ", c,c);
@@ -244,6 +385,17 @@ char *onion_base64_encode(const char *orig, int length) {
   return ret;
 }
 
+/// Value of an hex digit, or -1.
+static int onion_codecs_hex(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
 /**
  * @short Performs unquote inplace.
  * @ingroup codecs
@@ -253,20 +405,25 @@ char *onion_base64_encode(const char *orig, int length) {
 void onion_unquote_inplace(char *str) {
   char *r = str;
   char *w = str;
-  char tmp[3] = { 0, 0, 0 };
-  while (*r) {
-    if (*r == '%') {
+  for (;;) {
+    char *next = (char *)onion_codecs_find(r, &onion_codecs_url_stop);
+    if (w != r)
+      memmove(w, r, next - r);
+    w += next - r;
+    r = next;
+    if (!*r)
+      break;
+    if (*r == '+') {
+      *w++ = ' ';
       r++;
-      tmp[0] = *r++;
-      tmp[1] = *r;
-      *w = strtol(tmp, (char **)NULL, 16);
-    } else if (*r == '+') {
-      *w = ' ';
-    } else {
-      *w = *r;
+    } else {                    // %XX. If not valid hex, the % is kept as is.
+      int h = onion_codecs_hex(r[1]), l = (h >= 0) ? onion_codecs_hex(r[2]) : -1;
+      if (l >= 0) {
+        *w++ = (h << 4) | l;
+        r += 3;
+      } else
+        *w++ = *r++;
     }
-    r++;
-    w++;
   }
   *w = '\0';
 }
@@ -490,27 +647,43 @@ int onion_html_encoding_size(char c) {
  * If needs encoding returns a new string that should be deallocated, if not, returns NULL.
  */
 char *onion_html_quote(const char *str) {
+  const char *p = onion_html_find_unsafe(str);
+  if (!*p)                      // Most strings need no encoding
+    return NULL;
   /// first calculate size
-  int size = 0;
-  const char *p = str;
-  while ((*p)) {
-    size += onion_html_encoding_size(*p);
-    p++;
+  size_t size = p - str;
+  while (*p) {
+    const char *next = onion_html_find_unsafe(p + 1);
+    size += onion_html_encoding_size(*p) + (next - p - 1);
+    p = next;
   }
-  if (size == (p - str))
-    return NULL;
   char *ret = onion_low_scalar_malloc(size + 1);
-  memset(ret, 0, size + 1);
-  p = str;
   char *t = ret;
-  while ((*p)) {
-    t = onion_html_add_enc(*p, t);
-    p++;
+  p = str;
+  for (;;) {
+    const char *next = onion_html_find_unsafe(p);
+    memcpy(t, p, next - p);
+    t += next - p;
+    if (!*next)
+      break;
+    t = onion_html_add_enc(*next, t);
+    p = next + 1;
   }
   *t = '\0';
   return ret;
 }
 
+/**
+ * @short Returns the first char of str that needs HTML encoding, or the final \0.
+ * @ingroup codecs
+ *
+ * Allows to write the runs of safe chars at once. It checks several bytes at a time when the
+ * CPU allows it.
+ */
+const char *onion_html_find_unsafe(const char *str) {
+  return onion_codecs_find(str, &onion_codecs_html_stop);
+}
+
 /**
  * @short Calculates as a freshly allocated string the HTML encoding of a given string
  * @ingroup codecs
@@ -525,7 +698,18 @@ const char *onion_html_quote_dup(const char *str) {
   if (quostr != NULL)
     return quostr;
   else
-    return onion_low_strdup(quostr);
+    return onion_low_strdup(str);
+}
+
+/**
+ * @short Returns the first char of str that needs JSON escaping, or the final \0.
+ * @ingroup codecs
+ *
+ * Control chars, 127, " and \. As onion_html_find_unsafe, checks several bytes at a time
+ * when the CPU allows it.
+ */
+const char *onion_json_find_unsafe(const char *str) {
+  return onion_codecs_find(str, &onion_codecs_json_stop);
 }
 
 /**
@@ -538,12 +722,14 @@ void onion_json_quote_add(onion_block * block, const char *str) {
   if (!str)
     return;
 
-  // Optimistically resize to str length
-  onion_block_min_maxsize(block, onion_block_size(block) + strlen(str) + 1);
-
-  while (*str) {
-    unsigned char c = *str;
+  for (;;) {
+    const char *next = onion_json_find_unsafe(str);
+    if (next != str)
+      onion_block_add_data(block, str, next - str);
+    unsigned char c = *next;
     switch (c) {
+    case '\0':
+      return;
     case '\b':
       onion_block_add_data(block, "\\b", 2);
       break;
@@ -565,21 +751,15 @@ void onion_json_quote_add(onion_block * block, const char *str) {
     case '\\':
       onion_block_add_data(block, "\\\\", 2);
       break;
-    default:
-      // set the unicode escape for non printable characters. C is unsigned no prob with <0
-      if (c < 32 || c == 127) {
+    default:{                  // Other control chars and 127, as unicode escapes
         char codestr[6] = "\\u0000";
         const char *hex = "0123456789ABCDEF";
         codestr[4] = hex[((c & 0x0F0) >> 4) & 0x0F];
         codestr[5] = hex[(c & 0x0F)];
         onion_block_add_data(block, codestr, 6);
-      } else {
-        // Others just put it in.
-        // The reader should be able to read binary unicode chars. (ie: not \uXXXX encoded)
-        onion_block_add_char(block, c);
       }
     }
-    str++;
+    str = next + 1;
   }
 }
 
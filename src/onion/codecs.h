@@ -58,9 +58,21 @@ extern "C" {
 /// Calculates the HTML encoding of a string. Returned value must be freed. If no encoding needed, returns NULL.
   char *onion_html_quote(const char *str);
 
+/// Returns the first char of str that needs HTML encoding, or the final \0.
+  const char *onion_html_find_unsafe(const char *str);
+
+/// At p inserts the proper encoding of c, and returns the new string cursor (end of inserted symbols).
+  char *onion_html_add_enc(char c, char *p);
+
+/// Returns the size of the HTML encoding of c.
+  int onion_html_encoding_size(char c);
+
 /// Always return a freshly allocated string, to be later freed.
   const char *onion_html_quote_dup(const char *str);
 
+/// Returns the first char of str that needs JSON escaping, or the final \0.
+  const char *onion_json_find_unsafe(const char *str);
+
 /// Generates JSON string encoding and adds it to an existing block
   void onion_json_quote_add(onion_block * block, const char *str);
 
@@ -26,6 +26,11 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdint.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "log.h"
 #include "dict.h"
@@ -33,6 +38,7 @@
 #include "codecs.h"
 #include "block.h"
 #include "low.h"
+#include "low.h"
 
 /// @defgroup dict Dict.
 
@@ -73,12 +79,222 @@ typedef struct onion_dict_node_t {
   struct onion_dict_node_t *right;
 } onion_dict_node;
 
+/// Dicts up to this many elements are a flat sorted array, as most request dicts are small.
+#define ONION_DICT_SMALL_SIZE 16
+/// Dicts with more elements than this change to a hash table.
+#define ONION_DICT_HASH_THRESHOLD 64
+/// Keys shorter than this are copied into the hash slot itself, if they have to be dupped.
+#define ONION_DICT_INLINE_KEY 24
+
+enum onion_dict_hash_slot_state_e {
+  OD_SLOT_EMPTY = 0,
+  OD_SLOT_USED = 1,
+  OD_SLOT_DELETED = 2,
+};
+
+/**
+ * @short Slot of the hash table.
+ * @memberof onion_dict_t
+ * @ingroup dict
+ *
+ * Keeps the full hash, so that most non matching keys are discarded without a compare,
+ * and short keys inline, so most lookups touch just one cache line.
+ */
+typedef struct onion_dict_hash_slot_t {
+  unsigned int hash;
+  unsigned int seq;             ///< Insertion order, to keep repeated keys in order.
+  unsigned char state;
+  unsigned char inline_key;     ///< If the key is at key, and must not be freed.
+  onion_dict_node_data data;
+  char key[ONION_DICT_INLINE_KEY];
+} onion_dict_hash_slot;
+
+/**
+ * @short Open addressing, linear probing, hash table.
+ * @memberof onion_dict_t
+ * @ingroup dict
+ */
+typedef struct onion_dict_hash_t {
+  onion_dict_hash_slot *slots;
+  unsigned int size;            ///< Always a power of 2
+  unsigned int used;            ///< Used and deleted slots, for the load factor
+  unsigned int seq;
+} onion_dict_hash;
+
+/**
+ * @short Memory shared by all the dicts parsed from the same JSON.
+ * @memberof onion_dict_t
+ * @ingroup dict
+ *
+ * The JSON is copied here once and decoded in place, so keys and values point inside it and
+ * need no allocation of their own. Each dict keeps a reference, and the last one frees it.
+ */
+typedef struct onion_dict_arena_t {
+  int refcount;                 ///< Atomically changed.
+  char data[];
+} onion_dict_arena;
+
+/// Releases one reference of the arena.
+static void onion_dict_arena_free(onion_dict_arena * arena) {
+  if (__sync_sub_and_fetch(&arena->refcount, 1) == 0)
+    onion_low_free(arena);
+}
+
+#ifdef HAVE_PTHREADS
+/// Old data or memory, to be freed when no reader can see it.
+typedef struct onion_dict_garbage_t {
+  onion_dict_node_data data;
+  void *mem;                    ///< If set, just memory to free, as old hash tables.
+  struct onion_dict_garbage_t *next;
+} onion_dict_garbage;
+
+/**
+ * @short Epoch based reclamation for OD_RCU dicts.
+ * @memberof onion_dict_t
+ * @ingroup dict
+ *
+ * Readers count themselves at the counter of the current epoch, and never wait. Writers are
+ * serialized with the writer mutex, never change memory readers may be looking at, and keep
+ * the old data at garbage. At onion_dict_unlock they change epoch twice, waiting each time
+ * for the readers of the previous one to finish, and then free it.
+ *
+ * So a thread can not write while it holds the read lock of the same dict, as it would wait
+ * for itself forever. onion_dict_lock_write checks it and aborts.
+ */
+typedef struct onion_dict_rcu_t {
+  pthread_mutex_t writer;
+  unsigned int epoch;
+  int readers[2];
+  onion_dict_garbage *garbage;
+} onion_dict_rcu;
+
+/// Maximum read locks of OD_RCU dicts at the same time on one thread.
+#define ONION_DICT_RCU_NESTING 16
+
+/// Read locks of OD_RCU dicts held by this thread, to know at onion_dict_unlock which kind it is.
+static ONION_THREAD_LOCAL struct {
+  onion_dict_rcu *rcu;
+  int idx;
+} onion_dict_rcu_reading[ONION_DICT_RCU_NESTING];
+static ONION_THREAD_LOCAL int onion_dict_rcu_nreading = 0;
+/// Read locks over ONION_DICT_RCU_NESTING, that use the writer mutex.
+static ONION_THREAD_LOCAL int onion_dict_rcu_overflow = 0;
+#endif
+
+/**
+ * @short Small dicts, up to ONION_DICT_SMALL_SIZE elements, sorted by key and insertion order.
+ * @memberof onion_dict_t
+ * @ingroup dict
+ *
+ * Just one allocation for all the elements, and lookups are a scan of the contiguous
+ * array of hashes, comparing the keys only when the hash matches.
+ */
+typedef struct onion_dict_small_t {
+  unsigned int hash[ONION_DICT_SMALL_SIZE];
+  onion_dict_node_data data[ONION_DICT_SMALL_SIZE];
+} onion_dict_small;
+
 static void onion_dict_node_data_free(onion_dict_node_data * dict);
 static void onion_dict_set_node_data(onion_dict_node_data * data,
                                      const char *key, const void *value,
                                      int flags);
 static onion_dict_node *onion_dict_node_new(const char *key, const void *value,
                                             int flags);
+static void onion_dict_to_hash(onion_dict * dict);
+static unsigned int onion_dict_hash_key(const onion_dict * dict,
+                                        const char *key);
+static void onion_dict_small_sort(onion_dict * dict);
+static void onion_dict_hash_resize(onion_dict * dict, unsigned int size,
+                                   int rehash);
+static void onion_dict_unshare(onion_dict * dict);
+static const onion_dict_node_data *onion_dict_find_data(const onion_dict *
+                                                        dict, const char *key);
+
+#ifdef HAVE_PTHREADS
+/// Frees the garbage list.
+static void onion_dict_garbage_free(onion_dict_garbage * g) {
+  while (g) {
+    onion_dict_garbage *next = g->next;
+    if (g->mem)
+      onion_low_free(g->mem);
+    else
+      onion_dict_node_data_free(&g->data);
+    onion_low_free(g);
+    g = next;
+  }
+}
+
+/// Waits until all readers that may have seen the garbage are gone. Writer mutex must be held.
+static void onion_dict_rcu_synchronize(onion_dict_rcu * rcu) {
+  int i;
+  for (i = 0; i < 2; i++) {
+    int idx = __sync_fetch_and_add(&rcu->epoch, 1) & 1;
+    while (__atomic_load_n(&rcu->readers[idx], __ATOMIC_ACQUIRE) != 0)
+      sched_yield();
+  }
+}
+
+static void onion_dict_rcu_read_lock(onion_dict_rcu * rcu) {
+  if (onion_dict_rcu_nreading >= ONION_DICT_RCU_NESTING) {
+    ONION_WARNING
+        ("Too many nested read locks on OD_RCU dicts. Using the writer lock.");
+    pthread_mutex_lock(&rcu->writer);
+    onion_dict_rcu_overflow++;
+    return;
+  }
+  int idx = __atomic_load_n(&rcu->epoch, __ATOMIC_RELAXED) & 1;
+  __sync_add_and_fetch(&rcu->readers[idx], 1);  // Full barrier: reads are done after this
+  onion_dict_rcu_reading[onion_dict_rcu_nreading].rcu = rcu;
+  onion_dict_rcu_reading[onion_dict_rcu_nreading].idx = idx;
+  onion_dict_rcu_nreading++;
+}
+
+/// Unlocks the latest lock of this thread on the dict, be it read or write.
+/// If this thread holds a read lock of this OD_RCU dict.
+static int onion_dict_rcu_is_reading(onion_dict_rcu * rcu) {
+  int i;
+  for (i = 0; i < onion_dict_rcu_nreading; i++)
+    if (onion_dict_rcu_reading[i].rcu == rcu)
+      return 1;
+  return 0;
+}
+
+static void onion_dict_rcu_unlock(onion_dict_rcu * rcu) {
+  if (onion_dict_rcu_overflow) {
+    onion_dict_rcu_overflow--;
+    pthread_mutex_unlock(&rcu->writer);
+    return;
+  }
+  if (onion_dict_rcu_nreading
+      && onion_dict_rcu_reading[onion_dict_rcu_nreading - 1].rcu == rcu) {
+    onion_dict_rcu_nreading--;
+    __sync_sub_and_fetch(&rcu->readers
+                         [onion_dict_rcu_reading[onion_dict_rcu_nreading].idx],
+                         1);
+    return;
+  }
+  onion_dict_garbage *garbage = rcu->garbage;
+  rcu->garbage = NULL;
+  if (garbage)
+    onion_dict_rcu_synchronize(rcu);
+  pthread_mutex_unlock(&rcu->writer);
+  onion_dict_garbage_free(garbage);
+}
+#endif
+
+/// Frees the memory now, or when no reader can see it on OD_RCU dicts.
+static void onion_dict_retire_mem(onion_dict * dict, void *mem) {
+#ifdef HAVE_PTHREADS
+  if (dict->rcu) {
+    onion_dict_garbage *g = onion_low_calloc(1, sizeof(onion_dict_garbage));
+    g->mem = mem;
+    g->next = dict->rcu->garbage;
+    dict->rcu->garbage = g;
+    return;
+  }
+#endif
+  onion_low_free(mem);
+}
 
 /**
  * @memberof onion_dict_t
@@ -86,13 +302,29 @@ static onion_dict_node *onion_dict_node_new(const char *key, const void *value,
  * Initializes the basic tree with all the structure in place, but empty.
  */
 onion_dict *onion_dict_new() {
+  return onion_dict_new_with_flags(0);
+}
+
+/**
+ * @memberof onion_dict_t
+ * @ingroup dict
+ * Initializes an empty dict with the given flags.
+ *
+ * Mainly for OD_NO_LOCK, as then the lock is not even initialized. Request dicts
+ * (headers, query, post...) are created like this, as only the thread that serves
+ * the request uses them.
+ */
+onion_dict *onion_dict_new_with_flags(int flags) {
   onion_dict *dict = onion_low_calloc(1, sizeof(onion_dict));
+  dict->flags = flags & (OD_NO_LOCK | OD_RCU);
 #ifdef HAVE_PTHREADS
-  pthread_rwlock_init(&dict->lock, NULL);
-  pthread_mutex_init(&dict->refmutex, NULL);
+  if (!dict->flags)
+    pthread_rwlock_init(&dict->lock, NULL);
 #endif
   dict->refcount = 1;
   dict->cmp = strcmp;
+  if (flags)
+    onion_dict_set_flags(dict, flags);
   ONION_DEBUG0("New %p, refcount %d", dict, dict->refcount);
   return dict;
 }
@@ -102,11 +334,32 @@ onion_dict *onion_dict_new() {
  * @ingroup dict
  *
  * Sets the dict flags.
+ *
+ * OD_NO_LOCK and OD_RCU must be set before the dict is shared with other threads.
  */
 void onion_dict_set_flags(onion_dict * dict, int flags) {
+  if (dict->shared && (flags & (OD_ICASE | OD_HASH | OD_RCU)))  // They change the layout of the content
+    onion_dict_unshare(dict);
+#ifdef HAVE_PTHREADS
+  if ((flags & (OD_NO_LOCK | OD_RCU)) && !(dict->flags & (OD_NO_LOCK | OD_RCU)))
+    pthread_rwlock_destroy(&dict->lock);        // Not used anymore
+  if ((flags & OD_RCU) && !dict->rcu) {
+    dict->rcu = onion_low_calloc(1, sizeof(onion_dict_rcu));
+    pthread_mutex_init(&dict->rcu->writer, NULL);
+  }
+#endif
+  if (flags & OD_RCU)           // Readers need a structure that is not rebalanced under them
+    flags |= OD_HASH;
+  dict->flags |= flags;
   if (flags & OD_ICASE) {
     dict->cmp = strcasecmp;
+    if (dict->hash)             // Hashes change
+      onion_dict_hash_resize(dict, dict->hash->size, 1);
+    if (dict->small)            // Hashes and order change
+      onion_dict_small_sort(dict);
   }
+  if ((flags & OD_HASH) && !dict->hash)
+    onion_dict_to_hash(dict);
 }
 
 /// Sameas onion_dict_add, but ensures duplicates all. Necesary to ensure consistency.
@@ -140,14 +393,8 @@ void onion_dict_merge(onion_dict * me, const onion_dict * other) {
  * environment so that multiple threads cna have the same dict and free it when not in use anymore.
  */
 onion_dict *onion_dict_dup(onion_dict * dict) {
-#ifdef HAVE_PTHREADS
-  pthread_mutex_lock(&dict->refmutex);
-#endif
-  dict->refcount++;
+  __sync_add_and_fetch(&dict->refcount, 1);
   ONION_DEBUG0("Dup %p, refcount %d", dict, dict->refcount);
-#ifdef HAVE_PTHREADS
-  pthread_mutex_unlock(&dict->refmutex);
-#endif
   return dict;
 }
 
@@ -173,9 +420,139 @@ void onion_dict_hard_dup_helper(onion_dict * dict, const char *key,
 onion_dict *onion_dict_hard_dup(onion_dict * dict) {
   onion_dict *d = onion_dict_new();
   onion_dict_preorder(dict, onion_dict_hard_dup_helper, d);
+  d->changed = 0;
   return d;
 }
 
+static void onion_dict_share(onion_dict * dict);
+static void onion_dict_reset_changed(onion_dict * dict);
+
+/// Shares the subdicts too, so they are copied on write as well.
+static void onion_dict_share_helper(void *data, const char *key,
+                                    const void *value, int flags) {
+  if ((flags & OD_DICT) && !(((onion_dict *) value)->flags & OD_RCU))
+    onion_dict_share((onion_dict *) value);
+}
+
+/// Moves the content to a read only owner, so that snapshots can share it. Not changed anymore.
+static void onion_dict_share(onion_dict * dict) {
+  if (dict->shared)             // Already shared, and so unchanged
+    return;
+  onion_dict_preorder(dict, onion_dict_share_helper, NULL);
+  onion_dict *owner = onion_low_calloc(1, sizeof(onion_dict));
+  owner->root = dict->root;
+  owner->small = dict->small;
+  owner->hash = dict->hash;
+  owner->count = dict->count;
+  owner->flags = dict->flags | OD_NO_LOCK;      // Never changes, so no lock
+  owner->refcount = 1;
+  owner->cmp = dict->cmp;
+  owner->arena = dict->arena;
+  dict->shared = owner;
+  dict->changed = 0;
+}
+
+/**
+ * @short Creates a read only snapshot of the dict, that shares its memory until changed.
+ * @memberof onion_dict_t
+ * @ingroup dict
+ *
+ * It costs just a small struct, whatever the size of the dict. The snapshot and the original
+ * are separate dicts from now on: the first change on any of them copies the content, so the
+ * others keep seeing the old data. This is how the in memory sessions are given to each
+ * request.
+ *
+ * Subdicts are copied on write too: onion_dict_get_dict on a snapshot gives a subdict of
+ * its own, and changes on it make the parent count as changed.
+ *
+ * If the dict is not a snapshot itself, its content (and that of its subdicts) moves to a
+ * new read only owner, so if shared with other threads it needs the write lock. Snapshots of
+ * snapshots do not write anything, so several threads can take them at the same time.
+ * OD_RCU dicts are just copied, as their readers can not see the content change under them.
+ */
+onion_dict *onion_dict_snapshot(onion_dict * dict) {
+  if (dict->flags & OD_RCU)
+    return onion_dict_hard_dup(dict);
+  if (!dict->shared)
+    onion_dict_share(dict);
+
+  onion_dict *ret = onion_dict_new_with_flags(dict->flags & OD_NO_LOCK);
+  ret->root = dict->root;
+  ret->small = dict->small;
+  ret->hash = dict->hash;
+  ret->count = dict->count;
+  ret->flags = dict->flags;
+  ret->cmp = dict->cmp;
+  ret->arena = dict->arena;
+  ret->shared = onion_dict_dup(dict->shared);
+  return ret;
+}
+
+/// Subdicts are already shared, so they get just a snapshot.
+static void onion_dict_unshare_helper(onion_dict * dict, const char *key,
+                                      const void *value, int flags) {
+  if (flags & OD_DICT)
+    onion_dict_add(dict, key, onion_dict_snapshot((onion_dict *) value),
+                   OD_DUP_KEY | OD_FREE_VALUE | OD_DICT);
+  else
+    onion_dict_add(dict, key, value, OD_DUP_ALL);
+}
+
+/// At first change of a snapshot, gets its own copy of the content.
+static void onion_dict_unshare(onion_dict * dict) {
+  onion_dict *shared = dict->shared;
+  ONION_DEBUG0("Unshare %p from %p", dict, shared);
+  dict->shared = NULL;
+  dict->root = NULL;
+  dict->small = NULL;
+  dict->hash = NULL;
+  dict->arena = NULL;
+  dict->count = 0;
+  if (dict->flags & OD_HASH)
+    onion_dict_to_hash(dict);
+  onion_dict_preorder(shared, onion_dict_unshare_helper, dict);
+  onion_dict_free(shared);
+  dict->changed = 0;            // Same content yet; callers mark their changes
+}
+
+static void onion_dict_is_changed_helper(int *changed, const char *key,
+                                         const void *value, int flags) {
+  if ((flags & OD_DICT) && !*changed)
+    *changed = onion_dict_is_changed(value);
+}
+
+/**
+ * @short Whether the dict changed since created, or since its last snapshot.
+ * @memberof onion_dict_t
+ * @ingroup dict
+ *
+ * Dicts parsed from JSON or hard dupped count as just created. Changes on subdicts count
+ * too. Requests only save the session if it changed.
+ */
+int onion_dict_is_changed(const onion_dict * dict) {
+  if (!dict)
+    return 0;
+  if (dict->changed)
+    return 1;
+  if (dict->shared)             // Shared ones never changed
+    return 0;
+  int changed = 0;
+  onion_dict_preorder(dict, onion_dict_is_changed_helper, &changed);
+  return changed;
+}
+
+static void onion_dict_reset_changed_helper(void *data, const char *key,
+                                            const void *value, int flags) {
+  if (flags & OD_DICT)
+    onion_dict_reset_changed((onion_dict *) value);
+}
+
+/// Marks the dict and its subdicts as not changed.
+static void onion_dict_reset_changed(onion_dict * dict) {
+  dict->changed = 0;
+  onion_dict_preorder(dict, onion_dict_reset_changed_helper, NULL);
+}
+
 /// Removes a node and its data
 static void onion_dict_node_free(onion_dict_node * node) {
   if (node->left)
@@ -196,22 +573,47 @@ void onion_dict_free(onion_dict * dict) {
   if (!dict)                    // No free NULL
     return;
   ONION_DEBUG0("Free %p", dict);
+  int refcount = __sync_sub_and_fetch(&dict->refcount, 1);
+  ONION_DEBUG0("Free %p refcount %d", dict, refcount);
+  if (refcount == 0) {
 #ifdef HAVE_PTHREADS
-  pthread_mutex_lock(&dict->refmutex);
-#endif
-  dict->refcount--;
-  ONION_DEBUG0("Free %p refcount %d", dict, dict->refcount);
-  int remove = (dict->refcount == 0);
-#ifdef HAVE_PTHREADS
-  pthread_mutex_unlock(&dict->refmutex);
-#endif
-  if (remove) {
-#ifdef HAVE_PTHREADS
-    pthread_rwlock_destroy(&dict->lock);
-    pthread_mutex_destroy(&dict->refmutex);
+    if (dict->rcu) {
+      onion_dict_garbage_free(dict->rcu->garbage);
+      pthread_mutex_destroy(&dict->rcu->writer);
+      onion_low_free(dict->rcu);
+    } else if (!(dict->flags & OD_NO_LOCK))
+      pthread_rwlock_destroy(&dict->lock);
 #endif
+    if (dict->shared) {         // Content is not mine
+      onion_dict_free(dict->shared);
+      dict->root = NULL;
+      dict->small = NULL;
+      dict->hash = NULL;
+      dict->arena = NULL;
+    }
     if (dict->root)
       onion_dict_node_free(dict->root);
+    if (dict->small) {
+      int i;
+      for (i = 0; i < dict->count; i++)
+        onion_dict_node_data_free(&dict->small->data[i]);
+      onion_low_free(dict->small);
+    }
+    if (dict->hash) {
+      unsigned int i;
+      for (i = 0; i < dict->hash->size; i++) {
+        onion_dict_hash_slot *slot = &dict->hash->slots[i];
+        if (slot->state == OD_SLOT_USED) {
+          if (slot->inline_key)
+            slot->data.flags &= ~OD_FREE_KEY;
+          onion_dict_node_data_free(&slot->data);
+        }
+      }
+      onion_low_free(dict->hash->slots);
+      onion_low_free(dict->hash);
+    }
+    if (dict->arena)
+      onion_dict_arena_free(dict->arena);
     onion_low_free(dict);
   }
 }
@@ -354,6 +756,344 @@ static onion_dict_node *onion_dict_node_add(onion_dict * d,
   return node;
 }
 
+/// FNV-1a hash of the key, lowercase if case insensitive.
+static unsigned int onion_dict_hash_key(const onion_dict * dict,
+                                        const char *key) {
+  unsigned int h = 2166136261u;
+  if (dict->flags & OD_ICASE) {
+    for (; *key; key++) {
+      unsigned char c = *key;
+      if (c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+      h = (h ^ c) * 16777619u;
+    }
+  } else {
+    for (; *key; key++)
+      h = (h ^ (unsigned char)*key) * 16777619u;
+  }
+  return h;
+}
+
+/// Finds the first slot with that key, or NULL.
+static onion_dict_hash_slot *onion_dict_hash_find(const onion_dict * dict,
+                                                  const char *key) {
+  // Acquire loads, as OD_RCU readers may be here while a writer adds.
+  const onion_dict_hash *h = __atomic_load_n(&dict->hash, __ATOMIC_ACQUIRE);
+  unsigned int hash = onion_dict_hash_key(dict, key);
+  unsigned int mask = h->size - 1;
+  unsigned int i = hash & mask;
+  for (;;) {
+    onion_dict_hash_slot *slot = &h->slots[i];
+    unsigned char state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+    if (state == OD_SLOT_EMPTY)
+      return NULL;
+    if (state == OD_SLOT_USED && slot->hash == hash
+        && dict->cmp(key, slot->data.key) == 0)
+      return slot;
+    i = (i + 1) & mask;
+  }
+}
+
+/**
+ * @short Changes the size of the hash table, moving the used slots. If rehash, hashes are calculated again.
+ *
+ * It is a new table, and the old one is left untouched for OD_RCU readers.
+ */
+static void onion_dict_hash_resize(onion_dict * dict, unsigned int size,
+                                   int rehash) {
+  onion_dict_hash *old = dict->hash;
+  onion_dict_hash *h = onion_low_calloc(1, sizeof(onion_dict_hash));
+  h->slots = onion_low_calloc(size, sizeof(onion_dict_hash_slot));
+  h->size = size;
+  h->seq = old->seq;
+  unsigned int mask = size - 1;
+  unsigned int i;
+  for (i = 0; i < old->size; i++) {
+    if (old->slots[i].state != OD_SLOT_USED)
+      continue;
+    unsigned int hash = old->slots[i].hash;
+    if (rehash)
+      hash = onion_dict_hash_key(dict, old->slots[i].data.key);
+    unsigned int j = hash & mask;
+    while (h->slots[j].state != OD_SLOT_EMPTY)
+      j = (j + 1) & mask;
+    onion_dict_hash_slot *slot = &h->slots[j];
+    memcpy(slot, &old->slots[i], sizeof(onion_dict_hash_slot));
+    slot->hash = hash;
+    if (slot->inline_key)
+      slot->data.key = slot->key;
+    h->used++;
+  }
+  __atomic_store_n(&dict->hash, h, __ATOMIC_RELEASE);
+  onion_dict_retire_mem(dict, old->slots);
+  onion_dict_retire_mem(dict, old);
+}
+
+/// Ensures there is space for one more element.
+static void onion_dict_hash_reserve(onion_dict * dict) {
+  onion_dict_hash *h = dict->hash;
+  if ((h->used + 1) * 4 <= h->size * 3)
+    return;
+  unsigned int size = 16;
+  while (size * 3 < (dict->count + 1) * 8)      // So that after resize its at most 3/8 full
+    size *= 2;
+  onion_dict_hash_resize(dict, size, 0);
+}
+
+/// Sets the slot data, using the inline key if possible.
+static void onion_dict_hash_slot_set(onion_dict_hash_slot * slot,
+                                     const char *key, const void *value,
+                                     int flags) {
+  size_t l;
+  if ((flags & OD_DUP_KEY) == OD_DUP_KEY
+      && (l = strlen(key)) < ONION_DICT_INLINE_KEY) {
+    onion_dict_set_node_data(&slot->data, key, value,
+                             flags & ~(OD_DUP_KEY & ~OD_FREE_KEY));
+    memcpy(slot->key, key, l + 1);
+    slot->data.key = slot->key;
+    slot->data.flags = flags;
+    slot->inline_key = 1;
+  } else {
+    onion_dict_set_node_data(&slot->data, key, value, flags);
+    slot->inline_key = 0;
+  }
+}
+
+/// Frees the slot data, now or when no reader can see it on OD_RCU dicts.
+static void onion_dict_hash_slot_free(onion_dict * dict,
+                                      onion_dict_hash_slot * slot) {
+  onion_dict_node_data data = slot->data;
+  if (slot->inline_key)         // Lives at the slot
+    data.flags &= ~OD_FREE_KEY;
+#ifdef HAVE_PTHREADS
+  if (dict->rcu) {
+    onion_dict_garbage *g = onion_low_calloc(1, sizeof(onion_dict_garbage));
+    g->data = data;
+    g->next = dict->rcu->garbage;
+    dict->rcu->garbage = g;
+    return;
+  }
+#endif
+  onion_dict_node_data_free(&data);
+}
+
+/// If readers may be looking at the dict without locks.
+static int onion_dict_is_rcu(const onion_dict * dict) {
+#ifdef HAVE_PTHREADS
+  return dict->rcu != NULL;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @short Adds to the hash table. Repeated keys are kept, unless OD_REPLACE.
+ *
+ * On OD_RCU dicts slots are only written before they are marked as used, so replace adds
+ * a new slot and then removes the old one, and deleted slots are not reused until the
+ * next resize.
+ */
+static void onion_dict_hash_add(onion_dict * dict, const char *key,
+                                const void *value, int flags) {
+  onion_dict_hash_slot *slot, *old = NULL;
+  int rcu = onion_dict_is_rcu(dict);
+  if (flags & OD_REPLACE) {
+    slot = onion_dict_hash_find(dict, key);
+    if (slot && !rcu) {
+      onion_dict_hash_slot_free(dict, slot);
+      onion_dict_hash_slot_set(slot, key, value, flags);
+      return;
+    }
+    if (slot)
+      old = slot;
+  }
+  onion_dict_hash_reserve(dict);
+  if (old)                      // May have moved
+    old = onion_dict_hash_find(dict, key);
+  onion_dict_hash *h = dict->hash;
+  unsigned int hash = onion_dict_hash_key(dict, key);
+  unsigned int mask = h->size - 1;
+  unsigned int i = hash & mask;
+  while (h->slots[i].state == OD_SLOT_USED
+         || (rcu && h->slots[i].state == OD_SLOT_DELETED))
+    i = (i + 1) & mask;
+  slot = &h->slots[i];
+  if (slot->state == OD_SLOT_EMPTY)
+    h->used++;
+  slot->hash = hash;
+  slot->seq = h->seq++;
+  onion_dict_hash_slot_set(slot, key, value, flags);
+  __atomic_store_n(&slot->state, OD_SLOT_USED, __ATOMIC_RELEASE);
+  if (old) {
+    __atomic_store_n(&old->state, OD_SLOT_DELETED, __ATOMIC_RELEASE);
+    onion_dict_hash_slot_free(dict, old);
+  } else
+    dict->count++;
+}
+
+/// Moves the data to a new slot of the hash, while converting. Must be called in order.
+static void onion_dict_hash_move_data(onion_dict * dict,
+                                      const onion_dict_node_data * data) {
+  onion_dict_hash *h = dict->hash;
+  unsigned int hash = onion_dict_hash_key(dict, data->key);
+  unsigned int mask = h->size - 1;
+  unsigned int i = hash & mask;
+  while (h->slots[i].state != OD_SLOT_EMPTY)
+    i = (i + 1) & mask;
+  onion_dict_hash_slot *slot = &h->slots[i];
+  slot->state = OD_SLOT_USED;
+  slot->hash = hash;
+  slot->seq = h->seq++;
+  slot->data = *data;
+  h->used++;
+}
+
+/// Moves the tree nodes data to the hash, in order, and frees the nodes.
+static void onion_dict_node_move_to_hash(onion_dict * dict,
+                                         onion_dict_node * node) {
+  if (node->left)
+    onion_dict_node_move_to_hash(dict, node->left);
+  onion_dict_hash_move_data(dict, &node->data);
+  if (node->right)
+    onion_dict_node_move_to_hash(dict, node->right);
+  onion_low_free(node);
+}
+
+/// Changes the representation from small array or tree to hash table.
+static void onion_dict_to_hash(onion_dict * dict) {
+  onion_dict_hash *h = onion_low_calloc(1, sizeof(onion_dict_hash));
+  h->size = 16;
+  while (h->size * 3 < dict->count * 8)
+    h->size *= 2;
+  h->slots = onion_low_calloc(h->size, sizeof(onion_dict_hash_slot));
+  dict->hash = h;
+  if (dict->small) {
+    int i;
+    for (i = 0; i < dict->count; i++)
+      onion_dict_hash_move_data(dict, &dict->small->data[i]);
+    onion_low_free(dict->small);
+    dict->small = NULL;
+  }
+  if (dict->root)
+    onion_dict_node_move_to_hash(dict, dict->root);
+  dict->root = NULL;
+}
+
+/// Merge sort, as qsort has no user data for the cmp. Sorts by key, and insertion order.
+static void onion_dict_hash_sort(onion_dict_hash_slot ** slots,
+                                 onion_dict_hash_slot ** tmp, int n,
+                                 int (*cmp) (const char *, const char *)) {
+  if (n < 2)
+    return;
+  int half = n / 2;
+  onion_dict_hash_sort(slots, tmp, half, cmp);
+  onion_dict_hash_sort(slots + half, tmp, n - half, cmp);
+  int i = 0, j = half, k = 0;
+  while (i < half && j < n) {
+    int c = cmp(slots[i]->data.key, slots[j]->data.key);
+    if (c < 0 || (c == 0 && slots[i]->seq < slots[j]->seq))
+      tmp[k++] = slots[i++];
+    else
+      tmp[k++] = slots[j++];
+  }
+  while (i < half)
+    tmp[k++] = slots[i++];
+  while (j < n)
+    tmp[k++] = slots[j++];
+  memcpy(slots, tmp, n * sizeof(onion_dict_hash_slot *));
+}
+
+/// Calls func on all elements, sorted.
+static void onion_dict_hash_preorder(const onion_dict * dict, void *func,
+                                     void *data) {
+  void (*f) (void *data, const char *key, const void *value, int flags);
+  f = func;
+  const onion_dict_hash *h = __atomic_load_n(&dict->hash, __ATOMIC_ACQUIRE);
+  int n = dict->count;
+  if (n == 0)
+    return;
+  onion_dict_hash_slot **sorted =
+      onion_low_malloc(2 * n * sizeof(onion_dict_hash_slot *));
+  unsigned int i;
+  int k = 0;
+  for (i = 0; i < h->size && k < n; i++)        // On OD_RCU dicts count may be changing
+    if (__atomic_load_n(&h->slots[i].state, __ATOMIC_ACQUIRE) == OD_SLOT_USED)
+      sorted[k++] = &h->slots[i];
+  n = k;
+  onion_dict_hash_sort(sorted, sorted + n, n, dict->cmp);
+  for (k = 0; k < n; k++)
+    f(data, sorted[k]->data.key, sorted[k]->data.value, sorted[k]->data.flags);
+  onion_low_free(sorted);
+}
+
+/// Index of the first element with that key at the small array, or -1.
+static int onion_dict_small_find(const onion_dict * dict, const char *key) {
+  const onion_dict_small *small = dict->small;
+  unsigned int hash = onion_dict_hash_key(dict, key);
+  int i;
+  for (i = 0; i < dict->count; i++)
+    if (small->hash[i] == hash && dict->cmp(key, small->data[i].key) == 0)
+      return i;
+  return -1;
+}
+
+/// Sorts again, stable, after changing the cmp function.
+static void onion_dict_small_sort(onion_dict * dict) {
+  onion_dict_small *small = dict->small;
+  int i, j;
+  for (i = 0; i < dict->count; i++) {
+    onion_dict_node_data data = small->data[i];
+    for (j = i; j > 0 && dict->cmp(small->data[j - 1].key, data.key) > 0; j--)
+      small->data[j] = small->data[j - 1];
+    small->data[j] = data;
+  }
+  for (i = 0; i < dict->count; i++)
+    small->hash[i] = onion_dict_hash_key(dict, small->data[i].key);
+}
+
+/// Adds to the small array. Returns 0 if there is no space.
+static int onion_dict_small_add(onion_dict * dict, const char *key,
+                                const void *value, int flags) {
+  onion_dict_small *small = dict->small;
+  if (flags & OD_REPLACE) {
+    int i = onion_dict_small_find(dict, key);
+    if (i >= 0) {
+      onion_dict_node_data_free(&small->data[i]);
+      onion_dict_set_node_data(&small->data[i], key, value, flags);
+      return 1;
+    }
+  }
+  if (dict->count == ONION_DICT_SMALL_SIZE)
+    return 0;
+  int pos = dict->count;        // After any same key, to keep insertion order
+  while (pos > 0 && dict->cmp(small->data[pos - 1].key, key) > 0)
+    pos--;
+  memmove(&small->data[pos + 1], &small->data[pos],
+          (dict->count - pos) * sizeof(onion_dict_node_data));
+  memmove(&small->hash[pos + 1], &small->hash[pos],
+          (dict->count - pos) * sizeof(unsigned int));
+  onion_dict_set_node_data(&small->data[pos], key, value, flags);
+  small->hash[pos] = onion_dict_hash_key(dict, key);
+  dict->count++;
+  return 1;
+}
+
+/// Changes the representation from small array to tree.
+static void onion_dict_small_to_tree(onion_dict * dict) {
+  int i;
+  for (i = 0; i < dict->count; i++) {
+    onion_dict_node *node = onion_low_malloc(sizeof(onion_dict_node));
+    node->data = dict->small->data[i];
+    node->data.flags &= ~OD_REPLACE;    // Repeated keys are added, in order
+    node->left = NULL;
+    node->right = NULL;
+    node->level = 1;
+    dict->root = onion_dict_node_add(dict, dict->root, node);
+  }
+  onion_low_free(dict->small);
+  dict->small = NULL;
+}
+
 /**
  * @memberof onion_dict_t
  * @short Adds a value in the tree.
@@ -370,9 +1110,28 @@ void onion_dict_add(onion_dict * dict, const char *key, const void *value,
         ("Error, trying to add an empty key to a dictionary. There is a underliying bug here! Not adding anything.");
     return;
   }
+  if (dict->shared)
+    onion_dict_unshare(dict);
+  dict->changed = 1;
+  if (dict->hash) {
+    onion_dict_hash_add(dict, key, value, flags);
+    return;
+  }
+  if (!dict->root) {
+    if (!dict->small)
+      dict->small = onion_low_malloc(sizeof(onion_dict_small));
+    if (onion_dict_small_add(dict, key, value, flags))
+      return;
+    onion_dict_small_to_tree(dict);
+  }
+  if (!(flags & OD_REPLACE)
+      || !onion_dict_find_node(dict, dict->root, key, NULL))
+    dict->count++;
   dict->root =
       onion_dict_node_add(dict, dict->root,
                           onion_dict_node_new(key, value, flags));
+  if (dict->count > ONION_DICT_HASH_THRESHOLD)
+    onion_dict_to_hash(dict);
 }
 
 /// Frees the memory, if necesary of key and value
@@ -449,10 +1208,59 @@ static onion_dict_node *onion_dict_node_remove(const onion_dict * d,
  * Returns if it removed any node.
  */
 int onion_dict_remove(onion_dict * dict, const char *key) {
+  if (dict->shared) {
+    if (!onion_dict_find_data(dict, key))
+      return 0;
+    onion_dict_unshare(dict);
+  }
+  if (dict->hash) {
+    onion_dict_hash_slot *slot = onion_dict_hash_find(dict, key);
+    if (!slot)
+      return 0;
+    dict->changed = 1;
+    __atomic_store_n(&slot->state, OD_SLOT_DELETED, __ATOMIC_RELEASE);
+    onion_dict_hash_slot_free(dict, slot);
+    dict->count--;
+    return 1;
+  }
+  if (dict->small) {
+    onion_dict_small *small = dict->small;
+    int i = onion_dict_small_find(dict, key);
+    if (i < 0)
+      return 0;
+    dict->changed = 1;
+    onion_dict_node_data_free(&small->data[i]);
+    dict->count--;
+    memmove(&small->data[i], &small->data[i + 1],
+            (dict->count - i) * sizeof(onion_dict_node_data));
+    memmove(&small->hash[i], &small->hash[i + 1],
+            (dict->count - i) * sizeof(unsigned int));
+    return 1;
+  }
+  if (!onion_dict_find_node(dict, dict->root, key, NULL))
+    return 0;
+  dict->changed = 1;
   dict->root = onion_dict_node_remove(dict, dict->root, key);
+  dict->count--;
   return 1;
 }
 
+/// Finds the data for that key, whatever the representation.
+static const onion_dict_node_data *onion_dict_find_data(const onion_dict *
+                                                        dict, const char *key) {
+  if (dict->hash) {
+    const onion_dict_hash_slot *slot = onion_dict_hash_find(dict, key);
+    return slot ? &slot->data : NULL;
+  }
+  if (dict->small) {
+    int i = onion_dict_small_find(dict, key);
+    return i >= 0 ? &dict->small->data[i] : NULL;
+  }
+  const onion_dict_node *node =
+      onion_dict_find_node(dict, dict->root, key, NULL);
+  return node ? &node->data : NULL;
+}
+
 /**
  * @short Gets a value. For dicts returns NULL; use onion_dict_get_dict.
  * @memberof onion_dict_t
@@ -460,10 +1268,20 @@ int onion_dict_remove(onion_dict * dict, const char *key) {
 const char *onion_dict_get(const onion_dict * dict, const char *key) {
   if (!dict)                    // Get from null dicts, returns null data.
     return NULL;
-  const onion_dict_node *r;
-  r = onion_dict_find_node(dict, dict->root, key, NULL);
-  if (r && !(r->data.flags & OD_DICT))
-    return r->data.value;
+  const onion_dict_node_data *r = onion_dict_find_data(dict, key);
+  if (r && !(r->flags & OD_DICT))
+    return r->value;
+  return NULL;
+}
+
+/// Gets the subdict as it is, for reading.
+static const onion_dict *onion_dict_find_dict(const onion_dict * dict,
+                                              const char *key) {
+  const onion_dict_node_data *r = onion_dict_find_data(dict, key);
+  if (r) {
+    if (r->flags & OD_DICT)
+      return r->value;
+  }
   return NULL;
 }
 
@@ -471,15 +1289,17 @@ const char *onion_dict_get(const onion_dict * dict, const char *key) {
  * @short Gets a value, only if its a dict
  * @memberof onion_dict_t
  * @ingroup dict
+ *
+ * On a snapshot it first gets its own copy of the content (not a change), so the returned
+ * subdict can be changed without changing the other snapshots.
  */
 onion_dict *onion_dict_get_dict(const onion_dict * dict, const char *key) {
-  const onion_dict_node *r;
-  r = onion_dict_find_node(dict, dict->root, key, NULL);
-  if (r) {
-    if (r->data.flags & OD_DICT)
-      return (onion_dict *) r->data.value;
+  const onion_dict *sub = onion_dict_find_dict(dict, key);
+  if (sub && dict->shared) {
+    onion_dict_unshare((onion_dict *) dict);
+    sub = onion_dict_find_dict(dict, key);
   }
-  return NULL;
+  return (onion_dict *) sub;
 }
 
 static void onion_dict_node_print_dot(const onion_dict_node * node) {
@@ -509,6 +1329,17 @@ static void onion_dict_node_print_dot(const onion_dict_node * node) {
 void onion_dict_print_dot(const onion_dict * dict) {
   if (dict->root)
     onion_dict_node_print_dot(dict->root);
+  if (dict->small) {
+    int i;
+    for (i = 0; i < dict->count; i++)
+      fprintf(stderr, "\"%s\";\n", dict->small->data[i].key);
+  }
+  if (dict->hash) {             // No structure to show, just the keys
+    unsigned int i;
+    for (i = 0; i < dict->hash->size; i++)
+      if (dict->hash->slots[i].state == OD_SLOT_USED)
+        fprintf(stderr, "\"%s\";\n", dict->hash->slots[i].data.key);
+  }
 }
 
 static void onion_dict_node_preorder(const onion_dict_node * node, void *func,
@@ -532,18 +1363,19 @@ static void onion_dict_node_preorder(const onion_dict_node * node, void *func,
  * The function is of prototype void func(void *data, const char *key, const void *value, int flags);
  */
 void onion_dict_preorder(const onion_dict * dict, void *func, void *data) {
-  if (!dict || !dict->root)
+  if (!dict)
     return;
-  onion_dict_node_preorder(dict->root, func, data);
-}
-
-static int onion_dict_node_count(const onion_dict_node * node) {
-  int c = 1;
-  if (node->left)
-    c += onion_dict_node_count(node->left);
-  if (node->right)
-    c += onion_dict_node_count(node->right);
-  return c;
+  if (dict->hash)
+    onion_dict_hash_preorder(dict, func, data);
+  else if (dict->small) {
+    void (*f) (void *data, const char *key, const void *value, int flags);
+    f = func;
+    int i;
+    for (i = 0; i < dict->count; i++)
+      f(data, dict->small->data[i].key, dict->small->data[i].value,
+        dict->small->data[i].flags);
+  } else if (dict->root)
+    onion_dict_node_preorder(dict->root, func, data);
 }
 
 /**
@@ -552,8 +1384,8 @@ static int onion_dict_node_count(const onion_dict_node * node) {
  * @ingroup dict
  */
 int onion_dict_count(const onion_dict * dict) {
-  if (dict && dict->root)
-    return onion_dict_node_count(dict->root);
+  if (dict)
+    return dict->count;
   return 0;
 }
 
@@ -561,10 +1393,16 @@ int onion_dict_count(const onion_dict * dict) {
  * Do a read lock. Several can lock for reading, but only can be writing.
  * @memberof onion_dict_t
  * @ingroup dict
+ *
+ * On OD_RCU dicts it never blocks, and on OD_NO_LOCK dicts it does nothing. On OD_RCU dicts
+ * the same thread can not get the write lock until unlocked.
  */
 void onion_dict_lock_read(const onion_dict * dict) {
 #ifdef HAVE_PTHREADS
-  pthread_rwlock_rdlock((pthread_rwlock_t *) & dict->lock);
+  if (dict->rcu)
+    onion_dict_rcu_read_lock(dict->rcu);
+  else if (!(dict->flags & OD_NO_LOCK))
+    pthread_rwlock_rdlock((pthread_rwlock_t *) & dict->lock);
 #endif
 }
 
@@ -572,10 +1410,21 @@ void onion_dict_lock_read(const onion_dict * dict) {
  * @short Do a read lock. Several can lock for reading, but only can be writing.
  * @memberof onion_dict_t
  * @ingroup dict
+ *
+ * On OD_RCU dicts it only waits for other writers. If this thread holds the read lock it would
+ * deadlock at onion_dict_unlock waiting for itself, so it aborts instead.
  */
 void onion_dict_lock_write(onion_dict * dict) {
 #ifdef HAVE_PTHREADS
-  pthread_rwlock_wrlock(&dict->lock);
+  if (dict->rcu) {
+    if (onion_dict_rcu_is_reading(dict->rcu)) {
+      ONION_ERROR
+          ("Write lock of an OD_RCU dict while holding its read lock at the same thread. It would deadlock. Aborting.");
+      abort();
+    }
+    pthread_mutex_lock(&dict->rcu->writer);
+  } else if (!(dict->flags & OD_NO_LOCK))
+    pthread_rwlock_wrlock(&dict->lock);
 #endif
 }
 
@@ -583,33 +1432,32 @@ void onion_dict_lock_write(onion_dict * dict) {
  * @short Free latest lock be it read or write.
  * @memberof onion_dict_t
  * @ingroup dict
+ *
+ * On OD_RCU dicts, after a write it waits until the readers that may be using removed
+ * data finish, and frees it.
  */
 void onion_dict_unlock(onion_dict * dict) {
 #ifdef HAVE_PTHREADS
-  pthread_rwlock_unlock(&dict->lock);
+  if (dict->rcu)
+    onion_dict_rcu_unlock(dict->rcu);
+  else if (!(dict->flags & OD_NO_LOCK))
+    pthread_rwlock_unlock(&dict->lock);
 #endif
 }
 
 /**
  * @short Helps to prepare each pair.
  */
+static void onion_dict_json_add(onion_block * block, const onion_dict * dict);
+
 static void onion_dict_json_preorder(onion_block * block, const char *key,
                                      const void *value, int flags) {
-  if (!onion_block_size(block)) // Error somewhere.
-    return;
   onion_block_add_char(block, '\"');
   onion_json_quote_add(block, key);
   onion_block_add_data(block, "\":", 2);
-  if (flags & OD_DICT) {
-    onion_block *tmp;
-    tmp = onion_dict_to_json((onion_dict *) value);
-    if (!tmp) {
-      onion_block_clear(block);
-      return;
-    }
-    onion_block_add_block(block, tmp);
-    onion_block_free(tmp);
-  } else {
+  if (flags & OD_DICT)
+    onion_dict_json_add(block, value);
+  else {
     onion_block_add_char(block, '\"');
     onion_json_quote_add(block, value);
     onion_block_add_char(block, '\"');
@@ -624,27 +1472,22 @@ static void onion_dict_json_preorder(onion_block * block, const char *key,
  *
  * Given a dictionary and a buffer (with size), it writes a json dictionary to it.
  *
- * @returns an onion_block with the json data, or NULL on error
+ * @returns an onion_block with the json data
  */
 onion_block *onion_dict_to_json(onion_dict * dict) {
   onion_block *block = onion_block_new();
+  onion_dict_json_add(block, dict);
+  return block;
+}
 
+/// Adds the dict as json to the block. Subdicts are added to the same block, not copied.
+static void onion_dict_json_add(onion_block * block, const onion_dict * dict) {
+  off_t start = onion_block_size(block);
   onion_block_add_char(block, '{');
-  if (dict && dict->root)
-    onion_dict_node_preorder(dict->root, (void *)onion_dict_json_preorder,
-                             block);
-
-  int s = onion_block_size(block);
-  if (s == 0) {                 // Error.
-    onion_block_free(block);
-    return NULL;
-  }
-  if (s != 1)                   // To remove a final ", "
+  onion_dict_preorder(dict, (void *)onion_dict_json_preorder, block);
+  if (onion_block_size(block) != start + 1)     // To remove a final ", "
     onion_block_rewind(block, 2);
-
   onion_block_add_char(block, '}');
-
-  return block;
 }
 
 /**
@@ -670,7 +1513,7 @@ const char *onion_dict_rget(const onion_dict * dict, const char *key, ...) {
       va_end(va);
       return onion_dict_get(d, k);
     }
-    d = onion_dict_get_dict(d, k);
+    d = onion_dict_find_dict(d, k);
     k = nextk;
   }
   va_end(va);
@@ -705,128 +1548,386 @@ onion_dict *onion_dict_rget_dict(const onion_dict * dict, const char *key, ...)
   return NULL;
 }
 
-static onion_dict *onion_dict_from_json_(const char **data);
+/// Maximum nesting of objects and arrays when parsing JSON.
+#define ONION_DICT_JSON_MAX_DEPTH 64
+
+/// One open object or array while parsing.
+typedef struct onion_dict_json_level_t {
+  onion_dict *dict;
+  int index;                    ///< Next index for arrays, -1 for objects.
+} onion_dict_json_level;
+
+static char *onion_dict_json_skip_space(char *p) {
+  while (is_json_space(*p))
+    ++p;
+  return p;
+}
 
 /**
- * @short Creates a dict from a json
- * @ingroup dict
+ * @short Returns the first '"', '\\' or control char, including the final \0.
  *
- * Onion dicts do not support full json semantics, soit will do the translations as possible;
- * sometimes information may be lost.
+ * Checks 8 bytes at a time, and only looks byte by byte at the word that has one of them.
+ */
+static char *onion_dict_json_scan_string(char *p, const char *end) {
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t highs = 0x8080808080808080ULL;
+  while (end - p >= 8) {
+    uint64_t x, q, b;
+    memcpy(&x, p, 8);
+    q = x ^ (ones * '"');
+    b = x ^ (ones * '\\');
+    if ((((q - ones) & ~q) | ((b - ones) & ~b) | ((x - ones * 0x20) & ~x)) &
+        highs)
+      break;
+    p += 8;
+  }
+  while ((unsigned char)*p >= 0x20 && *p != '"' && *p != '\\')
+    ++p;
+  return p;
+}
+
+/// Reads 4 hex digits, or returns -1.
+static int onion_dict_json_hex4(const char *p) {
+  int i, ret = 0;
+  for (i = 0; i < 4; i++) {
+    char c = p[i];
+    ret <<= 4;
+    if (c >= '0' && c <= '9')
+      ret |= c - '0';
+    else if (c >= 'a' && c <= 'f')
+      ret |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      ret |= c - 'A' + 10;
+    else
+      return -1;
+  }
+  return ret;
+}
+
+/**
+ * @short Decodes the string at *_p in place.
  *
- * Anyway dicts created by onion are ensured to be readable by onion.
+ * The decoded string is never longer than the quoted one, so it is written over it, and the
+ * closing quote leaves room for the \0.
  *
- * If the data is invalid NULL is returned.
+ * @returns the decoded string, and *_p after the closing quote; or NULL on error.
  */
-onion_dict *onion_dict_from_json(const char *data) {
-  if (!data)
-    return NULL;
-  const char *_data[1] = { data };
-  onion_dict *ret = onion_dict_from_json_(_data);
-  while (is_json_space(*_data[0]))
-    ++_data[0];
-  if (*_data[0]) {
-    ONION_DEBUG("Invalid JSON, not ends at end");
-    onion_dict_free(ret);
-    return NULL;
+static char *onion_dict_json_string(char **_p, const char *end) {
+  char *p = *_p + 1;
+  char *str = p;
+  char *w;
+  p = onion_dict_json_scan_string(p, end);
+  w = p;
+  for (;;) {
+    if (*p == '"') {
+      *w = 0;
+      *_p = p + 1;
+      return str;
+    }
+    if (*p != '\\') {
+      ONION_DEBUG("Invalid char %d inside JSON string", *p);
+      return NULL;
+    }
+    ++p;
+    switch (*p) {
+    case '"':
+    case '\\':
+    case '/':
+      *w++ = *p++;
+      break;
+    case 'b':
+      *w++ = '\b';
+      p++;
+      break;
+    case 'f':
+      *w++ = '\f';
+      p++;
+      break;
+    case 'n':
+      *w++ = '\n';
+      p++;
+      break;
+    case 'r':
+      *w++ = '\r';
+      p++;
+      break;
+    case 't':
+      *w++ = '\t';
+      p++;
+      break;
+    case 'u':{
+        int uc = onion_dict_json_hex4(p + 1), uc2;
+        if (uc <= 0 || (uc >= 0xdc00 && uc <= 0xdfff)) {
+ bad_utf16:
+          ONION_DEBUG
+              ("Expected a valid non-NUL UTF-16 char in hex, got something else");
+          return NULL;
+        }
+        p += 5;
+        if (uc >= 0xd800 && uc <= 0xdbff) {     // Surrogate pair
+          if (p[0] != '\\' || p[1] != 'u')
+            goto bad_utf16;
+          uc2 = onion_dict_json_hex4(p + 2);
+          if (uc2 < 0xdc00 || uc2 > 0xdfff)
+            goto bad_utf16;
+          p += 6;
+          uc = ((uc - 0xd7c0) << 10) | (uc2 & 0x3ff);
+        }
+        if (uc < 0x80)
+          *w++ = uc;
+        else if (uc < 0x800) {
+          *w++ = 0xc0 | (uc >> 6);
+          *w++ = 0x80 | (uc & 0x3f);
+        } else if (uc < 0x10000) {
+          *w++ = 0xe0 | (uc >> 12);
+          *w++ = 0x80 | ((uc >> 6) & 0x3f);
+          *w++ = 0x80 | (uc & 0x3f);
+        } else {
+          *w++ = 0xf0 | (uc >> 18);
+          *w++ = 0x80 | ((uc >> 12) & 0x3f);
+          *w++ = 0x80 | ((uc >> 6) & 0x3f);
+          *w++ = 0x80 | (uc & 0x3f);
+        }
+      }
+      break;
+    default:
+      ONION_DEBUG("Invalid escape \\%c in JSON string", *p);
+      return NULL;
+    }
+    // Copy the run until the next escape or end
+    char *next = onion_dict_json_scan_string(p, end);
+    memmove(w, p, next - p);
+    w += next - p;
+    p = next;
   }
-  return ret;
 }
 
-/// Real dict_from_json, reads until {} matches.
-/// The other checks also that there is nothing after the json data.
-static onion_dict *onion_dict_from_json_(const char **_data) {
-  const char *data = *_data;
-  ONION_DEBUG("Parse %s", *_data);
-  while (is_json_space(*data))
-    ++data;
-  if (*data != '{')
+/**
+ * @short Checks the number at *_p, and makes it a string.
+ *
+ * There is no room for the \0 after a number, as the next char is still to be parsed, so it
+ * is moved one byte back, over the ':', ',', '[' or space before it, that are already parsed.
+ *
+ * @returns the number as a string, and *_p after it; or NULL on error.
+ */
+static char *onion_dict_json_number(char **_p) {
+  char *start = *_p, *p = start;
+  if (*p == '-')
+    ++p;
+  if (*p == '0')
+    ++p;
+  else if (is_json_digit(*p)) {
+    while (is_json_digit(*p))
+      ++p;
+  } else
     return NULL;
-  ++data;
-
-  while (is_json_space(*data))
-    ++data;
-  ;
-  onion_dict *ret = onion_dict_new();
-  onion_block *key = onion_block_new();
-  onion_block *value = onion_block_new();
-  while (*data != '}') {
-    // Get Key
-    ssize_t read_bytes = onion_json_unquote_add(key, data);
-    if (read_bytes < 0)
-      goto error;
-    data += read_bytes;
-
-    while (is_json_space(*data))
-      ++data;
-
-    /// Get :
-    if (*data != ':') {         // Includes \0
-      ONION_DEBUG("Expected : got %c", *data);
-      goto error;
-    }
-    ++data;
-    while (is_json_space(*data))
-      ++data;
+  if (*p == '.') {
+    ++p;
+    if (!is_json_digit(*p))
+      return NULL;
+    while (is_json_digit(*p))
+      ++p;
+  }
+  if (*p == 'e' || *p == 'E') {
+    ++p;
+    if (*p == '+' || *p == '-')
+      ++p;
+    if (!is_json_digit(*p))
+      return NULL;
+    while (is_json_digit(*p))
+      ++p;
+  }
+  memmove(start - 1, start, p - start);
+  p[-1] = 0;
+  *_p = p;
+  return start - 1;
+}
 
-    /// Get Value
-    if (*data == '{') {         // Includes \0
-      *_data = data;
+static onion_dict *onion_dict_json_new(onion_dict_arena * arena) {
+  onion_dict *dict = onion_dict_new();
+  dict->arena = arena;
+  arena->refcount++;            // Not shared yet
+  return dict;
+}
 
-      onion_dict *sub = onion_dict_from_json_(_data);
-      if (!sub) {
-        goto error;
+/**
+ * @short Parses the JSON at data, that ends at end, in place.
+ *
+ * Single pass, without recursion: open objects and arrays are kept in a small stack.
+ */
+static onion_dict *onion_dict_json_parse(onion_dict_arena * arena, char *p,
+                                         const char *end) {
+  onion_dict_json_level stack[ONION_DICT_JSON_MAX_DEPTH];
+  int depth = 1;
+  int first = 1;
+  p = onion_dict_json_skip_space(p);
+  if (*p != '{') {
+    ONION_DEBUG("JSON data must be an object");
+    return NULL;
+  }
+  ++p;
+  onion_dict *ret = onion_dict_json_new(arena);
+  stack[0].dict = ret;
+  stack[0].index = -1;
+
+  while (depth) {
+    onion_dict_json_level *level = &stack[depth - 1];
+    const char *key;
+    char keytmp[16];
+    int flags = 0;
+    char *value;
+
+    p = onion_dict_json_skip_space(p);
+    if (!first || *p != (level->index < 0 ? '}' : ']')) {
+      // Get key
+      if (level->index < 0) {
+        if (*p != '"') {
+          ONION_DEBUG("Expected \" got %c", *p);
+          goto error;
+        }
+        key = onion_dict_json_string(&p, end);
+        if (!key)
+          goto error;
+        p = onion_dict_json_skip_space(p);
+        if (*p != ':') {        // Includes \0
+          ONION_DEBUG("Expected : got %c", *p);
+          goto error;
+        }
+        p = onion_dict_json_skip_space(p + 1);
+      } else {                  // Arrays are dicts with the index as key
+        snprintf(keytmp, sizeof(keytmp), "%d", level->index++);
+        key = keytmp;
+        flags = OD_DUP_KEY;
       }
-      onion_dict_add(ret, onion_block_data(key), sub,
-                     OD_DUP_KEY | OD_DICT | OD_FREE_VALUE);
-      data = *_data;
-    } else if (is_json_digit(*data)) {
-      while (is_json_digit(*data)) {
-        onion_block_add_char(value, *data);
-        ++data;
+
+      // Get value
+      switch (*p) {
+      case '{':
+      case '[':
+        if (depth == ONION_DICT_JSON_MAX_DEPTH) {
+          ONION_DEBUG("JSON too deep, max %d levels",
+                      ONION_DICT_JSON_MAX_DEPTH);
+          goto error;
+        }
+        stack[depth].dict = onion_dict_json_new(arena);
+        stack[depth].index = (*p == '{') ? -1 : 0;
+        onion_dict_add(level->dict, key, stack[depth].dict,
+                       flags | OD_DICT | OD_FREE_VALUE);
+        depth++;
+        first = 1;
+        ++p;
+        continue;
+      case '"':
+        value = onion_dict_json_string(&p, end);
+        if (!value)
+          goto error;
+        onion_dict_add(level->dict, key, value, flags);
+        break;
+      case 't':
+        if (strncmp(p, "true", 4) != 0)
+          goto invalid_value;
+        onion_dict_add(level->dict, key, "true", flags);
+        p += 4;
+        break;
+      case 'f':
+        if (strncmp(p, "false", 5) != 0)
+          goto invalid_value;
+        onion_dict_add(level->dict, key, "false", flags);
+        p += 5;
+        break;
+      case 'n':                // null is as not set
+        if (strncmp(p, "null", 4) != 0)
+          goto invalid_value;
+        p += 4;
+        break;
+      default:
+        value = onion_dict_json_number(&p);
+        if (!value) {
+ invalid_value:
+          ONION_DEBUG("Invalid JSON value at %c", *p);     // Includes \0
+          goto error;
+        }
+        onion_dict_add(level->dict, key, value, flags);
+      }
+      p = onion_dict_json_skip_space(p);
+      if (*p == ',') {
+        ++p;
+        first = 0;
+        continue;
       }
-      onion_dict_add(ret, onion_block_data(key), onion_block_data(value),
-                     OD_DUP_ALL);
-      onion_block_clear(value);
-    } else if (*data == '"') {  // parse string
-      ssize_t read_bytes = onion_json_unquote_add(value, data);
-      if (read_bytes < 0)
-        goto error;
-      data += read_bytes;
-      onion_dict_add(ret, onion_block_data(key), onion_block_data(value),
-                     OD_DUP_ALL);
-      onion_block_clear(value);
-    } else {                    // Includes \0
-      ONION_DEBUG("Expected \" got %c", *data);
-      goto error;
-    }
-    onion_block_clear(key);
-
-    while (is_json_space(*data))
-      ++data;
-    if (*data == '}') {
-      ++data;
-      *_data = data;
-      onion_block_free(key);
-      onion_block_free(value);
-      return ret;
     }
-    if (*data != ',') {
-      ONION_DEBUG("Expected , got %c", *data);
-      goto error;
+    // Close current level, and maybe the parent ones too
+    for (;;) {
+      if (*p != (stack[depth - 1].index < 0 ? '}' : ']')) {
+        ONION_DEBUG("Expected , or end of %s, got %c",
+                    stack[depth - 1].index < 0 ? "object" : "array", *p);
+        goto error;
+      }
+      ++p;
+      if (--depth == 0)
+        break;
+      p = onion_dict_json_skip_space(p);
+      if (*p == ',') {
+        ++p;
+        first = 0;
+        break;
+      }
     }
-    ++data;
-    while (is_json_space(*data))
-      ++data;
-  }
-  ++data;
-  *_data = data;
-  onion_block_free(key);
-  onion_block_free(value);
+  }
+
+  p = onion_dict_json_skip_space(p);
+  if (p != end) {
+    ONION_DEBUG("Invalid JSON, not ends at end");
+    goto error;
+  }
   return ret;
  error:
-  onion_block_free(key);
-  onion_block_free(value);
   onion_dict_free(ret);
   return NULL;
 }
+
+/**
+ * @short Creates a dict from a json
+ * @ingroup dict
+ *
+ * Onion dicts do not support full json semantics, so it will do the translations as possible;
+ * sometimes information may be lost:
+ *
+ * - Arrays are dicts with "0", "1"... as keys.
+ * - Numbers, true and false are kept as strings, as written.
+ * - null values are not added, so they read as not set.
+ *
+ * Anyway dicts created by onion are ensured to be readable by onion.
+ *
+ * The data is copied once and all keys and values point inside that copy, so it is a single
+ * allocation for all the strings, shared by the dict and its subdicts.
+ *
+ * If the data is invalid NULL is returned.
+ */
+onion_dict *onion_dict_from_json(const char *data) {
+  if (!data)
+    return NULL;
+  return onion_dict_from_json_length(data, strlen(data));
+}
+
+/**
+ * @short Creates a dict from a json of the given length, that does not need to end in \0.
+ * @ingroup dict
+ *
+ * @see onion_dict_from_json
+ */
+onion_dict *onion_dict_from_json_length(const char *data, size_t length) {
+  if (!data)
+    return NULL;
+  onion_dict_arena *arena =
+      onion_low_malloc(sizeof(onion_dict_arena) + length + 1);
+  arena->refcount = 1;
+  memcpy(arena->data, data, length);
+  arena->data[length] = 0;
+  onion_dict *ret =
+      onion_dict_json_parse(arena, arena->data, arena->data + length);
+  onion_dict_arena_free(arena);
+  if (ret)
+    onion_dict_reset_changed(ret);
+  return ret;
+}
@@ -53,10 +53,15 @@ extern "C" {
 
     // Flags for onion_dict_set_flags
     OD_ICASE = 0x01,            ///< Do case insensitive cmps.
+    OD_HASH = 0x010000,         ///< Use a hash table instead of a tree. Big dicts change automatically.
+    OD_NO_LOCK = 0x020000,      ///< Only used by one thread: onion_dict_lock_* do nothing.
+    OD_RCU = 0x040000,          ///< Readers never block, writers free old data when no reader can see it. Implies OD_HASH. A thread can not write while reading it.
   };
 
 /// Initializes a dict.
   onion_dict *onion_dict_new();
+/// Initializes a dict with the given onion_dict_flags_e flags, as OD_NO_LOCK.
+  onion_dict *onion_dict_new_with_flags(int flags);
 
   void onion_dict_set_flags(onion_dict * dict, int flags);
 
@@ -79,6 +84,12 @@ extern "C" {
 /// Creates a hard duplicate of the dict.
   onion_dict *onion_dict_hard_dup(onion_dict * dict);
 
+/// Creates a snapshot of the dict, that shares its memory until any of them changes.
+  onion_dict *onion_dict_snapshot(onion_dict * dict);
+
+/// Whether it changed since created or since last snapshot.
+  int onion_dict_is_changed(const onion_dict * dict);
+
 /// Gets a value
   const char *onion_dict_get(const onion_dict * dict, const char *key);
 
@@ -114,6 +125,8 @@ extern "C" {
   onion_block *onion_dict_to_json(onion_dict * dict);
 /// Converts a C string into a dictionary
   onion_dict *onion_dict_from_json(const char *data);
+/// Converts a JSON of the given length into a dictionary
+  onion_dict *onion_dict_from_json_length(const char *data, size_t length);
 
 #ifdef __cplusplus
 }
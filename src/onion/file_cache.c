@@ -0,0 +1,431 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "file_cache.h"
+#include "shortcuts.h"
+#include "mime.h"
+#include "log.h"
+#include "low.h"
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+/// @defgroup file_cache File cache. Keeps static files open, with its metadata, between requests.
+
+/// Number of independent locked shards. Must be a power of 2.
+#define ONION_FILE_CACHE_SHARDS 16
+/// Number of hash buckets on each shard.
+#define ONION_FILE_CACHE_BUCKETS 32
+/// Default maximum number of entries, if not changed with ONION_FILE_CACHE envvar or onion_file_cache_set_max_entries.
+#define ONION_FILE_CACHE_DEFAULT_ENTRIES 256
+
+/**
+ * Entries keep the values of the headers (etag, mime), not a preformatted header
+ * block: onion_response keeps headers on a dict that the handler and the response
+ * itself (Date, Connection, Range) change until onion_response_write_headers.
+ */
+struct onion_file_cache_entry_t {
+  char *filename;
+  unsigned int hash;
+  int fd;
+  struct stat st;
+  char etag[32];
+  char *mime;
+  int mime_generation;          ///< To know if mime types changed since calculated.
+  time_t checked;               ///< Last time the file on disk was checked to be this one.
+  time_t used;                  ///< Last time it was returned by onion_file_cache_get, for eviction.
+  int refcount;                 ///< One for the cache itself, plus one per user.
+  bool cached;                  ///< If false, this entry is not on any shard, and refcount is not locked.
+  struct onion_file_cache_entry_t *next;
+};
+
+typedef struct onion_file_cache_shard_t {
+  onion_file_cache_entry *buckets[ONION_FILE_CACHE_BUCKETS];
+  int count;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;
+#endif
+} onion_file_cache_shard;
+
+static onion_file_cache_shard onion_file_cache_shards[ONION_FILE_CACHE_SHARDS];
+static int onion_file_cache_ttl = 1;
+static int onion_file_cache_max_entries = -1;
+
+#ifdef HAVE_PTHREADS
+static pthread_once_t onion_file_cache_once = PTHREAD_ONCE_INIT;
+#endif
+
+static void file_cache_init_once() {
+#ifdef HAVE_PTHREADS
+  int i;
+  for (i = 0; i < ONION_FILE_CACHE_SHARDS; i++)
+    pthread_mutex_init(&onion_file_cache_shards[i].mutex, NULL);
+#endif
+  if (onion_file_cache_max_entries < 0) {
+    const char *envmax = getenv("ONION_FILE_CACHE");
+    if (envmax)
+      onion_file_cache_max_entries = atoi(envmax);
+    else
+      onion_file_cache_max_entries = ONION_FILE_CACHE_DEFAULT_ENTRIES;
+    if (onion_file_cache_max_entries < 0)
+      onion_file_cache_max_entries = 0;
+  }
+}
+
+static void file_cache_init() {
+#ifdef HAVE_PTHREADS
+  pthread_once(&onion_file_cache_once, file_cache_init_once);
+#else
+  static int done = 0;
+  if (!done) {
+    file_cache_init_once();
+    done = 1;
+  }
+#endif
+}
+
+static void file_cache_lock(onion_file_cache_shard * shard) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&shard->mutex);
+#endif
+}
+
+static void file_cache_unlock(onion_file_cache_shard * shard) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&shard->mutex);
+#endif
+}
+
+/// FNV-1a, good enough for paths.
+static unsigned int file_cache_hash(const char *str) {
+  unsigned int h = 2166136261u;
+  while (*str) {
+    h ^= (unsigned char)*str++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static onion_file_cache_shard *file_cache_shard(unsigned int hash) {
+  return &onion_file_cache_shards[hash & (ONION_FILE_CACHE_SHARDS - 1)];
+}
+
+static onion_file_cache_entry **file_cache_bucket(onion_file_cache_shard *
+                                                  shard, unsigned int hash) {
+  return &shard->buckets[(hash / ONION_FILE_CACHE_SHARDS) %
+                         ONION_FILE_CACHE_BUCKETS];
+}
+
+/// Decrements the refcount, and frees if last. If cached, shard lock must be held.
+static void file_cache_unref(onion_file_cache_entry * entry) {
+  entry->refcount--;
+  if (entry->refcount > 0)
+    return;
+  ONION_DEBUG0("Closing cached file %s", entry->filename);
+  close(entry->fd);
+  onion_low_free(entry->filename);
+  onion_low_free(entry->mime);
+  onion_low_free(entry);
+}
+
+/// Removes the entry from the shard, if still there. Shard lock must be held.
+static void file_cache_unlink(onion_file_cache_shard * shard,
+                              onion_file_cache_entry * entry) {
+  onion_file_cache_entry **p = file_cache_bucket(shard, entry->hash);
+  while (*p) {
+    if (*p == entry) {
+      *p = entry->next;
+      entry->next = NULL;
+      shard->count--;
+      file_cache_unref(entry);
+      return;
+    }
+    p = &(*p)->next;
+  }
+}
+
+/// Removes the least recently used entry of the shard. Shard lock must be held.
+static void file_cache_evict(onion_file_cache_shard * shard) {
+  onion_file_cache_entry *oldest = NULL;
+  int i;
+  for (i = 0; i < ONION_FILE_CACHE_BUCKETS; i++) {
+    onion_file_cache_entry *e;
+    for (e = shard->buckets[i]; e; e = e->next)
+      if (!oldest || e->used < oldest->used)
+        oldest = e;
+  }
+  if (oldest)
+    file_cache_unlink(shard, oldest);
+}
+
+/// Checks if the file on disk is still the one we have open. Times with nanoseconds, as rewrites may be in the same second.
+static bool file_cache_is_same(const struct stat *a, const struct stat *b) {
+  return a->st_ino == b->st_ino && a->st_dev == b->st_dev
+      && a->st_size == b->st_size
+      && a->st_mtim.tv_sec == b->st_mtim.tv_sec
+      && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec
+      && a->st_ctim.tv_sec == b->st_ctim.tv_sec
+      && a->st_ctim.tv_nsec == b->st_ctim.tv_nsec;
+}
+
+/// Opens the file and fills a new entry with refcount 1.
+static onion_file_cache_entry *file_cache_entry_new(const char *filename,
+                                                    unsigned int hash,
+                                                    time_t now) {
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  if (O_CLOEXEC == 0) {         // Good compiler know how to cut this out
+    int flags = fcntl(fd, F_GETFD);
+    if (flags == -1) {
+      ONION_ERROR("Retrieving flags from file descriptor");
+    }
+    flags |= FD_CLOEXEC;
+    if (fcntl(fd, F_SETFD, flags) == -1) {
+      ONION_ERROR("Setting O_CLOEXEC to file descriptor");
+    }
+  }
+
+  onion_file_cache_entry *entry =
+      onion_low_calloc(1, sizeof(onion_file_cache_entry));
+  if (fstat(fd, &entry->st) != 0 || !S_ISREG(entry->st.st_mode)) {
+    close(fd);
+    onion_low_free(entry);
+    return NULL;
+  }
+  entry->fd = fd;
+  entry->filename = onion_low_strdup(filename);
+  entry->hash = hash;
+  entry->checked = now;
+  entry->used = now;
+  entry->refcount = 1;
+  onion_shortcut_etag(&entry->st, entry->etag);
+  entry->mime = onion_low_strdup(onion_mime_get(filename));
+  entry->mime_generation = onion_mime_generation();     // After get, as it may fill the mime types.
+  return entry;
+}
+
+/**
+ * @short Returns the open file and metadata for the given filename.
+ * @memberof onion_file_cache_entry_t
+ * @ingroup file_cache
+ *
+ * If the file was opened recently it reuses the same file descriptor, stat data, etag and
+ * mime type. Entries older than the TTL (1 second by default) are checked again with stat,
+ * and reopened if the file changed (size, mtime, ctime or inode), or if the mime types
+ * changed (onion_mime_update, onion_mime_set).
+ *
+ * The cache is split in several independently locked shards, so that concurrent requests for
+ * different files do not compete for the same lock.
+ *
+ * Max number of cached files can be set with the ONION_FILE_CACHE environment variable, or
+ * onion_file_cache_set_max_entries. 0 disables the cache, and each call opens the file again.
+ *
+ * The returned entry must be released with onion_file_cache_entry_free.
+ *
+ * @returns The entry, or NULL if the file can not be opened or is not a regular file.
+ */
+onion_file_cache_entry *onion_file_cache_get(const char *filename) {
+  file_cache_init();
+
+  unsigned int hash = file_cache_hash(filename);
+  time_t now = time(NULL);
+  if (onion_file_cache_max_entries == 0)
+    return file_cache_entry_new(filename, hash, now);
+
+  onion_file_cache_shard *shard = file_cache_shard(hash);
+  onion_file_cache_entry *entry;
+
+  file_cache_lock(shard);
+  for (entry = *file_cache_bucket(shard, hash); entry; entry = entry->next)
+    if (entry->hash == hash && strcmp(entry->filename, filename) == 0)
+      break;
+  if (entry) {
+    entry->refcount++;
+    entry->used = now;
+    bool mime_ok = (entry->mime_generation == onion_mime_generation());
+    if (mime_ok && now - entry->checked < onion_file_cache_ttl) {
+      file_cache_unlock(shard);
+      return entry;
+    }
+    file_cache_unlock(shard);
+
+    // Stale. Check without lock; we keep a reference so it can not go away.
+    struct stat st;
+    bool same = (mime_ok && stat(filename, &st) == 0
+                 && file_cache_is_same(&st, &entry->st));
+
+    file_cache_lock(shard);
+    if (same) {
+      entry->checked = now;
+      file_cache_unlock(shard);
+      return entry;
+    }
+    ONION_DEBUG0("File %s changed on disk", filename);
+    file_cache_unlink(shard, entry);
+    file_cache_unref(entry);
+    file_cache_unlock(shard);
+  } else
+    file_cache_unlock(shard);
+
+  entry = file_cache_entry_new(filename, hash, now);
+  if (!entry)
+    return NULL;
+  entry->cached = true;
+  entry->refcount++;            // One for the cache, one for the caller
+
+  int max_per_shard =
+      (onion_file_cache_max_entries + ONION_FILE_CACHE_SHARDS -
+       1) / ONION_FILE_CACHE_SHARDS;
+  onion_file_cache_entry **bucket = file_cache_bucket(shard, hash);
+
+  file_cache_lock(shard);
+  {                             // Maybe another thread opened it meanwhile. Newest wins.
+    onion_file_cache_entry *e;
+    for (e = *bucket; e; e = e->next)
+      if (e->hash == hash && strcmp(e->filename, filename) == 0) {
+        file_cache_unlink(shard, e);
+        break;
+      }
+  }
+  while (shard->count >= max_per_shard)
+    file_cache_evict(shard);
+  entry->next = *bucket;
+  *bucket = entry;
+  shard->count++;
+  file_cache_unlock(shard);
+
+  return entry;
+}
+
+/**
+ * @short Releases an entry as returned by onion_file_cache_get
+ * @memberof onion_file_cache_entry_t
+ * @ingroup file_cache
+ *
+ * The file descriptor is closed when no request and no cache slot use it anymore.
+ */
+void onion_file_cache_entry_free(onion_file_cache_entry * entry) {
+  if (!entry->cached) {
+    file_cache_unref(entry);
+    return;
+  }
+  onion_file_cache_shard *shard = file_cache_shard(entry->hash);
+  file_cache_lock(shard);
+  file_cache_unref(entry);
+  file_cache_unlock(shard);
+}
+
+/**
+ * @short Returns the file descriptor of this entry
+ * @memberof onion_file_cache_entry_t
+ * @ingroup file_cache
+ *
+ * It is shared with other requests, so do not change the file position; use pread or sendfile
+ * with an explicit offset.
+ */
+int onion_file_cache_entry_fd(onion_file_cache_entry * entry) {
+  return entry->fd;
+}
+
+/**
+ * @short Returns the stat data of this entry
+ * @memberof onion_file_cache_entry_t
+ * @ingroup file_cache
+ */
+const struct stat *onion_file_cache_entry_stat(onion_file_cache_entry * entry) {
+  return &entry->st;
+}
+
+/**
+ * @short Returns the etag of this entry, as by onion_shortcut_etag
+ * @memberof onion_file_cache_entry_t
+ * @ingroup file_cache
+ */
+const char *onion_file_cache_entry_etag(onion_file_cache_entry * entry) {
+  return entry->etag;
+}
+
+/**
+ * @short Returns the mime type of this entry, as by onion_mime_get
+ * @memberof onion_file_cache_entry_t
+ * @ingroup file_cache
+ */
+const char *onion_file_cache_entry_mime(onion_file_cache_entry * entry) {
+  return entry->mime;
+}
+
+/**
+ * @short Sets how many seconds an entry is used without checking the file on disk.
+ * @ingroup file_cache
+ *
+ * Default is 1 second. 0 means to stat the file on every request, but still saves the open.
+ */
+void onion_file_cache_set_ttl(int seconds) {
+  onion_file_cache_ttl = seconds;
+}
+
+/**
+ * @short Sets the maximum number of open files to keep
+ * @ingroup file_cache
+ *
+ * 0 disables the cache. Current entries are removed.
+ */
+void onion_file_cache_set_max_entries(int max_entries) {
+  file_cache_init();
+  onion_file_cache_clean();
+  onion_file_cache_max_entries = max_entries < 0 ? 0 : max_entries;
+}
+
+/**
+ * @short Removes all the cached entries
+ * @ingroup file_cache
+ *
+ * Entries still in use by some request are closed when that request finishes.
+ */
+void onion_file_cache_clean() {
+  file_cache_init();
+  int i, j;
+  for (i = 0; i < ONION_FILE_CACHE_SHARDS; i++) {
+    onion_file_cache_shard *shard = &onion_file_cache_shards[i];
+    file_cache_lock(shard);
+    for (j = 0; j < ONION_FILE_CACHE_BUCKETS; j++) {
+      while (shard->buckets[j])
+        file_cache_unlink(shard, shard->buckets[j]);
+    }
+    file_cache_unlock(shard);
+  }
+}
@@ -0,0 +1,58 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef ONION_FILE_CACHE_H
+#define ONION_FILE_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "types.h"
+
+/// Returns the (maybe cached) open file and metadata for that filename. NULL if not a regular readable file.
+  onion_file_cache_entry *onion_file_cache_get(const char *filename);
+/// Releases an entry as returned by onion_file_cache_get
+  void onion_file_cache_entry_free(onion_file_cache_entry * entry);
+
+/// Returns the read only file descriptor of the entry.
+  int onion_file_cache_entry_fd(onion_file_cache_entry * entry);
+/// Returns the stat data of the entry.
+  const struct stat *onion_file_cache_entry_stat(onion_file_cache_entry *
+                                                 entry);
+/// Returns the precalculated etag of the entry.
+  const char *onion_file_cache_entry_etag(onion_file_cache_entry * entry);
+/// Returns the precalculated mime type of the entry.
+  const char *onion_file_cache_entry_mime(onion_file_cache_entry * entry);
+
+/// Sets how many seconds an entry is trusted before checking the file again. 0 checks always.
+  void onion_file_cache_set_ttl(int seconds);
+/// Sets the maximum number of cached files. 0 disables the cache.
+  void onion_file_cache_set_max_entries(int max_entries);
+/// Removes all cached entries, closing the unused file descriptors.
+  void onion_file_cache_clean();
+
+#ifdef __cplusplus
+}
+#endif
+#endif
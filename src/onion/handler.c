@@ -73,8 +73,11 @@ onion_connection_status onion_handler_handle(onion_handler * handler,
           onion_response_set_length(response, response->buffer_pos);
         onion_response_flush(response);
         if (res == OCS_WEBSOCKET) {
-          if (request->websocket)
+          if (request->websocket) {
+            if (request->connection.slot)       // The poller calls it when there is data. See onion_request_process.
+              return OCS_WEBSOCKET;
             return onion_websocket_call(request->websocket);
+          }
           else {
             ONION_ERROR
                 ("Handler did set the OCS_WEBSOCKET, but did not initialize the websocket on this request.");
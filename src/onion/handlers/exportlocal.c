@@ -22,6 +22,7 @@
 */
 
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -32,6 +33,14 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <pwd.h>
+#include <errno.h>
+#include <time.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include <onion/shortcuts.h>
 #include <onion/handler.h>
@@ -39,21 +48,94 @@
 #include <onion/codecs.h>
 #include <onion/log.h>
 #include <onion/low.h>
+#include <onion/dict.h>
+#include <onion/mime.h>
+#include <onion/block.h>
+#include <onion/request.h>
 
 #include "exportlocal.h"
 
+/// A file kept in memory by the hot file cache, with its gzip version if worth it.
+typedef struct onion_handler_export_local_cached_t {
+  char *path;
+  char *data;
+  size_t size;
+  char *gzdata;                 ///< gzip compressed data, or NULL if not compressible.
+  size_t gzsize;
+  char *mime;
+  char etag[32];                ///< Same as onion_shortcut_response_file would give
+  char gzetag[40];              ///< The etag plus -gz, for the gzip variant
+  struct stat st;               ///< To revalidate against the stat done at each request
+  int refcount;                 ///< One for the cache, plus one for each request using it.
+  struct onion_handler_export_local_cached_t *prev, *next;      ///< LRU list, most recent first.
+} onion_handler_export_local_cached;
+
+/// In memory cache of small hot files. @see onion_handler_export_local_set_cache
+typedef struct onion_handler_export_local_cache_t {
+  onion_dict *entries;          ///< path -> onion_handler_export_local_cached
+  onion_handler_export_local_cached *head, *tail;
+  size_t size;                  ///< Memory used by cached data
+  size_t max_size;
+  size_t max_file_size;
+  int refcount;                 ///< One for the handler, plus one for each request using it.
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;
+#endif
+} onion_handler_export_local_cache;
+
+/// A file as shown at the directory listings
+typedef struct onion_handler_export_local_listing_entry_t {
+  const char *name;
+  off_t size;
+  const char *owner;            ///< At the owners cache, lives as long as the handler.
+  int is_dir;
+} onion_handler_export_local_listing_entry;
+
+/// Listing of a directory, as it was at the given mtime.
+typedef struct onion_handler_export_local_listing_t {
+  char *path;
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime;
+  onion_block *names;           ///< All names, 0 separated, to avoid one malloc per name.
+  onion_handler_export_local_listing_entry *entries;    ///< Sorted by name
+  int count;
+  onion_block *js;              ///< Already rendered for the HTML listing
+  int refcount;
+  struct onion_handler_export_local_listing_t *prev, *next;     ///< LRU list, most recent first.
+} onion_handler_export_local_listing;
+
 struct onion_handler_export_local_data_t {
   void (*renderer_header) (onion_response * res, const char *dirname);
   void (*renderer_footer) (onion_response * res, const char *dirname);
   char *localpath;
+  onion_handler_export_local_cache *cache;
+  onion_dict *owners;           ///< uid -> user name, as getpwuid is slow and not thread safe.
+  onion_dict *listings;         ///< path -> onion_handler_export_local_listing
+  onion_handler_export_local_listing *listings_head, *listings_tail;
+  int listings_count;
+  int listings_max;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;        ///< For owners, listings and to get the cache
+#endif
   int is_file:1;
 };
 
 typedef struct onion_handler_export_local_data_t
  onion_handler_export_local_data;
 
+static int onion_handler_export_local_cached_file(onion_handler_export_local_cache
+                                                  * cache, const char *realp,
+                                                  struct stat *reals,
+                                                  onion_request * req,
+                                                  onion_response * res);
+static onion_handler_export_local_cache
+    *export_local_cache_ref(onion_handler_export_local_data * d);
+static void export_local_cache_unref(onion_handler_export_local_cache * cache);
+
 int onion_handler_export_local_directory(onion_handler_export_local_data * data,
                                          const char *realp,
+                                         struct stat *reals,
                                          const char *showpath,
                                          onion_request * req,
                                          onion_response * res);
@@ -98,11 +180,20 @@ int onion_handler_export_local_handler(onion_handler_export_local_data * d,
 
   if (S_ISDIR(reals.st_mode)) {
     //ONION_DEBUG("DIR");
-    return onion_handler_export_local_directory(d, realp,
+    return onion_handler_export_local_directory(d, realp, &reals,
                                                 onion_request_get_path(request),
                                                 request, response);
   } else if (S_ISREG(reals.st_mode)) {
     //ONION_DEBUG("FILE");
+    onion_handler_export_local_cache *cache = export_local_cache_ref(d);
+    if (cache && reals.st_size <= cache->max_file_size) {
+      int r = onion_handler_export_local_cached_file(cache, realp, &reals,
+                                                     request, response);
+      export_local_cache_unref(cache);
+      return r;
+    }
+    if (cache)
+      export_local_cache_unref(cache);
     return onion_shortcut_response_file(realp, request, response);
   }
   ONION_DEBUG0("Dont know how to handle");
@@ -132,17 +223,339 @@ void onion_handler_export_local_footer_default(onion_response * res,
                         "Under <a href=\"http://www.gnu.org/licenses/lgpl-3.0.html\">LGPL 3.0.</a> License.</h2>\n");
 }
 
+/// Lock for owners and listings.
+static void export_local_lock(onion_handler_export_local_data * d) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&d->mutex);
+#endif
+}
+
+static void export_local_unlock(onion_handler_export_local_data * d) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&d->mutex);
+#endif
+}
+
+/**
+ * @short Returns the user name for that uid, from the owners cache if possible.
+ *
+ * Only found users are cached, so that a transient failure (NSS server down, for example)
+ * is retried on the next listing.
+ */
+static const char *export_local_owner(onion_handler_export_local_data * d,
+                                      uid_t uid) {
+  char key[24];
+  snprintf(key, sizeof(key), "%u", (unsigned int)uid);
+  export_local_lock(d);
+  const char *ret = onion_dict_get(d->owners, key);
+  if (!ret) {
+    struct passwd pwd, *res = NULL;
+    long size = sysconf(_SC_GETPW_R_SIZE_MAX);
+    if (size <= 0)
+      size = 1024;
+    char *buffer = onion_low_scalar_malloc(size);
+    int err;
+    while ((err = getpwuid_r(uid, &pwd, buffer, size, &res)) == ERANGE
+           && size < 1024 * 1024) {
+      size *= 2;
+      buffer = onion_low_realloc(buffer, size);
+    }
+    if (err == 0 && res) {
+      onion_dict_add(d->owners, key, res->pw_name, OD_DUP_ALL);
+      ret = onion_dict_get(d->owners, key);
+    } else
+      ret = "???";
+    onion_low_free(buffer);
+  }
+  export_local_unlock(d);
+  return ret;
+}
+
+/// Adds the string quoted for json. Also escapes <, so that it can be inside a <script>.
+static void export_local_json_quote_add(onion_block * b, const char *str) {
+  char tmp[NAME_MAX + 1];
+  onion_block_add_char(b, '"');
+  while (*str) {
+    size_t l = strcspn(str, "<");
+    if (l > NAME_MAX)
+      l = NAME_MAX;
+    memcpy(tmp, str, l);
+    tmp[l] = 0;
+    onion_json_quote_add(b, tmp);
+    str += l;
+    if (*str == '<') {
+      onion_block_add_str(b, "\\u003c");
+      str++;
+    }
+  }
+  onion_block_add_char(b, '"');
+}
+
+static int export_local_listing_entry_cmp(const void *a, const void *b) {
+  return strcmp(((const onion_handler_export_local_listing_entry *)a)->name,
+                ((const onion_handler_export_local_listing_entry *)b)->name);
+}
+
+/**
+ * @short Reads the directory into a new listing, with refcount 1.
+ *
+ * Uses fstatat relative to the directory, so no full path is built and resolved for each file. If
+ * the stat fails (dangling symlinks, races), d_type is used to know if it is a directory.
+ */
+static onion_handler_export_local_listing
+    *export_local_listing_new(onion_handler_export_local_data * d,
+                              const char *realp, struct stat *reals) {
+  DIR *dir = opendir(realp);
+  if (!dir)
+    return NULL;
+  int dfd = dirfd(dir);
+
+  onion_handler_export_local_listing *l =
+      onion_low_calloc(1, sizeof(onion_handler_export_local_listing));
+  l->path = onion_low_strdup(realp);
+  l->dev = reals->st_dev;
+  l->ino = reals->st_ino;
+  l->mtime = reals->st_mtim;
+  l->names = onion_block_new();
+  l->refcount = 1;
+
+  int max = 16;
+  size_t *offsets = onion_low_scalar_malloc(max * sizeof(size_t));
+  l->entries =
+      onion_low_malloc(max * sizeof(onion_handler_export_local_listing_entry));
+
+  struct dirent *fi;
+  struct stat st;
+  uid_t last_uid = 0;
+  const char *last_owner = NULL;
+  while ((fi = readdir(dir)) != NULL) {
+    if (fi->d_name[0] == '.')
+      continue;
+    if (l->count == max) {
+      max *= 2;
+      offsets = onion_low_realloc(offsets, max * sizeof(size_t));
+      l->entries =
+          onion_low_realloc(l->entries,
+                            max * sizeof(onion_handler_export_local_listing_entry));
+    }
+    onion_handler_export_local_listing_entry *e = &l->entries[l->count];
+    if (fstatat(dfd, fi->d_name, &st, 0) == 0) {
+      e->is_dir = S_ISDIR(st.st_mode);
+      e->size = st.st_size;
+      if (!last_owner || st.st_uid != last_uid) {       // Normally all from the same user
+        last_uid = st.st_uid;
+        last_owner = export_local_owner(d, st.st_uid);
+      }
+      e->owner = last_owner;
+    } else {
+      e->is_dir = (fi->d_type == DT_DIR);
+      e->size = 0;
+      e->owner = "???";
+    }
+    offsets[l->count] = onion_block_size(l->names);
+    onion_block_add_data(l->names, fi->d_name, strlen(fi->d_name) + 1);
+    l->count++;
+  }
+  closedir(dir);
+
+  // Now names will not move anymore
+  const char *names = onion_block_data(l->names);
+  int i;
+  for (i = 0; i < l->count; i++)
+    l->entries[i].name = names + offsets[i];
+  onion_low_free(offsets);
+  qsort(l->entries, l->count, sizeof(onion_handler_export_local_listing_entry),
+        export_local_listing_entry_cmp);
+
+  l->js = onion_block_new();
+  char tmp[64];
+  for (i = 0; i < l->count; i++) {
+    onion_handler_export_local_listing_entry *e = &l->entries[i];
+    onion_block_add_str(l->js, "  [");
+    if (e->is_dir) {
+      char name[NAME_MAX + 2];
+      snprintf(name, sizeof(name), "%s/", e->name);
+      export_local_json_quote_add(l->js, name);
+    } else
+      export_local_json_quote_add(l->js, e->name);
+    snprintf(tmp, sizeof(tmp), ",%lld,", (long long)e->size);
+    onion_block_add_str(l->js, tmp);
+    export_local_json_quote_add(l->js, e->owner);
+    onion_block_add_str(l->js, e->is_dir ? ",'dir'],\n" : ",'file'],\n");
+  }
+  return l;
+}
+
+/// Drops a reference to a listing. Lock must be held if it was ever at the cache.
+static void export_local_listing_unref(onion_handler_export_local_listing * l) {
+  l->refcount--;
+  if (l->refcount > 0)
+    return;
+  onion_low_free(l->path);
+  onion_block_free(l->names);
+  onion_block_free(l->js);
+  onion_low_free(l->entries);
+  onion_low_free(l);
+}
+
+/// Removes the listing from the cache. Lock must be held.
+static void export_local_listing_remove(onion_handler_export_local_data * d,
+                                        onion_handler_export_local_listing * l) {
+  if (l->prev)
+    l->prev->next = l->next;
+  else
+    d->listings_head = l->next;
+  if (l->next)
+    l->next->prev = l->prev;
+  else
+    d->listings_tail = l->prev;
+  d->listings_count--;
+  onion_dict_remove(d->listings, l->path);
+  export_local_listing_unref(l);
+}
+
+/**
+ * @short Returns a reference to the listing of the directory, from the cache if still valid.
+ *
+ * Listings are valid while the directory mtime does not change, which happens when files are
+ * created, removed or renamed. Sizes of files modified in place are not updated until then.
+ *
+ * Directories changed in the last second are not cached, as more changes could come in the same
+ * mtime tick.
+ */
+static onion_handler_export_local_listing
+    *export_local_listing_get(onion_handler_export_local_data * d,
+                              const char *realp, struct stat *reals) {
+  onion_handler_export_local_listing *l;
+  if (d->listings_max) {
+    export_local_lock(d);
+    l = (void *)onion_dict_get(d->listings, realp);
+    if (l) {
+      if (l->dev == reals->st_dev && l->ino == reals->st_ino
+          && l->mtime.tv_sec == reals->st_mtim.tv_sec
+          && l->mtime.tv_nsec == reals->st_mtim.tv_nsec) {
+        if (d->listings_head != l) {    // To the head of the LRU
+          l->prev->next = l->next;
+          if (l->next)
+            l->next->prev = l->prev;
+          else
+            d->listings_tail = l->prev;
+          l->prev = NULL;
+          l->next = d->listings_head;
+          d->listings_head->prev = l;
+          d->listings_head = l;
+        }
+        l->refcount++;
+        export_local_unlock(d);
+        return l;
+      }
+      export_local_listing_remove(d, l);
+    }
+    export_local_unlock(d);
+  }
+
+  l = export_local_listing_new(d, realp, reals);
+  if (!l || !d->listings_max || reals->st_mtime >= time(NULL) - 1)
+    return l;
+
+  export_local_lock(d);
+  onion_handler_export_local_listing *old =
+      (void *)onion_dict_get(d->listings, realp);
+  if (old)                      // Another thread read it meanwhile
+    export_local_listing_remove(d, old);
+  while (d->listings_count >= d->listings_max)
+    export_local_listing_remove(d, d->listings_tail);
+  l->refcount++;
+  l->next = d->listings_head;
+  if (d->listings_head)
+    d->listings_head->prev = l;
+  else
+    d->listings_tail = l;
+  d->listings_head = l;
+  d->listings_count++;
+  onion_dict_add(d->listings, l->path, l, 0);
+  export_local_unlock(d);
+  return l;
+}
+
+static void export_local_listing_release(onion_handler_export_local_data * d,
+                                         onion_handler_export_local_listing *
+                                         l) {
+  export_local_lock(d);
+  export_local_listing_unref(l);
+  export_local_unlock(d);
+}
+
+/**
+ * @short Returns the directory listing as json
+ *
+ * Can be paginated with the offset and limit query arguments. Files are sorted by name.
+ *
+ * @code
+ * {"path":"/","total":120,"offset":0,"files":[{"name":"a.txt","size":10,"owner":"root","type":"file"}, ...]}
+ * @endcode
+ */
+static int export_local_directory_json(onion_handler_export_local_listing * l,
+                                       const char *showpath,
+                                       onion_request * req,
+                                       onion_response * res) {
+  int offset = atoi(onion_request_get_queryd(req, "offset", "0"));
+  int limit = atoi(onion_request_get_queryd(req, "limit", "-1"));
+  if (offset < 0 || offset > l->count)
+    offset = l->count;
+  int end = l->count;
+  if (limit >= 0 && limit < end - offset)
+    end = offset + limit;
+
+  onion_block *b = onion_block_new_segmented();
+  char tmp[128];
+  onion_block_add_str(b, "{\"path\":");
+  export_local_json_quote_add(b, showpath);
+  snprintf(tmp, sizeof(tmp), ",\"total\":%d,\"offset\":%d,\"files\":[",
+           l->count, offset);
+  onion_block_add_str(b, tmp);
+  int i;
+  for (i = offset; i < end; i++) {
+    onion_handler_export_local_listing_entry *e = &l->entries[i];
+    onion_block_add_str(b, i == offset ? "{\"name\":" : ",{\"name\":");
+    export_local_json_quote_add(b, e->name);
+    snprintf(tmp, sizeof(tmp), ",\"size\":%lld,\"owner\":", (long long)e->size);
+    onion_block_add_str(b, tmp);
+    export_local_json_quote_add(b, e->owner);
+    onion_block_add_str(b, e->is_dir ? ",\"type\":\"dir\"}" :
+                        ",\"type\":\"file\"}");
+  }
+  onion_block_add_str(b, "]}");
+
+  onion_response_set_header(res, "Content-Type", "application/json");
+  onion_response_set_length(res, onion_block_size(b));
+  onion_response_write_block(res, b);
+  onion_block_free(b);
+  return OCS_PROCESSED;
+}
+
 /**
  * @short Returns the directory listing
+ *
+ * With format=json at the query, returns it as json. @see export_local_directory_json
  */
 int onion_handler_export_local_directory(onion_handler_export_local_data * data,
                                          const char *realp,
+                                         struct stat *reals,
                                          const char *showpath,
                                          onion_request * req,
                                          onion_response * res) {
-  DIR *dir = opendir(realp);
-  if (!dir)                     // Continue on next. Quite probably a custom error.
+  onion_handler_export_local_listing *l =
+      export_local_listing_get(data, realp, reals);
+  if (!l)                       // Continue on next. Quite probably a custom error.
     return 0;
+  const char *format = onion_request_get_query(req, "format");
+  if (format && strcmp(format, "json") == 0) {
+    int ret = export_local_directory_json(l, showpath, req, res);
+    export_local_listing_release(data, l);
+    return ret;
+  }
+
   onion_response_set_header(res, "Content-Type", "text/html; charset=utf-8");
 
   onion_response_write0(res,
@@ -182,24 +595,8 @@ int onion_handler_export_local_directory(onion_handler_export_local_data * data,
                         "	files=files.splice(0,files.length-1)\n"
                         "	update(0)\n" "}\n" "\n" "files=[\n");
 
-  struct dirent *fi;
-  struct stat st;
-  char temp[1024];
-  struct passwd *pwd;
-  while ((fi = readdir(dir)) != NULL) {
-    if (fi->d_name[0] == '.')
-      continue;
-    snprintf(temp, sizeof(temp), "%s/%s", realp, fi->d_name);
-    stat(temp, &st);
-    pwd = getpwuid(st.st_uid);
-
-    if (S_ISDIR(st.st_mode))
-      onion_response_printf(res, "  ['%s/',%ld,'%s','dir'],\n", fi->d_name,
-                            st.st_size, pwd ? pwd->pw_name : "???");
-    else
-      onion_response_printf(res, "  ['%s',%ld,'%s','file'],\n", fi->d_name,
-                            st.st_size, pwd ? pwd->pw_name : "???");
-  }
+  onion_response_write(res, onion_block_data(l->js), onion_block_size(l->js));
+  export_local_listing_release(data, l);
 
   onion_response_write0(res, "  [] ]\n</script>\n");
 
@@ -219,18 +616,409 @@ int onion_handler_export_local_directory(onion_handler_export_local_data * data,
 
   onion_response_write0(res, "</body></html>");
 
-  closedir(dir);
+  return OCS_PROCESSED;
+}
+
+/// Drops a reference to a cached file, and frees it if last. Cache lock must be held.
+static void export_local_cached_unref(onion_handler_export_local_cached * c) {
+  c->refcount--;
+  if (c->refcount > 0)
+    return;
+  onion_low_free(c->path);
+  onion_low_free(c->data);
+  if (c->gzdata)
+    onion_low_free(c->gzdata);
+  onion_low_free(c->mime);
+  onion_low_free(c);
+}
+
+/// Removes the entry from the cache. Cache lock must be held.
+static void export_local_cache_remove(onion_handler_export_local_cache * cache,
+                                      onion_handler_export_local_cached * c) {
+  if (c->prev)
+    c->prev->next = c->next;
+  else
+    cache->head = c->next;
+  if (c->next)
+    c->next->prev = c->prev;
+  else
+    cache->tail = c->prev;
+  cache->size -= c->size + c->gzsize;
+  onion_dict_remove(cache->entries, c->path);
+  export_local_cached_unref(c);
+}
+
+/// Moves to the head of the LRU list. Cache lock must be held.
+static void export_local_cache_touch(onion_handler_export_local_cache * cache,
+                                     onion_handler_export_local_cached * c) {
+  if (cache->head == c)
+    return;
+  c->prev->next = c->next;
+  if (c->next)
+    c->next->prev = c->prev;
+  else
+    cache->tail = c->prev;
+  c->prev = NULL;
+  c->next = cache->head;
+  cache->head->prev = c;
+  cache->head = c;
+}
+
+#ifdef HAVE_ZLIB
+/// Only compress what is known to compress well.
+static int export_local_is_compressible(const char *mime) {
+  return strncmp(mime, "text/", 5) == 0
+      || strstr(mime, "javascript") || strstr(mime, "json")
+      || strstr(mime, "xml") || strstr(mime, "svg");
+}
+
+/// Returns the gzip version of data, only if it is worth it (at least 10% smaller).
+static char *export_local_gzip(const char *data, size_t size, size_t *gzsize) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    return NULL;
+  size_t max = deflateBound(&zs, size);
+  char *ret = onion_low_scalar_malloc(max);
+  zs.next_in = (Bytef *) data;
+  zs.avail_in = size;
+  zs.next_out = (Bytef *) ret;
+  zs.avail_out = max;
+  int ok = deflate(&zs, Z_FINISH);
+  *gzsize = zs.total_out;
+  deflateEnd(&zs);
+  if (ok != Z_STREAM_END || *gzsize > size - size / 10) {
+    onion_low_free(ret);
+    return NULL;
+  }
+  return ret;
+}
+#endif
 
+/// Reads the file into a new cache entry, with refcount 1.
+static onion_handler_export_local_cached *export_local_cached_new(const char
+                                                                  *realp,
+                                                                  struct stat
+                                                                  *reals) {
+  int fd = open(realp, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+      || st.st_size != reals->st_size) {        // Changed meanwhile, do not cache
+    close(fd);
+    return NULL;
+  }
+  char *data = onion_low_scalar_malloc(st.st_size ? st.st_size : 1);
+  size_t pos = 0;
+  while (pos < st.st_size) {
+    ssize_t r = pread(fd, data + pos, st.st_size - pos, pos);
+    if (r <= 0) {
+      close(fd);
+      onion_low_free(data);
+      return NULL;
+    }
+    pos += r;
+  }
+  close(fd);
+
+  onion_handler_export_local_cached *c =
+      onion_low_calloc(1, sizeof(onion_handler_export_local_cached));
+  c->path = onion_low_strdup(realp);
+  c->data = data;
+  c->size = st.st_size;
+  c->st = st;
+  c->mime = onion_low_strdup(onion_mime_get(realp));
+  c->refcount = 1;
+  onion_shortcut_etag(&st, c->etag);
+#ifdef HAVE_ZLIB
+  if (c->size >= 256 && export_local_is_compressible(c->mime)) {
+    c->gzdata = export_local_gzip(c->data, c->size, &c->gzsize);
+    if (c->gzdata)
+      snprintf(c->gzetag, sizeof(c->gzetag), "%s-gz", c->etag);
+  }
+#endif
+  return c;
+}
+
+/**
+ * @short Gets the cached version of the file, loading it if needed. Returns a new reference.
+ *
+ * reals is the stat done at this request, so revalidation is just a comparison.
+ *
+ * Returns NULL if it can not be loaded or admitted, and then the caller should serve it
+ * directly from disk.
+ */
+static onion_handler_export_local_cached
+    *export_local_cache_get(onion_handler_export_local_cache * cache,
+                            const char *realp, struct stat *reals) {
+  onion_handler_export_local_cached *c;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&cache->mutex);
+#endif
+  c = (void *)onion_dict_get(cache->entries, realp);
+  if (c) {
+    if (c->st.st_ino == reals->st_ino && c->st.st_dev == reals->st_dev
+        && c->st.st_size == reals->st_size
+        && c->st.st_mtim.tv_sec == reals->st_mtim.tv_sec
+        && c->st.st_mtim.tv_nsec == reals->st_mtim.tv_nsec
+        && c->st.st_ctim.tv_sec == reals->st_ctim.tv_sec
+        && c->st.st_ctim.tv_nsec == reals->st_ctim.tv_nsec) {
+      export_local_cache_touch(cache, c);
+      c->refcount++;
+#ifdef HAVE_PTHREADS
+      pthread_mutex_unlock(&cache->mutex);
+#endif
+      return c;
+    }
+    ONION_DEBUG0("%s changed, reloading", realp);
+    export_local_cache_remove(cache, c);
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&cache->mutex);
+#endif
+
+  c = export_local_cached_new(realp, reals);
+  if (!c)
+    return NULL;
+
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&cache->mutex);
+#endif
+  onion_handler_export_local_cached *old =
+      (void *)onion_dict_get(cache->entries, realp);
+  if (old)                      // Another thread loaded it meanwhile
+    export_local_cache_remove(cache, old);
+  if (c->size + c->gzsize > cache->max_size && c->gzdata) {    // Keep at least the plain version
+    onion_low_free(c->gzdata);
+    c->gzdata = NULL;
+    c->gzsize = 0;
+  }
+  while (cache->tail && cache->size + c->size + c->gzsize > cache->max_size)
+    export_local_cache_remove(cache, cache->tail);
+  if (cache->size + c->size + c->gzsize > cache->max_size) {
+    export_local_cached_unref(c);
+    c = NULL;
+  } else {
+    c->refcount++;
+    c->next = cache->head;
+    if (cache->head)
+      cache->head->prev = c;
+    else
+      cache->tail = c;
+    cache->head = c;
+    cache->size += c->size + c->gzsize;
+    onion_dict_add(cache->entries, c->path, c, 0);
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&cache->mutex);
+#endif
+  return c;
+}
+
+static void export_local_cache_release(onion_handler_export_local_cache * cache,
+                                       onion_handler_export_local_cached * c) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&cache->mutex);
+#endif
+  export_local_cached_unref(c);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&cache->mutex);
+#endif
+}
+
+static void export_local_cache_free(onion_handler_export_local_cache * cache) {
+  while (cache->head)
+    export_local_cache_remove(cache, cache->head);
+  onion_dict_free(cache->entries);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&cache->mutex);
+#endif
+  onion_low_free(cache);
+}
+
+/// Gets the current cache, if any, with a new reference, so it is not freed while in use.
+static onion_handler_export_local_cache
+    *export_local_cache_ref(onion_handler_export_local_data * d) {
+  if (!__atomic_load_n(&d->cache, __ATOMIC_RELAXED))
+    return NULL;
+  export_local_lock(d);
+  onion_handler_export_local_cache *cache = d->cache;
+  if (cache)
+    __sync_add_and_fetch(&cache->refcount, 1);
+  export_local_unlock(d);
+  return cache;
+}
+
+/// Drops a reference to the cache, and frees it if last.
+static void export_local_cache_unref(onion_handler_export_local_cache * cache) {
+  if (__sync_sub_and_fetch(&cache->refcount, 1) == 0)
+    export_local_cache_free(cache);
+}
+
+/**
+ * @short Checks if the Accept-Encoding header allows gzip.
+ *
+ * gzip (or x-gzip), or else *, must be listed with a q-value other than 0.
+ */
+static int export_local_accepts_gzip(const char *ae) {
+  if (!ae)
+    return 0;
+  int gzip = -1, star = -1;
+  while (*ae) {
+    while (*ae == ' ' || *ae == '\t' || *ae == ',')
+      ae++;
+    const char *name = ae;
+    while (*ae && *ae != ',' && *ae != ';' && *ae != ' ' && *ae != '\t')
+      ae++;
+    size_t namel = ae - name;
+    int accepted = 1;
+    while (*ae && *ae != ',') { // Parameters, only q is of interest
+      if (*ae == ';') {
+        ae++;
+        while (*ae == ' ' || *ae == '\t')
+          ae++;
+        if ((*ae == 'q' || *ae == 'Q') && ae[1] == '=')
+          accepted = (strtod(ae + 2, NULL) > 0.0);
+      } else
+        ae++;
+    }
+    if ((namel == 4 && strncasecmp(name, "gzip", 4) == 0)
+        || (namel == 6 && strncasecmp(name, "x-gzip", 6) == 0))
+      gzip = accepted;
+    else if (namel == 1 && *name == '*')
+      star = accepted;
+  }
+  if (gzip >= 0)
+    return gzip;
+  return star > 0;
+}
+
+/**
+ * @short Serves a file from the hot file cache.
+ *
+ * Ranges are not cached, they go to onion_shortcut_response_file.
+ */
+static int onion_handler_export_local_cached_file(onion_handler_export_local_cache
+                                                  * cache, const char *realp,
+                                                  struct stat *reals,
+                                                  onion_request * req,
+                                                  onion_response * res) {
+  if (onion_request_get_header(req, "Range"))
+    return onion_shortcut_response_file(realp, req, res);
+  onion_handler_export_local_cached *c =
+      export_local_cache_get(cache, realp, reals);
+  if (!c)
+    return onion_shortcut_response_file(realp, req, res);
+
+  const char *data = c->data;
+  const char *etag = c->etag;
+  size_t size = c->size;
+  if (c->gzdata) {
+    const char *ae = onion_request_get_header(req, "Accept-Encoding");
+    onion_response_set_header(res, "Vary", "Accept-Encoding");
+    if (export_local_accepts_gzip(ae)) {
+      data = c->gzdata;
+      etag = c->gzetag;
+      size = c->gzsize;
+      onion_response_set_header(res, "Content-Encoding", "gzip");
+    }
+  }
+  onion_response_set_header(res, "Etag", etag);
+  onion_response_set_header(res, "Content-Type", c->mime);
+
+  const char *prev_etag = onion_request_get_header(req, "If-None-Match");
+  if (prev_etag && strcmp(prev_etag, etag) == 0) {
+    onion_response_set_length(res, 0);
+    onion_response_set_code(res, HTTP_NOT_MODIFIED);
+    onion_response_write_headers(res);
+    export_local_cache_release(cache, c);
+    return OCS_PROCESSED;
+  }
+  onion_response_set_length(res, size);
+  if (onion_response_write_headers(res) != OR_SKIP_CONTENT && size)
+    onion_response_write(res, data, size);
+  export_local_cache_release(cache, c);
   return OCS_PROCESSED;
 }
 
 /// Frees local data from the directory handler
 void onion_handler_export_local_delete(void *data) {
   onion_handler_export_local_data *d = data;
+  if (d->cache)
+    export_local_cache_unref(d->cache);
+  while (d->listings_head)
+    export_local_listing_remove(d, d->listings_head);
+  onion_dict_free(d->listings);
+  onion_dict_free(d->owners);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&d->mutex);
+#endif
   onion_low_free(d->localpath);
   onion_low_free(d);
 }
 
+/**
+ * @short Keeps the listing of the last max_dirs listed directories.
+ *
+ * Listings are read again when the directory changes (its mtime), so changes of size of files
+ * modified in place are not seen until then. 0 disables.
+ */
+void onion_handler_export_local_set_listing_cache(onion_handler * handler,
+                                                  int max_dirs) {
+  onion_handler_export_local_data *d = onion_handler_get_private_data(handler);
+  export_local_lock(d);
+  d->listings_max = max_dirs > 0 ? max_dirs : 0;
+  while (d->listings_count > d->listings_max)
+    export_local_listing_remove(d, d->listings_tail);
+  export_local_unlock(d);
+}
+
+/**
+ * @short Keeps small hot files in memory.
+ *
+ * Files up to max_file_size bytes are kept in memory, up to max_size bytes in total, removing the
+ * least recently used when full. Each request still does the stat to check the path, and if the
+ * file changed it is read again.
+ *
+ * Compressible files (text, javascript, json...) also keep a gzip version, for clients that
+ * accept it (q-value not 0).
+ *
+ * Etags are the same as the ones onion_shortcut_response_file gives, so clients do not see a
+ * difference between cached and not cached files.
+ *
+ * max_size 0 disables the cache. max_file_size must not be bigger than max_size.
+ *
+ * It can be changed while serving: requests in flight keep using the old cache until done.
+ */
+void onion_handler_export_local_set_cache(onion_handler * handler,
+                                          size_t max_size,
+                                          size_t max_file_size) {
+  onion_handler_export_local_data *d = onion_handler_get_private_data(handler);
+  onion_handler_export_local_cache *cache = NULL;
+  if (max_file_size > max_size) {
+    ONION_ERROR
+        ("Hot file cache max_file_size (%lu) can not be bigger than max_size (%lu). Cache disabled.",
+         (unsigned long)max_file_size, (unsigned long)max_size);
+  } else if (max_size) {
+    cache = onion_low_calloc(1, sizeof(onion_handler_export_local_cache));
+    cache->entries = onion_dict_new();
+    cache->max_size = max_size;
+    cache->max_file_size = max_file_size;
+    cache->refcount = 1;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_init(&cache->mutex, NULL);
+#endif
+  }
+  export_local_lock(d);
+  onion_handler_export_local_cache *old = d->cache;
+  d->cache = cache;
+  export_local_unlock(d);
+  if (old)
+    export_local_cache_unref(old);
+}
+
 /// Sets the header renderer
 void onion_handler_export_local_set_header(onion_handler * handler,
                                            void (*renderer) (onion_response *
@@ -276,6 +1064,15 @@ onion_handler *onion_handler_export_local_new(const char *localpath) {
       onion_low_malloc(sizeof(onion_handler_export_local_data));
 
   priv_data->localpath = rp;
+  priv_data->cache = NULL;
+  priv_data->owners = onion_dict_new();
+  priv_data->listings = onion_dict_new();
+  priv_data->listings_head = priv_data->listings_tail = NULL;
+  priv_data->listings_count = 0;
+  priv_data->listings_max = 0;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&priv_data->mutex, NULL);
+#endif
   priv_data->renderer_header = onion_handler_export_local_header_default;
   priv_data->renderer_footer = onion_handler_export_local_footer_default;
 
@@ -47,6 +47,13 @@ extern "C" {
                                                                res,
                                                                const char
                                                                *dirname));
+/// Keeps small files in memory (up to max_file_size each, max_size total), with gzip versions. 0 disables.
+  void onion_handler_export_local_set_cache(onion_handler * dir,
+                                            size_t max_size,
+                                            size_t max_file_size);
+/// Keeps the listings of up to max_dirs directories, until they change. 0 disables.
+  void onion_handler_export_local_set_listing_cache(onion_handler * dir,
+                                                    int max_dirs);
 
 #ifdef __cplusplus
 }
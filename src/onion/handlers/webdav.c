@@ -614,7 +614,7 @@ onion_connection_status onion_webdav_propfind(const char *filename,
   onion_response_write_headers(res);
   onion_response_flush(res);
 
-  onion_response_write(res, onion_block_data(block), onion_block_size(block));
+  onion_response_write_block(res, block);
 
   onion_block_free(block);
 
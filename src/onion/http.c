@@ -34,6 +34,8 @@
 
 static ssize_t onion_http_read(onion_request * req, char *data, size_t len);
 ssize_t onion_http_write(onion_request * req, const char *data, size_t len);
+static ssize_t onion_http_writev(onion_request * req, const struct iovec *iov,
+                                 int iovcnt);
 int onion_http_read_ready(onion_request * req);
 
 /**
@@ -54,6 +56,7 @@ onion_listen_point *onion_http_new() {
 
   ret->read = onion_http_read;
   ret->write = onion_http_write;
+  ret->writev = onion_http_writev;
   ret->close = onion_listen_point_request_close_socket;
   ret->read_ready = onion_http_read_ready;
   ret->secure = false;
@@ -101,3 +104,15 @@ int onion_http_read_ready(onion_request * con) {
 ssize_t onion_http_write(onion_request * con, const char *data, size_t len) {
   return write(con->connection.fd, data, len);
 }
+
+/**
+ * @short Write several buffers to the HTTP client at once
+ * @memberof onion_http_t
+ * @ingroup http
+ */
+static ssize_t onion_http_writev(onion_request * con, const struct iovec *iov,
+                                 int iovcnt) {
+  if (con->connection.listen_point->write != onion_http_write)  // Changed, it must see all data
+    return onion_listen_point_writev_with_write(con, iov, iovcnt);
+  return writev(con->connection.fd, iov, iovcnt);
+}
@@ -27,6 +27,10 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <string.h>
+#include <time.h>
 
 #include "low.h"
 #include "https.h"
@@ -35,6 +39,28 @@
 #include "log.h"
 #include "listen_point.h"
 #include "request.h"
+#include "poller.h"
+#include "dict.h"
+#include "websocket.h"
+
+#ifdef __linux__
+#define USE_KTLS
+#endif
+
+#ifdef USE_KTLS
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#if GNUTLS_VERSION_NUMBER >= 0x030703
+#include <gnutls/socket.h>
+#endif
+#endif
 
 #ifdef HAVE_PTHREADS
 #include <pthread.h>
@@ -47,6 +73,15 @@ GCRY_THREAD_OPTION_PTHREAD_IMPL;
 
 /// @defgroup https HTTPS. Specific bits for https listen points. Use to set certificates.
 
+/// Default time to renew the session ticket key, in seconds.
+#define ONION_HTTPS_TICKET_ROTATION (24 * 60 * 60)
+/// Max plaintext in a TLS record. Writes are gathered until this size, and reads done in this size.
+#define ONION_HTTPS_RECORD_SIZE (16 * 1024)
+/// Session cache shards. Each has its own lock, so handshakes at different threads rarely wait.
+#define ONION_HTTPS_CACHE_SHARDS 16
+
+typedef struct onion_https_cache_t onion_https_cache;
+
 /**
  * @short Stores some data about the connection
  * @struct onion_https_t
@@ -59,18 +94,390 @@ struct onion_https_t {
   gnutls_certificate_credentials_t x509_cred;
   gnutls_dh_params_t dh_params;
   gnutls_priority_t priority_cache;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t ticket_mutex;
+#endif
+  gnutls_datum_t ticket_key;    ///< Session ticket master key, if any yet.
+  time_t ticket_key_time;       ///< When it was generated.
+  int ticket_rotation;          ///< Seconds until it is renewed. 0 if session tickets are disabled.
+  onion_https_cache *cache;     ///< Session cache, if any.
+  bool ktls;                    ///< Try to pass the sending to the kernel after the handshake.
 };
 
 typedef struct onion_https_t onion_https;
 
+/**
+ * @short Per connection data, at req->connection.user_data.
+ * @ingroup https
+ */
+struct onion_https_connection_t {
+  gnutls_session_t session;
+  bool handshaking;             ///< Handshake still in progress, advanced at each poller event.
+  bool ktls;                    ///< The kernel encrypts what is written to the fd (kTLS), not gnutls.
+  bool corked;                  ///< Writes are kept by gnutls, until flushed or a full record.
+  size_t corked_bytes;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;        ///< For writes, as websockets may write from other threads.
+#endif
+};
+
+typedef struct onion_https_connection_t onion_https_connection;
+
 int onion_http_read_ready(onion_request * req);
 static int onion_https_request_init(onion_request * req);
+static int onion_https_read_ready(onion_request * req);
 static ssize_t onion_https_read(onion_request * req, char *data, size_t len);
 ssize_t onion_https_write(onion_request * req, const char *data, size_t len);
+static ssize_t onion_https_writev(onion_request * req,
+                                  const struct iovec *iov, int iovcnt);
+static int onion_https_flush(onion_request * req);
+static size_t onion_https_pending(onion_request * req);
 static void onion_https_close(onion_request * req);
 static void onion_https_listen_stop(onion_listen_point * op);
 static void onion_https_free_user_data(onion_listen_point * op);
 
+/**
+ * @short Session cache, so clients without tickets can also resume their sessions.
+ * @ingroup https
+ *
+ * Sessions are spread by id into shards, each an onion_dict with its own lock. Each shard
+ * keeps at most its share of the entries; when full the oldest stored is removed.
+ */
+struct onion_https_cache_t {
+  struct onion_https_cache_shard_t {
+#ifdef HAVE_PTHREADS
+    pthread_mutex_t mutex;
+#endif
+    onion_dict *sessions;       ///< Hex session id to its onion_https_cache_entry.
+    struct {
+      char *id;
+      unsigned int seq;
+    } *order;                   ///< Ring of stored ids, oldest first, to know what to evict.
+    int head;
+    int count;
+    int size;
+    unsigned int seq;
+  } shard[ONION_HTTPS_CACHE_SHARDS];
+};
+
+/// Session data as stored at the dict.
+typedef struct onion_https_cache_entry_t {
+  unsigned int seq;             ///< To know if the order entry refers to this one, or to a replaced one.
+  unsigned int size;
+  unsigned char data[];
+} onion_https_cache_entry;
+
+static onion_https_cache *onion_https_cache_new(size_t max_entries) {
+  onion_https_cache *cache = onion_low_calloc(1, sizeof(onion_https_cache));
+  int size = (max_entries + ONION_HTTPS_CACHE_SHARDS - 1) /
+      ONION_HTTPS_CACHE_SHARDS;
+  int i;
+  for (i = 0; i < ONION_HTTPS_CACHE_SHARDS; i++) {
+    struct onion_https_cache_shard_t *shard = &cache->shard[i];
+#ifdef HAVE_PTHREADS
+    pthread_mutex_init(&shard->mutex, NULL);
+#endif
+    shard->sessions = onion_dict_new();
+    shard->size = size;
+    shard->order = onion_low_calloc(size, sizeof(*shard->order));
+  }
+  return cache;
+}
+
+static void onion_https_cache_free(onion_https_cache * cache) {
+  int i, j;
+  for (i = 0; i < ONION_HTTPS_CACHE_SHARDS; i++) {
+    struct onion_https_cache_shard_t *shard = &cache->shard[i];
+    for (j = 0; j < shard->count; j++)
+      onion_low_free(shard->order[(shard->head + j) % shard->size].id);
+    onion_low_free(shard->order);
+    onion_dict_free(shard->sessions);
+#ifdef HAVE_PTHREADS
+    pthread_mutex_destroy(&shard->mutex);
+#endif
+  }
+  onion_low_free(cache);
+}
+
+/// Returns the shard for the session id, locked, and the id as hex at id.
+static struct onion_https_cache_shard_t *onion_https_cache_shard(onion_https_cache
+                                                                 * cache,
+                                                                 gnutls_datum_t
+                                                                 key,
+                                                                 char **id) {
+  const char *hex = "0123456789abcdef";
+  unsigned int hash = 2166136261u;
+  unsigned int i;
+  *id = onion_low_malloc(key.size * 2 + 1);
+  for (i = 0; i < key.size; i++) {
+    hash = (hash ^ key.data[i]) * 16777619u;
+    (*id)[i * 2] = hex[key.data[i] >> 4];
+    (*id)[i * 2 + 1] = hex[key.data[i] & 0x0F];
+  }
+  (*id)[key.size * 2] = 0;
+  struct onion_https_cache_shard_t *shard =
+      &cache->shard[hash % ONION_HTTPS_CACHE_SHARDS];
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&shard->mutex);
+#endif
+  return shard;
+}
+
+static void onion_https_cache_unlock(struct onion_https_cache_shard_t *shard) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&shard->mutex);
+#endif
+}
+
+/// gnutls_db_store_func. Stores the session, evicting the oldest if the shard is full.
+static int onion_https_cache_store(void *ptr, gnutls_datum_t key,
+                                   gnutls_datum_t data) {
+  char *id;
+  struct onion_https_cache_shard_t *shard =
+      onion_https_cache_shard((onion_https_cache *) ptr, key, &id);
+
+  if (shard->count == shard->size) {
+    char *old = shard->order[shard->head].id;
+    onion_https_cache_entry *e =
+        (onion_https_cache_entry *) onion_dict_get(shard->sessions, old);
+    if (e && e->seq == shard->order[shard->head].seq)
+      onion_dict_remove(shard->sessions, old);
+    onion_low_free(old);
+    shard->head = (shard->head + 1) % shard->size;
+    shard->count--;
+  }
+
+  onion_https_cache_entry *e =
+      onion_low_malloc(sizeof(onion_https_cache_entry) + data.size);
+  e->seq = ++shard->seq;
+  e->size = data.size;
+  memcpy(e->data, data.data, data.size);
+  onion_dict_add(shard->sessions, id, e,
+                 OD_DUP_KEY | OD_FREE_VALUE | OD_REPLACE);
+
+  int last = (shard->head + shard->count) % shard->size;
+  shard->order[last].id = id;
+  shard->order[last].seq = e->seq;
+  shard->count++;
+
+  onion_https_cache_unlock(shard);
+  return 0;
+}
+
+/// gnutls_db_retr_func. Returns a copy of the stored session, or an empty datum.
+static gnutls_datum_t onion_https_cache_retrieve(void *ptr, gnutls_datum_t key) {
+  gnutls_datum_t ret = { NULL, 0 };
+  char *id;
+  struct onion_https_cache_shard_t *shard =
+      onion_https_cache_shard((onion_https_cache *) ptr, key, &id);
+
+  onion_https_cache_entry *e =
+      (onion_https_cache_entry *) onion_dict_get(shard->sessions, id);
+  if (e) {
+    ret.data = gnutls_malloc(e->size);
+    if (ret.data) {
+      memcpy(ret.data, e->data, e->size);
+      ret.size = e->size;
+    }
+  }
+
+  onion_https_cache_unlock(shard);
+  onion_low_free(id);
+  return ret;
+}
+
+/// gnutls_db_remove_func. Its order entry is left, and skipped when its turn comes.
+static int onion_https_cache_remove(void *ptr, gnutls_datum_t key) {
+  char *id;
+  struct onion_https_cache_shard_t *shard =
+      onion_https_cache_shard((onion_https_cache *) ptr, key, &id);
+  int removed = onion_dict_remove(shard->sessions, id);
+  onion_https_cache_unlock(shard);
+  onion_low_free(id);
+  return removed ? 0 : -1;
+}
+
+/**
+ * @short Enables session tickets on the session, renewing the key if it is too old.
+ *
+ * gnutls derives the keys that encrypt the tickets from this one, and already rotates them
+ * as tickets expire. Renewing it also drops all tickets given until now.
+ */
+static void onion_https_ticket_enable(onion_https * https,
+                                      gnutls_session_t session) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&https->ticket_mutex);
+#endif
+  time_t now = time(NULL);
+  if (!https->ticket_key.data
+      || now - https->ticket_key_time >= https->ticket_rotation) {
+    gnutls_datum_t key;
+    int r = gnutls_session_ticket_key_generate(&key);
+    if (r < 0)
+      ONION_ERROR("Could not generate the session ticket key (%s)",
+                  gnutls_strerror(r));
+    else {
+      if (https->ticket_key.data) {
+        ONION_DEBUG("Renewing the session ticket key");
+        memset(https->ticket_key.data, 0, https->ticket_key.size);
+        gnutls_free(https->ticket_key.data);
+      }
+      https->ticket_key = key;
+      https->ticket_key_time = now;
+    }
+  }
+  // The session keeps its own copy of the key.
+  if (https->ticket_key.data)
+    gnutls_session_ticket_enable_server(session, &https->ticket_key);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&https->ticket_mutex);
+#endif
+}
+
+#ifdef USE_KTLS
+/// Fills the AES GCM crypto info. On TLS 1.2 the explicit nonce starts as the sequence number.
+#define ONION_HTTPS_KTLS_GCM(ci) do { \
+    if (key.size != sizeof(ci.key) \
+        || iv.size < sizeof(ci.salt) + (version == GNUTLS_TLS1_2 ? 0 : sizeof(ci.iv))) \
+      return false; \
+    memcpy(ci.salt, iv.data, sizeof(ci.salt)); \
+    if (version == GNUTLS_TLS1_2) \
+      memcpy(ci.iv, seq, sizeof(ci.iv)); \
+    else \
+      memcpy(ci.iv, iv.data + sizeof(ci.salt), sizeof(ci.iv)); \
+    memcpy(ci.key, key.data, sizeof(ci.key)); \
+    memcpy(ci.rec_seq, seq, sizeof(ci.rec_seq)); \
+    ci_len = sizeof(ci); \
+  } while (0)
+
+/// Records gnutls would send after the kernel took over would be encrypted twice; fail instead.
+static ssize_t onion_https_ktls_push(gnutls_transport_ptr_t ptr,
+                                     const giovec_t * iov, int iovcnt) {
+  errno = EIO;
+  return -1;
+}
+
+/**
+ * @short Passes the sending side of the connection to the kernel (kTLS), if possible.
+ *
+ * The keys negotiated at the handshake are set at the socket, and from then on the kernel
+ * encrypts what is written to it, so it can be used with sendfile. Receiving is still done by
+ * gnutls, which also handles the TLS control messages.
+ *
+ * If gnutls already did it, as set at its system configuration, it is used as is.
+ *
+ * @returns If what is written to the fd gets to the client encrypted.
+ */
+static bool onion_https_ktls_enable(onion_request * req) {
+  onion_https *https = (onion_https *) req->connection.listen_point->user_data;
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  gnutls_session_t session = conn->session;
+#if GNUTLS_VERSION_NUMBER >= 0x030703
+  if (gnutls_transport_is_ktls_enabled(session) & GNUTLS_KTLS_SEND)
+    return true;
+#endif
+  if (!https->ktls)
+    return false;
+
+  gnutls_protocol_t version = gnutls_protocol_get_version(session);
+  if (version != GNUTLS_TLS1_2 && version != GNUTLS_TLS1_3)
+    return false;
+  gnutls_datum_t mac, iv, key;
+  unsigned char seq[8];
+  if (gnutls_record_get_state(session, 0, &mac, &iv, &key, seq) < 0)
+    return false;
+
+  union {
+    struct tls_crypto_info info;
+    struct tls12_crypto_info_aes_gcm_128 aes128;
+#ifdef TLS_CIPHER_AES_GCM_256
+    struct tls12_crypto_info_aes_gcm_256 aes256;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    struct tls12_crypto_info_chacha20_poly1305 chacha;
+#endif
+  } ci;
+  socklen_t ci_len;
+  memset(&ci, 0, sizeof(ci));
+  ci.info.version =
+      (version == GNUTLS_TLS1_2) ? TLS_1_2_VERSION : TLS_1_3_VERSION;
+  switch (gnutls_cipher_get(session)) {
+  case GNUTLS_CIPHER_AES_128_GCM:
+    ci.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+    ONION_HTTPS_KTLS_GCM(ci.aes128);
+    break;
+#ifdef TLS_CIPHER_AES_GCM_256
+  case GNUTLS_CIPHER_AES_256_GCM:
+    ci.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+    ONION_HTTPS_KTLS_GCM(ci.aes256);
+    break;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+  case GNUTLS_CIPHER_CHACHA20_POLY1305:
+    if (key.size != sizeof(ci.chacha.key) || iv.size != sizeof(ci.chacha.iv))
+      return false;
+    ci.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+    memcpy(ci.chacha.iv, iv.data, sizeof(ci.chacha.iv));
+    memcpy(ci.chacha.key, key.data, sizeof(ci.chacha.key));
+    memcpy(ci.chacha.rec_seq, seq, sizeof(ci.chacha.rec_seq));
+    ci_len = sizeof(ci.chacha);
+    break;
+#endif
+  default:
+    ONION_DEBUG0("No kTLS for cipher %s",
+                 gnutls_cipher_get_name(gnutls_cipher_get(session)));
+    return false;
+  }
+
+  int fd = req->connection.fd;
+  if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+    if (errno == ENOENT || errno == ENOPROTOOPT) {
+      ONION_WARNING("Kernel has no TLS support (%s). Not using kTLS.",
+                    strerror(errno));
+      https->ktls = false;
+    }
+    memset(&ci, 0, sizeof(ci));
+    return false;
+  }
+  // With no keys set the socket just works as before, so on error gnutls can go on.
+  int r = setsockopt(fd, SOL_TLS, TLS_TX, &ci, ci_len);
+  memset(&ci, 0, sizeof(ci));
+  if (r < 0) {
+    ONION_DEBUG("Could not set kTLS keys (%s)", strerror(errno));
+    return false;
+  }
+
+  gnutls_transport_set_vec_push_function(session, onion_https_ktls_push);
+  conn->ktls = true;
+  ONION_DEBUG0("Using kTLS to send, fd %d", fd);
+  return true;
+}
+
+/// Sends the close_notify alert through the kernel.
+static void onion_https_ktls_bye(int fd) {
+  unsigned char alert[2] = { 1, 0 };    // Warning, close_notify
+  char control[CMSG_SPACE(sizeof(unsigned char))];
+  struct iovec iov = { alert, sizeof(alert) };
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_TLS;
+  cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+  *CMSG_DATA(cmsg) = 21;        // Alert
+  sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+#else
+static bool onion_https_ktls_enable(onion_request * req) {
+  return false;
+}
+#endif
+
 /**
  * @short Creates a new listen point with HTTPS powers.
  * @memberof onion_https_t
@@ -92,12 +499,19 @@ onion_listen_point *onion_https_new() {
   op->listen_stop = onion_https_listen_stop;
   op->read = onion_https_read;
   op->write = onion_https_write;
+  op->writev = onion_https_writev;
+  op->flush = onion_https_flush;
+  op->pending = onion_https_pending;
   op->close = onion_https_close;
-  op->read_ready = onion_http_read_ready;
+  op->read_ready = onion_https_read_ready;
   op->secure = true;
 
   op->user_data = onion_low_calloc(1, sizeof(onion_https));
   onion_https *https = (onion_https *) op->user_data;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&https->ticket_mutex, NULL);
+#endif
+  https->ticket_rotation = ONION_HTTPS_TICKET_ROTATION;
 
 #ifdef HAVE_PTHREADS
 #if GCRYPT_VERSION_NUMBER < 010600
@@ -186,6 +600,15 @@ static void onion_https_free_user_data(onion_listen_point * op) {
   gnutls_certificate_free_credentials(https->x509_cred);
   gnutls_dh_params_deinit(https->dh_params);
   gnutls_priority_deinit(https->priority_cache);
+  if (https->ticket_key.data) {
+    memset(https->ticket_key.data, 0, https->ticket_key.size);
+    gnutls_free(https->ticket_key.data);
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&https->ticket_mutex);
+#endif
+  if (https->cache)
+    onion_https_cache_free(https->cache);
   //if (op->server->flags&O_SSL_NO_DEINIT)
   gnutls_global_deinit();       // This may cause problems if several characters use the gnutls on the same binary.
   onion_low_free(https);
@@ -196,14 +619,20 @@ static void onion_https_free_user_data(onion_listen_point * op) {
  * @memberof onion_https_t
  * @ingroup https
  *
- * Do the accept of the request, and the SSL handshake.
+ * Do the accept of the request, and prepares the SSL session.
+ *
+ * When polling with epoll the handshake is not done here, but step by step at
+ * onion_https_read_ready as data arrives, so a slow client does not block the
+ * accepting thread. On O_ONE mode there is no poller, so it is done here.
  *
  * @param req The request
  * @returns <0 in case of error.
  */
 static int onion_https_request_init(onion_request * req) {
-  onion_listen_point_request_init_from_socket(req);
-  onion_https *https = (onion_https *) req->connection.listen_point->user_data;
+  if (onion_listen_point_request_init_from_socket(req) < 0)
+    return -1;
+  onion_listen_point *op = req->connection.listen_point;
+  onion_https *https = (onion_https *) op->user_data;
 
   ONION_DEBUG("Accept new request, fd %d", req->connection.fd);
 
@@ -219,6 +648,38 @@ static int onion_https_request_init(onion_request * req) {
 
   gnutls_transport_set_ptr(session,
                            (gnutls_transport_ptr_t) (long)req->connection.fd);
+
+  if (https->ticket_rotation)
+    onion_https_ticket_enable(https, session);
+  if (https->cache) {
+    gnutls_db_set_ptr(session, https->cache);
+    gnutls_db_set_store_function(session, onion_https_cache_store);
+    gnutls_db_set_retrieve_function(session, onion_https_cache_retrieve);
+    gnutls_db_set_remove_function(session, onion_https_cache_remove);
+  }
+
+  onion_https_connection *conn =
+      onion_low_calloc(1, sizeof(onion_https_connection));
+  conn->session = session;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&conn->mutex, NULL);
+#endif
+  req->connection.user_data = conn;
+
+#ifdef HAVE_EPOLL
+  // Only epoll can wait for write from the callback, as the handshake may need.
+  if (!(op->server->flags & O_ONE)) {
+    int flags = fcntl(req->connection.fd, F_GETFL);
+    if (flags != -1
+        && fcntl(req->connection.fd, F_SETFL, flags | O_NONBLOCK) != -1) {
+      conn->handshaking = true;
+      return 0;
+    }
+    ONION_WARNING("Could not set the connection non blocking (%s). "
+                  "Doing the SSL handshake now.", strerror(errno));
+  }
+#endif
+
   int ret;
   do {
     ret = gnutls_handshake(session);
@@ -227,28 +688,188 @@ static int onion_https_request_init(onion_request * req) {
     ONION_ERROR("Handshake has failed (%s)", gnutls_strerror(ret));
     gnutls_bye(session, GNUTLS_SHUT_WR);
     gnutls_deinit(session);
+#ifdef HAVE_PTHREADS
+    pthread_mutex_destroy(&conn->mutex);
+#endif
+    onion_low_free(conn);
+    req->connection.user_data = NULL;
     onion_listen_point_request_close_socket(req);
     return -1;
   }
+  req->connection.fd_plaintext = onion_https_ktls_enable(req);
 
-  req->connection.user_data = (void *)session;
   return 0;
 }
 
+/**
+ * @short Advances the SSL handshake, as far as the data available allows.
+ * @memberof onion_https_t
+ * @ingroup https
+ *
+ * While it can not finish, waits at the poller for the direction gnutls needs.
+ * Once finished the connection is back to blocking, as the HTTP processing
+ * expects.
+ *
+ * @returns OCS_PROCESSED to keep waiting, OCS_CLOSE_CONNECTION on error.
+ */
+static int onion_https_handshake(onion_request * req) {
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  int ret = gnutls_handshake(conn->session);
+  if (ret < 0) {
+    if (gnutls_error_is_fatal(ret)) {
+      ONION_ERROR("Handshake has failed (%s)", gnutls_strerror(ret));
+      return OCS_CLOSE_CONNECTION;
+    }
+    onion_poller_slot_set_type(req->connection.slot,
+                               gnutls_record_get_direction(conn->session) ?
+                               O_POLL_WRITE : O_POLL_READ);
+    return OCS_PROCESSED;
+  }
+
+  int flags = fcntl(req->connection.fd, F_GETFL);
+  if (flags == -1
+      || fcntl(req->connection.fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+    ONION_ERROR("Could not set the connection back to blocking (%s)",
+                strerror(errno));
+    return OCS_CLOSE_CONNECTION;
+  }
+  conn->handshaking = false;
+  req->connection.fd_plaintext = onion_https_ktls_enable(req);
+  onion_poller_slot_set_type(req->connection.slot, O_POLL_READ);
+  ONION_DEBUG0("Handshake done, fd %d", req->connection.fd);
+  return OCS_PROCESSED;
+}
+
+/**
+ * @short Connection is ready; continue the handshake, or read the HTTP request.
+ * @memberof onion_https_t
+ * @ingroup https
+ *
+ * Reads up to a full record at a time, and goes on with the data gnutls already has, which
+ * would not wake the poller again, also after a request is processed. If the request became
+ * a websocket, that data is passed to it.
+ */
+static int onion_https_read_ready(onion_request * req) {
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  if (conn->handshaking) {
+    int ret = onion_https_handshake(req);
+    if (ret != OCS_PROCESSED || conn->handshaking
+        || gnutls_record_check_pending(conn->session) == 0)
+      return ret;
+  }
+
+  char buffer[ONION_HTTPS_RECORD_SIZE];
+  do {
+    ssize_t len = onion_https_read(req, buffer, sizeof(buffer));
+    if (len <= 0)
+      return OCS_CLOSE_CONNECTION;
+    onion_connection_status st = onion_request_write(req, buffer, len);
+    if (st != OCS_NEED_MORE_DATA) {
+      if (st == OCS_REQUEST_READY)
+        st = onion_request_process(req);
+      if (st < 0)
+        return st;
+      if (req->connection.pending)      // Output parked, that is sent before reading more
+        return OCS_PROCESSED;
+      if (req->websocket && req->websocket->polled) {
+        if (gnutls_record_check_pending(conn->session) > 0)
+          return onion_websocket_read_ready(req->websocket);
+        return OCS_PROCESSED;
+      }
+    }
+  } while (gnutls_record_check_pending(conn->session) > 0);
+  return OCS_PROCESSED;
+}
+
+/**
+ * @short Returns the bytes gnutls already decrypted, and which the next read gets.
+ * @memberof onion_https_t
+ * @ingroup https
+ *
+ * A read gets at most the asked for bytes, so the rest of a record stays at gnutls, and as it
+ * was already read from the fd the poller does not wake for it.
+ */
+static size_t onion_https_pending(onion_request * req) {
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  if (conn->handshaking)
+    return 0;
+  return gnutls_record_check_pending(conn->session);
+}
+
+static void onion_https_lock(onion_https_connection * conn) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&conn->mutex);
+#endif
+}
+
+static void onion_https_unlock(onion_https_connection * conn) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&conn->mutex);
+#endif
+}
+
+/// Sends all the corked data, in full records. Must have the lock.
+static int onion_https_uncork(onion_https_connection * conn) {
+  if (!conn->corked)
+    return 0;
+  conn->corked = false;
+  conn->corked_bytes = 0;
+  int ret;
+  do {
+    ret = gnutls_record_uncork(conn->session, GNUTLS_RECORD_WAIT);
+  } while (ret < 0 && !gnutls_error_is_fatal(ret));
+  if (ret < 0) {
+    ONION_ERROR("Writing data has failed (%s)", gnutls_strerror(ret));
+    errno = EIO;
+    return -1;
+  }
+  return 0;
+}
+
+/// Adds the data to the corked data, and sends it once there is a full record. Must have the lock.
+static ssize_t onion_https_cork(onion_https_connection * conn,
+                                const char *data, size_t len) {
+  if (!conn->corked) {
+    gnutls_record_cork(conn->session);
+    conn->corked = true;
+  }
+  ssize_t ret = gnutls_record_send(conn->session, data, len);
+  if (ret < 0) {
+    ONION_ERROR("Writing data has failed (%s)", gnutls_strerror(ret));
+    errno = EIO;
+    return -1;
+  }
+  conn->corked_bytes += ret;
+  if (conn->corked_bytes >= ONION_HTTPS_RECORD_SIZE
+      && onion_https_uncork(conn) < 0)
+    return -1;
+  return ret;
+}
+
 /**
  * @short Method to read some HTTPS data.
  * @memberof onion_https_t
  * @ingroup https
  *
+ * Any data still corked is sent first, as the client may be waiting for it to answer.
+ *
  * @param req to get data from
  * @param data where to store unencrypted data
  * @param Lenght of desired data
  * @returns Actual read data. 0 means EOF.
  */
 static ssize_t onion_https_read(onion_request * req, char *data, size_t len) {
-  gnutls_session_t session = (gnutls_session_t) req->connection.user_data;
-  ssize_t ret = gnutls_record_recv(session, data, len);
-  ONION_DEBUG("Read! (%p), %d bytes", session, ret);
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  onion_https_lock(conn);      // Websockets may write from other threads
+  int r = onion_https_uncork(conn);
+  onion_https_unlock(conn);
+  if (r < 0)
+    return -1;
+  ssize_t ret = gnutls_record_recv(conn->session, data, len);
   if (ret < 0) {
     ONION_ERROR("Reading data has failed (%s)", gnutls_strerror(ret));
   }
@@ -260,15 +881,69 @@ static ssize_t onion_https_read(onion_request * req, char *data, size_t len) {
  * @memberof onion_https_t
  * @ingroup https
  *
+ * Small writes are gathered into full TLS records, so they are not sent until there is a full
+ * record or onion_https_flush is called.
+ *
  * @param req to where write the data
  * @param data to write
  * @param len Ammount of data desired to write
  * @returns Actual ammount of data written.
  */
 ssize_t onion_https_write(onion_request * req, const char *data, size_t len) {
-  gnutls_session_t session = (gnutls_session_t) req->connection.user_data;
-  ONION_DEBUG("Write! (%p)", session);
-  return gnutls_record_send(session, data, len);
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  if (conn->ktls)
+    return write(req->connection.fd, data, len);
+  onion_https_lock(conn);
+  ssize_t ret = onion_https_cork(conn, data, len);
+  onion_https_unlock(conn);
+  return ret;
+}
+
+/**
+ * @short Writes several buffers to the HTTPS client, as one write.
+ * @memberof onion_https_t
+ * @ingroup https
+ */
+static ssize_t onion_https_writev(onion_request * req,
+                                  const struct iovec *iov, int iovcnt) {
+  if (req->connection.listen_point->write != onion_https_write) // Changed, it must see all data
+    return onion_listen_point_writev_with_write(req, iov, iovcnt);
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  if (conn->ktls)
+    return writev(req->connection.fd, iov, iovcnt);
+  ssize_t ret = 0;
+  int i;
+  onion_https_lock(conn);
+  for (i = 0; i < iovcnt; i++) {
+    ssize_t w = onion_https_cork(conn, iov[i].iov_base, iov[i].iov_len);
+    if (w < 0) {
+      ret = -1;
+      break;
+    }
+    ret += w;
+  }
+  onion_https_unlock(conn);
+  return ret;
+}
+
+/**
+ * @short Sends the data gathered by write and writev.
+ * @memberof onion_https_t
+ * @ingroup https
+ *
+ * @returns 0 if sent, <0 on error.
+ */
+static int onion_https_flush(onion_request * req) {
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  if (!conn)
+    return 0;
+  onion_https_lock(conn);
+  int ret = onion_https_uncork(conn);
+  onion_https_unlock(conn);
+  return ret;
 }
 
 /**
@@ -282,12 +957,23 @@ ssize_t onion_https_write(onion_request * req, const char *data, size_t len) {
  */
 static void onion_https_close(onion_request * req) {
   ONION_DEBUG("Close HTTPS connection");
-  gnutls_session_t session = (gnutls_session_t) req->connection.user_data;
-  if (session) {
-    ONION_DEBUG("Free session %p", session);
-    gnutls_bye(session, GNUTLS_SHUT_WR);
-    gnutls_deinit(session);
-
+  onion_https_connection *conn =
+      (onion_https_connection *) req->connection.user_data;
+  if (conn) {
+    ONION_DEBUG("Free session %p", conn->session);
+#ifdef USE_KTLS
+    if (conn->ktls)
+      onion_https_ktls_bye(req->connection.fd);
+    else
+#endif
+    if (!conn->handshaking && onion_https_flush(req) == 0)
+      gnutls_bye(conn->session, GNUTLS_SHUT_WR);
+    gnutls_deinit(conn->session);
+#ifdef HAVE_PTHREADS
+    pthread_mutex_destroy(&conn->mutex);
+#endif
+    onion_low_free(conn);
+    req->connection.user_data = NULL;
   }
   onion_listen_point_request_close_socket(req);
 }
@@ -380,3 +1066,95 @@ int onion_https_set_certificate_argv(onion_listen_point * ol,
 
   return r;
 }
+
+/**
+ * @short Sets how often the session ticket key is renewed, or disables session tickets.
+ * @memberof onion_https_t
+ * @ingroup https
+ *
+ * With session tickets the client keeps its session state encrypted by the server, and can
+ * resume it at the next connection, with no asymmetric crypto. They are enabled by
+ * default, with the key renewed daily.
+ *
+ * All tickets given before the key is renewed are no longer valid.
+ *
+ * @param ol Listen point
+ * @param rotation Seconds to renew the key, or 0 to disable session tickets.
+ * @returns 0 if set, -1 on error.
+ */
+int onion_https_set_session_tickets(onion_listen_point * ol, int rotation) {
+  if (ol->write != onion_https_write || rotation < 0) {
+    ONION_ERROR("Session tickets can only be set on HTTPS listen points, "
+                "with a positive rotation time");
+    errno = EINVAL;
+    return -1;
+  }
+  onion_https *https = (onion_https *) ol->user_data;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&https->ticket_mutex);
+#endif
+  https->ticket_rotation = rotation;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&https->ticket_mutex);
+#endif
+  return 0;
+}
+
+/**
+ * @short Sets a server side session cache, so clients can resume their sessions by id.
+ * @memberof onion_https_t
+ * @ingroup https
+ *
+ * It is for clients that do not support session tickets. There is none by default.
+ *
+ * When full, each new session replaces one of the oldest. Must be set before listening.
+ *
+ * @param ol Listen point
+ * @param max_entries Max number of sessions to keep, or 0 to remove the cache.
+ * @returns 0 if set, -1 on error.
+ */
+int onion_https_set_session_cache(onion_listen_point * ol, size_t max_entries) {
+  if (ol->write != onion_https_write) {
+    ONION_ERROR("Session cache can only be set on HTTPS listen points");
+    errno = EINVAL;
+    return -1;
+  }
+  onion_https *https = (onion_https *) ol->user_data;
+  if (https->cache)
+    onion_https_cache_free(https->cache);
+  https->cache = max_entries ? onion_https_cache_new(max_entries) : NULL;
+  return 0;
+}
+
+/**
+ * @short Sets if the sending is passed to the kernel (kTLS) after the handshake.
+ * @memberof onion_https_t
+ * @ingroup https
+ *
+ * With kTLS the kernel encrypts the data, so files can be sent with sendfile, as with HTTP,
+ * with no copies to user space. It needs the Linux tls module, and an AES GCM or
+ * ChaCha20-Poly1305 cipher suite; if not possible for some connection, gnutls is used as
+ * usual. Receiving is always done by gnutls.
+ *
+ * It is disabled by default.
+ *
+ * @param ol Listen point
+ * @param enable If it should try to use kTLS.
+ * @returns 0 if set, -1 on error.
+ */
+int onion_https_set_ktls(onion_listen_point * ol, int enable) {
+  if (ol->write != onion_https_write) {
+    ONION_ERROR("kTLS can only be set on HTTPS listen points");
+    errno = EINVAL;
+    return -1;
+  }
+#ifndef USE_KTLS
+  if (enable) {
+    ONION_ERROR("kTLS is only available on Linux");
+    errno = ENOSYS;
+    return -1;
+  }
+#endif
+  ((onion_https *) ol->user_data)->ktls = enable ? true : false;
+  return 0;
+}
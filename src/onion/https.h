@@ -25,6 +25,7 @@
 #define ONION_HTTPS_H
 
 #include <stdarg.h>
+#include <stddef.h>
 #include "types.h"
 
 #ifdef __cplusplus
@@ -38,6 +39,13 @@ extern "C" {
   int onion_https_set_certificate_argv(onion_listen_point * ol,
                                        onion_ssl_certificate_type type,
                                        const char *filename, va_list va);
+/// Seconds to renew the session ticket key, or 0 to disable tickets. Default one day.
+  int onion_https_set_session_tickets(onion_listen_point * ol, int rotation);
+/// Max sessions at the server side session cache, or 0 for none, the default.
+  int onion_https_set_session_cache(onion_listen_point * ol,
+                                    size_t max_entries);
+/// If enabled, sending is done by the kernel (kTLS) when possible, so sendfile can be used. Default off.
+  int onion_https_set_ktls(onion_listen_point * ol, int enable);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,404 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "json.h"
+#include "codecs.h"
+#include "dict.h"
+#include "block.h"
+#include "response.h"
+#include "types_internal.h"
+#include "log.h"
+#include "low.h"
+
+/**
+ * @defgroup json JSON. Streaming writer, with no intermediate buffers.
+ *
+ * The writer keeps just the nesting state, and writes each piece as soon as it is known,
+ * so a response is written directly into the response buffer:
+ *
+ * @code
+ *   onion_json_writer *w = onion_json_writer_new(res);
+ *   onion_json_object_start(w);
+ *   onion_json_key(w, "count");
+ *   onion_json_int(w, 2);
+ *   onion_json_key(w, "items");
+ *   onion_json_array_start(w);
+ *   onion_json_string(w, "a");
+ *   onion_json_bool(w, 1);
+ *   onion_json_array_end(w);
+ *   onion_json_object_end(w);
+ *   onion_json_writer_free(w);
+ * @endcode
+ *
+ * Separators are ", ", as onion_dict_to_json uses.
+ */
+
+/// Maximum nesting of objects and arrays.
+#define ONION_JSON_MAX_DEPTH 64
+
+struct onion_json_writer_t {
+  onion_response *res;          ///< Writes here,
+  onion_block *block;           ///< or here. If none just counts.
+  size_t size;
+  int depth;
+  char type[ONION_JSON_MAX_DEPTH];      ///< '{' or '[' for each level
+  char first[ONION_JSON_MAX_DEPTH];     ///< If there is no value yet at each level
+  char has_key;                 ///< Inside objects, if the key for next value is written
+  char error;
+};
+
+static void onion_json_writer_add(onion_json_writer * w, const char *data,
+                                  size_t length) {
+  w->size += length;
+  if (w->res)
+    onion_response_write(w->res, data, length);
+  else if (w->block)
+    onion_block_add_data(w->block, data, length);
+}
+
+/**
+ * @short Creates a writer to the response.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ *
+ * If res is NULL nothing is written, and it just counts the size, for example to set the
+ * Content-Length before writing.
+ */
+onion_json_writer *onion_json_writer_new(onion_response * res) {
+  onion_json_writer *w = onion_low_calloc(1, sizeof(onion_json_writer));
+  w->res = res;
+  return w;
+}
+
+/**
+ * @short Creates a writer that appends to the block.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+onion_json_writer *onion_json_writer_new_block(onion_block * block) {
+  onion_json_writer *w = onion_low_calloc(1, sizeof(onion_json_writer));
+  w->block = block;
+  return w;
+}
+
+/**
+ * @short Frees the writer.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ *
+ * @returns 0 if all was correct and all objects and arrays were closed, -1 if not.
+ */
+int onion_json_writer_free(onion_json_writer * w) {
+  int ret = (w->error || w->depth) ? -1 : 0;
+  if (w->depth && !w->error)
+    ONION_ERROR("JSON writer freed with %d objects or arrays not closed",
+                w->depth);
+  onion_low_free(w);
+  return ret;
+}
+
+/**
+ * @short Bytes written so far.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+size_t onion_json_writer_size(const onion_json_writer * w) {
+  return w->size;
+}
+
+/// Writes the separator if needed before a value. Returns 0 if the value is not allowed here.
+static int onion_json_writer_value(onion_json_writer * w) {
+  if (w->error)
+    return 0;
+  if (w->depth == 0) {
+    if (w->size) {
+      ONION_ERROR("Only one JSON value can be written");
+      w->error = 1;
+      return 0;
+    }
+    return 1;
+  }
+  if (w->type[w->depth - 1] == '{') {
+    if (!w->has_key) {
+      ONION_ERROR("JSON object values need a key first");
+      w->error = 1;
+      return 0;
+    }
+    w->has_key = 0;
+    return 1;
+  }
+  if (!w->first[w->depth - 1])
+    onion_json_writer_add(w, ", ", 2);
+  w->first[w->depth - 1] = 0;
+  return 1;
+}
+
+/// Writes the string quoted. Runs of characters that need no escaping are found and written at once.
+static void onion_json_writer_quoted(onion_json_writer * w, const char *str) {
+  onion_json_writer_add(w, "\"", 1);
+  for (;;) {
+    const char *next = onion_json_find_unsafe(str);
+    if (next != str)
+      onion_json_writer_add(w, str, next - str);
+    unsigned char c = *next;
+    if (!c)
+      break;
+    str = next + 1;
+    switch (c) {
+    case '\b':
+      onion_json_writer_add(w, "\\b", 2);
+      break;
+    case '\f':
+      onion_json_writer_add(w, "\\f", 2);
+      break;
+    case '\n':
+      onion_json_writer_add(w, "\\n", 2);
+      break;
+    case '\r':
+      onion_json_writer_add(w, "\\r", 2);
+      break;
+    case '\t':
+      onion_json_writer_add(w, "\\t", 2);
+      break;
+    case '"':
+      onion_json_writer_add(w, "\\\"", 2);
+      break;
+    case '\\':
+      onion_json_writer_add(w, "\\\\", 2);
+      break;
+    default:{
+        char codestr[6] = "\\u0000";
+        const char *hex = "0123456789ABCDEF";
+        codestr[4] = hex[(c >> 4) & 0x0F];
+        codestr[5] = hex[c & 0x0F];
+        onion_json_writer_add(w, codestr, 6);
+      }
+    }
+  }
+  onion_json_writer_add(w, "\"", 1);
+}
+
+static void onion_json_writer_start(onion_json_writer * w, char type) {
+  if (!onion_json_writer_value(w))
+    return;
+  if (w->depth == ONION_JSON_MAX_DEPTH) {
+    ONION_ERROR("Too deep JSON, max %d levels", ONION_JSON_MAX_DEPTH);
+    w->error = 1;
+    return;
+  }
+  w->type[w->depth] = type;
+  w->first[w->depth] = 1;
+  w->depth++;
+  onion_json_writer_add(w, &type, 1);
+}
+
+static void onion_json_writer_end(onion_json_writer * w, char type) {
+  if (w->error)
+    return;
+  if (w->depth == 0 || w->type[w->depth - 1] != type || w->has_key) {
+    ONION_ERROR("Closing a JSON %s that is not open, or has a key without value",
+                type == '{' ? "object" : "array");
+    w->error = 1;
+    return;
+  }
+  w->depth--;
+  onion_json_writer_add(w, type == '{' ? "}" : "]", 1);
+}
+
+/**
+ * @short Starts an object. Values inside must be preceded by onion_json_key.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_object_start(onion_json_writer * w) {
+  onion_json_writer_start(w, '{');
+}
+
+/**
+ * @short Ends current object.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_object_end(onion_json_writer * w) {
+  onion_json_writer_end(w, '{');
+}
+
+/**
+ * @short Starts an array.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_array_start(onion_json_writer * w) {
+  onion_json_writer_start(w, '[');
+}
+
+/**
+ * @short Ends current array.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_array_end(onion_json_writer * w) {
+  onion_json_writer_end(w, '[');
+}
+
+/**
+ * @short Writes the key for the next value of current object.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_key(onion_json_writer * w, const char *key) {
+  if (w->error)
+    return;
+  if (w->depth == 0 || w->type[w->depth - 1] != '{' || w->has_key) {
+    ONION_ERROR("JSON keys only allowed inside objects, once per value");
+    w->error = 1;
+    return;
+  }
+  if (!w->first[w->depth - 1])
+    onion_json_writer_add(w, ", ", 2);
+  w->first[w->depth - 1] = 0;
+  onion_json_writer_quoted(w, key);
+  onion_json_writer_add(w, ":", 1);
+  w->has_key = 1;
+}
+
+/**
+ * @short Writes a string value. NULL is written as null.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_string(onion_json_writer * w, const char *str) {
+  if (!str) {
+    onion_json_null(w);
+    return;
+  }
+  if (onion_json_writer_value(w))
+    onion_json_writer_quoted(w, str);
+}
+
+/**
+ * @short Writes an integer value.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_int(onion_json_writer * w, long long n) {
+  char tmp[24];
+  int l = snprintf(tmp, sizeof(tmp), "%lld", n);
+  if (onion_json_writer_value(w))
+    onion_json_writer_add(w, tmp, l);
+}
+
+/**
+ * @short Writes a number value. JSON has no NaN nor infinite, so they are written as null.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_double(onion_json_writer * w, double n) {
+  if (!isfinite(n)) {
+    onion_json_null(w);
+    return;
+  }
+  char tmp[32];
+  int l = snprintf(tmp, sizeof(tmp), "%.17g", n);
+  if (onion_json_writer_value(w))
+    onion_json_writer_add(w, tmp, l);
+}
+
+/**
+ * @short Writes true or false.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_bool(onion_json_writer * w, int b) {
+  if (onion_json_writer_value(w)) {
+    if (b)
+      onion_json_writer_add(w, "true", 4);
+    else
+      onion_json_writer_add(w, "false", 5);
+  }
+}
+
+/**
+ * @short Writes null.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ */
+void onion_json_null(onion_json_writer * w) {
+  if (onion_json_writer_value(w))
+    onion_json_writer_add(w, "null", 4);
+}
+
+static void onion_json_dict_preorder(onion_json_writer * w, const char *key,
+                                     const void *value, int flags) {
+  onion_json_key(w, key);
+  if (flags & OD_DICT)
+    onion_json_dict(w, value);
+  else
+    onion_json_string(w, value);
+}
+
+/**
+ * @short Writes a dict as an object, with subdicts as objects.
+ * @memberof onion_json_writer_t
+ * @ingroup json
+ *
+ * Same output as onion_dict_to_json, but written as it goes.
+ */
+void onion_json_dict(onion_json_writer * w, const onion_dict * dict) {
+  onion_json_object_start(w);
+  onion_dict_preorder(dict, (void *)onion_json_dict_preorder, w);
+  onion_json_object_end(w);
+}
+
+/**
+ * @short Writes the dict as JSON to the response.
+ * @memberof onion_dict_t
+ * @ingroup json
+ *
+ * If the headers are not written yet and no length is set, it calculates the length first,
+ * so the response has a Content-Length and can be kept alive without chunked encoding. No
+ * intermediate buffer is used in either case.
+ *
+ * @returns the bytes of JSON written, or -1 on error.
+ */
+ssize_t onion_dict_write_json(const onion_dict * dict, onion_response * res) {
+  onion_json_writer *w;
+  if (!(res->flags & (OR_HEADER_SENT | OR_LENGTH_SET))) {
+    w = onion_json_writer_new(NULL);
+    onion_json_dict(w, dict);
+    size_t length = onion_json_writer_size(w);
+    if (onion_json_writer_free(w) < 0)
+      return -1;
+    onion_response_set_length(res, length);
+  }
+  w = onion_json_writer_new(res);
+  onion_json_dict(w, dict);
+  ssize_t ret = onion_json_writer_size(w);
+  if (onion_json_writer_free(w) < 0)
+    return -1;
+  return ret;
+}
@@ -0,0 +1,67 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef ONION_JSON_H
+#define ONION_JSON_H
+
+#include "types.h"
+#include <stddef.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Creates a writer to the response. If res is NULL it just counts the bytes.
+  onion_json_writer *onion_json_writer_new(onion_response * res);
+/// Creates a writer that appends to the block.
+  onion_json_writer *onion_json_writer_new_block(onion_block * block);
+/// Frees the writer. Returns 0 if the JSON was complete and correct, -1 if not.
+  int onion_json_writer_free(onion_json_writer * w);
+/// Bytes written so far.
+  size_t onion_json_writer_size(const onion_json_writer * w);
+
+  void onion_json_object_start(onion_json_writer * w);
+  void onion_json_object_end(onion_json_writer * w);
+  void onion_json_array_start(onion_json_writer * w);
+  void onion_json_array_end(onion_json_writer * w);
+/// Key of the next value, inside objects.
+  void onion_json_key(onion_json_writer * w, const char *key);
+
+/// A string value. NULL is written as null.
+  void onion_json_string(onion_json_writer * w, const char *str);
+  void onion_json_int(onion_json_writer * w, long long n);
+/// A number value. NaN and infinite are written as null.
+  void onion_json_double(onion_json_writer * w, double n);
+  void onion_json_bool(onion_json_writer * w, int b);
+  void onion_json_null(onion_json_writer * w);
+/// A dict as an object, with subdicts as objects.
+  void onion_json_dict(onion_json_writer * w, const onion_dict * dict);
+
+/// Writes the dict as JSON to the response, setting the Content-Length if possible.
+  ssize_t onion_dict_write_json(const onion_dict * dict, onion_response * res);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
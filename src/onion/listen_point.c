@@ -33,11 +33,13 @@
 #include <fcntl.h>
 
 #include "types_internal.h"
+#include "websocket.h"
 #include "low.h"
 #include "log.h"
 #include "poller.h"
 #include "request.h"
 #include "listen_point.h"
+#include "onion.h"
 
 #ifndef SOCK_CLOEXEC
 #define SOCK_CLOEXEC 0
@@ -51,6 +53,7 @@
 /// @defgroup listen_point Listen Point. Allows to listen at several ports with different protocols, and to add new protocols.
 
 static int onion_listen_point_read_ready(onion_request * req);
+static int onion_listen_point_write_pending(onion_request * req);
 
 /**
  * @short Creates an empty listen point.
@@ -116,6 +119,10 @@ int onion_listen_point_accept(onion_listen_point * op) {
                                     req->connection.listen_point->server->
                                     timeout);
       onion_poller_slot_set_shutdown(slot, (void *)onion_request_free, req);
+#ifdef HAVE_EPOLL
+      // Only epoll rearms with the type changed from the callback, needed to park pending output.
+      req->connection.slot = slot;
+#endif
       onion_poller_add(req->connection.listen_point->server->poller, slot);
       return 1;
     }
@@ -260,10 +267,118 @@ static int onion_listen_point_read_ready(onion_request * req) {
     return OCS_INTERNAL_ERROR;
   }
 #endif
+  if (req->connection.pending)
+    return onion_listen_point_write_pending(req);
+  if (req->websocket && req->websocket->polled)
+    return onion_websocket_read_ready(req->websocket);
 
   return req->connection.listen_point->read_ready(req);
 }
 
+/**
+ * @short Parks some output on the connection, to be resumed when the connection is writable.
+ * @memberof onion_listen_point_t
+ * @ingroup listen_point
+ *
+ * When a non blocking write would block (EAGAIN), as sendfile of a big file to a slow client,
+ * the handler can return normally and leave the rest of the work here. The poller then waits
+ * for the connection to be writable, and calls resume again without blocking the thread
+ * meanwhile. No new request data is read until all is sent.
+ *
+ * It is only possible for connections managed by the epoll poller; else it returns -1, and the
+ * caller must do a blocking wait itself.
+ *
+ * @param req The request
+ * @param resume Function to call when writable. Returns 0 when finished, >0 to wait again, <0 on error.
+ * @param free_data Function to free the data when finished or the connection is closed.
+ * @param data Data for resume and free_data.
+ * @returns 0 if parked, -1 if not possible.
+ */
+int onion_listen_point_request_set_pending(onion_request * req,
+                                           int (*resume) (onion_request *,
+                                                          void *),
+                                           void (*free_data) (void *),
+                                           void *data) {
+  onion_poller_slot *slot = req->connection.slot;
+  if (req->connection.pending || !slot)
+    return -1;
+
+  struct onion_connection_pending_t *pending =
+      onion_low_calloc(1, sizeof(struct onion_connection_pending_t));
+  pending->resume = resume;
+  pending->free = free_data;
+  pending->data = data;
+  req->connection.pending = pending;
+  onion_poller_slot_set_type(slot, O_POLL_WRITE);
+  return 0;
+}
+
+/**
+ * @short Frees the pending output, if any, without sending it.
+ * @memberof onion_listen_point_t
+ * @ingroup listen_point
+ */
+void onion_listen_point_request_free_pending(onion_request * req) {
+  struct onion_connection_pending_t *pending = req->connection.pending;
+  if (!pending)
+    return;
+  req->connection.pending = NULL;
+  if (pending->free)
+    pending->free(pending->data);
+  onion_low_free(pending);
+}
+
+/**
+ * @short Writes the buffers one by one with the listen point write.
+ * @memberof onion_listen_point_t
+ * @ingroup listen_point
+ *
+ * Default writev implementations use it when write was changed, for example to capture the
+ * output, so all data goes through it.
+ *
+ * @returns the bytes written, that may be less than asked, or <0 on error if none.
+ */
+ssize_t onion_listen_point_writev_with_write(onion_request * req,
+                                             const struct iovec *iov,
+                                             int iovcnt) {
+  ssize_t total = 0;
+  int i;
+  for (i = 0; i < iovcnt; i++) {
+    if (!iov[i].iov_len)
+      continue;
+    ssize_t w =
+        req->connection.listen_point->write(req, iov[i].iov_base,
+                                            iov[i].iov_len);
+    if (w < 0)
+      return total ? total : w;
+    total += w;
+    if ((size_t) w < iov[i].iov_len)
+      break;
+  }
+  return total;
+}
+
+/**
+ * @short Connection is writable, continue with the pending output.
+ * @memberof onion_listen_point_t
+ * @ingroup listen_point
+ *
+ * Once finished, polls for reading again, or closes if the response could not keep alive.
+ */
+static int onion_listen_point_write_pending(onion_request * req) {
+  struct onion_connection_pending_t *pending = req->connection.pending;
+  int r = pending->resume(req, pending->data);
+  if (r > 0)                    // Still more to send. Poller keeps waiting for write.
+    return OCS_PROCESSED;
+  bool close = pending->close;
+  onion_listen_point_request_free_pending(req);
+  if (r < 0 || close)
+    return OCS_CLOSE_CONNECTION;
+
+  onion_poller_slot_set_type(req->connection.slot, O_POLL_READ);
+  return OCS_PROCESSED;
+}
+
 /**
  * @short Default implementation that initializes the request from a socket
  * @memberof onion_listen_point_t
@@ -25,6 +25,8 @@
 #define ONION_LISTEN_POINT_H
 
 #include "types.h"
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,6 +39,15 @@ extern "C" {
   int onion_listen_point_accept(onion_listen_point *);
   int onion_listen_point_request_init_from_socket(onion_request * op);
   void onion_listen_point_request_close_socket(onion_request * oc);
+  int onion_listen_point_request_set_pending(onion_request * req,
+                                             int (*resume) (onion_request *,
+                                                            void *),
+                                             void (*free_data) (void *),
+                                             void *data);
+  void onion_listen_point_request_free_pending(onion_request * req);
+  ssize_t onion_listen_point_writev_with_write(onion_request * req,
+                                               const struct iovec *iov,
+                                               int iovcnt);
 #ifdef __cplusplus
 }
 #endif
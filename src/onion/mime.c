@@ -24,25 +24,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "types.h"
 #include "mime.h"
+#include "mime_hash.h"
 #include "dict.h"
 #include "log.h"
-#include "utils.h"
+
+#include <onion/mime_table.h>
 
 /// @defgroup mime MIME. mime functionctionalities
 
-/// Dict with all extension to mime type. This will never be freed.
+/// User set mime types, checked before the builtin ones. "" means removed.
 static onion_dict *onion_mime_dict = NULL;
-
-static void onion_mime_fill();
+/// Changes each time the mime dict changes
+static int onion_mime_generation_counter = 0;
 
 /**
  * @short Sets a user set dict as mime dict
  * @ingroup mime
  *
- * This dict maps "extension" -> "mimetype".
+ * This dict maps "extension" -> "mimetype", and is checked before the builtin mime types.
  *
  * At onion_server_free it is freed, as if this function is called again.
  */
@@ -50,23 +53,38 @@ void onion_mime_set(onion_dict * d) {
   if (onion_mime_dict)
     onion_dict_free(onion_mime_dict);
   onion_mime_dict = d;
+  onion_mime_generation_counter++;
+}
+
+/**
+ * @short Looks for the extension at the builtin table.
+ *
+ * The table is a perfect hash generated at compile time from src/onion/mime.types, so it
+ * is just two hashes and a compare, with no initialization at all.
+ */
+static const char *onion_mime_table_get(const char *extension) {
+  unsigned int bucket =
+      onion_mime_hash(extension, 0) % ONION_MIME_TABLE_BUCKETS;
+  unsigned int slot =
+      onion_mime_hash(extension,
+                      onion_mime_table_seeds[bucket]) % ONION_MIME_TABLE_SIZE;
+  if (onion_mime_table[slot].extension
+      && strcasecmp(onion_mime_table[slot].extension, extension) == 0)
+    return onion_mime_table_types[onion_mime_table[slot].type];
+  return NULL;
 }
 
 /**
  * @short Given a filename or extensiton, it returns the proper mime type.
  * @ingroup mime
  *
- * If onion_mime_set was called before, it is used, else it reads mime types /etc/mime.types.
- *
- * Full mime catalog, from /etc/mime.types, takes about 36kb on ubuntu 10.10, may depend on
- * how many mime types are known.
+ * First checks the mime types set with onion_mime_set or onion_mime_update, and then the
+ * builtin ones, compiled from src/onion/mime.types. Extensions are case insensitive for the
+ * builtin ones.
  *
  * If none is found, returns text/plain.
  */
 const char *onion_mime_get(const char *filename) {
-  if (!onion_mime_dict)
-    onion_mime_fill();
-
   const char *extension = filename;
   int l = strlen(filename);
   int i;
@@ -77,9 +95,13 @@ const char *onion_mime_get(const char *filename) {
     }
   }
 
-  //ONION_DEBUG("I know %d mime types", onion_dict_count(onion_mime_dict));
-
-  const char *r = onion_dict_get(onion_mime_dict, extension);
+  const char *r;
+  if (onion_mime_dict) {
+    r = onion_dict_get(onion_mime_dict, extension);
+    if (r)
+      return *r ? r : "text/plain";
+  }
+  r = onion_mime_table_get(extension);
   if (r)
     return r;
   //ONION_DEBUG("Mime type for extension '%s' %s",extension, r);
@@ -87,96 +109,29 @@ const char *onion_mime_get(const char *filename) {
 }
 
 /**
- * @short Reads the /etc/mime.types file
+ * @short Allow to update mime types.
  * @ingroup mime
  *
- *
+ * User can add new mime types, or remove (if mimetype == NULL), also the builtin ones.
  */
-static void onion_mime_fill() {
-  onion_mime_set(NULL);
-  onion_mime_dict = onion_dict_new();
-  //ONION_DEBUG("Filling mime types");
-
-  FILE *fd = fopen("/etc/mime.types", "rt");
-  if (!fd) {
-    ONION_WARNING
-        ("Could not read MIME types (etc/mime.types), returned mime types may be incorrect. Adding minimal set.");
-    onion_dict_add(onion_mime_dict, "html", "text/html", 0);
-    onion_dict_add(onion_mime_dict, "htm", "text/html", 0);
-    onion_dict_add(onion_mime_dict, "js", "application/javascript", 0);
-    onion_dict_add(onion_mime_dict, "mjs", "application/javascript", 0);
-    onion_dict_add(onion_mime_dict, "css", "text/css", 0);
-    onion_dict_add(onion_mime_dict, "png", "image/png", 0);
-    onion_dict_add(onion_mime_dict, "jpg", "image/jpeg", 0);
-    return;
-  }
-  char mimetype[128];
-  char extension[8];
-  int mode = 0;                 // 0 mimetype, 1 extension
-  int i = 0;
-  int c;
-
-  while ((c = getc(fd)) >= 0) {
-    if (c == '#') {
-      while ((c = getc(fd)) >= 0 && c != '\n') ;
-    }
-    if (c == '\n') {
-      if (mode == 1 && i != 0) {
-        extension[i] = 0;
-        onion_dict_add(onion_mime_dict, extension, mimetype, OD_DUP_ALL);
-        //ONION_DEBUG("Add mimetype '%s' (%s).", extension, mimetype);
-      }
-      mode = 0;
-      i = 0;
-    } else {
-      if (is_space(c)) {
-        if (mode == 0) {
-          mimetype[i] = '\0';
-          mode = 1;
-          i = 0;
-        } else if (i != 0) {
-          extension[i] = '\0';
-          i = 0;
-          onion_dict_add(onion_mime_dict, extension, mimetype, OD_DUP_ALL);
-          //ONION_DEBUG("Add mimetype '%s' (%s)", extension, mimetype);
-        }
-      } else {
-        if (mode == 0) {
-          if (i >= sizeof(mimetype) - 1) {
-            while ((c = getc(fd)) >= 0 && c != '\n') ;
-          } else
-            mimetype[i++] = c;
-        } else {
-          if (i >= sizeof(extension) - 1) {
-            while ((c = getc(fd)) >= 0 && c != '\n') ;
-            extension[i] = '\0';
-            i = 0;
-            mode = 0;
-            onion_dict_add(onion_mime_dict, extension, mimetype, OD_DUP_ALL);
-            //ONION_DEBUG("Add mimetype '%s' (%s)..", extension, mimetype);
-          } else
-            extension[i++] = c;
-        }
-      }
-    }
-  }
-  fclose(fd);
+void onion_mime_update(const char *extension, const char *mimetype) {
+  if (!onion_mime_dict)
+    onion_mime_dict = onion_dict_new();
 
-  ONION_DEBUG("I know %d mime types", onion_dict_count(onion_mime_dict));
+  if (mimetype)
+    onion_dict_add(onion_mime_dict, extension, mimetype,
+                   OD_DUP_ALL | OD_REPLACE);
+  else
+    onion_dict_add(onion_mime_dict, extension, "", OD_DUP_KEY | OD_REPLACE);
+  onion_mime_generation_counter++;
 }
 
 /**
- * @short Allow to update mime types.
+ * @short Returns a number that changes each time the mime types change.
  * @ingroup mime
  *
- * User can add new mime types, or remove (if mimetype == NULL).
+ * Allows to cache the result of onion_mime_get, and know when it is outdated.
  */
-void onion_mime_update(const char *extension, const char *mimetype) {
-  if (!onion_mime_dict)
-    onion_mime_fill();
-
-  if (mimetype)
-    onion_dict_add(onion_mime_dict, extension, mimetype, OD_DUP_ALL);
-  else
-    onion_dict_remove(onion_mime_dict, extension);
+int onion_mime_generation() {
+  return onion_mime_generation_counter;
 }
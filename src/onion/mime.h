@@ -36,6 +36,8 @@ extern "C" {
   const char *onion_mime_get(const char *filename);
 /// Updates a mime record, for that extensions set that mimetype. If mimetype==NULL, removes it.
   void onion_mime_update(const char *extension, const char *mimetype);
+/// Returns a counter that changes each time mime types are changed, to invalidate cached mime types.
+  int onion_mime_generation();
 
 #ifdef __cplusplus
 }
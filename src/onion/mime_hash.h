@@ -0,0 +1,51 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef ONION_MIME_HASH_H
+#define ONION_MIME_HASH_H
+
+/**
+ * @short Hash of an extension, for the mime perfect hash table. Case insensitive.
+ *
+ * Shared by onion_mime_get and tools/mimetable, which generates the table, so they must match.
+ * Seed 0 selects the bucket, and the bucket seed the final slot.
+ */
+static inline unsigned int onion_mime_hash(const char *extension,
+                                           unsigned int seed) {
+  unsigned int h = 2166136261u ^ (seed * 0x9e3779b9u);
+  for (; *extension; extension++) {
+    unsigned char c = *extension;
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+    h ^= c;
+    h *= 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+#endif
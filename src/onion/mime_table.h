@@ -0,0 +1,3144 @@
+/* Generated by tools/mimetable from mime.types. Do not edit, regenerate with make mime_table. */
+
+#define ONION_MIME_TABLE_BUCKETS 383
+#define ONION_MIME_TABLE_SIZE 1912
+
+static const unsigned int onion_mime_table_seeds[383] = {
+  26, 1, 1, 9, 1, 17, 4, 27, 1, 21, 5, 4, 43, 11, 13, 1,
+  9, 2, 8, 38, 1, 4, 8, 44, 14, 29, 2, 27, 28, 14, 4, 0,
+  1, 21, 2, 5, 0, 13, 1, 26, 14, 21, 6, 8, 1, 3, 11, 3,
+  6, 1, 5, 18, 2, 8, 7, 5, 23, 56, 8, 2, 42, 1, 10, 7,
+  40, 19, 1, 5, 8, 3, 20, 24, 5, 2, 11, 12, 11, 2, 9, 3,
+  1, 10, 28, 1, 4, 5, 7, 7, 16, 3, 37, 4, 8, 4, 18, 2,
+  11, 9, 33, 6, 24, 8, 1, 2, 4, 1, 1, 6, 15, 3, 5, 15,
+  16, 13, 2, 2, 2, 34, 13, 5, 104, 2, 18, 4, 29, 4, 27, 19,
+  42, 5, 16, 33, 6, 1, 2, 8, 4, 17, 1, 10, 22, 30, 6, 3,
+  3, 20, 17, 10, 8, 5, 1, 13, 6, 23, 7, 30, 2, 59, 10, 2,
+  10, 18, 11, 2, 21, 23, 32, 61, 1, 6, 30, 20, 1, 1, 45, 10,
+  11, 6, 43, 10, 7, 35, 1, 16, 11, 18, 3, 17, 1, 4, 1, 17,
+  34, 14, 14, 4, 1, 12, 35, 22, 4, 3, 20, 11, 3, 7, 47, 6,
+  158, 40, 25, 3, 2, 34, 32, 3, 4, 96, 1, 4, 11, 31, 13, 35,
+  2, 50, 5, 11, 0, 44, 11, 3, 3, 48, 2, 2, 5, 24, 2, 1,
+  7, 43, 4, 39, 17, 1, 57, 43, 1, 28, 4, 18, 30, 169, 1, 46,
+  87, 8, 1, 1, 32, 1, 3, 9, 9, 1, 59, 5, 1, 34, 1, 3,
+  17, 2, 92, 58, 2, 28, 44, 6, 2, 1, 5, 39, 24, 2, 6, 4,
+  2, 11, 52, 2, 8, 74, 131, 4, 23, 1, 17, 0, 192, 32, 34, 14,
+  5, 3, 1, 7, 20, 5, 5, 18, 34, 14, 14, 47, 9, 5, 30, 10,
+  26, 35, 46, 12, 1, 56, 11, 6, 5, 10, 1, 2, 180, 9, 26, 1,
+  46, 19, 21, 47, 4, 6, 19, 2, 8, 11, 88, 19, 2, 51, 6, 21,
+  2, 0, 3, 8, 1, 35, 16, 6, 8, 19, 13, 2, 0, 11, 16, 59,
+  1, 33, 8, 11, 5, 20, 0, 1, 8, 45, 2, 5, 15, 5, 5
+};
+
+static const char *const onion_mime_table_types[1192] = {
+  "application/A2L",
+  "application/AML",
+  "application/andrew-inset",
+  "application/annodex",
+  "application/ATF",
+  "application/ATFX",
+  "application/atom+xml",
+  "application/atomcat+xml",
+  "application/atomdeleted+xml",
+  "application/atomserv+xml",
+  "application/atomsvc+xml",
+  "application/atsc-dwd+xml",
+  "application/atsc-held+xml",
+  "application/atsc-rsat+xml",
+  "application/ATXML",
+  "application/auth-policy+xml",
+  "application/automationml-amlx+zip",
+  "application/bacnet-xdd+zip",
+  "application/bbolin",
+  "application/calendar+xml",
+  "application/cbor",
+  "application/cccex",
+  "application/ccmp+xml",
+  "application/ccxml+xml",
+  "application/CDFX+XML",
+  "application/cdmi-capability",
+  "application/cdmi-container",
+  "application/cdmi-domain",
+  "application/cdmi-object",
+  "application/cdmi-queue",
+  "application/CEA",
+  "application/cellml+xml",
+  "application/clr",
+  "application/clue_info+xml",
+  "application/cms",
+  "application/cpl+xml",
+  "application/csrattrs",
+  "application/cu-seeme",
+  "application/cwl",
+  "application/cwl+json",
+  "application/dash+xml",
+  "application/dashdelta",
+  "application/davmount+xml",
+  "application/DCD",
+  "application/dicom",
+  "application/DII",
+  "application/DIT",
+  "application/dskpp+xml",
+  "application/dsptype",
+  "application/dssc+der",
+  "application/dssc+xml",
+  "application/dvcs",
+  "application/efi",
+  "application/emma+xml",
+  "application/emotionml+xml",
+  "application/epub+zip",
+  "application/exi",
+  "application/express",
+  "application/fastinfoset",
+  "application/fdf",
+  "application/fdt+xml",
+  "application/font-tdpfr",
+  "application/futuresplash",
+  "application/geo+json",
+  "application/geopackage+sqlite3",
+  "application/gltf-buffer",
+  "application/gml+xml",
+  "application/gzip",
+  "application/hta",
+  "application/hyperstudio",
+  "application/inkml+xml",
+  "application/ipfix",
+  "application/its+xml",
+  "application/java-archive",
+  "application/java-serialized-object",
+  "application/java-vm",
+  "application/jrd+json",
+  "application/json",
+  "application/json-patch+json",
+  "application/ld+json",
+  "application/lgr+xml",
+  "application/link-format",
+  "application/lost+xml",
+  "application/lostsync+xml",
+  "application/lpf+zip",
+  "application/LXF",
+  "application/m3g",
+  "application/mac-binhex40",
+  "application/mac-compactpro",
+  "application/mads+xml",
+  "application/manifest+json",
+  "application/marc",
+  "application/marcxml+xml",
+  "application/mathematica",
+  "application/mathml+xml",
+  "application/mbox",
+  "application/metalink4+xml",
+  "application/mets+xml",
+  "application/MF4",
+  "application/mmt-aei+xml",
+  "application/mmt-usd+xml",
+  "application/mods+xml",
+  "application/mp21",
+  "application/msaccess",
+  "application/msword",
+  "application/mxf",
+  "application/n-quads",
+  "application/n-triples",
+  "application/ocsp-request",
+  "application/ocsp-response",
+  "application/octet-stream",
+  "application/ODA",
+  "application/ODX",
+  "application/oebps-package+xml",
+  "application/ogg",
+  "application/onenote",
+  "application/oxps",
+  "application/p21",
+  "application/p2p-overlay+xml",
+  "application/pdf",
+  "application/PDX",
+  "application/pem-certificate-chain",
+  "application/pgp-encrypted",
+  "application/pgp-keys",
+  "application/pgp-signature",
+  "application/pics-rules",
+  "application/pkcs10",
+  "application/pkcs12",
+  "application/pkcs7-mime",
+  "application/pkcs7-signature",
+  "application/pkcs8",
+  "application/pkcs8-encrypted",
+  "application/pkix-attr-cert",
+  "application/pkix-cert",
+  "application/pkix-crl",
+  "application/pkix-pkipath",
+  "application/pkixcmp",
+  "application/postscript",
+  "application/provenance+xml",
+  "application/prs.cww",
+  "application/prs.hpub+zip",
+  "application/prs.nprend",
+  "application/prs.rdf-xml-crypt",
+  "application/prs.xsf+xml",
+  "application/pskc+xml",
+  "application/rdf+xml",
+  "application/reginfo+xml",
+  "application/relax-ng-compact-syntax",
+  "application/resource-lists+xml",
+  "application/resource-lists-diff+xml",
+  "application/rfc+xml",
+  "application/rls-services+xml",
+  "application/route-apd+xml",
+  "application/route-s-tsid+xml",
+  "application/route-usd+xml",
+  "application/rpki-ghostbusters",
+  "application/rpki-manifest",
+  "application/rpki-roa",
+  "application/rtf",
+  "application/sarif+json",
+  "application/sarif-external-properties+json",
+  "application/scim+json",
+  "application/scvp-cv-request",
+  "application/scvp-cv-response",
+  "application/scvp-vp-request",
+  "application/scvp-vp-response",
+  "application/sdp",
+  "application/senml+cbor",
+  "application/senml+json",
+  "application/senml+xml",
+  "application/senml-etch+cbor",
+  "application/senml-etch+json",
+  "application/senml-exi",
+  "application/sensml+cbor",
+  "application/sensml+json",
+  "application/sensml+xml",
+  "application/sensml-exi",
+  "application/sgml-open-catalog",
+  "application/shf+xml",
+  "application/sieve",
+  "application/simple-filter+xml",
+  "application/smil+xml",
+  "application/sparql-query",
+  "application/sparql-results+xml",
+  "application/spdx+json",
+  "application/sql",
+  "application/srgs",
+  "application/srgs+xml",
+  "application/sru+xml",
+  "application/ssml+xml",
+  "application/stix+json",
+  "application/swid+cbor",
+  "application/swid+xml",
+  "application/tamp-apex-update",
+  "application/tamp-apex-update-confirm",
+  "application/tamp-community-update",
+  "application/tamp-community-update-confirm",
+  "application/tamp-error",
+  "application/tamp-sequence-adjust",
+  "application/tamp-sequence-adjust-confirm",
+  "application/tamp-update",
+  "application/tamp-update-confirm",
+  "application/td+json",
+  "application/tei+xml",
+  "application/thraud+xml",
+  "application/timestamp-query",
+  "application/timestamp-reply",
+  "application/timestamped-data",
+  "application/tm+json",
+  "application/trig",
+  "application/ttml+xml",
+  "application/urc-grpsheet+xml",
+  "application/urc-ressheet+xml",
+  "application/urc-targetdesc+xml",
+  "application/urc-uisocketdesc+xml",
+  "application/vnd.1000minds.decision-model+xml",
+  "application/vnd.3gpp.pic-bw-large",
+  "application/vnd.3gpp.pic-bw-small",
+  "application/vnd.3gpp.pic-bw-var",
+  "application/vnd.3gpp2.sms",
+  "application/vnd.3gpp2.tcap",
+  "application/vnd.3lightssoftware.imagescal",
+  "application/vnd.3M.Post-it-Notes",
+  "application/vnd.accpac.simply.aso",
+  "application/vnd.accpac.simply.imp",
+  "application/vnd.acucobol",
+  "application/vnd.acucorp",
+  "application/vnd.adobe.flash.movie",
+  "application/vnd.adobe.formscentral.fcdt",
+  "application/vnd.adobe.fxp",
+  "application/vnd.adobe.xdp+xml",
+  "application/vnd.afpc.modca",
+  "application/vnd.afpc.modca-overlay",
+  "application/vnd.afpc.modca-pagesegment",
+  "application/vnd.age",
+  "application/vnd.ahead.space",
+  "application/vnd.airzip.filesecure.azf",
+  "application/vnd.airzip.filesecure.azs",
+  "application/vnd.amazon.mobi8-ebook",
+  "application/vnd.americandynamics.acc",
+  "application/vnd.amiga.ami",
+  "application/vnd.android.ota",
+  "application/vnd.android.package-archive",
+  "application/vnd.anki",
+  "application/vnd.anser-web-certificate-issue-initiation",
+  "application/vnd.anser-web-funds-transfer-initiation",
+  "application/vnd.apache.arrow.file",
+  "application/vnd.apache.arrow.stream",
+  "application/vnd.apexlang",
+  "application/vnd.apple.installer+xml",
+  "application/vnd.apple.keynote",
+  "application/vnd.apple.mpegurl",
+  "application/vnd.apple.numbers",
+  "application/vnd.apple.pages",
+  "application/vnd.aristanetworks.swi",
+  "application/vnd.artisan+json",
+  "application/vnd.astraea-software.iota",
+  "application/vnd.audiograph",
+  "application/vnd.autopackage",
+  "application/vnd.balsamiq.bmml+xml",
+  "application/vnd.balsamiq.bmpr",
+  "application/vnd.banana-accounting",
+  "application/vnd.belightsoft.lhzd+zip",
+  "application/vnd.belightsoft.lhzl+zip",
+  "application/vnd.blueice.multipass",
+  "application/vnd.bluetooth.ep.oob",
+  "application/vnd.bluetooth.le.oob",
+  "application/vnd.bmi",
+  "application/vnd.businessobjects",
+  "application/vnd.cendio.thinlinc.clientconf",
+  "application/vnd.chemdraw+xml",
+  "application/vnd.chess-pgn",
+  "application/vnd.chipnuts.karaoke-mmd",
+  "application/vnd.cinderella",
+  "application/vnd.citationstyles.style+xml",
+  "application/vnd.claymore",
+  "application/vnd.cloanto.rp9",
+  "application/vnd.clonk.c4group",
+  "application/vnd.cluetrust.cartomobile-config",
+  "application/vnd.cluetrust.cartomobile-config-pkg",
+  "application/vnd.coffeescript",
+  "application/vnd.collabio.xodocuments.document",
+  "application/vnd.collabio.xodocuments.document-template",
+  "application/vnd.collabio.xodocuments.presentation",
+  "application/vnd.collabio.xodocuments.presentation-template",
+  "application/vnd.collabio.xodocuments.spreadsheet",
+  "application/vnd.collabio.xodocuments.spreadsheet-template",
+  "application/vnd.comicbook+zip",
+  "application/vnd.comicbook-rar",
+  "application/vnd.commerce-battelle",
+  "application/vnd.commonspace",
+  "application/vnd.contact.cmsg",
+  "application/vnd.coreos.ignition+json",
+  "application/vnd.cosmocaller",
+  "application/vnd.crick.clicker",
+  "application/vnd.crick.clicker.keyboard",
+  "application/vnd.crick.clicker.palette",
+  "application/vnd.crick.clicker.template",
+  "application/vnd.crick.clicker.wordbank",
+  "application/vnd.criticaltools.wbs+xml",
+  "application/vnd.crypto-shade-file",
+  "application/vnd.cryptomator.encrypted",
+  "application/vnd.cryptomator.vault",
+  "application/vnd.ctc-posml",
+  "application/vnd.cups-ppd",
+  "application/vnd.dart",
+  "application/vnd.data-vision.rdz",
+  "application/vnd.datalog",
+  "application/vnd.dbf",
+  "application/vnd.debian.binary-package",
+  "application/vnd.dece.data",
+  "application/vnd.dece.ttml+xml",
+  "application/vnd.dece.unspecified",
+  "application/vnd.dece.zip",
+  "application/vnd.denovo.fcselayout-link",
+  "application/vnd.desmume.movie",
+  "application/vnd.dna",
+  "application/vnd.document+json",
+  "application/vnd.doremir.scorecloud-binary-document",
+  "application/vnd.dpgraph",
+  "application/vnd.dreamfactory",
+  "application/vnd.dtg.local.flash",
+  "application/vnd.dvb.ait",
+  "application/vnd.dvb.service",
+  "application/vnd.dynageo",
+  "application/vnd.dzr",
+  "application/vnd.ecowin.chart",
+  "application/vnd.eln+zip",
+  "application/vnd.enliven",
+  "application/vnd.epson.esf",
+  "application/vnd.epson.msf",
+  "application/vnd.epson.quickanime",
+  "application/vnd.epson.salt",
+  "application/vnd.epson.ssf",
+  "application/vnd.ericsson.quickcall",
+  "application/vnd.espass-espass+zip",
+  "application/vnd.eszigno3+xml",
+  "application/vnd.etsi.asic-e+zip",
+  "application/vnd.etsi.asic-s+zip",
+  "application/vnd.etsi.timestamp-token",
+  "application/vnd.eu.kasparian.car+json",
+  "application/vnd.evolv.ecig.profile",
+  "application/vnd.evolv.ecig.settings",
+  "application/vnd.evolv.ecig.theme",
+  "application/vnd.exstream-empower+zip",
+  "application/vnd.exstream-package",
+  "application/vnd.ezpix-album",
+  "application/vnd.ezpix-package",
+  "application/vnd.familysearch.gedcom+zip",
+  "application/vnd.fastcopy-disk-image",
+  "application/vnd.fdsn.mseed",
+  "application/vnd.fdsn.seed",
+  "application/vnd.ficlab.flb+zip",
+  "application/vnd.filmit.zfc",
+  "application/vnd.FloGraphIt",
+  "application/vnd.fluxtime.clip",
+  "application/vnd.font-fontforge-sfd",
+  "application/vnd.framemaker",
+  "application/vnd.fsc.weblaunch",
+  "application/vnd.fujitsu.oasys",
+  "application/vnd.fujitsu.oasys2",
+  "application/vnd.fujitsu.oasys3",
+  "application/vnd.fujitsu.oasysgp",
+  "application/vnd.fujitsu.oasysprs",
+  "application/vnd.fujixerox.ddd",
+  "application/vnd.fujixerox.docuworks",
+  "application/vnd.fujixerox.docuworks.binder",
+  "application/vnd.fujixerox.docuworks.container",
+  "application/vnd.fuzzysheet",
+  "application/vnd.genomatix.tuxedo",
+  "application/vnd.genozip",
+  "application/vnd.gentics.grd+json",
+  "application/vnd.gentoo.ebuild",
+  "application/vnd.gentoo.eclass",
+  "application/vnd.gentoo.gpkg",
+  "application/vnd.gentoo.xpak",
+  "application/vnd.geogebra.file",
+  "application/vnd.geogebra.slides",
+  "application/vnd.geogebra.tool",
+  "application/vnd.geometry-explorer",
+  "application/vnd.geonext",
+  "application/vnd.geoplan",
+  "application/vnd.geospace",
+  "application/vnd.google-earth.kml+xml",
+  "application/vnd.google-earth.kmz",
+  "application/vnd.grafeq",
+  "application/vnd.groove-account",
+  "application/vnd.groove-help",
+  "application/vnd.groove-identity-message",
+  "application/vnd.groove-injector",
+  "application/vnd.groove-tool-message",
+  "application/vnd.groove-tool-template",
+  "application/vnd.groove-vcard",
+  "application/vnd.hal+xml",
+  "application/vnd.HandHeld-Entertainment+xml",
+  "application/vnd.hbci",
+  "application/vnd.hdt",
+  "application/vnd.hhe.lesson-player",
+  "application/vnd.hp-HPGL",
+  "application/vnd.hp-hpid",
+  "application/vnd.hp-hps",
+  "application/vnd.hp-jlyt",
+  "application/vnd.hp-PCL",
+  "application/vnd.hydrostatix.sof-data",
+  "application/vnd.ibm.electronic-media",
+  "application/vnd.ibm.MiniPay",
+  "application/vnd.ibm.rights-management",
+  "application/vnd.ibm.secure-container",
+  "application/vnd.iccprofile",
+  "application/vnd.ieee.1905",
+  "application/vnd.igloader",
+  "application/vnd.imagemeter.folder+zip",
+  "application/vnd.imagemeter.image+zip",
+  "application/vnd.immervision-ivp",
+  "application/vnd.immervision-ivu",
+  "application/vnd.ims.imsccv1p1",
+  "application/vnd.insors.igm",
+  "application/vnd.intercon.formnet",
+  "application/vnd.intergeo",
+  "application/vnd.intu.qbo",
+  "application/vnd.intu.qfx",
+  "application/vnd.ipld.car",
+  "application/vnd.ipunplugged.rcprofile",
+  "application/vnd.irepository.package+xml",
+  "application/vnd.is-xpr",
+  "application/vnd.isac.fcs",
+  "application/vnd.jam",
+  "application/vnd.jcp.javame.midlet-rms",
+  "application/vnd.jisp",
+  "application/vnd.joost.joda-archive",
+  "application/vnd.kahootz",
+  "application/vnd.kde.karbon",
+  "application/vnd.kde.kchart",
+  "application/vnd.kde.kformula",
+  "application/vnd.kde.kivio",
+  "application/vnd.kde.kontour",
+  "application/vnd.kde.kpresenter",
+  "application/vnd.kde.kspread",
+  "application/vnd.kde.kword",
+  "application/vnd.kenameaapp",
+  "application/vnd.kidspiration",
+  "application/vnd.Kinar",
+  "application/vnd.koan",
+  "application/vnd.kodak-descriptor",
+  "application/vnd.las",
+  "application/vnd.las.las+json",
+  "application/vnd.las.las+xml",
+  "application/vnd.llamagraphics.life-balance.desktop",
+  "application/vnd.llamagraphics.life-balance.exchange+xml",
+  "application/vnd.logipipe.circuit+zip",
+  "application/vnd.loom",
+  "application/vnd.lotus-1-2-3",
+  "application/vnd.lotus-approach",
+  "application/vnd.lotus-freelance",
+  "application/vnd.lotus-notes",
+  "application/vnd.lotus-organizer",
+  "application/vnd.lotus-screencam",
+  "application/vnd.lotus-wordpro",
+  "application/vnd.macports.portpkg",
+  "application/vnd.mapbox-vector-tile",
+  "application/vnd.marlin.drm.mdcf",
+  "application/vnd.maxar.archive.3tz+zip",
+  "application/vnd.maxmind.maxmind-db",
+  "application/vnd.mcd",
+  "application/vnd.medcalcdata",
+  "application/vnd.mediastation.cdkey",
+  "application/vnd.medicalholodeck.recordxr",
+  "application/vnd.MFER",
+  "application/vnd.mfmp",
+  "application/vnd.micrografx.flo",
+  "application/vnd.micrografx.igx",
+  "application/vnd.mif",
+  "application/vnd.Mobius.DAF",
+  "application/vnd.Mobius.DIS",
+  "application/vnd.Mobius.MBK",
+  "application/vnd.Mobius.MQY",
+  "application/vnd.Mobius.MSL",
+  "application/vnd.Mobius.PLC",
+  "application/vnd.Mobius.TXF",
+  "application/vnd.mophun.application",
+  "application/vnd.mophun.certificate",
+  "application/vnd.mozilla.xul+xml",
+  "application/vnd.ms-3mfdocument",
+  "application/vnd.ms-artgalry",
+  "application/vnd.ms-asf",
+  "application/vnd.ms-cab-compressed",
+  "application/vnd.ms-excel",
+  "application/vnd.ms-excel.addin.macroEnabled.12",
+  "application/vnd.ms-excel.sheet.binary.macroEnabled.12",
+  "application/vnd.ms-excel.sheet.macroEnabled.12",
+  "application/vnd.ms-excel.template.macroEnabled.12",
+  "application/vnd.ms-fontobject",
+  "application/vnd.ms-htmlhelp",
+  "application/vnd.ms-ims",
+  "application/vnd.ms-lrm",
+  "application/vnd.ms-officetheme",
+  "application/vnd.ms-pki.seccat",
+  "application/vnd.ms-powerpoint",
+  "application/vnd.ms-powerpoint.addin.macroEnabled.12",
+  "application/vnd.ms-powerpoint.presentation.macroEnabled.12",
+  "application/vnd.ms-powerpoint.slide.macroEnabled.12",
+  "application/vnd.ms-powerpoint.slideshow.macroEnabled.12",
+  "application/vnd.ms-powerpoint.template.macroEnabled.12",
+  "application/vnd.ms-project",
+  "application/vnd.ms-tnef",
+  "application/vnd.ms-word.document.macroEnabled.12",
+  "application/vnd.ms-word.template.macroEnabled.12",
+  "application/vnd.ms-works",
+  "application/vnd.ms-wpl",
+  "application/vnd.ms-xpsdocument",
+  "application/vnd.msa-disk-image",
+  "application/vnd.mseq",
+  "application/vnd.multiad.creator",
+  "application/vnd.multiad.creator.cif",
+  "application/vnd.musician",
+  "application/vnd.muvee.style",
+  "application/vnd.mynfc",
+  "application/vnd.nebumind.line",
+  "application/vnd.nervana",
+  "application/vnd.neurolanguage.nlu",
+  "application/vnd.nimn",
+  "application/vnd.nintendo.nitro.rom",
+  "application/vnd.nintendo.snes.rom",
+  "application/vnd.nitf",
+  "application/vnd.noblenet-directory",
+  "application/vnd.noblenet-sealer",
+  "application/vnd.noblenet-web",
+  "application/vnd.nokia.n-gage.data",
+  "application/vnd.nokia.radio-preset",
+  "application/vnd.nokia.radio-presets",
+  "application/vnd.novadigm.EDM",
+  "application/vnd.novadigm.EDX",
+  "application/vnd.novadigm.EXT",
+  "application/vnd.oasis.opendocument.base",
+  "application/vnd.oasis.opendocument.chart",
+  "application/vnd.oasis.opendocument.chart-template",
+  "application/vnd.oasis.opendocument.formula",
+  "application/vnd.oasis.opendocument.graphics",
+  "application/vnd.oasis.opendocument.graphics-template",
+  "application/vnd.oasis.opendocument.image",
+  "application/vnd.oasis.opendocument.image-template",
+  "application/vnd.oasis.opendocument.presentation",
+  "application/vnd.oasis.opendocument.presentation-template",
+  "application/vnd.oasis.opendocument.spreadsheet",
+  "application/vnd.oasis.opendocument.spreadsheet-template",
+  "application/vnd.oasis.opendocument.text",
+  "application/vnd.oasis.opendocument.text-master",
+  "application/vnd.oasis.opendocument.text-template",
+  "application/vnd.oasis.opendocument.text-web",
+  "application/vnd.olpc-sugar",
+  "application/vnd.oma.dd2+xml",
+  "application/vnd.onepager",
+  "application/vnd.onepagertamp",
+  "application/vnd.onepagertamx",
+  "application/vnd.onepagertat",
+  "application/vnd.onepagertatp",
+  "application/vnd.onepagertatx",
+  "application/vnd.openblox.game+xml",
+  "application/vnd.openblox.game-binary",
+  "application/vnd.openeye.oeb",
+  "application/vnd.openofficeorg.extension",
+  "application/vnd.openstreetmap.data+xml",
+  "application/vnd.openxmlformats-officedocument.presentationml.presentation",
+  "application/vnd.openxmlformats-officedocument.presentationml.slide",
+  "application/vnd.openxmlformats-officedocument.presentationml.slideshow",
+  "application/vnd.openxmlformats-officedocument.presentationml.template",
+  "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet",
+  "application/vnd.openxmlformats-officedocument.spreadsheetml.template",
+  "application/vnd.openxmlformats-officedocument.wordprocessingml.document",
+  "application/vnd.openxmlformats-officedocument.wordprocessingml.template",
+  "application/vnd.osa.netdeploy",
+  "application/vnd.osgeo.mapguide.package",
+  "application/vnd.osgi.dp",
+  "application/vnd.osgi.subsystem",
+  "application/vnd.oxli.countgraph",
+  "application/vnd.palm",
+  "application/vnd.panoply",
+  "application/vnd.patentdive",
+  "application/vnd.pawaafile",
+  "application/vnd.pg.format",
+  "application/vnd.pg.osasli",
+  "application/vnd.piaccess.application-licence",
+  "application/vnd.picsel",
+  "application/vnd.pmi.widget",
+  "application/vnd.pocketlearn",
+  "application/vnd.powerbuilder6",
+  "application/vnd.preminet",
+  "application/vnd.previewsystems.box",
+  "application/vnd.proteus.magazine",
+  "application/vnd.psfs",
+  "application/vnd.publishare-delta-tree",
+  "application/vnd.pvi.ptid1",
+  "application/vnd.qualcomm.brew-app-res",
+  "application/vnd.Quark.QuarkXPress",
+  "application/vnd.quobject-quoxdocument",
+  "application/vnd.rainstor.data",
+  "application/vnd.rar",
+  "application/vnd.realvnc.bed",
+  "application/vnd.recordare.musicxml",
+  "application/vnd.resilient.logic",
+  "application/vnd.rig.cryptonote",
+  "application/vnd.rim.cod",
+  "application/vnd.route66.link66+xml",
+  "application/vnd.sailingtracker.track",
+  "application/vnd.sar",
+  "application/vnd.scribus",
+  "application/vnd.sealed.3df",
+  "application/vnd.sealed.csf",
+  "application/vnd.sealed.doc",
+  "application/vnd.sealed.eml",
+  "application/vnd.sealed.mht",
+  "application/vnd.sealed.ppt",
+  "application/vnd.sealed.tiff",
+  "application/vnd.sealed.xls",
+  "application/vnd.sealedmedia.softseal.html",
+  "application/vnd.sealedmedia.softseal.pdf",
+  "application/vnd.seemail",
+  "application/vnd.sema",
+  "application/vnd.semd",
+  "application/vnd.semf",
+  "application/vnd.shade-save-file",
+  "application/vnd.shana.informed.formdata",
+  "application/vnd.shana.informed.formtemplate",
+  "application/vnd.shana.informed.interchange",
+  "application/vnd.shana.informed.package",
+  "application/vnd.shp",
+  "application/vnd.shx",
+  "application/vnd.sigrok.session",
+  "application/vnd.SimTech-MindMapper",
+  "application/vnd.smaf",
+  "application/vnd.smart.notebook",
+  "application/vnd.smart.teacher",
+  "application/vnd.snesdev-page-table",
+  "application/vnd.software602.filler.form+xml",
+  "application/vnd.software602.filler.form-xml-zip",
+  "application/vnd.solent.sdkm+xml",
+  "application/vnd.spotfire.dxp",
+  "application/vnd.spotfire.sfs",
+  "application/vnd.sqlite3",
+  "application/vnd.stardivision.calc",
+  "application/vnd.stardivision.chart",
+  "application/vnd.stardivision.draw",
+  "application/vnd.stardivision.impress",
+  "application/vnd.stardivision.math",
+  "application/vnd.stardivision.writer",
+  "application/vnd.stardivision.writer-global",
+  "application/vnd.stepmania.package",
+  "application/vnd.stepmania.stepchart",
+  "application/vnd.sun.wadl+xml",
+  "application/vnd.sun.xml.calc",
+  "application/vnd.sun.xml.calc.template",
+  "application/vnd.sun.xml.draw",
+  "application/vnd.sun.xml.draw.template",
+  "application/vnd.sun.xml.impress",
+  "application/vnd.sun.xml.impress.template",
+  "application/vnd.sun.xml.math",
+  "application/vnd.sun.xml.writer",
+  "application/vnd.sun.xml.writer.global",
+  "application/vnd.sun.xml.writer.template",
+  "application/vnd.sus-calendar",
+  "application/vnd.sybyl.mol2",
+  "application/vnd.sycle+xml",
+  "application/vnd.syft+json",
+  "application/vnd.symbian.install",
+  "application/vnd.syncml+xml",
+  "application/vnd.syncml.dm+wbxml",
+  "application/vnd.syncml.dm+xml",
+  "application/vnd.syncml.dmddf+xml",
+  "application/vnd.tao.intent-module-archive",
+  "application/vnd.tcpdump.pcap",
+  "application/vnd.theqvd",
+  "application/vnd.think-cell.ppttc+json",
+  "application/vnd.tml",
+  "application/vnd.tmobile-livetv",
+  "application/vnd.trid.tpt",
+  "application/vnd.triscape.mxs",
+  "application/vnd.trueapp",
+  "application/vnd.ufdl",
+  "application/vnd.uiq.theme",
+  "application/vnd.umajin",
+  "application/vnd.unity",
+  "application/vnd.uoml+xml",
+  "application/vnd.uri-map",
+  "application/vnd.valve.source.material",
+  "application/vnd.vcx",
+  "application/vnd.vd-study",
+  "application/vnd.vectorworks",
+  "application/vnd.veritone.aion+json",
+  "application/vnd.veryant.thin",
+  "application/vnd.ves.encrypted",
+  "application/vnd.vidsoft.vidconference",
+  "application/vnd.visio",
+  "application/vnd.visionary",
+  "application/vnd.vsf",
+  "application/vnd.wap.sic",
+  "application/vnd.wap.slc",
+  "application/vnd.wap.wbxml",
+  "application/vnd.wap.wmlc",
+  "application/vnd.wap.wmlscriptc",
+  "application/vnd.wasmflow.wafl",
+  "application/vnd.webturbo",
+  "application/vnd.wfa.p2p",
+  "application/vnd.wfa.wsc",
+  "application/vnd.wmc",
+  "application/vnd.wolfram.mathematica",
+  "application/vnd.wolfram.mathematica.package",
+  "application/vnd.wolfram.player",
+  "application/vnd.wordperfect",
+  "application/vnd.wqd",
+  "application/vnd.wt.stf",
+  "application/vnd.wv.csp+wbxml",
+  "application/vnd.xara",
+  "application/vnd.xfdl",
+  "application/vnd.xmpie.cpkg",
+  "application/vnd.xmpie.dpkg",
+  "application/vnd.xmpie.ppkg",
+  "application/vnd.xmpie.xlim",
+  "application/vnd.yamaha.hv-dic",
+  "application/vnd.yamaha.hv-script",
+  "application/vnd.yamaha.hv-voice",
+  "application/vnd.yamaha.openscoreformat",
+  "application/vnd.yamaha.smaf-audio",
+  "application/vnd.yamaha.smaf-phrase",
+  "application/vnd.yaoweme",
+  "application/vnd.yellowriver-custom-menu",
+  "application/vnd.zul",
+  "application/vnd.zzazz.deck+xml",
+  "application/voicexml+xml",
+  "application/voucher-cms+json",
+  "application/wasm",
+  "application/watcherinfo+xml",
+  "application/widget",
+  "application/wsdl+xml",
+  "application/wspolicy+xml",
+  "application/x-123",
+  "application/x-7z-compressed",
+  "application/x-abiword",
+  "application/x-apple-diskimage",
+  "application/x-bcpio",
+  "application/x-bittorrent",
+  "application/x-cdf",
+  "application/x-cdlink",
+  "application/x-comsol",
+  "application/x-cpio",
+  "application/x-csh",
+  "application/x-director",
+  "application/x-doom",
+  "application/x-dvi",
+  "application/x-font",
+  "application/x-font-pcf",
+  "application/x-freemind",
+  "application/x-ganttproject",
+  "application/x-gnumeric",
+  "application/x-go-sgf",
+  "application/x-graphing-calculator",
+  "application/x-gtar",
+  "application/x-gtar-compressed",
+  "application/x-hdf",
+  "application/x-hwp",
+  "application/x-ica",
+  "application/x-info",
+  "application/x-internet-signup",
+  "application/x-iphone",
+  "application/x-iso9660-image",
+  "application/x-java-jnlp-file",
+  "application/x-jmol",
+  "application/x-killustrator",
+  "application/x-latex",
+  "application/x-lha",
+  "application/x-lyx",
+  "application/x-lzh",
+  "application/x-lzx",
+  "application/x-maker",
+  "application/x-ms-wmd",
+  "application/x-ms-wmz",
+  "application/x-msdos-program",
+  "application/x-msi",
+  "application/x-netcdf",
+  "application/x-ns-proxy-autoconfig",
+  "application/x-nwc",
+  "application/x-object",
+  "application/x-oz-application",
+  "application/x-pkcs7-certreqresp",
+  "application/x-python-code",
+  "application/x-qgis",
+  "application/x-quicktimeplayer",
+  "application/x-rdp",
+  "application/x-redhat-package-manager",
+  "application/x-rss+xml",
+  "application/x-ruby",
+  "application/x-scilab",
+  "application/x-scilab-xcos",
+  "application/x-sh",
+  "application/x-shar",
+  "application/x-silverlight",
+  "application/x-stuffit",
+  "application/x-sv4cpio",
+  "application/x-sv4crc",
+  "application/x-tar",
+  "application/x-tcl",
+  "application/x-tex-gf",
+  "application/x-tex-pk",
+  "application/x-texinfo",
+  "application/x-trash",
+  "application/x-troff-man",
+  "application/x-troff-me",
+  "application/x-troff-ms",
+  "application/x-ustar",
+  "application/x-wais-source",
+  "application/x-wingz",
+  "application/x-x509-ca-cert",
+  "application/x-xfig",
+  "application/x-xpinstall",
+  "application/x-xz",
+  "application/xcap-att+xml",
+  "application/xcap-caps+xml",
+  "application/xcap-diff+xml",
+  "application/xcap-el+xml",
+  "application/xcap-error+xml",
+  "application/xcap-ns+xml",
+  "application/xfdf",
+  "application/xhtml+xml",
+  "application/xliff+xml",
+  "application/xml",
+  "application/xml-dtd",
+  "application/xml-external-parsed-entity",
+  "application/xop+xml",
+  "application/xslt+xml",
+  "application/xspf+xml",
+  "application/xv+xml",
+  "application/yang",
+  "application/yin+xml",
+  "application/zip",
+  "application/zstd",
+  "audio/32kadpcm",
+  "audio/aac",
+  "audio/ac3",
+  "audio/AMR",
+  "audio/AMR-WB",
+  "audio/annodex",
+  "audio/asc",
+  "audio/ATRAC-ADVANCED-LOSSLESS",
+  "audio/ATRAC-X",
+  "audio/ATRAC3",
+  "audio/basic",
+  "audio/csound",
+  "audio/dls",
+  "audio/EVRC",
+  "audio/EVRC-QCP",
+  "audio/EVRCB",
+  "audio/EVRCNW",
+  "audio/EVRCWB",
+  "audio/flac",
+  "audio/iLBC",
+  "audio/L16",
+  "audio/mhas",
+  "audio/mobile-xmf",
+  "audio/mp4",
+  "audio/mpeg",
+  "audio/mpegurl",
+  "audio/ogg",
+  "audio/prs.sid",
+  "audio/SMV",
+  "audio/sofa",
+  "audio/sp-midi",
+  "audio/usac",
+  "audio/vnd.audiokoz",
+  "audio/vnd.dece.audio",
+  "audio/vnd.digital-winds",
+  "audio/vnd.dolby.mlp",
+  "audio/vnd.dts",
+  "audio/vnd.dts.hd",
+  "audio/vnd.everad.plj",
+  "audio/vnd.lucent.voice",
+  "audio/vnd.ms-playready.media.pya",
+  "audio/vnd.nortel.vbk",
+  "audio/vnd.nuera.ecelp4800",
+  "audio/vnd.nuera.ecelp7470",
+  "audio/vnd.nuera.ecelp9600",
+  "audio/vnd.presonus.multitrack",
+  "audio/vnd.rip",
+  "audio/vnd.sealedmedia.softseal.mpeg",
+  "audio/x-aiff",
+  "audio/x-gsm",
+  "audio/x-ms-wax",
+  "audio/x-ms-wma",
+  "audio/x-pn-realaudio",
+  "audio/x-scpls",
+  "audio/x-sd2",
+  "audio/x-wav",
+  "chemical/x-alchemy",
+  "chemical/x-cache",
+  "chemical/x-cache-csf",
+  "chemical/x-cactvs-binary",
+  "chemical/x-cdx",
+  "chemical/x-chem3d",
+  "chemical/x-cmdf",
+  "chemical/x-compass",
+  "chemical/x-crossfire",
+  "chemical/x-csml",
+  "chemical/x-ctx",
+  "chemical/x-cxf",
+  "chemical/x-embl-dl-nucleotide",
+  "chemical/x-galactic-spc",
+  "chemical/x-gamess-input",
+  "chemical/x-gaussian-checkpoint",
+  "chemical/x-gaussian-cube",
+  "chemical/x-gaussian-input",
+  "chemical/x-gaussian-log",
+  "chemical/x-gcg8-sequence",
+  "chemical/x-genbank",
+  "chemical/x-hin",
+  "chemical/x-isostar",
+  "chemical/x-jcamp-dx",
+  "chemical/x-kinemage",
+  "chemical/x-macmolecule",
+  "chemical/x-macromodel-input",
+  "chemical/x-mdl-molfile",
+  "chemical/x-mdl-rdfile",
+  "chemical/x-mdl-rxnfile",
+  "chemical/x-mdl-sdfile",
+  "chemical/x-mdl-tgf",
+  "chemical/x-mmcif",
+  "chemical/x-molconn-Z",
+  "chemical/x-mopac-graph",
+  "chemical/x-mopac-input",
+  "chemical/x-mopac-out",
+  "chemical/x-mopac-vib",
+  "chemical/x-ncbi-asn1",
+  "chemical/x-ncbi-asn1-ascii",
+  "chemical/x-ncbi-asn1-binary",
+  "chemical/x-rosdal",
+  "chemical/x-swissprot",
+  "chemical/x-vamas-iso14976",
+  "chemical/x-vmd",
+  "chemical/x-xtel",
+  "chemical/x-xyz",
+  "font/collection",
+  "font/otf",
+  "font/ttf",
+  "font/woff",
+  "font/woff2",
+  "image/aces",
+  "image/apng",
+  "image/avci",
+  "image/avcs",
+  "image/avif",
+  "image/bmp",
+  "image/cgm",
+  "image/dicom-rle",
+  "image/dpx",
+  "image/emf",
+  "image/fits",
+  "image/gif",
+  "image/heic",
+  "image/heic-sequence",
+  "image/heif",
+  "image/heif-sequence",
+  "image/hej2k",
+  "image/hsj2",
+  "image/ief",
+  "image/jls",
+  "image/jp2",
+  "image/jpeg",
+  "image/jph",
+  "image/jphc",
+  "image/jpm",
+  "image/jpx",
+  "image/jxl",
+  "image/jxr",
+  "image/jxrA",
+  "image/jxrS",
+  "image/jxs",
+  "image/jxsc",
+  "image/jxsi",
+  "image/jxss",
+  "image/ktx",
+  "image/ktx2",
+  "image/png",
+  "image/prs.btif",
+  "image/prs.pti",
+  "image/svg+xml",
+  "image/tiff",
+  "image/tiff-fx",
+  "image/vnd.adobe.photoshop",
+  "image/vnd.airzip.accelerator.azv",
+  "image/vnd.dece.graphic",
+  "image/vnd.djvu",
+  "image/vnd.dwg",
+  "image/vnd.dxf",
+  "image/vnd.fastbidsheet",
+  "image/vnd.fpx",
+  "image/vnd.fst",
+  "image/vnd.fujixerox.edmics-mmr",
+  "image/vnd.fujixerox.edmics-rlc",
+  "image/vnd.globalgraphics.pgb",
+  "image/vnd.microsoft.icon",
+  "image/vnd.ms-modi",
+  "image/vnd.pco.b16",
+  "image/vnd.radiance",
+  "image/vnd.sealed.png",
+  "image/vnd.sealedmedia.softseal.gif",
+  "image/vnd.sealedmedia.softseal.jpg",
+  "image/vnd.tencent.tap",
+  "image/vnd.valve.source.texture",
+  "image/vnd.wap.wbmp",
+  "image/vnd.xiff",
+  "image/vnd.zbrush.pcx",
+  "image/webp",
+  "image/wmf",
+  "image/x-canon-cr2",
+  "image/x-canon-crw",
+  "image/x-cmu-raster",
+  "image/x-coreldraw",
+  "image/x-coreldrawpattern",
+  "image/x-coreldrawtemplate",
+  "image/x-epson-erf",
+  "image/x-jg",
+  "image/x-jng",
+  "image/x-nikon-nef",
+  "image/x-olympus-orf",
+  "image/x-portable-anymap",
+  "image/x-portable-bitmap",
+  "image/x-portable-graymap",
+  "image/x-portable-pixmap",
+  "image/x-rgb",
+  "image/x-xbitmap",
+  "image/x-xcf",
+  "image/x-xpixmap",
+  "image/x-xwindowdump",
+  "message/global",
+  "message/global-delivery-status",
+  "message/global-disposition-notification",
+  "message/global-headers",
+  "message/rfc822",
+  "model/gltf+json",
+  "model/gltf-binary",
+  "model/iges",
+  "model/JT",
+  "model/mesh",
+  "model/mtl",
+  "model/obj",
+  "model/prc",
+  "model/step",
+  "model/step+xml",
+  "model/step+zip",
+  "model/step-xml+zip",
+  "model/stl",
+  "model/u3d",
+  "model/vnd.cld",
+  "model/vnd.collada+xml",
+  "model/vnd.dwf",
+  "model/vnd.gdl",
+  "model/vnd.gtw",
+  "model/vnd.moml+xml",
+  "model/vnd.mts",
+  "model/vnd.opengex",
+  "model/vnd.parasolid.transmit.binary",
+  "model/vnd.parasolid.transmit.text",
+  "model/vnd.pytha.pyox",
+  "model/vnd.sap.vds",
+  "model/vnd.usda",
+  "model/vnd.usdz+zip",
+  "model/vnd.valve.source.compiled-map",
+  "model/vnd.vtu",
+  "model/vrml",
+  "model/x3d+fastinfoset",
+  "model/x3d+xml",
+  "model/x3d-vrml",
+  "multipart/vnd.bint.med-plus",
+  "multipart/voice-message",
+  "text/cache-manifest",
+  "text/calendar",
+  "text/cql",
+  "text/css",
+  "text/csv",
+  "text/csv-schema",
+  "text/dns",
+  "text/gff3",
+  "text/html",
+  "application/javascript",
+  "text/jcr-cnd",
+  "text/markdown",
+  "text/mizar",
+  "text/n3",
+  "text/plain",
+  "text/provenance-notation",
+  "text/prs.fallenstein.rst",
+  "text/prs.lines.tag",
+  "text/SGML",
+  "text/shaclc",
+  "text/shex",
+  "text/spdx",
+  "text/tab-separated-values",
+  "text/texmacs",
+  "text/troff",
+  "text/turtle",
+  "text/uri-list",
+  "text/vcard",
+  "text/vnd.a",
+  "text/vnd.abc",
+  "text/vnd.ascii-art",
+  "text/vnd.curl",
+  "text/vnd.debian.copyright",
+  "text/vnd.DMClientScript",
+  "text/vnd.esmertec.theme-descriptor",
+  "text/vnd.exchangeable",
+  "text/vnd.familysearch.gedcom",
+  "text/vnd.ficlab.flt",
+  "text/vnd.fly",
+  "text/vnd.fmi.flexstor",
+  "text/vnd.graphviz",
+  "text/vnd.hans",
+  "text/vnd.hgl",
+  "text/vnd.in3d.3dml",
+  "text/vnd.in3d.spot",
+  "text/vnd.ms-mediapackage",
+  "text/vnd.net2phone.commcenter.command",
+  "text/vnd.senx.warpscript",
+  "text/vnd.sosi",
+  "text/vnd.sun.j2me.app-descriptor",
+  "text/vnd.trolltech.linguist",
+  "text/vnd.wap.si",
+  "text/vnd.wap.sl",
+  "text/vnd.wap.wml",
+  "text/vnd.wap.wmlscript",
+  "text/vtt",
+  "text/wgsl",
+  "text/x-bibtex",
+  "text/x-boo",
+  "text/x-c++hdr",
+  "text/x-c++src",
+  "text/x-chdr",
+  "text/x-component",
+  "text/x-csrc",
+  "text/x-diff",
+  "text/x-dsrc",
+  "text/x-haskell",
+  "text/x-java",
+  "text/x-lilypond",
+  "text/x-literate-haskell",
+  "text/x-moc",
+  "text/x-pascal",
+  "text/x-pcs-gcd",
+  "text/x-perl",
+  "text/x-python",
+  "text/x-scala",
+  "text/x-setext",
+  "text/x-sfv",
+  "text/x-tcl",
+  "text/x-tex",
+  "text/x-vcalendar",
+  "video/annodex",
+  "video/dv",
+  "video/fli",
+  "video/gl",
+  "video/iso.segment",
+  "video/mj2",
+  "video/mp4",
+  "video/mpeg",
+  "video/ogg",
+  "video/quicktime",
+  "video/vnd.dece.hd",
+  "video/vnd.dece.mobile",
+  "video/vnd.dece.mp4",
+  "video/vnd.dece.pd",
+  "video/vnd.dece.sd",
+  "video/vnd.dece.video",
+  "video/vnd.dvb.file",
+  "video/vnd.fvt",
+  "video/vnd.mpegurl",
+  "video/vnd.ms-playready.media.pyv",
+  "video/vnd.nokia.interleaved-multimedia",
+  "video/vnd.radgamettools.bink",
+  "video/vnd.radgamettools.smacker",
+  "video/vnd.sealed.mpeg1",
+  "video/vnd.sealed.mpeg4",
+  "video/vnd.sealed.swf",
+  "video/vnd.sealedmedia.softseal.mov",
+  "video/vnd.vivo",
+  "video/vnd.youtube.yt",
+  "video/webm",
+  "video/x-flv",
+  "video/x-la-asf",
+  "video/x-matroska",
+  "video/x-mng",
+  "video/x-ms-wm",
+  "video/x-ms-wmv",
+  "video/x-ms-wmx",
+  "video/x-ms-wvx",
+  "video/x-msvideo",
+  "video/x-sgi-movie",
+};
+
+static const struct {
+  const char *extension;
+  unsigned short type;
+} onion_mime_table[1912] = {
+  {"or3", 455},
+  {"hwp", 758},
+  {"com", 775},
+  {"usdz", 1062},
+  {"dae", 1050},
+  {"cnd", 1081},
+  {NULL, 0},
+  {"shaclc", 1090},
+  {"hal", 393},
+  {"eps", 137},
+  {"pvb", 218},
+  {"dvc", 51},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"mjs", 1080},
+  {"asice", 337},
+  {"woff", 940},
+  {"pfb", 748},
+  {"semf", 619},
+  {"smc", 522},
+  {"cmp", 724},
+  {"nnw", 526},
+  {"potx", 565},
+  {NULL, 0},
+  {"sswf", 1177},
+  {"ra", 886},
+  {"evc", 847},
+  {"tsd", 207},
+  {"eml", 1034},
+  {"hqx", 87},
+  {"psfs", 589},
+  {"odc", 534},
+  {NULL, 0},
+  {"plp", 576},
+  {"wpl", 508},
+  {"bat", 775},
+  {"zir", 725},
+  {NULL, 0},
+  {"hdt", 396},
+  {"rq", 182},
+  {"xfdf", 820},
+  {NULL, 0},
+  {"drle", 949},
+  {"awb", 838},
+  {NULL, 0},
+  {NULL, 0},
+  {"shp", 625},
+  {"manifest", 1071},
+  {NULL, 0},
+  {"stf", 709},
+  {NULL, 0},
+  {"sxg", 657},
+  {NULL, 0},
+  {"see", 616},
+  {NULL, 0},
+  {NULL, 0},
+  {"p7s", 129},
+  {"seml", 609},
+  {"sfv", 1148},
+  {NULL, 0},
+  {"dzr", 325},
+  {"tiff", 982},
+  {"lhzl", 263},
+  {"pptm", 499},
+  {"mbk", 474},
+  {"jxsi", 974},
+  {"p7c", 128},
+  {"xyz", 936},
+  {NULL, 0},
+  {"sensmle", 176},
+  {"xla", 486},
+  {"text", 1085},
+  {"a2l", 0},
+  {"xhtm", 821},
+  {"jpx", 967},
+  {"musd", 100},
+  {NULL, 0},
+  {"210", 117},
+  {"xodt", 281},
+  {"iota", 256},
+  {"pt", 632},
+  {"smk", 1174},
+  {"zmm", 394},
+  {"oeb", 559},
+  {"sdd", 642},
+  {"stml", 614},
+  {"wmf", 1009},
+  {NULL, 0},
+  {"deb", 309},
+  {"senmle", 172},
+  {"scim", 161},
+  {"uvvz", 313},
+  {"tatx", 556},
+  {"sjpg", 1002},
+  {NULL, 0},
+  {"txt", 1085},
+  {"atfx", 5},
+  {"jfif", 963},
+  {NULL, 0},
+  {"unityweb", 680},
+  {"ndc", 570},
+  {"wtb", 700},
+  {NULL, 0},
+  {"xo", 549},
+  {"cub", 906},
+  {"gtar", 755},
+  {"abc", 1100},
+  {"mp1", 858},
+  {"ufdl", 677},
+  {"age", 234},
+  {NULL, 0},
+  {"ndl", 454},
+  {"pkg", 249},
+  {"mwc", 319},
+  {"json-patch", 78},
+  {"gml", 66},
+  {NULL, 0},
+  {"mwf", 467},
+  {NULL, 0},
+  {"aa3", 843},
+  {"link66", 602},
+  {"nimn", 520},
+  {NULL, 0},
+  {"susp", 659},
+  {"clkw", 298},
+  {"study-inter", 685},
+  {"tcap", 220},
+  {NULL, 0},
+  {"rld", 149},
+  {"xhtml", 821},
+  {"omg", 843},
+  {"clue", 33},
+  {"cu", 37},
+  {"gen", 910},
+  {"rfcxml", 150},
+  {NULL, 0},
+  {"wdb", 507},
+  {NULL, 0},
+  {"mdi", 997},
+  {"cpl", 35},
+  {"dcd", 43},
+  {"smi", 181},
+  {NULL, 0},
+  {"exi", 56},
+  {"acu", 225},
+  {"wqd", 708},
+  {"sdc", 639},
+  {"exr", 942},
+  {"fig", 811},
+  {NULL, 0},
+  {"jrd", 76},
+  {"aep", 257},
+  {"p7z", 128},
+  {"sema", 617},
+  {"ppt", 497},
+  {NULL, 0},
+  {"c9r", 301},
+  {"orq", 108},
+  {NULL, 0},
+  {"pgn", 271},
+  {"vds", 1060},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"ovl", 232},
+  {"fbs", 990},
+  {"tatp", 555},
+  {"pti", 980},
+  {NULL, 0},
+  {"mcif", 922},
+  {"sti", 654},
+  {"sxm", 655},
+  {"mdc", 460},
+  {NULL, 0},
+  {"tag", 1088},
+  {"atx", 842},
+  {"flv", 1182},
+  {"x_b", 1057},
+  {"jpe", 963},
+  {"esf", 329},
+  {"spd", 615},
+  {"vmd", 934},
+  {"es", 1080},
+  {"gre", 379},
+  {"uvvh", 1162},
+  {"apr", 452},
+  {"ota", 241},
+  {"glb", 1036},
+  {"gff3", 1078},
+  {"pk", 801},
+  {"ns3", 454},
+  {NULL, 0},
+  {"wmlsc", 698},
+  {"java", 1138},
+  {"inp", 904},
+  {NULL, 0},
+  {NULL, 0},
+  {"jxsc", 973},
+  {"ms", 806},
+  {"sfd-hdstx", 403},
+  {"gph", 354},
+  {"uvvt", 311},
+  {"bmpr", 260},
+  {"wlnk", 81},
+  {"smv", 862},
+  {"oa2", 360},
+  {"psg", 233},
+  {"aif", 882},
+  {"tar", 798},
+  {NULL, 0},
+  {"qxd", 593},
+  {"semd", 618},
+  {"ivu", 414},
+  {"rst", 1087},
+  {NULL, 0},
+  {NULL, 0},
+  {"step", 1043},
+  {"flw", 434},
+  {"rep", 268},
+  {"cc", 1131},
+  {NULL, 0},
+  {"wgsl", 1127},
+  {"x3dvz", 1068},
+  {"ns2", 454},
+  {NULL, 0},
+  {"srt", 1085},
+  {"mpeg", 1159},
+  {"mods", 101},
+  {"p21", 117},
+  {"fcs", 425},
+  {"csml", 899},
+  {"wasm", 729},
+  {"mj2", 1157},
+  {"ngdat", 527},
+  {"sid", 861},
+  {NULL, 0},
+  {"oza", 781},
+  {"val", 930},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"p10", 126},
+  {"kin", 914},
+  {"azv", 985},
+  {NULL, 0},
+  {"dsm", 315},
+  {"xlim", 716},
+  {"xdssc", 50},
+  {"kne", 441},
+  {"7z", 735},
+  {"daf", 472},
+  {"ac3", 836},
+  {"umj", 679},
+  {"isws", 688},
+  {NULL, 0},
+  {"odg", 537},
+  {NULL, 0},
+  {"vcx", 684},
+  {NULL, 0},
+  {"css", 1074},
+  {"xlsm", 489},
+  {"roff", 1095},
+  {"wsc", 702},
+  {"jar", 73},
+  {"lostsyncxml", 83},
+  {"las", 444},
+  {"jdx", 913},
+  {"sic", 694},
+  {"sus", 659},
+  {"scr", 794},
+  {"uvm", 1163},
+  {"dxf", 989},
+  {"jxss", 975},
+  {NULL, 0},
+  {"loas", 865},
+  {"ogex", 1056},
+  {"icf", 289},
+  {"oprc", 575},
+  {"gtm", 390},
+  {NULL, 0},
+  {"wav", 889},
+  {"odb", 533},
+  {"ccmp", 22},
+  {"appcache", 1071},
+  {"dii", 45},
+  {NULL, 0},
+  {"s1p", 611},
+  {"dir", 745},
+  {"imscc", 415},
+  {"etx", 1147},
+  {NULL, 0},
+  {"dpkg", 714},
+  {"qwt", 593},
+  {"gv", 1111},
+  {"ssvc", 300},
+  {"hps", 400},
+  {"pgp", 122},
+  {"qgs", 784},
+  {"apexlang", 248},
+  {"mov", 1161},
+  {"x3d", 1067},
+  {"mqy", 475},
+  {"lvp", 873},
+  {"ged", 1107},
+  {"upa", 395},
+  {"shex", 1091},
+  {NULL, 0},
+  {"smo", 1178},
+  {"jlt", 401},
+  {"xotp", 284},
+  {"hif", 946},
+  {"mvt", 459},
+  {"ly", 1139},
+  {NULL, 0},
+  {"ebuild", 372},
+  {"cpt", 88},
+  {NULL, 0},
+  {"odd", 203},
+  {NULL, 0},
+  {NULL, 0},
+  {"lin", 18},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"cgm", 948},
+  {"cat", 496},
+  {"spc", 903},
+  {"sxl", 613},
+  {"ascii", 1101},
+  {"sos", 1119},
+  {"wmd", 773},
+  {"stp", 1043},
+  {"nb", 704},
+  {NULL, 0},
+  {"gpkg", 64},
+  {"pem", 121},
+  {"senml-etchj", 171},
+  {"hbci", 395},
+  {"sac", 199},
+  {"vcg", 392},
+  {NULL, 0},
+  {NULL, 0},
+  {"rnc", 147},
+  {NULL, 0},
+  {"pgm", 1023},
+  {"xdw", 365},
+  {"hvp", 719},
+  {NULL, 0},
+  {"le", 266},
+  {"n3", 1084},
+  {"uoml", 681},
+  {"rp9", 276},
+  {"ctx", 900},
+  {"xvml", 829},
+  {"tsq", 205},
+  {"s1n", 1000},
+  {"csl", 274},
+  {NULL, 0},
+  {"mfm", 468},
+  {NULL, 0},
+  {NULL, 0},
+  {"ctab", 893},
+  {"ves", 689},
+  {"lcs", 449},
+  {"senmlc", 167},
+  {"sfs", 637},
+  {"tra", 676},
+  {"xpx", 417},
+  {"uvf", 310},
+  {"igl", 410},
+  {"pot", 1085},
+  {"tsa", 198},
+  {"uvva", 867},
+  {"fxp", 229},
+  {NULL, 0},
+  {NULL, 0},
+  {"maker", 772},
+  {NULL, 0},
+  {"texinfo", 802},
+  {"ifm", 621},
+  {"amr", 837},
+  {"vsd", 691},
+  {"aml", 1},
+  {"distz", 249},
+  {"odf", 536},
+  {"crtr", 512},
+  {NULL, 0},
+  {"carjson", 340},
+  {"zst", 833},
+  {"ep", 265},
+  {NULL, 0},
+  {"wif", 730},
+  {"pml", 303},
+  {NULL, 0},
+  {"karbon", 431},
+  {"ai", 137},
+  {"sldm", 500},
+  {NULL, 0},
+  {"fly", 1109},
+  {NULL, 0},
+  {NULL, 0},
+  {"finf", 58},
+  {"mpkg", 249},
+  {"xav", 814},
+  {NULL, 0},
+  {"lha", 768},
+  {"nitf", 523},
+  {"wg", 583},
+  {"nim", 1172},
+  {"cww", 139},
+  {"wm", 1186},
+  {"imf", 411},
+  {"pm", 1144},
+  {NULL, 0},
+  {"ps", 137},
+  {"grxml", 187},
+  {"c4d", 277},
+  {"mgp", 571},
+  {"xvm", 829},
+  {"sensmlx", 175},
+  {"jmz", 765},
+  {"cer", 133},
+  {"sgml", 1089},
+  {"stl", 1047},
+  {NULL, 0},
+  {NULL, 0},
+  {"dms", 1104},
+  {NULL, 0},
+  {"pyox", 1059},
+  {"crl", 134},
+  {"cdkey", 465},
+  {"fe_launch", 314},
+  {NULL, 0},
+  {NULL, 0},
+  {"evb", 849},
+  {"oa3", 361},
+  {"sdw", 644},
+  {"acn", 840},
+  {"chm", 492},
+  {"mpw", 344},
+  {"slc", 695},
+  {"pls", 887},
+  {"kmz", 384},
+  {"zaz", 726},
+  {"xdf", 816},
+  {"sms", 219},
+  {NULL, 0},
+  {"mpp", 503},
+  {NULL, 0},
+  {"pcl", 402},
+  {NULL, 0},
+  {"rnd", 141},
+  {"apk", 242},
+  {"cdy", 273},
+  {"kfo", 433},
+  {"sfc", 522},
+  {NULL, 0},
+  {NULL, 0},
+  {"pbd", 585},
+  {"loom", 450},
+  {"tfx", 983},
+  {"utz", 678},
+  {NULL, 0},
+  {"ins", 761},
+  {"hbc", 395},
+  {"xif", 1006},
+  {"png", 978},
+  {"rct", 141},
+  {"urimap", 682},
+  {"grv", 389},
+  {"cryptonote", 600},
+  {"uvh", 1162},
+  {"mus", 514},
+  {"dbf", 308},
+  {"scl", 661},
+  {"tat", 554},
+  {"td", 213},
+  {"bkm", 518},
+  {"psb", 217},
+  {"fpx", 991},
+  {"hpid", 399},
+  {"src", 808},
+  {"mmr", 993},
+  {"mads", 89},
+  {"shc", 1090},
+  {NULL, 0},
+  {"uvvi", 986},
+  {NULL, 0},
+  {"mp2", 858},
+  {"xcf", 1027},
+  {"c++", 1131},
+  {"lbe", 448},
+  {"scala", 1146},
+  {NULL, 0},
+  {"twd", 628},
+  {"win", 1052},
+  {NULL, 0},
+  {"rms", 427},
+  {NULL, 0},
+  {"sik", 803},
+  {NULL, 0},
+  {"emm", 404},
+  {"mop", 925},
+  {"xltm", 490},
+  {"acutc", 226},
+  {"ter", 197},
+  {"xz", 813},
+  {"davmount", 42},
+  {"m1v", 1159},
+  {"x_t", 1058},
+  {"lca", 449},
+  {"dotx", 569},
+  {"dcr", 745},
+  {"ntf", 454},
+  {"ssml", 189},
+  {"hvd", 717},
+  {"eln", 327},
+  {"oga", 860},
+  {"mpd", 40},
+  {"tuc", 201},
+  {NULL, 0},
+  {"cbz", 287},
+  {"wmlc", 697},
+  {"me", 805},
+  {NULL, 0},
+  {"ivp", 413},
+  {"mpga", 858},
+  {"lhzd", 262},
+  {"cdr", 1013},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"package", 258},
+  {"uvs", 1166},
+  {"emb", 902},
+  {"ser", 74},
+  {"azf", 236},
+  {"str", 579},
+  {"rpss", 529},
+  {"ign", 292},
+  {"zmt", 925},
+  {"cwl.json", 39},
+  {NULL, 0},
+  {"otf", 938},
+  {"pfa", 748},
+  {"clkp", 296},
+  {"geojson", 63},
+  {"sofa", 863},
+  {"ma", 93},
+  {"mpy", 405},
+  {"flo", 469},
+  {"tk", 1149},
+  {"jsonld", 79},
+  {NULL, 0},
+  {"rtf", 158},
+  {"dvi", 747},
+  {"mseq", 511},
+  {"cpkg", 713},
+  {"sxls", 613},
+  {"cdxml", 270},
+  {"pptx", 562},
+  {"~", 803},
+  {"xpak", 375},
+  {"eps2", 137},
+  {"wvx", 1189},
+  {"rar", 596},
+  {"cea", 30},
+  {NULL, 0},
+  {"aiff", 882},
+  {NULL, 0},
+  {"mp21", 102},
+  {"c11amc", 278},
+  {"chrt", 432},
+  {"bdm", 665},
+  {"sar", 604},
+  {"jls", 961},
+  {"xdp", 230},
+  {"s1w", 608},
+  {NULL, 0},
+  {"oas", 359},
+  {"sgm", 1089},
+  {"s1q", 1178},
+  {"wpd", 707},
+  {"udeb", 309},
+  {"vbox", 587},
+  {"stk", 69},
+  {NULL, 0},
+  {"fsc", 358},
+  {"swf", 227},
+  {"mxmf", 856},
+  {"isp", 761},
+  {NULL, 0},
+  {"org", 455},
+  {"btf", 979},
+  {"vsf", 693},
+  {"pub", 345},
+  {NULL, 0},
+  {"sh", 792},
+  {"x3dz", 1067},
+  {"pre", 453},
+  {"senml-etchc", 170},
+  {"stpx", 1044},
+  {"mpc", 480},
+  {"mol", 917},
+  {"smf", 643},
+  {NULL, 0},
+  {"opf", 113},
+  {"scld", 318},
+  {"tnf", 504},
+  {"igm", 416},
+  {"tgz", 756},
+  {"stc", 650},
+  {"p7m", 128},
+  {"rss", 788},
+  {"embl", 902},
+  {NULL, 0},
+  {"rxt", 466},
+  {"csp", 290},
+  {"vfk", 1106},
+  {"o", 780},
+  {"pcx", 1007},
+  {"spdf", 615},
+  {"yang", 830},
+  {"cii", 244},
+  {"hpub", 140},
+  {"gau", 907},
+  {"qfx", 420},
+  {NULL, 0},
+  {NULL, 0},
+  {"ppm", 1024},
+  {"atomsvc", 10},
+  {"ecig", 342},
+  {"uvvs", 1166},
+  {NULL, 0},
+  {"vtnstd", 687},
+  {"nnd", 524},
+  {"xct", 367},
+  {"shx", 626},
+  {NULL, 0},
+  {"dvb", 1168},
+  {"portpkg", 458},
+  {"mb", 93},
+  {"mxml", 829},
+  {NULL, 0},
+  {"lasjson", 445},
+  {"xtel", 935},
+  {NULL, 0},
+  {"jnlp", 764},
+  {"rl", 148},
+  {NULL, 0},
+  {"stpnc", 117},
+  {"mseed", 350},
+  {NULL, 0},
+  {"ic1", 289},
+  {"qam", 331},
+  {NULL, 0},
+  {NULL, 0},
+  {"avi", 1190},
+  {"pbm", 1022},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"urim", 682},
+  {"gsm", 883},
+  {"nsg", 454},
+  {NULL, 0},
+  {"1km", 215},
+  {"sarif-external-properties", 160},
+  {NULL, 0},
+  {"qcp", 848},
+  {NULL, 0},
+  {"pnm", 1021},
+  {"fits", 952},
+  {"iso", 763},
+  {"aion", 687},
+  {"cbor", 20},
+  {NULL, 0},
+  {"kwt", 438},
+  {"kml", 383},
+  {"wmz", 774},
+  {"rdf-crypt", 142},
+  {"plb", 216},
+  {"m3u", 859},
+  {"markdown", 1082},
+  {"p12", 127},
+  {"aac", 835},
+  {"key", 123},
+  {NULL, 0},
+  {NULL, 0},
+  {"spo", 1115},
+  {"ktx2", 977},
+  {"usda", 1061},
+  {"spn", 1000},
+  {"roa", 157},
+  {"nebul", 517},
+  {NULL, 0},
+  {NULL, 0},
+  {"pcf.z", 749},
+  {"c9s", 301},
+  {"preminet", 586},
+  {NULL, 0},
+  {"ts", 1121},
+  {"knp", 441},
+  {"numbers", 252},
+  {"onepkg", 115},
+  {"lbc", 853},
+  {NULL, 0},
+  {"pya", 874},
+  {"es3", 336},
+  {NULL, 0},
+  {"uvvd", 310},
+  {NULL, 0},
+  {"mf4", 98},
+  {"itp", 622},
+  {"dna", 316},
+  {"dim", 349},
+  {"sql", 185},
+  {"tsp", 48},
+  {"st", 603},
+  {"ic7", 289},
+  {"ipfix", 71},
+  {"fchk", 905},
+  {"m3u8", 251},
+  {NULL, 0},
+  {NULL, 0},
+  {"mmod", 916},
+  {NULL, 0},
+  {"ors", 109},
+  {"smzip", 646},
+  {"xlsb", 488},
+  {NULL, 0},
+  {"moml", 1054},
+  {"htke", 439},
+  {"flx", 1110},
+  {"sda", 641},
+  {"cascii", 893},
+  {"cla", 275},
+  {NULL, 0},
+  {NULL, 0},
+  {"wmx", 1188},
+  {"vtt", 1126},
+  {"jp2", 962},
+  {"tamx", 553},
+  {"scd", 605},
+  {"cpa", 897},
+  {NULL, 0},
+  {"wbs", 299},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"mtl", 1040},
+  {NULL, 0},
+  {"irm", 406},
+  {"webm", 1181},
+  {NULL, 0},
+  {"gz", 67},
+  {"ttc", 937},
+  {"vwx", 686},
+  {"relo", 118},
+  {"istc", 688},
+  {"pyc", 783},
+  {"3dml", 1114},
+  {NULL, 0},
+  {NULL, 0},
+  {"saf", 721},
+  {"m4v", 1158},
+  {"mcm", 915},
+  {"dcm", 44},
+  {"azs", 237},
+  {"psid", 861},
+  {"boo", 1129},
+  {"xspf", 828},
+  {"mm", 750},
+  {"msa", 510},
+  {"wax", 884},
+  {NULL, 0},
+  {"cdbcmsg", 291},
+  {"rusd", 154},
+  {"vew", 452},
+  {"1905.1", 409},
+  {"flb", 352},
+  {"atomdeleted", 8},
+  {"xlm", 486},
+  {"gqf", 385},
+  {"zfo", 634},
+  {"emf", 951},
+  {"prt", 929},
+  {"sxc", 649},
+  {"dl", 307},
+  {"stif", 612},
+  {"lhs", 1140},
+  {"g2w", 381},
+  {"xsm", 664},
+  {"bik", 1173},
+  {"mph", 742},
+  {"acc", 239},
+  {"jxr", 969},
+  {NULL, 0},
+  {NULL, 0},
+  {"fvt", 1169},
+  {"zone", 1077},
+  {"sse", 443},
+  {"cryptomator", 302},
+  {"iii", 762},
+  {"twds", 628},
+  {"cache", 891},
+  {"sensml", 174},
+  {"odp", 541},
+  {"uvvg", 986},
+  {"bin", 110},
+  {"prc", 1042},
+  {"lmp", 1052},
+  {"msu", 110},
+  {"qvd", 670},
+  {"yin", 831},
+  {NULL, 0},
+  {"jad", 1120},
+  {"nsh", 454},
+  {NULL, 0},
+  {"s3df", 606},
+  {"wk", 734},
+  {"stpxz", 1046},
+  {"diff", 1135},
+  {"prz", 453},
+  {"xods", 285},
+  {NULL, 0},
+  {"spp", 165},
+  {"docjson", 317},
+  {NULL, 0},
+  {"xlw", 486},
+  {"man", 804},
+  {"rgb", 1025},
+  {"listafp", 231},
+  {"xls", 486},
+  {NULL, 0},
+  {"oth", 548},
+  {"b16", 998},
+  {NULL, 0},
+  {NULL, 0},
+  {"imi", 412},
+  {NULL, 0},
+  {"sv4cpio", 796},
+  {"rlm", 599},
+  {"txd", 369},
+  {"seed", 351},
+  {"3dm", 1114},
+  {"sxi", 653},
+  {"asf", 484},
+  {"inkml", 70},
+  {"sdkd", 635},
+  {"sce", 337},
+  {"mmd", 272},
+  {"xns", 819},
+  {"gxt", 380},
+  {"webp", 1008},
+  {"sd", 920},
+  {"csvs", 1076},
+  {"s1m", 881},
+  {NULL, 0},
+  {NULL, 0},
+  {"les", 397},
+  {"latex", 767},
+  {"oxlicg", 574},
+  {"gf", 800},
+  {NULL, 0},
+  {"tnef", 504},
+  {"tsv", 1093},
+  {"ddd", 364},
+  {"tur", 200},
+  {NULL, 0},
+  {"c4u", 277},
+  {"sds", 640},
+  {NULL, 0},
+  {"m4u", 1170},
+  {"svg", 981},
+  {"apkg", 243},
+  {"bsp", 1063},
+  {"xer", 818},
+  {"tr", 1095},
+  {"uvvf", 310},
+  {"ppd", 304},
+  {NULL, 0},
+  {"dls", 846},
+  {"tau", 193},
+  {"hpi", 399},
+  {NULL, 0},
+  {"cif", 513},
+  {NULL, 0},
+  {"skm", 442},
+  {NULL, 0},
+  {"teicorpus", 203},
+  {"qt", 1161},
+  {"cmc", 293},
+  {NULL, 0},
+  {NULL, 0},
+  {"msp", 110},
+  {"gl", 1155},
+  {NULL, 0},
+  {NULL, 0},
+  {"tgf", 921},
+  {"jsontm", 208},
+  {"lzx", 771},
+  {"obj", 1041},
+  {NULL, 0},
+  {NULL, 0},
+  {"gtw", 1053},
+  {"ppttc", 671},
+  {"csd", 845},
+  {"mbox", 95},
+  {"ahead", 235},
+  {"cpio", 743},
+  {"mgz", 588},
+  {"ifc", 117},
+  {"m4s", 1156},
+  {"smov", 1178},
+  {"cdmid", 27},
+  {"ram", 886},
+  {"rpst", 528},
+  {"b", 923},
+  {NULL, 0},
+  {"class", 75},
+  {"sls", 153},
+  {"xbm", 1026},
+  {"stix", 190},
+  {"ns4", 454},
+  {NULL, 0},
+  {"m2v", 1159},
+  {"cab", 485},
+  {"ami", 240},
+  {"dot", 1111},
+  {"nwc", 779},
+  {"zfc", 353},
+  {"senmlx", 169},
+  {"mdb", 103},
+  {"imp", 224},
+  {"pas", 1142},
+  {NULL, 0},
+  {NULL, 0},
+  {"onetoc2", 115},
+  {"mpega", 858},
+  {"jpg", 963},
+  {"psd", 984},
+  {"brf", 1085},
+  {"kwd", 438},
+  {"pqa", 575},
+  {"wad", 746},
+  {"evw", 851},
+  {"lwp", 457},
+  {"mc1", 464},
+  {NULL, 0},
+  {"mxu", 1170},
+  {"texi", 802},
+  {"wks", 507},
+  {"heifs", 957},
+  {"xca", 815},
+  {"deploy", 110},
+  {"tcu", 195},
+  {NULL, 0},
+  {"genozip", 370},
+  {"dxr", 745},
+  {"sarif-external-properties.json", 160},
+  {"mxi", 685},
+  {NULL, 0},
+  {"siv", 179},
+  {"sarif.json", 159},
+  {"miz", 1083},
+  {"vsc", 690},
+  {"ftc", 355},
+  {"woff2", 941},
+  {"mpf", 1116},
+  {NULL, 0},
+  {"dist", 249},
+  {"mlp", 869},
+  {"gan", 751},
+  {NULL, 0},
+  {"qps", 590},
+  {"sig", 124},
+  {"mrc", 91},
+  {"kpt", 436},
+  {"vcj", 728},
+  {"spl", 62},
+  {"srx", 183},
+  {"eclass", 373},
+  {"bk2", 1173},
+  {"skd", 442},
+  {"u8dsn", 1031},
+  {"xdd", 17},
+  {"lpf", 84},
+  {"gac", 386},
+  {"moo", 926},
+  {"p2p", 701},
+  {"ras", 1012},
+  {NULL, 0},
+  {"ml2", 660},
+  {"ott", 547},
+  {"si", 1122},
+  {"ac", 132},
+  {NULL, 0},
+  {NULL, 0},
+  {"ggt", 378},
+  {NULL, 0},
+  {"hxx", 1130},
+  {"epub", 55},
+  {"spdx.json", 184},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"ink", 70},
+  {"ttml", 210},
+  {"wbxml", 696},
+  {NULL, 0},
+  {"ief", 960},
+  {"json", 77},
+  {"qcall", 334},
+  {"mxf", 105},
+  {"xul", 481},
+  {"otg", 538},
+  {"tamp", 552},
+  {"jpeg", 963},
+  {"hh", 1130},
+  {"d", 1136},
+  {"msm", 1052},
+  {"spx", 860},
+  {"fg5", 362},
+  {"sldx", 563},
+  {"nns", 525},
+  {"bh2", 363},
+  {"py", 1145},
+  {"gdl", 1052},
+  {"torrent", 739},
+  {"jxl", 968},
+  {NULL, 0},
+  {"info", 760},
+  {"spot", 1115},
+  {"jxra", 970},
+  {NULL, 0},
+  {NULL, 0},
+  {"cql", 1073},
+  {"nsf", 454},
+  {"ez2", 346},
+  {"swi", 254},
+  {NULL, 0},
+  {"fit", 952},
+  {"spng", 1000},
+  {"jpf", 967},
+  {NULL, 0},
+  {"dwd", 11},
+  {"dtshd", 871},
+  {"pl", 1144},
+  {"its", 72},
+  {NULL, 0},
+  {"xml", 823},
+  {"qxl", 593},
+  {NULL, 0},
+  {"xpr", 424},
+  {"smil", 181},
+  {NULL, 0},
+  {NULL, 0},
+  {"pki", 136},
+  {NULL, 0},
+  {"kpr", 436},
+  {"c4p", 277},
+  {"xmt_bin", 1057},
+  {"trig", 209},
+  {"quox", 594},
+  {"apex", 248},
+  {NULL, 0},
+  {"gcg", 909},
+  {"clkk", 295},
+  {"potm", 502},
+  {"htm", 1079},
+  {"s1a", 615},
+  {"tfi", 204},
+  {NULL, 0},
+  {"cdf", 740},
+  {"ic6", 289},
+  {"rb", 789},
+  {"cda", 740},
+  {"tst", 339},
+  {"qca", 334},
+  {"odx", 112},
+  {"heics", 955},
+  {"wml", 1124},
+  {"cdmia", 25},
+  {NULL, 0},
+  {"rxn", 919},
+  {"irp", 423},
+  {"pcap", 669},
+  {"cld", 1049},
+  {"viaframe", 672},
+  {"nt", 107},
+  {"rsat", 13},
+  {"flt", 1108},
+  {"otp", 542},
+  {"request", 518},
+  {NULL, 0},
+  {NULL, 0},
+  {"rsm", 1052},
+  {NULL, 0},
+  {"ssw", 1177},
+  {"qtl", 785},
+  {NULL, 0},
+  {"hvs", 718},
+  {"crt", 810},
+  {"mc2", 1118},
+  {"sfd", 356},
+  {"csrattrs", 36},
+  {NULL, 0},
+  {"pil", 581},
+  {"senml", 168},
+  {"nml", 328},
+  {NULL, 0},
+  {NULL, 0},
+  {"exp", 57},
+  {"maei", 99},
+  {NULL, 0},
+  {"ei6", 580},
+  {"dd2", 550},
+  {NULL, 0},
+  {"sis", 663},
+  {"cml", 31},
+  {"sarif", 159},
+  {"dtd", 824},
+  {"xop", 826},
+  {NULL, 0},
+  {NULL, 0},
+  {"txf", 478},
+  {"sdf", 441},
+  {"sxw", 656},
+  {"vrm", 1065},
+  {"eps3", 137},
+  {"mxs", 675},
+  {NULL, 0},
+  {NULL, 0},
+  {"xsf", 143},
+  {"gal", 908},
+  {"shar", 793},
+  {"fbdoc", 772},
+  {"kil", 766},
+  {"wspolicy", 733},
+  {"pkd", 395},
+  {"tao", 668},
+  {NULL, 0},
+  {"ecigprofile", 341},
+  {"rcprofile", 422},
+  {"uvvm", 1163},
+  {NULL, 0},
+  {"meta4", 96},
+  {"cdx", 894},
+  {"dif", 1153},
+  {NULL, 0},
+  {"ifb", 1072},
+  {"webmanifest", 90},
+  {"rlc", 994},
+  {"jpm", 966},
+  {"held", 12},
+  {NULL, 0},
+  {"sgi", 1001},
+  {"dotm", 506},
+  {"mrcx", 92},
+  {"ics", 1072},
+  {"csv", 1075},
+  {NULL, 0},
+  {"htc", 1133},
+  {"adts", 835},
+  {NULL, 0},
+  {NULL, 0},
+  {"cst", 290},
+  {"provn", 1086},
+  {"axv", 1152},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"emotionml", 54},
+  {"swidtag", 192},
+  {"dis", 473},
+  {"cef", 901},
+  {"avcs", 945},
+  {"ods", 543},
+  {"dsc", 1088},
+  {NULL, 0},
+  {"dts", 870},
+  {"rpm", 787},
+  {"kom", 395},
+  {"pyv", 1171},
+  {NULL, 0},
+  {NULL, 0},
+  {"mml", 94},
+  {"wz", 809},
+  {"tree", 595},
+  {"cxx", 1131},
+  {"pac", 778},
+  {"nlu", 519},
+  {NULL, 0},
+  {NULL, 0},
+  {"cac", 891},
+  {"zirz", 725},
+  {"vss", 691},
+  {"gnumeric", 752},
+  {NULL, 0},
+  {"dmg", 737},
+  {"erf", 1016},
+  {NULL, 0},
+  {"jhc", 965},
+  {"gdz", 348},
+  {"vrml", 1065},
+  {"artisan", 255},
+  {"quiz", 594},
+  {"wps", 507},
+  {"lxf", 85},
+  {"wmls", 1125},
+  {"sv4crc", 797},
+  {"xlt", 486},
+  {"sitx", 795},
+  {NULL, 0},
+  {"jph", 964},
+  {"sensmlc", 173},
+  {"mol2", 660},
+  {"clkx", 294},
+  {"sru", 188},
+  {"plf", 584},
+  {"xcos", 791},
+  {"shtml", 1079},
+  {"nc", 777},
+  {"jxrs", 971},
+  {"old", 803},
+  {"bmp", 947},
+  {"qxb", 593},
+  {"x3db", 1066},
+  {"ccc", 1117},
+  {"m21", 102},
+  {NULL, 0},
+  {"aso", 223},
+  {"jpgm", 966},
+  {"arrow", 246},
+  {NULL, 0},
+  {"cmdf", 896},
+  {"tif", 982},
+  {"pdb", 575},
+  {"obg", 558},
+  {"uva", 867},
+  {"smp", 881},
+  {NULL, 0},
+  {"vms", 933},
+  {"xmt_txt", 1058},
+  {"otc", 535},
+  {"movie", 1191},
+  {NULL, 0},
+  {"enw", 850},
+  {"pwn", 222},
+  {NULL, 0},
+  {NULL, 0},
+  {"mif", 471},
+  {NULL, 0},
+  {"stw", 658},
+  {"orc", 845},
+  {"vst", 691},
+  {"pfr", 61},
+  {"mpg4", 1158},
+  {"xlc", 486},
+  {"soa", 1077},
+  {"atomcat", 7},
+  {"xbd", 366},
+  {"asc", 123},
+  {"msd", 350},
+  {NULL, 0},
+  {NULL, 0},
+  {"u8msg", 1030},
+  {"1clr", 32},
+  {"pages", 253},
+  {"ogx", 114},
+  {"abw", 736},
+  {"xyze", 999},
+  {NULL, 0},
+  {"sco", 845},
+  {"dart", 305},
+  {"ggs", 377},
+  {"patch", 1135},
+  {"line", 517},
+  {"mail", 1034},
+  {"sgl", 645},
+  {NULL, 0},
+  {"fdt", 60},
+  {"fla", 321},
+  {"uvg", 986},
+  {"docm", 505},
+  {"ggb", 376},
+  {"xhe", 865},
+  {"xmls", 47},
+  {"fo", 633},
+  {"ktr", 430},
+  {"lostxml", 82},
+  {"scm", 456},
+  {"xel", 817},
+  {"fdf", 59},
+  {"ext", 532},
+  {"p8e", 131},
+  {"lyx", 769},
+  {"vpm", 1070},
+  {"cbin", 893},
+  {"mid", 864},
+  {NULL, 0},
+  {"mng", 1185},
+  {"istr", 912},
+  {"ignition", 292},
+  {NULL, 0},
+  {"icc", 408},
+  {"fts", 952},
+  {"soc", 177},
+  {"sdoc", 608},
+  {NULL, 0},
+  {"pskcxml", 144},
+  {"xht", 821},
+  {"dv", 1153},
+  {"oda", 111},
+  {"uvt", 311},
+  {"c3ex", 21},
+  {"hdr", 999},
+  {"wrl", 1065},
+  {"mkv", 1184},
+  {"mpv", 1184},
+  {"rdz", 306},
+  {"kon", 435},
+  {"tap", 1003},
+  {NULL, 0},
+  {"gamin", 904},
+  {NULL, 0},
+  {NULL, 0},
+  {"jsontd", 202},
+  {"xots", 286},
+  {NULL, 0},
+  {"uris", 1097},
+  {"msl", 476},
+  {"wgt", 731},
+  {"glbuf", 65},
+  {"mod", 824},
+  {"ktz", 430},
+  {"art", 1017},
+  {"726", 834},
+  {"dpgraph", 319},
+  {NULL, 0},
+  {"md", 1082},
+  {"efi", 52},
+  {"one", 115},
+  {"entity", 518},
+  {"vcd", 741},
+  {NULL, 0},
+  {NULL, 0},
+  {"fch", 905},
+  {NULL, 0},
+  {"ogg", 860},
+  {"p8", 130},
+  {"atc", 226},
+  {"geo", 324},
+  {NULL, 0},
+  {NULL, 0},
+  {"mp3", 858},
+  {"scq", 162},
+  {"c4g", 277},
+  {NULL, 0},
+  {"smpg", 1175},
+  {"vtu", 1064},
+  {"mts", 1055},
+  {"gcf", 754},
+  {"rd", 918},
+  {"vcf", 1098},
+  {"tlclient", 269},
+  {NULL, 0},
+  {NULL, 0},
+  {"sty", 1150},
+  {"ksp", 437},
+  {"uis", 214},
+  {"h++", 1130},
+  {"xlf", 822},
+  {"coswid", 191},
+  {"slt", 332},
+  {"ddeb", 309},
+  {"cap", 669},
+  {"sxd", 651},
+  {"pseg3820", 231},
+  {"hans", 1112},
+  {"slaz", 605},
+  {NULL, 0},
+  {NULL, 0},
+  {"avif", 946},
+  {"provx", 138},
+  {"sqlite3", 638},
+  {NULL, 0},
+  {"rsheet", 212},
+  {"azw3", 238},
+  {NULL, 0},
+  {"prf", 125},
+  {"u3d", 1048},
+  {"box", 587},
+  {NULL, 0},
+  {NULL, 0},
+  {"vsw", 691},
+  {"dit", 46},
+  {"nef", 1019},
+  {"uvx", 312},
+  {NULL, 0},
+  {"jng", 1018},
+  {"l16", 854},
+  {"mpt", 503},
+  {"skt", 442},
+  {"jxs", 972},
+  {"xslt", 827},
+  {"mvb", 927},
+  {"wk4", 451},
+  {"xpm", 1028},
+  {"fcdt", 228},
+  {"xott", 282},
+  {"gif", 953},
+  {"ecigtheme", 343},
+  {"cellml", 31},
+  {"exe", 775},
+  {"wbmp", 1005},
+  {"hs", 1137},
+  {"sem", 609},
+  {"tpt", 674},
+  {"pat", 1014},
+  {NULL, 0},
+  {"aifc", 882},
+  {NULL, 0},
+  {"auc", 194},
+  {"ic2", 289},
+  {NULL, 0},
+  {NULL, 0},
+  {"mpm", 264},
+  {"gqs", 385},
+  {"cmsc", 34},
+  {"xfd", 712},
+  {"ic5", 289},
+  {"nbp", 706},
+  {"esa", 573},
+  {"vtf", 1004},
+  {"mag", 326},
+  {"icd", 289},
+  {NULL, 0},
+  {"svc", 323},
+  {"edx", 531},
+  {NULL, 0},
+  {NULL, 0},
+  {"tmo", 673},
+  {"xfdl", 712},
+  {"jam", 426},
+  {NULL, 0},
+  {"djvu", 987},
+  {"ica", 759},
+  {"kcm", 518},
+  {NULL, 0},
+  {"ez3", 347},
+  {"uri", 1097},
+  {"hej2", 958},
+  {"model-inter", 685},
+  {"xlam", 487},
+  {"xodp", 283},
+  {"c3d", 895},
+  {"ghf", 387},
+  {NULL, 0},
+  {"nds", 521},
+  {"sjp", 1002},
+  {"tcl", 799},
+  {"bar", 592},
+  {"ecelp9600", 878},
+  {NULL, 0},
+  {"atom", 6},
+  {"uvvx", 312},
+  {"wafl", 699},
+  {"plc", 477},
+  {NULL, 0},
+  {"bib", 1128},
+  {"scsf", 607},
+  {"jpg2", 962},
+  {"xps", 509},
+  {NULL, 0},
+  {"dwg", 988},
+  {"efif", 582},
+  {"ent", 825},
+  {"reload", 599},
+  {"ass", 835},
+  {"cwl", 38},
+  {"apng", 943},
+  {"qbo", 419},
+  {"tsr", 206},
+  {"dll", 775},
+  {"m4a", 857},
+  {"tei", 203},
+  {"xcs", 19},
+  {"msty", 515},
+  {NULL, 0},
+  {"aal", 841},
+  {"vbk", 875},
+  {"curl", 1102},
+  {NULL, 0},
+  {"ez", 2},
+  {NULL, 0},
+  {"cbr", 288},
+  {"m", 705},
+  {"smh", 610},
+  {"fti", 245},
+  {"vmt", 683},
+  {"jisp", 428},
+  {NULL, 0},
+  {"oxps", 116},
+  {"ecelp7470", 877},
+  {"mpe", 1159},
+  {"%", 803},
+  {"lsf", 1183},
+  {"xpw", 417},
+  {NULL, 0},
+  {NULL, 0},
+  {"frm", 677},
+  {"ppsx", 564},
+  {"u8hdr", 1033},
+  {"lsx", 1183},
+  {"stpz", 1045},
+  {"pps", 497},
+  {"uo", 681},
+  {"dpg", 319},
+  {NULL, 0},
+  {"std", 652},
+  {"s11", 1175},
+  {"pcf", 749},
+  {"vcard", 1098},
+  {"a", 1099},
+  {"bmed", 1069},
+  {"cdt", 1015},
+  {"gpt", 924},
+  {"anx", 3},
+  {NULL, 0},
+  {"uvvv", 1167},
+  {NULL, 0},
+  {NULL, 0},
+  {"onetmp", 115},
+  {"atf", 4},
+  {NULL, 0},
+  {"s1j", 1002},
+  {"h", 1132},
+  {"xar", 711},
+  {"imgcal", 221},
+  {"icm", 408},
+  {"obgx", 557},
+  {"lzh", 770},
+  {"sr", 627},
+  {"pyo", 783},
+  {"3mf", 482},
+  {NULL, 0},
+  {"cls", 1150},
+  {"glbin", 65},
+  {"xltx", 567},
+  {"fxpl", 229},
+  {"iges", 1037},
+  {"spdx", 1092},
+  {NULL, 0},
+  {"syft.json", 662},
+  {"ssf", 333},
+  {NULL, 0},
+  {"cuc", 196},
+  {"3tz", 461},
+  {"rgbe", 999},
+  {NULL, 0},
+  {"wk1", 451},
+  {"cxf", 901},
+  {NULL, 0},
+  {"doc", 104},
+  {"emma", 53},
+  {"iif", 623},
+  {"cod", 601},
+  {NULL, 0},
+  {"pgb", 995},
+  {NULL, 0},
+  {"gcd", 1143},
+  {"html", 1079},
+  {NULL, 0},
+  {"mmdb", 462},
+  {"jphc", 965},
+  {NULL, 0},
+  {"asics", 338},
+  {NULL, 0},
+  {"mcd", 463},
+  {NULL, 0},
+  {"igx", 470},
+  {"g3w", 382},
+  {NULL, 0},
+  {"wv", 710},
+  {NULL, 0},
+  {"uvp", 1165},
+  {"sdkm", 635},
+  {"csf", 892},
+  {"c4f", 277},
+  {"ait", 322},
+  {"vfr", 672},
+  {"lgr", 80},
+  {"clkt", 297},
+  {"mpdd", 41},
+  {"rdp", 786},
+  {NULL, 0},
+  {"wmv", 1187},
+  {"ico", 996},
+  {NULL, 0},
+  {"mpg", 1159},
+  {"vxml", 727},
+  {"sw", 932},
+  {"koz", 866},
+  {"coffee", 280},
+  {"cw", 139},
+  {"tm", 1094},
+  {"epsf", 137},
+  {"taz", 756},
+  {"hin", 911},
+  {"shf", 178},
+  {"ist", 912},
+  {"dp", 572},
+  {NULL, 0},
+  {"wsdl", 732},
+  {"cl", 180},
+  {"car", 421},
+  {NULL, 0},
+  {NULL, 0},
+  {"mesh", 1039},
+  {"jt", 1038},
+  {"xhvml", 829},
+  {"i2g", 418},
+  {NULL, 0},
+  {"ppkg", 715},
+  {"btif", 979},
+  {NULL, 0},
+  {"dmp", 669},
+  {"spq", 164},
+  {NULL, 0},
+  {"tm.json", 208},
+  {"smht", 610},
+  {"book", 772},
+  {NULL, 0},
+  {NULL, 0},
+  {"cdmio", 28},
+  {"hgl", 1113},
+  {"gjf", 907},
+  {"dive", 577},
+  {"paw", 578},
+  {NULL, 0},
+  {"uvv", 1167},
+  {"rm", 886},
+  {"ic8", 289},
+  {"qwd", 593},
+  {"ots", 544},
+  {"qxt", 593},
+  {"ssv", 620},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"ptid", 591},
+  {"sgf", 753},
+  {NULL, 0},
+  {"avci", 944},
+  {"mhas", 855},
+  {"gjc", 907},
+  {"afp", 231},
+  {NULL, 0},
+  {"xsl", 827},
+  {"multitrack", 879},
+  {"s14", 1176},
+  {"s1e", 613},
+  {NULL, 0},
+  {"mft", 156},
+  {"p", 1142},
+  {"mxl", 598},
+  {"pkipath", 135},
+  {"frame", 772},
+  {"dssc", 49},
+  {"smp3", 881},
+  {"odt", 545},
+  {"dwf", 1051},
+  {"gltf", 1035},
+  {"xwd", 1029},
+  {"hpgl", 398},
+  {"teacher", 631},
+  {"c11amz", 279},
+  {"c", 1134},
+  {"hpp", 1130},
+  {"ltx", 1150},
+  {NULL, 0},
+  {"or2", 455},
+  {NULL, 0},
+  {"au", 844},
+  {"bak", 803},
+  {"bcpio", 738},
+  {NULL, 0},
+  {NULL, 0},
+  {"gram", 186},
+  {NULL, 0},
+  {"at3", 843},
+  {"skp", 442},
+  {"hdf", 757},
+  {"djv", 987},
+  {"mmf", 629},
+  {NULL, 0},
+  {"wadl", 648},
+  {"dxp", 636},
+  {"epsi", 137},
+  {NULL, 0},
+  {"rdf", 145},
+  {NULL, 0},
+  {"dpx", 950},
+  {"cil", 483},
+  {"bmml", 259},
+  {"csm", 899},
+  {"sc", 407},
+  {NULL, 0},
+  {"mp4", 1158},
+  {"msi", 776},
+  {"rif", 146},
+  {"dataless", 351},
+  {"dor", 1052},
+  {NULL, 0},
+  {NULL, 0},
+  {"apxml", 15},
+  {"cdmiq", 29},
+  {"sppt", 611},
+  {"sd2", 888},
+  {NULL, 0},
+  {NULL, 0},
+  {"ic4", 289},
+  {"x3dv", 1068},
+  {NULL, 0},
+  {"osf", 720},
+  {"gbr", 155},
+  {NULL, 0},
+  {NULL, 0},
+  {"nq", 106},
+  {NULL, 0},
+  {"hta", 68},
+  {"orf", 1020},
+  {"odm", 546},
+  {"opus", 860},
+  {"dx", 913},
+  {"s1h", 614},
+  {NULL, 0},
+  {"bed", 597},
+  {"uvvu", 1164},
+  {"ustar", 807},
+  {"copyright", 1103},
+  {"cdfx", 24},
+  {"sci", 790},
+  {"crw", 1011},
+  {NULL, 0},
+  {"hsj2", 959},
+  {"wk3", 451},
+  {"wcm", 507},
+  {"t", 1095},
+  {"ktx", 976},
+  {NULL, 0},
+  {"dfac", 320},
+  {"ppam", 498},
+  {NULL, 0},
+  {"gex", 379},
+  {NULL, 0},
+  {"sdo", 608},
+  {"rip", 880},
+  {"odi", 539},
+  {NULL, 0},
+  {"fb", 772},
+  {"m3g", 86},
+  {NULL, 0},
+  {"vcs", 1151},
+  {NULL, 0},
+  {"uvvp", 1165},
+  {"yt", 1180},
+  {"mets", 97},
+  {"gsf", 748},
+  {"ros", 931},
+  {"axa", 839},
+  {NULL, 0},
+  {"svgz", 981},
+  {"oxt", 560},
+  {NULL, 0},
+  {"tam", 551},
+  {NULL, 0},
+  {"gam", 904},
+  {"eot", 491},
+  {"uvz", 313},
+  {"snd", 844},
+  {"igs", 1037},
+  {"moc", 1141},
+  {NULL, 0},
+  {"ttf", 939},
+  {"spf", 722},
+  {"lrm", 494},
+  {NULL, 0},
+  {"pdf", 119},
+  {"grd", 371},
+  {"js", 1080},
+  {"cdmic", 26},
+  {"gim", 388},
+  {"ufd", 677},
+  {"joda", 429},
+  {"ac2", 261},
+  {"cpp", 1131},
+  {"bpd", 395},
+  {"atxml", 14},
+  {"sm", 647},
+  {NULL, 0},
+  {"arrows", 247},
+  {NULL, 0},
+  {"asn", 928},
+  {"jtd", 1105},
+  {NULL, 0},
+  {"zip", 832},
+  {"taglet", 516},
+  {"thmx", 495},
+  {"sl", 1123},
+  {"oti", 540},
+  {"s1g", 1001},
+  {"fm", 357},
+  {NULL, 0},
+  {"ism", 1052},
+  {"ttl", 1096},
+  {"plj", 872},
+  {"heif", 956},
+  {NULL, 0},
+  {NULL, 0},
+  {"keynote", 250},
+  {"gpkg.tar", 374},
+  {"notebook", 630},
+  {"wmc", 703},
+  {"kia", 440},
+  {"scs", 163},
+  {"pfx", 127},
+  {"xpi", 812},
+  {"pdx", 120},
+  {NULL, 0},
+  {"sla", 605},
+  {"tm.jsonld", 208},
+  {NULL, 0},
+  {"list3820", 231},
+  {"ic0", 289},
+  {"fli", 1154},
+  {"sy2", 660},
+  {"wma", 885},
+  {"rs", 151},
+  {"bsd", 898},
+  {"bmi", 267},
+  {"flac", 852},
+  {"uvd", 310},
+  {"sml", 181},
+  {NULL, 0},
+  {"docx", 568},
+  {"sqlite", 638},
+  {"silo", 1039},
+  {NULL, 0},
+  {"ptrom", 632},
+  {"gsheet", 211},
+  {"ccxml", 23},
+  {"espass", 335},
+  {"ecelp4800", 876},
+  {"heic", 954},
+  {"yme", 723},
+  {"p7r", 782},
+  {"123", 451},
+  {"sit", 795},
+  {"ogv", 1160},
+  {"csh", 744},
+  {"alc", 890},
+  {"u8mdn", 1032},
+  {"sgif", 1001},
+  {"lbd", 447},
+  {"mopcrt", 925},
+  {"amlx", 16},
+  {"sieve", 179},
+  {"xlsx", 566},
+  {"osm", 561},
+  {"fst", 992},
+  {"ipk", 624},
+  {"cr2", 1010},
+  {"lasxml", 446},
+  {"et3", 336},
+  {"ims", 493},
+  {NULL, 0},
+  {"ic3", 289},
+  {"atomsrv", 9},
+  {NULL, 0},
+  {"sam", 457},
+  {"tpl", 391},
+  {NULL, 0},
+  {"uvu", 1164},
+  {NULL, 0},
+  {"sdp", 166},
+  {NULL, 0},
+  {"uvi", 986},
+  {"rapd", 152},
+  {NULL, 0},
+  {NULL, 0},
+  {NULL, 0},
+  {"mpn", 479},
+  {NULL, 0},
+  {"tex", 1150},
+  {"vis", 692},
+  {"viv", 1179},
+  {"msf", 330},
+  {"mjp2", 1157},
+  {"msh", 1039},
+  {NULL, 0},
+  {"xdm", 666},
+  {"ddf", 667},
+  {NULL, 0},
+  {"ppsm", 501},
+  {"fzs", 368},
+  {"edm", 530},
+  {"eol", 868},
+};
@@ -164,6 +164,7 @@ onion_url_add_url(url, ...); // Nesting
 #include "listen_point.h"
 #include "sessions.h"
 #include "mime.h"
+#include "file_cache.h"
 #include "http.h"
 #include "https.h"
 
@@ -281,6 +282,7 @@ void onion_free(onion * onion) {
   if (onion->internal_error_handler)
     onion_handler_free(onion->internal_error_handler);
   onion_mime_set(NULL);
+  onion_file_cache_clean();
   if (onion->sessions)
     onion_sessions_free(onion->sessions);
 
@@ -728,7 +730,7 @@ void onion_set_user(onion * server, const char *username) {
   server->username = onion_low_strdup(username);
 }
 
-void onion_url_free_data(onion_url_data ** d);
+void onion_url_free_data(onion_url_routes * d);
 
 /**
  * @short If no root handler is set, creates an url handler and returns it.
@@ -908,6 +910,35 @@ void onion_set_max_file_size(onion * server, size_t max_size) {
   server->max_file_size = max_size;
 }
 
+/**
+ * @short Enables permessage-deflate compression (RFC 7692) at websockets
+ * @ingroup onion
+ *
+ * When the client offers it, onion_websocket_new accepts the extension, and messages are
+ * compressed and decompressed transparently. It is disabled by default, as each connection
+ * keeps its compression state: up to 256KB with 15 window bits.
+ *
+ * Needs zlib.
+ *
+ * @param server The onion server
+ * @param window_bits Max LZ77 window to compress, from 9 (512 bytes) to 15 (32KB). 0 disables it.
+ * @param flags OWD_SERVER_NO_CONTEXT_TAKEOVER and OWD_CLIENT_NO_CONTEXT_TAKEOVER
+ */
+void onion_set_websocket_deflate(onion * server, int window_bits, int flags) {
+#ifdef HAVE_ZLIB
+  if (window_bits && (window_bits < 9 || window_bits > 15)) {
+    ONION_ERROR("Websocket deflate window bits must be from 9 to 15, not %d",
+                window_bits);
+    return;
+  }
+  server->websocket_deflate_bits = window_bits;
+  server->websocket_deflate_flags = flags;
+#else
+  if (window_bits)
+    ONION_ERROR("Websocket deflate needs zlib support, not compiled in");
+#endif
+}
+
 /**
  * @short Sets a new sessions backend.
  *
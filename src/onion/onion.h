@@ -110,6 +110,9 @@ extern "C" {
 /// Set the maximum post FILE size
   void onion_set_max_file_size(onion * server, size_t max_size);
 
+/// Enables permessage-deflate compression at websockets
+  void onion_set_websocket_deflate(onion * server, int window_bits, int flags);
+
 /// Set a new session backend
   void onion_set_session_backend(onion * server,
                                  onion_sessions * sessions_backend);
@@ -92,10 +92,16 @@ struct onion_poller_slot_t {
 
   time_t timeout;
   time_t timeout_limit;         ///< Limit in seconds for use with time function.
+  int running;                  ///< ONION_POLLER_RUNNING, and ONION_POLLER_REARM if it must set the type again when the handler returns.
 
   onion_poller_slot *next;
 };
 
+/// A thread is at the slot handler, and sets the type at epoll when it returns.
+#define ONION_POLLER_RUNNING 1
+/// Rearmed, or an event skipped, while at the handler, so the type must be set again.
+#define ONION_POLLER_REARM 2
+
 // Max number of polls, normally just 1024 as set by `ulimit -n` (fd count).
 static const int MAX_SLOTS = 1000000;
 
@@ -212,9 +218,14 @@ void onion_poller_slot_set_shutdown(onion_poller_slot * el, void (*sd) (void *),
  * @memberof onion_poller_slot_t
  *
  * @param el Slot to modify
- * @param timeout Time in milliseconds that this file can be waiting.
+ * @param timeout Time in milliseconds that this file can be waiting. 0 or less for no timeout.
  */
 void onion_poller_slot_set_timeout(onion_poller_slot * el, int timeout) {
+  if (timeout <= 0) {
+    el->timeout = -1;
+    el->timeout_limit = INT_MAX;
+    return;
+  }
   el->timeout = timeout / 1000; // I dont have that resolution.
   el->timeout_limit = onion_time() + el->timeout;
   ONION_DEBUG0("Set timeout to %d, %d s", el->timeout_limit, el->timeout);
@@ -473,6 +484,75 @@ int onion_poller_remove(onion_poller * poller, int fd) {
   return 0;
 }
 
+/// Sets the slot type at epoll.
+static int onion_poller_slot_mod(onion_poller * poller, onion_poller_slot * el,
+                                 int type) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = type;
+  ev.data.ptr = el;
+  int e = epoll_ctl(poller->fd, EPOLL_CTL_MOD, el->fd, &ev);
+  if (e < 0)
+    ONION_ERROR("Error resetting poller, %s", strerror(errno));
+  return e;
+}
+
+/**
+ * @short Marks the slot as at its handler.
+ *
+ * @returns 1 if it was not, and this thread must call it. Else the thread at it sets the
+ * type again when it returns.
+ */
+static int onion_poller_slot_enter(onion_poller_slot * el) {
+  for (;;) {
+    int running = el->running;
+    if (!running) {
+      if (__sync_bool_compare_and_swap(&el->running, 0, ONION_POLLER_RUNNING))
+        return 1;
+    } else if (__sync_bool_compare_and_swap(&el->running, running,
+                                            running | ONION_POLLER_REARM))
+      return 0;
+  }
+}
+
+/// Sets the slot type at epoll after its handler, again if rearmed meanwhile, and marks it as not at the handler.
+static void onion_poller_slot_leave(onion_poller * poller,
+                                    onion_poller_slot * el) {
+  for (;;) {
+    if (poller->fd >= 0)
+      onion_poller_slot_mod(poller, el, el->type);
+    if (__sync_bool_compare_and_swap(&el->running, ONION_POLLER_RUNNING, 0))
+      return;
+    __sync_bool_compare_and_swap(&el->running,
+                                 ONION_POLLER_RUNNING | ONION_POLLER_REARM,
+                                 ONION_POLLER_RUNNING);
+  }
+}
+
+/**
+ * @short Applies the slot type now
+ * @memberof onion_poller_t
+ * @ingroup poller
+ *
+ * Normally the slot type is applied when its handler returns. This is for slots that are
+ * waiting at the poller, to change what they wait for from another thread.
+ *
+ * It can be called from any thread. If a thread is at the slot handler, the type is applied
+ * when it returns, and meanwhile the handler is not called from other threads.
+ *
+ * @returns 0 if ok, <0 on error.
+ */
+int onion_poller_rearm(onion_poller * poller, onion_poller_slot * el) {
+  for (;;) {
+    int running = el->running;
+    if (!running)
+      return onion_poller_slot_mod(poller, el, el->type);
+    if (__sync_bool_compare_and_swap(&el->running, running,
+                                     running | ONION_POLLER_REARM))
+      return 0;
+  }
+}
+
 /**
  * @short Gets the poller slot
  * @ingroup poller
@@ -540,6 +620,8 @@ void onion_poller_poll(onion_poller * p) {
       onion_poller_slot *el = (onion_poller_slot *) event[i].data.ptr;
       if (!el)
         continue;
+      if (!onion_poller_slot_enter(el))
+        continue;               // Rearmed while at the handler; that thread sets it again.
       // Call the callback
       //ONION_DEBUG("Calling callback for fd %d (%X %X)", el->fd, event[i].events);
       int n = -1;
@@ -565,13 +647,7 @@ void onion_poller_poll(onion_poller * p) {
         onion_poller_remove(p, el->fd);
       } else {
         ONION_DEBUG0("Re setting poller %d", el->fd);
-        event[i].events = el->type;
-        if (p->fd >= 0) {
-          int e = epoll_ctl(p->fd, EPOLL_CTL_MOD, el->fd, &event[i]);
-          if (e < 0) {
-            ONION_ERROR("Error resetting poller, %s", strerror(errno));
-          }
-        }
+        onion_poller_slot_leave(p, el);
       }
     }
 #ifdef HAVE_PTHREADS
@@ -67,6 +67,8 @@ extern "C" {
   int onion_poller_add(onion_poller * poller, onion_poller_slot * el);
 /// Gets the poller to do some modifications as change shutdown
   onion_poller_slot *onion_poller_get(onion_poller * poller, int fd);
+/// Applies the slot type now, while it waits at the poller.
+  int onion_poller_rearm(onion_poller * poller, onion_poller_slot * el);
 /// Removes a fd from the poller
   int onion_poller_remove(onion_poller * poller, int fd);
 
@@ -24,6 +24,9 @@
 #include <ev.h>
 #include <stdlib.h>
 #include <semaphore.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "poller.h"
 #include "log.h"
@@ -33,6 +36,11 @@ struct onion_poller_t {
   struct ev_loop *loop;
   sem_t sem;
   volatile int stop;
+  ev_async rearm_async;         ///< Wakes the loop to rearm the slots at rearm.
+  onion_poller_slot *rearm;     ///< Slots to rearm at the loop, as watchers can only be changed there.
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;        ///< For rearm
+#endif
 };
 
 struct onion_poller_slot_t {
@@ -45,6 +53,8 @@ struct onion_poller_slot_t {
   void *shutdown_data;
   void (*shutdown) (void *);
   onion_poller *poller;
+  onion_poller_slot *rearm_next;
+  int rearm_queued;
 };
 
 /// Create a new slot for the poller
@@ -58,10 +68,32 @@ onion_poller_slot *onion_poller_slot_new(int fd, int (*f) (void *), void *data)
   return ret;
 }
 
+static void onion_poller_lock(onion_poller * poller) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&poller->mutex);
+#endif
+}
+
+static void onion_poller_unlock(onion_poller * poller) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&poller->mutex);
+#endif
+}
+
 /// Cleans a poller slot. Do not call if already on the poller (onion_poller_add). Use onion_poller_remove instead.
 void onion_poller_slot_free(onion_poller_slot * el) {
-  if (el->poller)
+  if (el->poller) {
     ev_io_stop(el->poller->loop, &el->ev);
+    onion_poller_lock(el->poller);
+    if (el->rearm_queued) {     // Not to start it again
+      onion_poller_slot **prev = &el->poller->rearm;
+      while (*prev != el)
+        prev = &(*prev)->rearm_next;
+      *prev = el->rearm_next;
+      el->rearm_queued = 0;
+    }
+    onion_poller_unlock(el->poller);
+  }
   if (el->shutdown)
     el->shutdown(el->shutdown_data);
 }
@@ -73,9 +105,9 @@ void onion_poller_slot_set_shutdown(onion_poller_slot * el,
   el->shutdown_data = data;
 }
 
-/// Sets the timeout for this slot. Current implementation takes ms, but then it rounds to seconds.
+/// Sets the timeout for this slot, in ms. <=0 means no timeout. Timeouts are not implemented for libev.
 void onion_poller_slot_set_timeout(onion_poller_slot * el, int timeout_ms) {
-  el->timeout = timeout_ms;
+  el->timeout = timeout_ms > 0 ? timeout_ms : -1;
 }
 
 /// Sets the polling type: read/write/other. O_POLL_READ | O_POLL_WRITE | O_POLL_OTHER
@@ -87,16 +119,50 @@ void onion_poller_slot_set_type(onion_poller_slot * el, onion_poller_slot_type_e
     el->type |= EV_WRITE;
 }
 
+/// Sets the watchers of the slots at rearm to their type. Called at the loop.
+static void onion_poller_rearm_callback(struct ev_loop *loop, ev_async * w,
+                                        int revents) {
+  onion_poller *poller = w->data;
+  onion_poller_lock(poller);
+  while (poller->rearm) {
+    onion_poller_slot *el = poller->rearm;
+    poller->rearm = el->rearm_next;
+    el->rearm_next = NULL;
+    el->rearm_queued = 0;
+    ev_io_stop(loop, &el->ev);
+    ev_io_set(&el->ev, el->fd, el->type);
+    ev_io_start(loop, &el->ev);
+  }
+  onion_poller_unlock(poller);
+}
+
 /// Create a new poller
 onion_poller *onion_poller_new(int aprox_n) {
   onion_poller *ret = onion_low_calloc(1, sizeof(onion_poller));
   ret->loop = ev_default_loop(0);
   sem_init(&ret->sem, 0, 1);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&ret->mutex, NULL);
+#endif
+  {                             // ev_async_init, expanded as ev_io_init at onion_poller_add
+    ev_watcher *ew = (void *)(&ret->rearm_async);
+    ew->active = 0;
+    ew->pending = 0;
+    ew->priority = 0;
+    ret->rearm_async.cb = onion_poller_rearm_callback;
+  }
+  ev_async_set(&ret->rearm_async);
+  ret->rearm_async.data = ret;
+  ev_async_start(ret->loop, &ret->rearm_async);
   return ret;
 }
 
 /// Frees the poller. It first stops it.
 void onion_poller_free(onion_poller * p) {
+  ev_async_stop(p->loop, &p->rearm_async);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&p->mutex);
+#endif
   onion_low_free(p);
 }
 
@@ -142,6 +208,24 @@ int onion_poller_add(onion_poller * poller, onion_poller_slot * el) {
   return 1;
 }
 
+/**
+ * @short Applies the slot type now
+ *
+ * Watchers can only be changed at the loop, so it is queued and the loop is woken to do it. It
+ * can be called from any thread.
+ */
+int onion_poller_rearm(onion_poller * poller, onion_poller_slot * el) {
+  onion_poller_lock(poller);
+  if (!el->rearm_queued) {
+    el->rearm_queued = 1;
+    el->rearm_next = poller->rearm;
+    poller->rearm = el;
+  }
+  onion_poller_unlock(poller);
+  ev_async_send(poller->loop, &poller->rearm_async);
+  return 0;
+}
+
 /// Removes a fd from the poller
 int onion_poller_remove(onion_poller * poller, int fd) {
   ONION_ERROR("FIXME!! not removing fd %d", fd);
@@ -45,6 +45,7 @@ struct onion_poller_slot_t {
   int (*f) (void *);
   void *shutdown_data;
   void (*shutdown) (void *);
+  onion_poller *poller;
 };
 
 typedef struct onion_poller_slot_t onion_poller_slot;
@@ -62,8 +63,11 @@ onion_poller_slot *onion_poller_slot_new(int fd, int (*f) (void *), void *data)
 
 /// Cleans a poller slot. Do not call if already on the poller (onion_poller_add). Use onion_poller_remove instead.
 void onion_poller_slot_free(onion_poller_slot * el) {
-  if (el->ev)
+  if (el->ev) {
     event_del(el->ev);
+    event_free(el->ev);
+    el->ev = NULL;
+  }
   if (el->shutdown)
     el->shutdown(el->shutdown_data);
 }
@@ -75,13 +79,14 @@ void onion_poller_slot_set_shutdown(onion_poller_slot * el,
   el->shutdown_data = data;
 }
 
-/// Sets the timeout for this slot. Current implementation takes ms, but then it rounds to seconds.
+/// Sets the timeout for this slot, in ms. <=0 means no timeout.
 void onion_poller_slot_set_timeout(onion_poller_slot * el, int timeout_ms) {
-  el->timeout = timeout_ms;
+  el->timeout = timeout_ms > 0 ? timeout_ms : -1;
 }
 
 /// Sets the polling type: read/write/other. O_POLL_READ | O_POLL_WRITE | O_POLL_OTHER
-void onion_poller_slot_set_type(onion_poller_slot * el, int type) {
+void onion_poller_slot_set_type(onion_poller_slot * el,
+                                onion_poller_slot_type_e type) {
   el->type = EV_PERSIST;
   if (type & O_POLL_READ)
     el->type |= EV_READ;
@@ -113,9 +118,8 @@ static void event_callback(evutil_socket_t fd, short evtype, void *e) {
   }
 }
 
-/// Adds a slot to the poller
-int onion_poller_add(onion_poller * poller, onion_poller_slot * el) {
-  el->ev = event_new(poller->base, el->fd, el->type, event_callback, el);
+/// Adds the event of the slot to the loop, with its timeout if any.
+static void onion_poller_slot_add(onion_poller_slot * el) {
   if (el->timeout > 0) {
     struct timeval tv;
     tv.tv_sec = el->timeout / 1000;
@@ -124,9 +128,34 @@ int onion_poller_add(onion_poller * poller, onion_poller_slot * el) {
   } else {
     event_add(el->ev, NULL);
   }
+}
+
+/// Adds a slot to the poller
+int onion_poller_add(onion_poller * poller, onion_poller_slot * el) {
+  el->poller = poller;
+  el->ev = event_new(poller->base, el->fd, el->type, event_callback, el);
+  onion_poller_slot_add(el);
   return 1;
 }
 
+/// Sets the events of the slot to its type. Called at the loop, so never with the handler running.
+static void onion_poller_slot_reset(evutil_socket_t fd, short evtype,
+                                    void *data) {
+  onion_poller_slot *el = data;
+  if (!el->ev)                  // Freed meanwhile
+    return;
+  event_del(el->ev);
+  event_assign(el->ev, el->poller->base, el->fd, el->type, event_callback,
+               el);
+  onion_poller_slot_add(el);
+}
+
+/// Applies the slot type now. It can be called from any thread, as it is applied at the loop.
+int onion_poller_rearm(onion_poller * poller, onion_poller_slot * el) {
+  return event_base_once(poller->base, -1, EV_TIMEOUT,
+                         onion_poller_slot_reset, el, NULL);
+}
+
 /// Removes a fd from the poller
 int onion_poller_remove(onion_poller * poller, int fd) {
   ONION_ERROR("FIXME!! not removing fd %d", fd);
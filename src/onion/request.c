@@ -21,6 +21,7 @@
   <http://www.apache.org/licenses/LICENSE-2.0>.
 */
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -32,6 +33,7 @@
 #include "log.h"
 #include "sessions.h"
 #include "block.h"
+#include "codecs.h"
 #include "listen_point.h"
 #include "websocket.h"
 #include "low.h"
@@ -74,8 +76,7 @@ onion_request *onion_request_new(onion_listen_point * op) {
   req->connection.fd = -1;
 
   //req->connection=con;
-  req->headers = onion_dict_new();
-  onion_dict_set_flags(req->headers, OD_ICASE);
+  req->headers = onion_dict_new_with_flags(OD_ICASE | OD_NO_LOCK);
   ONION_DEBUG0("Create request %p", req);
 
   if (op) {
@@ -121,6 +122,9 @@ static void unlink_files(void *p, const char *key, const char *value, int flags)
 void onion_request_free(onion_request * req) {
   ONION_DEBUG0("Free request %p", req);
   onion_dict_free(req->headers);
+  onion_listen_point_request_free_pending(req);
+  if (req->websocket)           // Before closing, so hubs stop writing to the connection
+    onion_websocket_free(req->websocket);
 
   if (req->connection.listen_point != NULL
       && req->connection.listen_point->close)
@@ -139,20 +143,20 @@ void onion_request_free(onion_request * req) {
     if (onion_dict_count(req->session) == 0)
       onion_request_session_free(req);
     else {
-      onion_sessions_save(req->connection.listen_point->server->sessions,
-                          req->session_id, req->session);
+      if (onion_dict_is_changed(req->session))  // Else it is as stored
+        onion_sessions_save(req->connection.listen_point->server->sessions,
+                            req->session_id, req->session);
       onion_dict_free(req->session);    // Not really remove, just dereference
       onion_low_free(req->session_id);
     }
   }
   if (req->data)
     onion_block_free(req->data);
+  if (req->json)
+    onion_dict_free(req->json);
   if (req->connection.cli_info)
     onion_low_free(req->connection.cli_info);
 
-  if (req->websocket)
-    onion_websocket_free(req->websocket);
-
   if (req->parser_data)
     onion_request_parser_data_free(req->parser_data);
 
@@ -173,8 +177,7 @@ void onion_request_free(onion_request * req) {
 void onion_request_clean(onion_request * req) {
   ONION_DEBUG0("Clean request %p", req);
   onion_dict_free(req->headers);
-  req->headers = onion_dict_new();
-  onion_dict_set_flags(req->headers, OD_ICASE);
+  req->headers = onion_dict_new_with_flags(OD_ICASE | OD_NO_LOCK);
   req->flags &= OR_NO_KEEP_ALIVE;       // I keep keep alive.
   if (req->parser_data) {
     onion_request_parser_data_free(req->parser_data);
@@ -201,8 +204,9 @@ void onion_request_clean(onion_request * req) {
     if (onion_dict_count(req->session) == 0) {
       onion_request_session_free(req);
     } else {
-      onion_sessions_save(req->connection.listen_point->server->sessions,
-                          req->session_id, req->session);
+      if (onion_dict_is_changed(req->session))  // Else it is as stored
+        onion_sessions_save(req->connection.listen_point->server->sessions,
+                            req->session_id, req->session);
       onion_dict_free(req->session);    // Not really remove, just dereference
       req->session = NULL;
       onion_low_free(req->session_id);
@@ -213,6 +217,10 @@ void onion_request_clean(onion_request * req) {
     onion_block_free(req->data);
     req->data = NULL;
   }
+  if (req->json) {
+    onion_dict_free(req->json);
+    req->json = NULL;
+  }
   if (req->connection.cli_info) {
     onion_low_free(req->connection.cli_info);
     req->connection.cli_info = NULL;
@@ -226,6 +234,10 @@ void onion_request_clean(onion_request * req) {
     onion_ptr_list_free(req->free_list);
     req->free_list = NULL;
   }
+  req->path_params_count = 0;
+  req->path_params_in_query = 0;
+  req->query = NULL;
+  req->post_query = NULL;
 }
 
 /**
@@ -279,6 +291,138 @@ void onion_request_advance_path(onion_request * req, off_t addtopos) {
     req->path = &req->path[addtopos];
 }
 
+/// Returns the path param as a string, creating it if needed.
+static const char *onion_request_path_param_value(onion_request * req,
+                                                  struct
+                                                  onion_request_path_param_t
+                                                  *param) {
+  if (!param->value) {
+    param->value = onion_low_scalar_malloc(param->length + 1);
+    memcpy(param->value, param->start, param->length);
+    param->value[param->length] = '\0';
+    req->free_list = onion_ptr_list_add(req->free_list, param->value);
+  }
+  return param->value;
+}
+
+/**
+ * @short Gets a capture of the path, by group number, as set by the last onion_url that matched.
+ * @memberof onion_request_t
+ * @ingroup request
+ *
+ * Groups start at 1. If nested urls matched, the latest match with that group number is used,
+ * as with the "1", "2"... query values.
+ *
+ * @returns the captured string, or NULL if there is no such group.
+ */
+const char *onion_request_get_path_param_n(onion_request * req, int n) {
+  int i;
+  for (i = req->path_params_count - 1; i >= 0; i--) {
+    if (req->path_params[i].group == n)
+      return onion_request_path_param_value(req, &req->path_params[i]);
+  }
+  return NULL;
+}
+
+/**
+ * @short Gets a capture of the path, by group name or number.
+ * @memberof onion_request_t
+ * @ingroup request
+ *
+ * Named groups are set at onion_url regexps as (?<name>...). A name with only digits is the
+ * group number, as at onion_request_get_path_param_n. Captures of all nested urls that
+ * matched are available by name; if repeated, the innermost one is returned.
+ *
+ * The string is created on first use, and is valid until the request is cleaned.
+ *
+ * @returns the captured string, or NULL if there is no such group.
+ */
+const char *onion_request_get_path_param(onion_request * req, const char *name) {
+  const char *p = name;
+  while (*p >= '0' && *p <= '9')
+    p++;
+  if (p != name && !*p)
+    return onion_request_get_path_param_n(req, atoi(name));
+  int i;
+  for (i = req->path_params_count - 1; i >= 0; i--) {
+    if (req->path_params[i].name && strcmp(req->path_params[i].name, name) == 0)
+      return onion_request_path_param_value(req, &req->path_params[i]);
+  }
+  return NULL;
+}
+
+/**
+ * @short Parses the query part to a given dictionary.
+ *
+ * The data is overwriten as necessary. It is NOT dupped, so if you free this char *p, please free the tree too.
+ */
+static void onion_request_parse_query_to_dict(onion_dict * dict, char *p) {
+  ONION_DEBUG0("Query to dict %s", p);
+  while (*p) {
+    char *key = p;
+    char *end = strchr(p, '&');
+    if (end) {
+      *end = '\0';
+      p = end + 1;
+    } else
+      p = key + strlen(key);
+    char *value = strchr(key, '=');
+    if (value)
+      *value++ = '\0';
+    else if (!*key)             // Empty, as &&
+      continue;
+    onion_unquote_inplace(key);
+    if (value)
+      onion_unquote_inplace(value);
+    ONION_DEBUG0("Adding key %s=%-16s", key, value ? value : "");
+    onion_dict_add(dict, key, value ? value : "", 0);
+  }
+}
+
+/// Parses the query into GET, at first use.
+static void onion_request_parse_get(onion_request * req) {
+  if (!req->query)
+    return;
+  if (!req->GET)
+    req->GET = onion_dict_new_with_flags(OD_NO_LOCK);
+  onion_request_parse_query_to_dict(req->GET, req->query);
+  req->query = NULL;
+}
+
+/// Parses the urlencoded POST data into POST, at first use.
+static void onion_request_parse_post(onion_request * req) {
+  if (!req->post_query)
+    return;
+  if (!req->POST)
+    req->POST = onion_dict_new_with_flags(OD_NO_LOCK);
+  onion_request_parse_query_to_dict(req->POST, req->post_query);
+  req->post_query = NULL;
+}
+
+/**
+ * @short Adds the path params not yet there to the query, as "1", "2"...
+ * @memberof onion_request_t
+ * @ingroup request
+ *
+ * Older code gets url captures from the query, so they are added when the query is used.
+ */
+void onion_request_path_params_to_query(onion_request * req) {
+  onion_request_parse_get(req);
+  if (req->path_params_in_query == req->path_params_count)
+    return;
+  if (!req->GET)
+    req->GET = onion_dict_new_with_flags(OD_NO_LOCK);
+  for (; req->path_params_in_query < req->path_params_count;
+       req->path_params_in_query++) {
+    struct onion_request_path_param_t *param =
+        &req->path_params[req->path_params_in_query];
+    char tmpn[4];
+    snprintf(tmpn, sizeof(tmpn), "%d", param->group);
+    onion_dict_add(req->GET, tmpn, onion_request_path_param_value(req, param),
+                   OD_DUP_KEY | OD_REPLACE);
+  }
+}
+
 /**
  * @short Gets a header data
  * @memberof onion_request_t
@@ -292,8 +436,11 @@ const char *onion_request_get_header(onion_request * req, const char *header) {
  * @short Gets a query data
  * @memberof onion_request_t
  * @ingroup request
+ *
+ * The query is parsed at the first call to this or onion_request_get_query_dict.
  */
 const char *onion_request_get_query(onion_request * req, const char *query) {
+  onion_request_path_params_to_query(req);
   if (req->GET)
     return onion_dict_get(req->GET, query);
   return NULL;
@@ -317,8 +464,11 @@ const char *onion_request_get_queryd(onion_request * req, const char *key,
  * @short Gets a post data
  * @memberof onion_request_t
  * @ingroup request
+ *
+ * Urlencoded data is parsed at the first call to this or onion_request_get_post_dict.
  */
 const char *onion_request_get_post(onion_request * req, const char *query) {
+  onion_request_parse_post(req);
   if (req->POST)
     return onion_dict_get(req->POST, query);
   return NULL;
@@ -360,6 +510,7 @@ const onion_dict *onion_request_get_header_dict(onion_request * req) {
  * @ingroup request
  */
 const onion_dict *onion_request_get_query_dict(onion_request * req) {
+  onion_request_path_params_to_query(req);
   return req->GET;
 }
 
@@ -369,6 +520,7 @@ const onion_dict *onion_request_get_query_dict(onion_request * req) {
  * @ingroup request
  */
 const onion_dict *onion_request_get_post_dict(onion_request * req) {
+  onion_request_parse_post(req);
   return req->POST;
 }
 
@@ -440,7 +592,8 @@ void onion_request_guess_session_id(onion_request * req) {
  *
  * Session is not automatically retrieved as it is a slow operation and not used normally, only on "active" handlers.
  *
- * Returned dictionary can be freely managed (added new keys...) and this is the session data.
+ * Returned dictionary can be freely managed (added new keys...) and this is the session data. It is
+ * saved when the request is done, only if changed.
  *
  * @return session dictionary for current request.
  */
@@ -561,6 +714,24 @@ const onion_block *onion_request_get_data(onion_request * req) {
   return req->data;
 }
 
+/**
+ * @short The request data parsed as a JSON object, for example from a POST with JSON body.
+ * @memberof onion_request_t
+ * @ingroup request
+ *
+ * It is parsed at the first call, and kept for the next ones. The dict is owned by the request,
+ * use onion_dict_dup to keep it longer.
+ *
+ * @returns the dict, or NULL if there is no data or it is not a valid JSON object.
+ */
+onion_dict *onion_request_get_json(onion_request * req) {
+  if (!req->json && req->data)
+    req->json =
+        onion_dict_from_json_length(onion_block_data(req->data),
+                                    onion_block_size(req->data));
+  return req->json;
+}
+
 /**
  * @short Launches one handler for the given request
  * @ingroup request
@@ -594,6 +765,15 @@ onion_connection_status onion_request_process(onion_request * req) {
                               internal_error_handler, req, res);
   }
 
+  if (hs == OCS_WEBSOCKET) {
+    // From now on the poller calls onion_websocket_read_ready when there is data; no timeout.
+    onion_response_free(res);
+    req->websocket->polled = true;
+    if (req->connection.slot)   // Only set by the epoll poller
+      onion_poller_slot_set_timeout(req->connection.slot, 0);
+    return OCS_PROCESSED;
+  }
+
   if (hs == OCS_YIELD) {
     // Remove from the poller, and yield thread to poller. From now on it will be processed somewhere else (longpoll thread).
     onion_poller *poller =
@@ -606,6 +786,10 @@ onion_connection_status onion_request_process(onion_request * req) {
   int rs = onion_response_free(res);
   if (hs >= 0 && rs == OCS_KEEP_ALIVE)  // if keep alive, reset struct to get the new request.
     onion_request_clean(req);
+  if (req->connection.pending && hs > 0 && rs < 0) {    // Some output still pending, close when sent.
+    req->connection.pending->close = true;
+    return OCS_PROCESSED;
+  }
   return hs > 0 ? rs : hs;
 }
 
@@ -680,7 +864,7 @@ onion_dict *onion_request_get_cookies_dict(onion_request * req) {
   if (req->cookies)
     return req->cookies;
 
-  req->cookies = onion_dict_new();
+  req->cookies = onion_dict_new_with_flags(OD_NO_LOCK);
 
   const char *ccookies = onion_request_get_header(req, "Cookie");
   if (!ccookies)
@@ -114,6 +114,16 @@ extern "C" {
   const char *onion_request_get_queryd(onion_request * req, const char *key,
                                        const char *def);
 
+/// Gets a capture of the path set by onion_url, by name or number
+  const char *onion_request_get_path_param(onion_request * req,
+                                           const char *name);
+
+/// Gets a capture of the path set by onion_url, by number
+  const char *onion_request_get_path_param_n(onion_request * req, int n);
+
+/// Adds the path captures to the query, as "1", "2"...
+  void onion_request_path_params_to_query(onion_request * req);
+
 /// Gets post data
   const char *onion_request_get_post(onion_request * req, const char *query);
 
@@ -168,6 +178,9 @@ extern "C" {
 /// Returns extra request data, such as POST with non-form data, or PROPFIND. Needs the Content-Length request header.
   const onion_block *onion_request_get_data(onion_request * req);
 
+/// Returns the request data parsed as JSON. It is owned by the request.
+  onion_dict *onion_request_get_json(onion_request * req);
+
 /// Performs final touches to the request to its ready to be processed.
   void onion_request_polish(onion_request * req);
 
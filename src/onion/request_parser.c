@@ -91,7 +91,6 @@ typedef struct onion_multipart_buffer_s {
   int fd;                       /// If file, the file descriptor.
 } onion_multipart_buffer;
 
-static void onion_request_parse_query_to_dict(onion_dict * dict, char *p);
 static int onion_request_parse_query(onion_request * req);
 static onion_connection_status prepare_POST(onion_request * req);
 static onion_connection_status prepare_CONTENT_LENGTH(onion_request * req);
@@ -638,7 +637,7 @@ static onion_connection_status parse_POST_multipart_headers_key(onion_request *
 
   if (res == NEW_LINE) {
     if (!req->POST)
-      req->POST = onion_dict_new();
+      req->POST = onion_dict_new_with_flags(OD_NO_LOCK);
     ONION_DEBUG("New line");
     onion_multipart_buffer *multipart = (onion_multipart_buffer *) token->extra;
     multipart->pos = 0;
@@ -649,7 +648,7 @@ static onion_connection_status parse_POST_multipart_headers_key(onion_request *
       if (multipart->fd < 0)
         ONION_ERROR("Could not create temporal file at %s.", filename);
       if (!req->FILES)
-        req->FILES = onion_dict_new();
+        req->FILES = onion_dict_new_with_flags(OD_NO_LOCK);
       onion_dict_add(req->POST, multipart->name, multipart->filename, 0);
       onion_dict_add(req->FILES, multipart->name, filename, OD_DUP_VALUE);
       ONION_DEBUG0("Created temporal file %s", filename);
@@ -713,9 +712,8 @@ static onion_connection_status parse_POST_urlencode(onion_request * req,
   if (res <= 1000)
     return res;
 
-  req->POST = onion_dict_new();
-  onion_request_parse_query_to_dict(req->POST, token->extra);
-  token->extra = NULL;          // At query to dict, it keeps the pointer and free it when POST is freed.
+  req->post_query = token->extra;     // Parsed at first use. Freed with the request.
+  token->extra = NULL;
 
   return OCS_REQUEST_READY;
 }
@@ -841,9 +839,6 @@ static onion_connection_status parse_headers_VERSION(onion_request * req,
   if (strcmp(token->str, "HTTP/1.1") == 0)
     req->flags |= OR_HTTP11;
 
-  if (!req->GET)
-    req->GET = onion_dict_new();
-
   if (res == STRING) {
     req->parser = parse_headers_KEY_skip_NL;
     return parse_headers_KEY_skip_NL(req, data);
@@ -935,84 +930,23 @@ onion_connection_status onion_request_write(onion_request * req,
 }
 
 /**
- * @short Parses the query to unquote the path and get the query.
+ * @short Unquotes the path, and keeps the query for later.
+ *
+ * The query is only parsed into GET when used, as many handlers never check it.
  */
 static int onion_request_parse_query(onion_request * req) {
   if (!req->fullpath)
     return 0;
-  if (req->GET)                 // already done
-    return 1;
-
-  char *p = req->fullpath;
-  char have_query = 0;
-  while (*p) {
-    if (*p == '?') {
-      have_query = 1;
-      break;
-    }
-    p++;
+
+  char *p = strchr(req->fullpath, '?');
+  if (p) {
+    *p = '\0';
+    req->query = p + 1;
   }
-  *p = '\0';
   onion_unquote_inplace(req->fullpath);
-  if (have_query) {             // There are querys.
-    p++;
-    req->GET = onion_dict_new();
-    onion_request_parse_query_to_dict(req->GET, p);
-  }
   return 1;
 }
 
-/**
- * @short Parses the query part to a given dictionary.
- *
- * The data is overwriten as necessary. It is NOT dupped, so if you free this char *p, please free the tree too.
- */
-static void onion_request_parse_query_to_dict(onion_dict * dict, char *p) {
-  ONION_DEBUG0("Query to dict %s", p);
-  char *key = NULL, *value = NULL;
-  int state = 0;                // 0 key, 1 value
-  key = p;
-  while (*p) {
-    if (state == 0) {
-      if (*p == '=') {
-        *p = '\0';
-        value = p + 1;
-        state = 1;
-      } else if (*p == '&') {
-        *p = '\0';
-        onion_unquote_inplace(key);
-        ONION_DEBUG0("Adding key %s", key);
-        onion_dict_add(dict, key, "", 0);
-        key = p + 1;
-        state = 0;
-      }
-    } else {
-      if (*p == '&') {
-        *p = '\0';
-        onion_unquote_inplace(key);
-        onion_unquote_inplace(value);
-        ONION_DEBUG0("Adding key %s=%-16s", key, value);
-        onion_dict_add(dict, key, value, 0);
-        key = p + 1;
-        state = 0;
-      }
-    }
-    p++;
-  }
-  if (state == 0) {
-    if (key[0] != '\0') {
-      onion_unquote_inplace(key);
-      ONION_DEBUG0("Adding key %s", key);
-      onion_dict_add(dict, key, "", 0);
-    }
-  } else {
-    onion_unquote_inplace(key);
-    onion_unquote_inplace(value);
-    ONION_DEBUG0("Adding key %s=%-16s", key, value);
-    onion_dict_add(dict, key, value, 0);
-  }
-}
-
 /**
  * @short Prepares the POST
  */
@@ -1103,7 +1037,7 @@ static onion_connection_status prepare_CONTENT_LENGTH(onion_request * req) {
     return OCS_INTERNAL_ERROR;
   }
 
-  req->data = onion_block_new();
+  req->data = onion_block_new_segmented();     // Grows as data arrives, with no reallocs
 
   assert(token->extra == NULL);
   //token->extra=NULL; // Should be already null, as should have no data.
@@ -1145,7 +1079,7 @@ static onion_connection_status prepare_PUT(onion_request * req) {
                token->extra_size);
 
   if (!req->FILES) {
-    req->FILES = onion_dict_new();
+    req->FILES = onion_dict_new_with_flags(OD_NO_LOCK);
   }
   {
     const char *filename = onion_block_data(req->data);
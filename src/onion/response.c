@@ -40,11 +40,13 @@
 #include "types_internal.h"
 #include "log.h"
 #include "codecs.h"
+#include "block.h"
 #include "low.h"
 
 /// @defgroup response Response. Write response data to client: headers, content body...
 
 const char *onion_response_code_description(int code);
+static int onion_response_flush_buffer(onion_response * res);
 
 // DONT_USE_DATE_HEADER is not defined anywhere, but here just in case needed in the future.
 
@@ -82,7 +84,7 @@ onion_response *onion_response_new(onion_request * req) {
   onion_response *res = onion_low_malloc(sizeof(onion_response));
 
   res->request = req;
-  res->headers = onion_dict_new();
+  res->headers = onion_dict_new_with_flags(OD_NO_LOCK);
   res->code = 200;              // The most normal code, so no need to overwrite it in other codes.
   res->flags = 0;
   res->sent_bytes_total = res->length = res->sent_bytes = 0;
@@ -165,12 +167,14 @@ onion_connection_status onion_response_free(onion_response * res) {
   if (!(res->flags & OR_HEADER_SENT))
     onion_response_write_headers(res);
 
-  onion_response_flush(res);
+  onion_response_flush_buffer(res);
   onion_request *req = res->request;
 
   if (res->flags & OR_CHUNKED) {        // Set the chunked data end.
     req->connection.listen_point->write(req, "0\r\n\r\n", 5);
   }
+  if (req && req->connection.listen_point->flush)
+    req->connection.listen_point->flush(req);
 
   int r = OCS_CLOSE_CONNECTION;
 
@@ -178,9 +182,10 @@ onion_connection_status onion_response_free(onion_response * res) {
   if (req) {
     // keep alive only on HTTP/1.1.
     ONION_DEBUG0
-        ("keep alive [req wants] %d && ([skip] %d || [lenght ok] %d==%d || [chunked] %d)",
+        ("keep alive [req wants] %d && ([skip] %d || [lenght ok] %lu==%lu || [chunked] %d)",
          onion_request_keep_alive(req), res->flags & OR_SKIP_CONTENT,
-         res->length, res->sent_bytes, res->flags & OR_CHUNKED);
+         (unsigned long)res->length, (unsigned long)res->sent_bytes,
+         res->flags & OR_CHUNKED);
     if (onion_request_keep_alive(req)
         && (res->flags & OR_SKIP_CONTENT || res->length == res->sent_bytes
             || res->flags & OR_CHUNKED)
@@ -189,10 +194,11 @@ onion_connection_status onion_response_free(onion_response * res) {
 
     if ((onion_log_flags & OF_NOINFO) != OF_NOINFO)
       // FIXME! This is no proper logging at all. Maybe use a handler.
-      ONION_INFO("[%s] \"%s %s\" %d %d (%s)",
+      ONION_INFO("[%s] \"%s %s\" %d %lu (%s)",
                  onion_request_get_client_description(res->request),
                  onion_request_methods[res->request->flags & OR_METHODS],
-                 res->request->fullpath, res->code, res->sent_bytes,
+                 res->request->fullpath, res->code,
+                 (unsigned long)res->sent_bytes,
                  (r == OCS_KEEP_ALIVE) ? "Keep-Alive" : "Close connection");
   }
 
@@ -224,7 +230,7 @@ void onion_response_set_length(onion_response * res, size_t len) {
         ("Trying to set length after headers sent. Undefined onion behaviour.");
     return;
   }
-  char tmp[16];
+  char tmp[24];
   sprintf(tmp, "%lu", (unsigned long)len);
   onion_response_set_header(res, "Content-Length", tmp);
   res->length = len;
@@ -324,18 +330,66 @@ int onion_response_write_headers(onion_response * res) {
   res->sent_bytes = -res->buffer_pos;   // the header size is not counted here. It will add again so start negative.
 
   if ((res->request->flags & OR_METHODS) == OR_HEAD) {
-    onion_response_flush(res);
+    onion_response_flush_buffer(res);
     res->flags |= OR_SKIP_CONTENT;
     return OR_SKIP_CONTENT;
   }
   if (chunked) {
-    onion_response_flush(res);
+    onion_response_flush_buffer(res);
     res->flags |= OR_CHUNKED;
   }
 
   return 0;
 }
 
+/**
+ * @short Writes big data straight to the connection, without copying it to the buffer.
+ * @memberof onion_response_t
+ * @ingroup response
+ *
+ * Data bigger than the buffer would be copied and written in buffer size pieces, so instead
+ * the buffered data is flushed, and this data is written as is, in one chunk if chunked.
+ */
+static ssize_t onion_response_write_unbuffered(onion_response * res,
+                                               const char *data,
+                                               size_t length) {
+  if (!(res->flags & OR_HEADER_SENT))
+    onion_response_write_headers(res);
+  if (onion_response_flush_buffer(res) < 0)
+    return OCS_CLOSE_CONNECTION;
+  if (res->flags & OR_SKIP_CONTENT)
+    return OCS_CLOSE_CONNECTION;
+
+  onion_request *req = res->request;
+  ssize_t(*write) (onion_request *, const char *data, size_t len);
+  write = req->connection.listen_point->write;
+
+  if (res->flags & OR_CHUNKED) {
+    char tmp[24];
+    snprintf(tmp, sizeof(tmp), "%lX\r\n", (unsigned long)length);
+    if (write(req, tmp, strlen(tmp)) <= 0) {
+      ONION_WARNING("Error writing chunk encoding length (%s). Aborting write.",
+                    strerror(errno));
+      return OCS_CLOSE_CONNECTION;
+    }
+  }
+  size_t pos = 0;
+  while (pos < length) {
+    ssize_t w = write(req, data + pos, length - pos);
+    if (w <= 0) {
+      ONION_ERROR("Error writing %lu bytes (%s). Maybe closed connection.",
+                  (unsigned long)(length - pos), strerror(errno));
+      break;
+    }
+    pos += w;
+  }
+  if ((res->flags & OR_CHUNKED) && pos == length)
+    write(req, "\r\n", 2);
+  res->sent_bytes += pos;
+  res->sent_bytes_total += pos;
+  return pos;
+}
+
 /**
  * @short Write some response data.
  * @memberof onion_response_t
@@ -347,7 +401,8 @@ int onion_response_write_headers(onion_response * res) {
  *
  * Also it does some buffering, so data is not sent as written by code, but only in chunks.
  * These chunks are when the response is finished, or when the internal buffer is full. This
- * helps performance, and eases the programming on the user side.
+ * helps performance, and eases the programming on the user side. Data bigger than the buffer
+ * is written directly, without the copy.
  *
  * If length is 0, forces the write of pending data.
  *
@@ -368,14 +423,17 @@ ssize_t onion_response_write(onion_response * res, const char *data,
   }
   //ONION_DEBUG0("Write %d bytes [%d total] (%p)", length, res->sent_bytes, res);
 
-  int l = length;
-  int w = 0;
+  if (length >= sizeof(res->buffer))
+    return onion_response_write_unbuffered(res, data, length);
+
+  size_t l = length;
+  ssize_t w = 0;
   while (res->buffer_pos + l > sizeof(res->buffer)) {
-    int wb = sizeof(res->buffer) - res->buffer_pos;
+    size_t wb = sizeof(res->buffer) - res->buffer_pos;
     memcpy(&res->buffer[res->buffer_pos], data, wb);
 
     res->buffer_pos = sizeof(res->buffer);
-    if (onion_response_flush(res) < 0)
+    if (onion_response_flush_buffer(res) < 0)
       return w;
 
     l -= wb;
@@ -390,6 +448,74 @@ ssize_t onion_response_write(onion_response * res, const char *data,
   return w;
 }
 
+/// Max iovecs per writev at onion_response_write_block.
+#define ONION_RESPONSE_IOV_MAX 64
+
+/**
+ * @short Writes the block data to the response.
+ * @memberof onion_response_t
+ * @ingroup response
+ *
+ * Small blocks are buffered as with onion_response_write. Big ones are written directly from
+ * the block memory, with writev if the listen point supports it; for segmented blocks that is
+ * all the chunks in a few calls and no copies.
+ *
+ * @returns the bytes written, or <0 on error.
+ */
+ssize_t onion_response_write_block(onion_response * res,
+                                   const onion_block * block) {
+  onion_request *req = res->request;
+  ssize_t(*writev) (onion_request *, const struct iovec *, int) =
+      req->connection.listen_point->writev;
+  size_t length = onion_block_size(block);
+  struct iovec iov[ONION_RESPONSE_IOV_MAX];
+  size_t pos = 0;
+  int n;
+
+  if (length < sizeof(res->buffer) || !writev
+      || (res->flags & OR_SKIP_CONTENT)) {
+    while ((n = onion_block_iovec(block, pos, iov, ONION_RESPONSE_IOV_MAX))) {
+      int i;
+      for (i = 0; i < n; i++) {
+        ssize_t w = onion_response_write(res, iov[i].iov_base, iov[i].iov_len);
+        if (w < 0)
+          return w;
+        pos += iov[i].iov_len;
+      }
+    }
+    return pos;
+  }
+
+  if (!(res->flags & OR_HEADER_SENT))
+    onion_response_write_headers(res);
+  if (onion_response_flush_buffer(res) < 0)
+    return OCS_CLOSE_CONNECTION;
+
+  if (res->flags & OR_CHUNKED) {
+    char tmp[24];
+    snprintf(tmp, sizeof(tmp), "%lX\r\n", (unsigned long)length);
+    if (req->connection.listen_point->write(req, tmp, strlen(tmp)) <= 0) {
+      ONION_WARNING("Error writing chunk encoding length (%s). Aborting write.",
+                    strerror(errno));
+      return OCS_CLOSE_CONNECTION;
+    }
+  }
+  while ((n = onion_block_iovec(block, pos, iov, ONION_RESPONSE_IOV_MAX))) {
+    ssize_t w = writev(req, iov, n);
+    if (w <= 0) {
+      ONION_ERROR("Error writing %lu bytes (%s). Maybe closed connection.",
+                  (unsigned long)(length - pos), strerror(errno));
+      break;
+    }
+    pos += w;
+  }
+  if ((res->flags & OR_CHUNKED) && pos == length)
+    req->connection.listen_point->write(req, "\r\n", 2);
+  res->sent_bytes += pos;
+  res->sent_bytes_total += pos;
+  return pos;
+}
+
 /**
  * @short Writes all buffered output waiting for sending.
  * @ingroup response
@@ -398,8 +524,40 @@ ssize_t onion_response_write(onion_response * res, const char *data,
  * way header can use the buffer_size information to send the proper content-length, even when it
  * wasnt properly set by programmer. Whith this information its possib to keep alive the connection
  * on more cases.
+ *
+ * Listen points that gather writes, as HTTPS, are asked to send them too, so all written
+ * until now gets to the client.
  */
 int onion_response_flush(onion_response * res) {
+  int r = onion_response_flush_buffer(res);
+  onion_request *req = res->request;
+  if (r == 0 && req->connection.listen_point->flush)
+    r = req->connection.listen_point->flush(req);
+  return r < 0 ? OCS_CLOSE_CONNECTION : r;
+}
+
+/// Writes all the iovecs. Returns 0 if all written, <0 on error.
+static int onion_response_writev_all(onion_request * req, struct iovec *iov,
+                                     int n) {
+  while (n) {
+    ssize_t w = req->connection.listen_point->writev(req, iov, n);
+    if (w <= 0)
+      return -1;
+    while (n && w >= iov->iov_len) {
+      w -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n) {
+      iov->iov_base = (char *)iov->iov_base + w;
+      iov->iov_len -= w;
+    }
+  }
+  return 0;
+}
+
+/// Writes the buffer to the listen point, which may still keep it to send in bigger pieces.
+static int onion_response_flush_buffer(onion_response * res) {
   res->sent_bytes += res->buffer_pos;
   res->sent_bytes_total += res->buffer_pos;
   if (res->buffer_pos == 0)     // Not used.
@@ -427,6 +585,22 @@ int onion_response_flush(onion_response * res) {
   ssize_t w;
   off_t pos = 0;
   //ONION_DEBUG0("Write %d bytes",res->buffer_pos);
+  if ((res->flags & OR_CHUNKED) && req->connection.listen_point->writev) {
+    // Chunk length, data and end at once.
+    char tmp[16];
+    snprintf(tmp, sizeof(tmp), "%X\r\n", (unsigned int)res->buffer_pos);
+    struct iovec iov[3] = {
+      {tmp, strlen(tmp)},
+      {res->buffer, res->buffer_pos},
+      {(char *)"\r\n", 2}
+    };
+    int r = onion_response_writev_all(req, iov, 3);
+    if (r < 0)
+      ONION_ERROR("Error writing %d bytes (%s). Maybe closed connection.",
+                  res->buffer_pos, strerror(errno));
+    res->buffer_pos = 0;
+    return r < 0 ? OCS_CLOSE_CONNECTION : 0;
+  }
   if (res->flags & OR_CHUNKED) {
     char tmp[16];
     snprintf(tmp, sizeof(tmp), "%X\r\n", (unsigned int)res->buffer_pos);
@@ -474,13 +648,25 @@ ssize_t onion_response_write0(onion_response * res, const char *data) {
  * The encoding mens that <code><html> whould become &lt;html&gt;</code>
  */
 ssize_t onion_response_write_html_safe(onion_response * res, const char *data) {
-  char *tmp = onion_html_quote(data);
-  if (tmp) {
-    int r = onion_response_write0(res, tmp);
-    onion_low_free(tmp);
-    return r;
-  } else
-    return onion_response_write0(res, data);
+  ssize_t ret = 0;
+  for (;;) {                    // Safe runs as they are, and the entity for each unsafe char
+    const char *next = onion_html_find_unsafe(data);
+    if (next != data) {
+      ssize_t w = onion_response_write(res, data, next - data);
+      if (w < 0)
+        return w;
+      ret += w;
+    }
+    if (!*next)
+      return ret;
+    char entity[8];
+    ssize_t w = onion_response_write(res, entity,
+                                     onion_html_add_enc(*next, entity) - entity);
+    if (w < 0)
+      return w;
+    ret += w;
+    data = next + 1;
+  }
 }
 
 /**
@@ -127,6 +127,9 @@ extern "C" {
 /// Writes some data to the response
   ssize_t onion_response_write(onion_response * res, const char *data,
                                size_t length);
+/// Writes the block data to the response, with no copies if it is big.
+  ssize_t onion_response_write_block(onion_response * res,
+                                     const onion_block * block);
 /// Writes some data to the response. \0 ended string
   ssize_t onion_response_write0(onion_response * res, const char *data);
 /// Writes some data to the response. \0 ended string, and encodes it if necesary into html entities to make it safe
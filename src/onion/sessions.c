@@ -104,12 +104,12 @@ char *onion_sessions_create(onion_sessions * sessions) {
  * @memberof onion_sessions_t
  * @ingroup sessions
  *
- * It returns a dupped (ref counter ++) version of the dict. All modifications are straight here, but user
- * (normally onion_request) must dereference it.. as it really do.
+ * It returns a copy of the session for the caller, that must free it. On the memory backend it is a
+ * snapshot (onion_dict_snapshot) that shares the memory with the stored one until changed, so getting
+ * it costs the same whatever its size, and changes are not seen by others until saved with
+ * onion_sessions_save. onion_request only saves it if it changed (onion_dict_is_changed).
  *
- * This is this way to prevent a thread removing the dict, whilst others are using it. to really remove the
- * dict, call onion_sessions_remove, which will remove the reference here, which is the only
- * one which should stay across thread lifetimes.
+ * To really remove the session, call onion_sessions_remove.
  *
  * The sessionId is the session as asked by the client. If it does not exist it returns NULL, and
  * onion_sessions_create has to be used. It used to reuse the sessionId if it doe snot exist, but that
@@ -137,7 +137,8 @@ void onion_sessions_remove(onion_sessions * sessions, const char *sessionId) {
  * @short Ensures the content of the dict is saved to that session
  * @ingroup sessions
  *
- * On memory backend does nothing, on other backends may do the marshalling.
+ * On memory backend it stores a snapshot, so following changes to data are not saved until saved again;
+ * on other backends may do the marshalling.
  */
 void onion_sessions_save(onion_sessions * sessions, const char *sessionId,
                          onion_dict * data) {
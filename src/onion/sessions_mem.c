@@ -35,25 +35,25 @@ char *last_data = NULL;
 static onion_dict *onion_sessions_mem_get(onion_sessions * sessions,
                                           const char *session_id) {
   ONION_DEBUG0("Accessing session '%s'", session_id);
+  onion_dict_lock_read(sessions->data);
   onion_dict *sess = onion_dict_get_dict(sessions->data, session_id);
-  if (!sess) {
+  if (sess)                     // Stored ones are snapshots too, so this does not change it
+    sess = onion_dict_snapshot(sess);
+  onion_dict_unlock(sessions->data);
+  if (!sess)
     ONION_DEBUG0("Unknown session '%s'.", session_id);
-    return NULL;
-  }
-  return onion_dict_dup(sess);
+  return sess;
 }
 
 static void onion_sessions_mem_save(onion_sessions * sessions,
                                     const char *session_id, onion_dict * data) {
-  if (data == NULL) {
-    data = onion_dict_get_dict(sessions->data, session_id);
-    if (data) {
-      onion_dict_remove(sessions->data, session_id);
-    }
-    return;
-  }
-  onion_dict_add(sessions->data, session_id, onion_dict_dup(data),
-                 OD_DUP_KEY | OD_FREE_VALUE | OD_DICT | OD_REPLACE);
+  onion_dict_lock_write(sessions->data);
+  if (data == NULL)
+    onion_dict_remove(sessions->data, session_id);
+  else
+    onion_dict_add(sessions->data, session_id, onion_dict_snapshot(data),
+                   OD_DUP_KEY | OD_FREE_VALUE | OD_DICT | OD_REPLACE);
+  onion_dict_unlock(sessions->data);
 }
 
 static void onion_sessions_mem_free(onion_sessions * sessions) {
@@ -73,7 +73,8 @@ onion_sessions *onion_sessions_mem_new() {
   onion_random_init();
 
   onion_sessions *ret = onion_low_malloc(sizeof(onion_sessions));
-  ret->data = onion_dict_new();
+  // Many sessions looked up by id, by many threads at the same time
+  ret->data = onion_dict_new_with_flags(OD_RCU);
 
   ret->get = onion_sessions_mem_get;
   ret->save = onion_sessions_mem_save;
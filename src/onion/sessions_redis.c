@@ -90,7 +90,7 @@ static onion_dict *onion_sessions_redis_get(onion_sessions * sessions,
         freeReplyObject(reply);
         goto exit;
       } else {
-        ret = onion_dict_from_json(reply->str);
+        ret = onion_dict_from_json_length(reply->str, reply->len);
         freeReplyObject(reply);
         goto exit;
       }
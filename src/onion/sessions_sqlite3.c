@@ -87,7 +87,7 @@ static onion_dict *onion_sessions_sqlite3_get(onion_sessions * sessions,
   const char *text;
   text = (const char *)sqlite3_column_text(p->get, 0);
 
-  ret = onion_dict_from_json(text);
+  ret = onion_dict_from_json_length(text, sqlite3_column_bytes(p->get, 0));
   if (!ret) {
     ONION_DEBUG0("Invalid session parsing for id %s: %s", session_id, text);
     ONION_ERROR("Invalid session data");
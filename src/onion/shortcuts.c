@@ -22,6 +22,9 @@
 */
 
 #ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             /* splice */
+#endif
 #define USE_SENDFILE
 #endif
 
@@ -36,6 +39,7 @@
 #include <errno.h>
 #ifdef USE_SENDFILE
 #include <sys/sendfile.h>
+#include <poll.h>
 #endif
 
 #include "onion.h"
@@ -43,7 +47,10 @@
 #include "shortcuts.h"
 #include "dict.h"
 #include "block.h"
+#include "json.h"
 #include "mime.h"
+#include "file_cache.h"
+#include "listen_point.h"
 #include "types_internal.h"
 #include "low.h"
 
@@ -59,6 +66,11 @@ int onion_use_sendfile = -1;
 // Import it here as I need it to know if can use sendfile.
 ssize_t onion_http_write(onion_request * req, const char *data, size_t len);
 
+/// Max bytes for each sendfile/splice call, so that big files are sent in bounded slices.
+#define ONION_SENDFILE_SLICE (1024 * 1024)
+/// Size of the chunks when the file is copied through the listen point write.
+#define ONION_SHORTCUT_FILE_CHUNK (16 * 1024)
+
 /**
  * @short Shortcut for fast responses, like errors.
  * @ingroup shortcuts
@@ -131,12 +143,125 @@ onion_connection_status onion_shortcut_redirect(const char *newurl,
 onion_connection_status onion_shortcut_internal_redirect(const char *newurl,
                                                          onion_request * req,
                                                          onion_response * res) {
+  onion_request_get_query_dict(req);   // Query and captures point into the old path
+  req->path_params_count = req->path_params_in_query = 0;
   onion_low_free(req->fullpath);
   req->fullpath = req->path = onion_low_strdup(newurl);
   return onion_handler_handle(req->connection.listen_point->server->
                               root_handler, req, res);
 }
 
+#ifdef USE_SENDFILE
+/// State of a file being sent with sendfile or splice. May wait at the connection until writable.
+typedef struct onion_shortcut_file_transfer_t {
+  int sock;
+  onion_file_cache_entry *entry;
+  off_t offset;                 ///< Next file position to send
+  size_t left;                  ///< Bytes still to read from the file
+  int pipe[2];                  ///< When using splice, the pipe between file and socket. Else -1.
+  size_t piped;                 ///< Bytes at the pipe, not yet on the socket.
+  int socket_flags;             ///< Original socket flags, restored when finished.
+} onion_shortcut_file_transfer;
+
+/// Creates the transfer and sets the socket as non blocking. Takes ownership of the entry.
+static onion_shortcut_file_transfer *shortcut_file_transfer_new(int sock,
+                                                                onion_file_cache_entry
+                                                                * entry,
+                                                                off_t offset,
+                                                                size_t length) {
+  onion_shortcut_file_transfer *t =
+      onion_low_malloc(sizeof(onion_shortcut_file_transfer));
+  t->sock = sock;
+  t->entry = entry;
+  t->offset = offset;
+  t->left = length;
+  t->pipe[0] = t->pipe[1] = -1;
+  t->piped = 0;
+  t->socket_flags = fcntl(sock, F_GETFL);
+  if (t->socket_flags >= 0)
+    fcntl(sock, F_SETFL, t->socket_flags | O_NONBLOCK);
+  return t;
+}
+
+static void shortcut_file_transfer_free(onion_shortcut_file_transfer * t) {
+  if (t->socket_flags >= 0)
+    fcntl(t->sock, F_SETFL, t->socket_flags);
+  if (t->pipe[0] >= 0) {
+    close(t->pipe[0]);
+    close(t->pipe[1]);
+  }
+  onion_file_cache_entry_free(t->entry);
+  onion_low_free(t);
+}
+
+/**
+ * @short Sends as much of the file as possible without blocking.
+ *
+ * Uses sendfile in slices of ONION_SENDFILE_SLICE, so any file size can be sent. If the
+ * kernel does not allow sendfile for this file, it is spliced through a pipe.
+ *
+ * @returns 0 when all is sent, 1 if the socket would block, <0 on error.
+ */
+static int shortcut_file_transfer_send(onion_shortcut_file_transfer * t) {
+  int fd = onion_file_cache_entry_fd(t->entry);
+  while (t->left || t->piped) {
+    size_t n = t->left < ONION_SENDFILE_SLICE ? t->left : ONION_SENDFILE_SLICE;
+    ssize_t w;
+    if (t->pipe[0] < 0) {
+      w = sendfile(t->sock, fd, &t->offset, n);
+      if (w < 0 && (errno == EINVAL || errno == ENOSYS)) {
+        ONION_DEBUG("No sendfile for this file, using splice");
+        if (pipe(t->pipe) < 0) {
+          ONION_ERROR("Could not create pipe for splice (%s)", strerror(errno));
+          t->pipe[0] = t->pipe[1] = -1;
+          return -1;
+        }
+        continue;
+      }
+      if (w > 0)
+        t->left -= w;
+    } else {
+      if (!t->piped) {
+        w = splice(fd, &t->offset, t->pipe[1], NULL, n,
+                   SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (w < 0 && errno == EINTR)
+          continue;
+        if (w <= 0) {
+          ONION_ERROR("Error reading file to send (%s)",
+                      w == 0 ? "unexpected end of file" : strerror(errno));
+          return -1;
+        }
+        t->piped = w;
+        t->left -= w;
+      }
+      w = splice(t->pipe[0], NULL, t->sock, NULL, t->piped,
+                 SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (w > 0)
+        t->piped -= w;
+    }
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return 1;
+      ONION_ERROR("Could not send all file (%s)", strerror(errno));
+      return -1;
+    }
+    if (w == 0) {
+      ONION_ERROR("File shrinked while sending, %lu bytes missing",
+                  (unsigned long)t->left);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/// Connection is writable again. Continue sending.
+static int shortcut_file_transfer_resume(onion_request * req, void *t) {
+  return shortcut_file_transfer_send(t);
+}
+#endif
+
 /**
  * @short This shortcut returns the given file contents.
  * @ingroup shortcuts
@@ -144,6 +269,13 @@ onion_connection_status onion_shortcut_internal_redirect(const char *newurl,
  * This is the recomended way to send static files; it even can use sendfile Linux call
  * if suitable.
  *
+ * The open file descriptor, stat data, etag and mime type are kept at the file cache
+ * between requests, so hot files do not need an open and stat each time. See onion_file_cache_get.
+ *
+ * With sendfile the socket is set non blocking. If the client is slow and the socket buffer
+ * fills, the rest of the file is sent by the poller when the socket is writable again, and
+ * this thread is free to attend other requests.
+ *
  * It does no security checks, so caller must be security aware.
  */
 onion_connection_status onion_shortcut_response_file(const char *filename,
@@ -159,42 +291,20 @@ onion_connection_status onion_shortcut_response_file(const char *filename,
   }
   int use_sendfile = onion_use_sendfile;        // Now that we know global, use some local info as well.
 
-  int fd = open(filename, O_RDONLY | O_CLOEXEC);
-
-  if (fd < 0)
-    return OCS_NOT_PROCESSED;
-
-  if (O_CLOEXEC == 0) {         // Good compiler know how to cut this out
-    int flags = fcntl(fd, F_GETFD);
-    if (flags == -1) {
-      ONION_ERROR("Retrieving flags from file descriptor");
-    }
-    flags |= FD_CLOEXEC;
-    if (fcntl(fd, F_SETFD, flags) == -1) {
-      ONION_ERROR("Setting O_CLOEXEC to file descriptor");
-    }
-  }
-
-  struct stat st;
-  if (stat(filename, &st) != 0) {
-    ONION_WARNING("File does not exist: %s", filename);
-    close(fd);
+  onion_file_cache_entry *entry = onion_file_cache_get(filename);
+  if (!entry)
     return OCS_NOT_PROCESSED;
-  }
+  int fd = onion_file_cache_entry_fd(entry);
+  const struct stat *st = onion_file_cache_entry_stat(entry);
 
-  if (S_ISDIR(st.st_mode)) {
-    close(fd);
-    return OCS_NOT_PROCESSED;
-  }
-
-  size_t length = st.st_size;
+  size_t length = st->st_size;
+  off_t offset = 0;
   if (length < (1024 * 16))     // No sendfile for small files
     use_sendfile = 0;
-  if (length > 0x7ffff000) // ~2GB
-    use_sendfile = 0; // - a documented limitation for sendfile() command
 
   char etag[64];
-  onion_shortcut_etag(&st, etag);
+  strncpy(etag, onion_file_cache_entry_etag(entry), sizeof(etag) - 1);
+  etag[sizeof(etag) - 1] = '\0';
 
   const char *range = onion_request_get_header(request, "Range");
   if (range) {
@@ -207,7 +317,7 @@ onion_connection_status onion_shortcut_response_file(const char *filename,
     //ONION_DEBUG("Need just a range: %s",range);
     char tmp[1024];
     if (strlen(range + 6) >= sizeof(tmp)) {
-      close(fd);
+      onion_file_cache_entry_free(entry);
       return OCS_INTERNAL_ERROR;        // Bad specified range. Very bad indeed.
     }
     strncpy(tmp, range + 6, sizeof(tmp) - 1);
@@ -220,33 +330,36 @@ onion_connection_status onion_shortcut_response_file(const char *filename,
       end++;
 
       //ONION_DEBUG("Start %s, end %s",start,end);
-      size_t ends, starts;
+      long long ends, starts;
       if (*end)
-        ends = atol(end);
+        ends = strtoll(end, NULL, 10);
       else
-        ends = length - 1;
-      starts = atol(start);
-      if (starts > ends || starts > length) {
+        ends = (long long)length - 1;
+      if (ends >= (long long)length)
+        ends = (long long)length - 1;
+      starts = strtoll(start, NULL, 10);
+      if (starts > ends || starts < 0) {
         ONION_DEBUG0("Range not satisfiable");
-        snprintf(tmp, sizeof(tmp), "bytes */%d", (unsigned int)length);
+        snprintf(tmp, sizeof(tmp), "bytes */%lld", (long long)length);
         onion_response_set_header(res, "Content-Range", tmp);
         onion_response_set_code(res, HTTP_RANGE_NOT_SATISFIABLE);
         onion_response_write_headers(res);
-        close(fd);
+        onion_file_cache_entry_free(entry);
         return OCS_PROCESSED;
       }
       length = ends - starts + 1;
-      lseek(fd, starts, SEEK_SET);
-      snprintf(tmp, sizeof(tmp), "bytes %d-%d/%d", (unsigned int)starts,
-               (unsigned int)ends, (unsigned int)st.st_size);
+      offset = starts;
+      snprintf(tmp, sizeof(tmp), "bytes %lld-%lld/%lld", starts, ends,
+               (long long)st->st_size);
       //onion_response_set_header(res, "Accept-Ranges","bytes");
       onion_response_set_header(res, "Content-Range", tmp);
     }
   }
 
   onion_response_set_length(res, length);
-  onion_response_set_header(res, "Content-Type", onion_mime_get(filename));
-  ONION_DEBUG("Mime type is %s", onion_mime_get(filename));
+  onion_response_set_header(res, "Content-Type",
+                            onion_file_cache_entry_mime(entry));
+  ONION_DEBUG0("Mime type is %s", onion_file_cache_entry_mime(entry));
 
   ONION_DEBUG0("Etag %s", etag);
   const char *prev_etag = onion_request_get_header(request, "If-None-Match");
@@ -255,7 +368,7 @@ onion_connection_status onion_shortcut_response_file(const char *filename,
     onion_response_set_length(res, 0);
     onion_response_set_code(res, HTTP_NOT_MODIFIED);
     onion_response_write_headers(res);
-    close(fd);
+    onion_file_cache_entry_free(entry);
     return OCS_PROCESSED;
   }
   onion_response_write_headers(res);
@@ -265,53 +378,65 @@ onion_connection_status onion_shortcut_response_file(const char *filename,
 
   if (length) {
 #ifdef USE_SENDFILE
-    if (use_sendfile && request->connection.listen_point->write == (void *)onion_http_write) {  // Lets have a house party! I can use sendfile!
+    if (use_sendfile && (request->connection.listen_point->write == (void *)onion_http_write || request->connection.fd_plaintext)) {  // Lets have a house party! I can use sendfile!
       onion_response_write(res, NULL, 0);
       ONION_DEBUG("Using sendfile");
-      int r = sendfile(request->connection.fd, fd, NULL, length);
-      ONION_DEBUG("Wrote %d, should be %d (%s)", r, length,
-                  r == length ? "ok" : "nok");
-      if (r != length || r < 0) {
-        ONION_ERROR("Could not send all file (%s)", strerror(errno));
-        close(fd);
-        return OCS_INTERNAL_ERROR;
-      }
+      // From now on all is sent, or connection closed, so it is accounted already.
       res->sent_bytes += length;
       res->sent_bytes_total += length;
+      onion_shortcut_file_transfer *t =
+          shortcut_file_transfer_new(request->connection.fd, entry, offset,
+                                     length);
+      int r;
+      while ((r = shortcut_file_transfer_send(t)) > 0) {
+        if (onion_listen_point_request_set_pending
+            (request, shortcut_file_transfer_resume,
+             (void *)shortcut_file_transfer_free, t) == 0) {
+          ONION_DEBUG0("Connection busy, rest of %s sent when writable",
+                       filename);
+          return OCS_PROCESSED;
+        }
+        // Not on a poller, so just wait here.
+        struct pollfd pfd = { request->connection.fd, POLLOUT, 0 };
+        if (poll(&pfd, 1, request->connection.listen_point->server->timeout) <=
+            0) {
+          ONION_ERROR("Timeout sending file %s", filename);
+          r = -1;
+          break;
+        }
+      }
+      shortcut_file_transfer_free(t);
+      return (r < 0) ? OCS_CLOSE_CONNECTION : OCS_PROCESSED;
     } else
 #endif
     {                           // Ok, no I cant, do it as always.
-      int r = 0, w;
-      size_t tr = 0;
-      char tmp[4046];
-      if (length > sizeof(tmp)) {
-        size_t max = length - sizeof(tmp);
-        while (tr < max) {
-          r = read(fd, tmp, sizeof(tmp));
-          tr += r;
-          if (r < 0)
-            break;
-          w = onion_response_write(res, tmp, r);
-          if (w != r) {
-            ONION_ERROR
-                ("Wrote less than read: write %d, read %d. Quite probably closed connection.",
-                 w, r);
-            break;
-          }
+      char tmp[ONION_SHORTCUT_FILE_CHUNK];
+      while (length > 0) {
+        ssize_t r =
+            pread(fd, tmp, length < sizeof(tmp) ? length : sizeof(tmp),
+                  offset);
+        if (r < 0 && errno == EINTR)
+          continue;
+        if (r <= 0) {
+          ONION_ERROR("Error reading %s (%s)", filename,
+                      r == 0 ? "unexpected end of file" : strerror(errno));
+          onion_file_cache_entry_free(entry);
+          return OCS_CLOSE_CONNECTION;
         }
-      }
-      if (sizeof(tmp) >= (length - tr)) {
-        r = read(fd, tmp, length - tr);
-        w = onion_response_write(res, tmp, r);
+        ssize_t w = onion_response_write(res, tmp, r);
         if (w != r) {
           ONION_ERROR
               ("Wrote less than read: write %d, read %d. Quite probably closed connection.",
-               w, r);
+               (int)w, (int)r);
+          onion_file_cache_entry_free(entry);
+          return OCS_CLOSE_CONNECTION;
         }
+        offset += r;
+        length -= r;
       }
     }
   }
-  close(fd);
+  onion_file_cache_entry_free(entry);
   return OCS_PROCESSED;
 }
 
@@ -325,16 +450,13 @@ onion_connection_status onion_shortcut_response_json(onion_dict * d,
                                                      onion_request * req,
                                                      onion_response * res) {
   onion_response_set_header(res, "Content-Type", "application/json");
+  onion_response_set_code(res, HTTP_OK);
 
-  onion_block *bl = onion_dict_to_json(d);
+  ssize_t ret = onion_dict_write_json(d, res);  // Sets the length, and writes with no copies
   onion_dict_free(d);
-  char tmp[16];
-  snprintf(tmp, sizeof(tmp), "%ld", (long)onion_block_size(bl));
-  int ret =
-      onion_shortcut_response_extra_headers(onion_block_data(bl), HTTP_OK, req,
-                                            res, "Content-Length", tmp, NULL);
-  onion_block_free(bl);
-  return ret;
+  if (ret < 0)
+    return OCS_INTERNAL_ERROR;
+  return OCS_PROCESSED;
 }
 
 /**
@@ -122,6 +122,14 @@ extern "C" {
   struct onion_block_t;
   typedef struct onion_block_t onion_block;
 
+/**
+ * @struct onion_json_writer_t
+ * @short Writes JSON as it is generated, to a response or block.
+ * @ingroup json
+ */
+  struct onion_json_writer_t;
+  typedef struct onion_json_writer_t onion_json_writer;
+
 /**
  * @struct onion_poller_t
  * @short Manages the polling on a set of file descriptors
@@ -171,6 +179,22 @@ extern "C" {
   struct onion_websocket_t;
   typedef struct onion_websocket_t onion_websocket;
 
+/**
+ * @struct onion_websocket_frame_t
+ * @short A websocket frame encoded once, to be sent to several websockets.
+ * @ingroup websocket
+ */
+  struct onion_websocket_frame_t;
+  typedef struct onion_websocket_frame_t onion_websocket_frame;
+
+/**
+ * @struct onion_websocket_hub_t
+ * @short Publish/subscribe of messages to websockets, by topic.
+ * @ingroup websocket_hub
+ */
+  struct onion_websocket_hub_t;
+  typedef struct onion_websocket_hub_t onion_websocket_hub;
+
 /**
  * @short List of pointers.
  * @memberof onion_ptr_list_t
@@ -182,6 +206,18 @@ extern "C" {
   struct onion_ptr_list_t;
   typedef struct onion_ptr_list_t onion_ptr_list;
 
+/**
+ * @short Open file descriptor and metadata of a static file, as kept by the file cache.
+ * @memberof onion_file_cache_entry_t
+ * @struct onion_file_cache_entry_t
+ * @ingroup file_cache
+ *
+ * Entries are reference counted and shared between requests, so the file descriptor must
+ * only be used with positional reads (pread, sendfile with offset).
+ */
+  struct onion_file_cache_entry_t;
+  typedef struct onion_file_cache_entry_t onion_file_cache_entry;
+
 /// Flags for the mode of operation of the onion server.
 /// @ingroup onion
   enum onion_mode_e {
@@ -270,6 +306,7 @@ extern "C" {
  * @ingroup websocket
  */
   enum onion_websocket_opcode_e {
+    OWS_CONTINUATION = 0,       ///< Next fragment of a message. See onion_websocket_write_fragment.
     OWS_TEXT = 1,
     OWS_BINARY = 2,
     OWS_CONNECTION_CLOSE = 8,
@@ -279,6 +316,28 @@ extern "C" {
 
   typedef enum onion_websocket_opcode_e onion_websocket_opcode;
 
+/**
+ * @short Options of permessage-deflate compression. @see onion_set_websocket_deflate
+ * @ingroup websocket
+ */
+  enum onion_websocket_deflate_flags_e {
+    OWD_SERVER_NO_CONTEXT_TAKEOVER = 1, ///< Compress each message on its own. Less memory at the client, worse compression.
+    OWD_CLIENT_NO_CONTEXT_TAKEOVER = 2, ///< Ask clients to compress each message on its own.
+  };
+
+  typedef enum onion_websocket_deflate_flags_e onion_websocket_deflate_flags;
+
+/**
+ * @short What to do with subscribers whose output backlog is full
+ * @ingroup websocket_hub
+ */
+  enum onion_websocket_hub_overflow_e {
+    OWH_DROP = 0,               ///< Drop the message for that subscriber.
+    OWH_CLOSE = 1,              ///< Close the subscriber connection.
+  };
+
+  typedef enum onion_websocket_hub_overflow_e onion_websocket_hub_overflow;
+
 /// Signature of request handlers.
 /// @ingroup handler
   typedef onion_connection_status(*onion_handler_handler) (void *privdata,
@@ -27,6 +27,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <stdbool.h>
 #include "types.h"
 
@@ -49,12 +50,19 @@ extern "C" {
 
   struct onion_dict_t {
     struct onion_dict_node_t *root;
+    struct onion_dict_small_t *small;   ///< If set, data is at this flat array, not at root.
+    struct onion_dict_hash_t *hash;     ///< If set, data is at this hash table, not at root.
+    int count;
+    int flags;                  ///< As set with onion_dict_set_flags
 #ifdef HAVE_PTHREADS
-    pthread_rwlock_t lock;
-    pthread_mutex_t refmutex;
+    pthread_rwlock_t lock;      ///< Not initialized if OD_NO_LOCK or OD_RCU.
+    struct onion_dict_rcu_t *rcu;       ///< If OD_RCU, readers do not lock, writers use this.
 #endif
-    int refcount;
+    int refcount;               ///< Atomically changed.
     int (*cmp) (const char *a, const char *b);
+    struct onion_dict_arena_t *arena;   ///< If parsed from JSON, keys and values point here.
+    struct onion_dict_t *shared;        ///< On snapshots, the content belongs to this one until first change.
+    int changed;                ///< If changed since created or since last snapshot.
   };
 
   struct onion_t {
@@ -70,6 +78,8 @@ extern "C" {
     size_t max_post_size;       /// Maximum size of post data. This is the sum of posts, @see onion_request_write_post
     size_t max_file_size;       /// Maximum size of files. @see onion_request_write_post
     onion_sessions *sessions;   /// Storage for sessions.
+    int websocket_deflate_bits; /// Max window bits of permessage-deflate at websockets, or 0 if disabled.
+    int websocket_deflate_flags;        /// onion_websocket_deflate_flags
     void *client_data;
     onion_client_data_free_sig *client_data_free;
 #ifdef HAVE_PTHREADS
@@ -85,6 +95,30 @@ extern "C" {
     struct onion_ptr_list_t *next;
   };
 
+/// Output that could not be written without blocking. Resumed when the connection is writable. @see onion_listen_point_request_set_pending
+  struct onion_connection_pending_t {
+    int (*resume) (onion_request * req, void *data);    ///< Writes more data. 0 when finished, >0 to wait again, <0 on error.
+    void (*free) (void *data);
+    void *data;
+    bool close;                 ///< Close the connection once finished, as the response can not keep alive.
+  };
+
+/// Max path parameters kept at each request. If more, the oldest are forgotten.
+#define ONION_REQUEST_MAX_PATH_PARAMS 16
+
+/**
+ * @short A capture of the path, set by onion_url.
+ *
+ * Points into the request fullpath; the string value is only created if asked for.
+ */
+  struct onion_request_path_param_t {
+    const char *name;           ///< Name of the group, or NULL.
+    const char *start;          ///< Inside fullpath
+    char *value;                ///< Copy as string, at the free_list, once asked for.
+    int group;                  ///< Group number at its regexp
+    int length;
+  };
+
   struct onion_request_t {
     struct {
       onion_listen_point *listen_point;
@@ -93,6 +127,9 @@ extern "C" {
       struct sockaddr_storage cli_addr;
       socklen_t cli_len;
       char *cli_info;
+      struct onion_connection_pending_t *pending;       ///< Pending output, if any. No more data is read until sent.
+      onion_poller_slot *slot;  ///< Poller slot of this connection, if it can be used to park pending output.
+      bool fd_plaintext;        ///< Secure, but what is written to fd gets to the client encrypted, as with kTLS. So sendfile can be used.
     } connection;               /// Connection to the client.
     int flags;                  /// Flags for this response. Ored onion_request_flags_e
 
@@ -101,15 +138,21 @@ extern "C" {
     onion_dict *headers;        /// Headers prepared for this response.
     onion_dict *GET;            /// When the query (?q=query) is processed, the dict with the values @see onion_request_parse_query
     onion_dict *POST;           /// Dictionary with POST values
+    char *query;                /// Raw query, inside fullpath, until parsed into GET at first use.
+    char *post_query;           /// Raw urlencoded POST data, until parsed into POST at first use.
     onion_dict *FILES;          /// Dictionary with files. They are automatically saved at /tmp/ and removed at request free. mapped string is full path.
     onion_dict *session;        /// Pointer to related session
     onion_block *data;          /// Some extra data from PUT, normally PROPFIND.
+    onion_dict *json;           /// data parsed as JSON, at first onion_request_get_json.
     onion_dict *cookies;        /// Data about cookies.
     char *session_id;           /// Session id of the request, if any.
     void *parser;               /// When recieving data, where to put it. Check at request_parser.c.
     void *parser_data;          /// Data necesary while parsing, muy be deleted when state changed. At free is simply freed.
     onion_websocket *websocket; /// Websocket handler. 
     onion_ptr_list *free_list;  /// Memory that should be freed when the request finishes. IT allows to have simpler onion_dict, which dont copy/free data, but just splits a long string inplace.
+    struct onion_request_path_param_t path_params[ONION_REQUEST_MAX_PATH_PARAMS];      /// Captures of the path, by match order.
+    int path_params_count;
+    int path_params_in_query;   /// How many path params are already at GET, as "1", "2"...
   };
 
   struct onion_response_t {
@@ -117,9 +160,9 @@ extern "C" {
     onion_dict *headers;        /// Headers to write when appropiate.
     int code;                   /// Response code
     int flags;                  /// Flags. @see onion_response_flags_e
-    unsigned int length;        /// Length, if known, of the response, to create the Content-Lenght header. 
-    unsigned int sent_bytes;    /// Sent bytes at content.
-    unsigned int sent_bytes_total;      /// Total sent bytes, including headers.
+    size_t length;              /// Length, if known, of the response, to create the Content-Lenght header. 
+    size_t sent_bytes;          /// Sent bytes at content.
+    size_t sent_bytes_total;    /// Total sent bytes, including headers.
     char buffer[ONION_RESPONSE_BUFFER_SIZE];    /// buffer of output data. This way its do not send small chunks all the time, but blocks, so better network use. Also helps to keep alive connections with less than block size bytes.
     off_t buffer_pos;           /// Position in the internal buffer. When sizeof(buffer) its flushed to the onion IO.
   };
@@ -146,14 +189,20 @@ extern "C" {
   };
 
   struct onion_block_t {
-    char *data;
-    int size;
-    int maxsize;
+    char *data;                 ///< Contiguous data, if not segmented.
+    size_t size;
+    size_t maxsize;
+    bool segmented;             ///< If set, data is at the chunks list.
+    struct onion_block_chunk_t *first;
+    struct onion_block_chunk_t *last;
   };
 
 /// Opaque type used at onion_url internally
   struct onion_url_data_t;
   typedef struct onion_url_data_t onion_url_data;
+/// Opaque type used at onion_url internally, the routes and its compiled tree
+  struct onion_url_routes_t;
+  typedef struct onion_url_routes_t onion_url_routes;
 
   struct onion_listen_point_t {
     onion *server;              ///< Onion server
@@ -200,7 +249,10 @@ extern "C" {
     int (*request_init) (onion_request * req);
     int (*read_ready) (onion_request * req);    ///< When poller detects data is ready to be read. Might be diferent in diferent parts of the processing.
      ssize_t(*write) (onion_request * req, const char *data, size_t len);       ///< Write data to the given request.
+     ssize_t(*writev) (onion_request * req, const struct iovec * iov, int iovcnt);      ///< Optional. Write several buffers at once. The default ones use write if it was changed.
      ssize_t(*read) (onion_request * req, char *data, size_t len);      ///< Read data from the given request and write it in data.
+    int (*flush) (onion_request * req); ///< Optional. Sends the data write and writev keep to send in bigger pieces. <0 on error.
+    size_t(*pending) (onion_request * req);    ///< Optional. Bytes already read from the fd and kept by the listen point, as the rest of a TLS record. The poller will not wake for them.
     void (*close) (onion_request * req);        ///< Closes the connection and frees listen point user data. Request itself it left. It is called from onion_request_free ONLY.
     /// @}
   };
@@ -217,6 +269,33 @@ extern "C" {
     int8_t mask_pos;
     int8_t flags;               /// Defined at websocket.c
     onion_websocket_opcode opcode:4;
+    bool out_fragmented;        /// A fragmented message is being written, so next fragments are continuations. Set with the output lock.
+
+    bool polled;                /// Data is read by the poller, when ready, into in. Else blocking reads.
+    char *in;                   /// Input buffer, when polled. Frames are passed to the callback when complete.
+    size_t in_size;
+    size_t in_len;              /// Bytes at in.
+    size_t in_pos;              /// Next byte to process at in.
+    size_t in_need;             /// Bytes needed from in_pos for the current frame, if known.
+
+#ifdef HAVE_PTHREADS
+    pthread_mutex_t out_mutex;  /// Protects the output queue and hubs, as hubs publish from any thread.
+#endif
+    struct onion_websocket_out_t *out;  /// Frames queued to send, from out_first. Defined at websocket.c
+    int out_first;
+    int out_count;
+    int out_size;
+    size_t out_bytes;           /// Bytes at the output queue and held, not yet sent.
+    onion_websocket_frame **out_held;   /// Shared frames that wait for the fragmented message being written to end.
+    int out_nheld;
+    int out_held_size;
+    bool out_writing;           /// A thread is sending now. Only one at a time.
+    bool out_closed;            /// Could not send, or aborted. Connection is closing.
+    bool out_armed;             /// Waiting for the connection to be writable to send the queue.
+    bool busy;                  /// When polled, a thread is processing input.
+    onion_websocket_hub **hubs; /// Hubs where it is subscribed.
+    int nhubs;
+    struct onion_websocket_deflate_t *deflate;  /// permessage-deflate state, if negotiated. Defined at websocket.c
   };
 
 #ifdef __cplusplus
@@ -26,6 +26,10 @@
 #include <unistd.h>
 #include <regex.h>
 #include <stdio.h>
+#include <ctype.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "log.h"
 #include "handler.h"
@@ -38,6 +42,8 @@
 enum onion_url_data_flags_e {
   OUD_REGEXP = 1,
   OUD_STRCMP = 2,
+  OUD_LITERAL = 4,              ///< The prefix is all the expression, no need to regexec.
+  OUD_EXACT = 8,                ///< The path must end after the prefix.
 };
 
 typedef enum onion_url_data_flags_e onion_url_data_flags;
@@ -55,66 +61,320 @@ struct onion_url_data_t {
   char *orig;
 #endif
   int flags;
+  char *prefix;                 ///< Literal start that any matching path has
+  int prefix_len;
+  char **names;                 ///< Names of the groups, if any is named. 16 entries.
   onion_handler *inside;
   struct onion_url_data_t *next;
 };
 
 //typedef struct onion_url_data_t onion_url_data; // already at types-internal.h
 
+/**
+ * @short Node of the routing radix tree.
+ * @private
+ *
+ * Edges are labeled with parts of the route prefixes. Each node keeps the routes whose prefix
+ * ends there, by insertion order.
+ */
+typedef struct onion_url_node_t {
+  const char *label;            ///< Points inside a route prefix
+  int label_len;
+  struct onion_url_node_t **children;
+  int nchildren;
+  int *routes;                  ///< Routes that match paths that start here
+  int nroutes;
+  int *exact;                   ///< Routes that match paths that end here
+  int nexact;
+} onion_url_node;
+
+/**
+ * @short Routes compiled into a tree, and as an array by insertion order.
+ * @private
+ */
+typedef struct onion_url_trie_t {
+  onion_url_node *root;
+  onion_url_data **routes;
+  int count;
+  struct onion_url_trie_t *retired_next;        ///< Old tries are kept until the url is freed
+} onion_url_trie;
+
+/**
+ * @short Private data of the url handler.
+ * @private
+ *
+ * The routes list is the source of truth. The trie is compiled from it at the first request
+ * after any change, and replaced tries are kept until the url is freed, as other threads may
+ * still be using them.
+ */
+struct onion_url_routes_t {
+  onion_url_data *first;
+  int count;
+  onion_url_trie *trie;
+  onion_url_trie *retired;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;        ///< For changes to the list, and compilation.
+#endif
+};
+
+/// Max nodes with routes that a path can cross to use the trie. Else routes are checked one by one.
+#define ONION_URL_MAX_CANDIDATE_LISTS 32
+
+static void onion_url_node_add_route(int **list, int *n, int route) {
+  *list = onion_low_realloc(*list, sizeof(int) * (*n + 1));
+  (*list)[(*n)++] = route;
+}
+
+static onion_url_node *onion_url_node_new(const char *label, int label_len) {
+  onion_url_node *node = onion_low_calloc(1, sizeof(onion_url_node));
+  node->label = label;
+  node->label_len = label_len;
+  return node;
+}
+
+static void onion_url_node_free(onion_url_node * node) {
+  int i;
+  for (i = 0; i < node->nchildren; i++)
+    onion_url_node_free(node->children[i]);
+  onion_low_free(node->children);
+  onion_low_free(node->routes);
+  onion_low_free(node->exact);
+  onion_low_free(node);
+}
+
+/// Adds the route to the tree, splitting edges as needed.
+static void onion_url_node_insert(onion_url_node * node, const char *key,
+                                  int len, int route, int exact) {
+  while (len) {
+    onion_url_node *child = NULL;
+    int i;
+    for (i = 0; i < node->nchildren; i++) {
+      if (node->children[i]->label[0] == key[0]) {
+        child = node->children[i];
+        break;
+      }
+    }
+    if (!child) {
+      child = onion_url_node_new(key, len);
+      node->children =
+          onion_low_realloc(node->children,
+                            sizeof(onion_url_node *) * (node->nchildren + 1));
+      node->children[node->nchildren++] = child;
+      node = child;
+      break;
+    }
+    int common = 1;
+    while (common < len && common < child->label_len
+           && key[common] == child->label[common])
+      common++;
+    if (common < child->label_len) {    // Split, the child goes below the common part
+      onion_url_node *split = onion_url_node_new(child->label, common);
+      child->label += common;
+      child->label_len -= common;
+      split->children = onion_low_malloc(sizeof(onion_url_node *));
+      split->children[0] = child;
+      split->nchildren = 1;
+      node->children[i] = split;
+      child = split;
+    }
+    node = child;
+    key += common;
+    len -= common;
+  }
+  if (exact)
+    onion_url_node_add_route(&node->exact, &node->nexact, route);
+  else
+    onion_url_node_add_route(&node->routes, &node->nroutes, route);
+}
+
+/// Compiles the current routes. Called with the mutex held.
+static onion_url_trie *onion_url_trie_new(onion_url_routes * r) {
+  onion_url_trie *trie = onion_low_calloc(1, sizeof(onion_url_trie));
+  trie->root = onion_url_node_new("", 0);
+  trie->routes = onion_low_malloc(sizeof(onion_url_data *) * (r->count + 1));
+  onion_url_data *d;
+  for (d = r->first; d; d = d->next) {
+    trie->routes[trie->count] = d;
+    onion_url_node_insert(trie->root, d->prefix, d->prefix_len, trie->count,
+                          d->flags & OUD_EXACT);
+    trie->count++;
+  }
+  return trie;
+}
+
+static void onion_url_trie_free(onion_url_trie * trie) {
+  onion_url_node_free(trie->root);
+  onion_low_free(trie->routes);
+  onion_low_free(trie);
+}
+
+/// Returns the compiled trie, compiling it if needed.
+static onion_url_trie *onion_url_get_trie(onion_url_routes * r) {
+  onion_url_trie *trie = __atomic_load_n(&r->trie, __ATOMIC_ACQUIRE);
+  if (trie)
+    return trie;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&r->mutex);
+#endif
+  trie = r->trie;
+  if (!trie) {
+    trie = onion_url_trie_new(r);
+    __atomic_store_n(&r->trie, trie, __ATOMIC_RELEASE);
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&r->mutex);
+#endif
+  return trie;
+}
+
+/**
+ * @short Checks if the route matches the path, that is known to start with the route prefix.
+ *
+ * @returns the length of the path matched, or -1.
+ */
+static int onion_url_route_match(onion_url_data * d, const char *path,
+                                 regmatch_t * match) {
+  if (d->flags & OUD_LITERAL) {
+    if ((d->flags & OUD_EXACT) && path[d->prefix_len])
+      return -1;
+    match[0].rm_so = 0;
+    match[0].rm_eo = d->prefix_len;
+    match[1].rm_so = -1;
+    return d->prefix_len;
+  }
+  if (regexec(&d->regexp, path, 16, match, 0) != 0)
+    return -1;
+  return match[0].rm_eo;
+}
+
+/**
+ * @short Finds the first route, by insertion order, that matches the path.
+ *
+ * Walks the tree along the path, so only routes whose literal prefix matches are checked.
+ * Each node list is sorted, so they are merged to check them in order.
+ *
+ * @returns the route, or NULL.
+ */
+static onion_url_data *onion_url_find(onion_url_trie * trie, const char *path,
+                                      regmatch_t * match) {
+  const int *lists[ONION_URL_MAX_CANDIDATE_LISTS];
+  int sizes[ONION_URL_MAX_CANDIDATE_LISTS];
+  int nlists = 0;
+  onion_url_node *node = trie->root;
+  const char *p = path;
+  for (;;) {
+    if (node->nroutes) {
+      if (nlists == ONION_URL_MAX_CANDIDATE_LISTS)
+        goto check_all;
+      lists[nlists] = node->routes;
+      sizes[nlists++] = node->nroutes;
+    }
+    if (!*p) {
+      if (node->nexact) {
+        if (nlists == ONION_URL_MAX_CANDIDATE_LISTS)
+          goto check_all;
+        lists[nlists] = node->exact;
+        sizes[nlists++] = node->nexact;
+      }
+      break;
+    }
+    onion_url_node *child = NULL;
+    int i;
+    for (i = 0; i < node->nchildren; i++) {
+      if (node->children[i]->label[0] == *p) {
+        child = node->children[i];
+        break;
+      }
+    }
+    if (!child || strncmp(p, child->label, child->label_len) != 0)
+      break;
+    p += child->label_len;
+    node = child;
+  }
+
+  for (;;) {                    // Merge, lowest route first
+    int best = -1, i;
+    for (i = 0; i < nlists; i++) {
+      if (sizes[i] && (best < 0 || lists[i][0] < lists[best][0]))
+        best = i;
+    }
+    if (best < 0)
+      return NULL;
+    onion_url_data *d = trie->routes[lists[best][0]];
+    lists[best]++;
+    sizes[best]--;
+    if (onion_url_route_match(d, path, match) >= 0)
+      return d;
+  }
+
+ check_all:
+  {
+    int i;
+    for (i = 0; i < trie->count; i++) {
+      onion_url_data *d = trie->routes[i];
+      if (strncmp(path, d->prefix, d->prefix_len) == 0
+          && onion_url_route_match(d, path, match) >= 0)
+        return d;
+    }
+  }
+  return NULL;
+}
+
 /**
  * @short Performs the real request: checks if its for me, and then calls the inside level.
  * @ingroup url
  */
-int onion_url_handler(onion_url_data ** dd, onion_request * request,
+int onion_url_handler(onion_url_routes * routes, onion_request * request,
                       onion_response * response) {
-  onion_url_data *next = *dd;
   regmatch_t match[16];
   int i;
 
   const char *path = onion_request_get_path(request);
-  while (next) {
-    ONION_DEBUG0("Check %s against %s", onion_request_get_path(request),
-                 next->orig);
-    if (next->flags & OUD_STRCMP) {
-      if (strcmp(path, next->str) == 0) {
-        ONION_DEBUG0("Ok, simple match.");
-
-        onion_request_advance_path(request, strlen(next->str));
-        return onion_handler_handle(next->inside, request, response);
-      }
-    } else
-        if (regexec
-            (&next->regexp, onion_request_get_path(request), 16, match,
-             0) == 0) {
-      //ONION_DEBUG("Ok,match");
-      onion_dict *reqheader = request->GET;
-      for (i = 1; i < 16; i++) {
-        regmatch_t *rm = &match[i];
-        if (rm->rm_so != -1) {
-          char *tmp = onion_low_scalar_malloc(rm->rm_eo - rm->rm_so + 1);
-          memcpy(tmp, &path[rm->rm_so], rm->rm_eo - rm->rm_so);
-          tmp[rm->rm_eo - rm->rm_so] = '\0';    // proper finish string
-          char tmpn[4];
-          snprintf(tmpn, sizeof(tmpn), "%d", i);
-          onion_dict_add(reqheader, tmpn, tmp, OD_DUP_KEY | OD_FREE_VALUE);
-          ONION_DEBUG("Add group %d: %s (%d-%d)", i, tmp, rm->rm_so, rm->rm_eo);
-        } else
-          break;
-      }
-      onion_request_advance_path(request, match[0].rm_eo);
-      ONION_DEBUG0("Ok, regexp match.");
-
-      return onion_handler_handle(next->inside, request, response);
+  onion_url_data *next =
+      onion_url_find(onion_url_get_trie(routes), path, match);
+  if (!next)
+    return 0;
+
+  ONION_DEBUG0("Match %s against %s", path, next->orig);
+  for (i = 1; i < 16; i++) {
+    regmatch_t *rm = &match[i];
+    if (rm->rm_so == -1)
+      break;
+    if (request->path_params_count == ONION_REQUEST_MAX_PATH_PARAMS) {       // Forget the oldest
+      memmove(&request->path_params[0], &request->path_params[1],
+              sizeof(request->path_params[0]) *
+              (ONION_REQUEST_MAX_PATH_PARAMS - 1));
+      request->path_params_count--;
+      if (request->path_params_in_query)
+        request->path_params_in_query--;
     }
-
-    next = next->next;
+    struct onion_request_path_param_t *param =
+        &request->path_params[request->path_params_count++];
+    param->name = next->names ? next->names[i] : NULL;
+    param->start = &path[rm->rm_so];
+    param->length = rm->rm_eo - rm->rm_so;
+    param->value = NULL;
+    param->group = i;
+    ONION_DEBUG0("Add group %d: %.*s (%d-%d)", i, param->length, param->start,
+                 rm->rm_so, rm->rm_eo);
   }
-  return 0;
+  onion_request_advance_path(request, match[0].rm_eo);
+
+  return onion_handler_handle(next->inside, request, response);
+}
+
+static void onion_url_free_names(char **names) {
+  if (!names)
+    return;
+  int i;
+  for (i = 0; i < 16; i++)
+    onion_low_free(names[i]);
+  onion_low_free(names);
 }
 
 /// Removes internal data for this handler.
-void onion_url_free_data(onion_url_data ** d) {
-  onion_url_data *next = *d;
+void onion_url_free_data(onion_url_routes * routes) {
+  onion_url_data *next = routes->first;
   while (next) {
     onion_url_data *t = next;
     onion_handler_free(t->inside);
@@ -122,13 +382,127 @@ void onion_url_free_data(onion_url_data ** d) {
       regfree(&t->regexp);
     else
       onion_low_free(t->str);
+    onion_low_free(t->prefix);
+    onion_url_free_names(t->names);
     next = t->next;
 #ifdef __DEBUG__
     onion_low_free(t->orig);
 #endif
     onion_low_free(t);
   }
-  onion_low_free(d);
+  if (routes->trie)
+    onion_url_trie_free(routes->trie);
+  while (routes->retired) {
+    onion_url_trie *t = routes->retired;
+    routes->retired = t->retired_next;
+    onion_url_trie_free(t);
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&routes->mutex);
+#endif
+  onion_low_free(routes);
+}
+
+/**
+ * @short Gets the literal prefix of a regexp, after the ^.
+ *
+ * Stops at the first special char, or before a char that is optional. Alternatives may match
+ * anything, so there is no prefix if there is any |.
+ *
+ * @returns the prefix length. At flags sets OUD_LITERAL, and OUD_EXACT, if the expression is
+ * just the prefix.
+ */
+static int onion_url_literal_prefix(const char *re, char *prefix, int *flags) {
+  int n = 0;
+  const char *p = re;
+  if (strchr(re, '|')) {
+    prefix[0] = '\0';
+    return 0;
+  }
+  while (*p) {
+    char c;
+    const char *next;
+    if (*p == '\\') {
+      if (!p[1] || isalnum(p[1]))
+        break;
+      c = p[1];
+      next = p + 2;
+    } else if (strchr(".[]()*+?{}^$", *p))
+      break;
+    else {
+      c = *p;
+      next = p + 1;
+    }
+    if (*next == '*' || *next == '?' || *next == '{')
+      break;
+    prefix[n++] = c;
+    p = next;
+    if (*p == '+')              // c is there, but not what follows
+      break;
+  }
+  prefix[n] = '\0';
+  if (!*p)
+    *flags |= OUD_LITERAL;
+  else if (p[0] == '$' && !p[1])
+    *flags |= OUD_LITERAL | OUD_EXACT;
+  return n;
+}
+
+/**
+ * @short Removes the group names, (?<name>...), from the regexp, as regcomp does not know them.
+ *
+ * Groups are counted as regcomp does, skipping escaped parenthesis and bracket expressions.
+ *
+ * @returns the names of the first 16 groups, or NULL if none is named. At clean the regexp
+ * without names.
+ */
+static char **onion_url_group_names(const char *regexp, char *clean) {
+  char **names = NULL;
+  int group = 0;
+  const char *p = regexp;
+  while (*p) {
+    if (*p == '\\' && p[1]) {
+      *clean++ = *p++;
+      *clean++ = *p++;
+      continue;
+    }
+    if (*p == '[') {            // Copy the bracket expression as is. ] just after [ or [^ is a char.
+      *clean++ = *p++;
+      if (*p == '^')
+        *clean++ = *p++;
+      if (*p == ']')
+        *clean++ = *p++;
+      while (*p && *p != ']')
+        *clean++ = *p++;
+      continue;
+    }
+    *clean++ = *p;
+    if (*p++ != '(')
+      continue;
+    group++;
+    const char *name = NULL;
+    if (p[0] == '?' && p[1] == '<')
+      name = p + 2;
+    else if (p[0] == '?' && p[1] == 'P' && p[2] == '<')
+      name = p + 3;
+    if (!name)
+      continue;
+    const char *end = name;
+    while (isalnum(*end) || *end == '_')
+      end++;
+    if (*end != '>' || end == name)
+      continue;                 // Not a name, let regcomp complain.
+    if (group < 16) {
+      if (!names)
+        names = onion_low_calloc(16, sizeof(char *));
+      names[group] = onion_low_scalar_malloc(end - name + 1);
+      memcpy(names[group], name, end - name);
+      names[group][end - name] = '\0';
+    }
+    p = end + 1;
+  }
+  *clean = '\0';
+  return names;
 }
 
 /**
@@ -167,9 +541,20 @@ void onion_url_free_data(onion_url_data ** d) {
  * @code
  *  onion_url_add(url, "^index(.html)", index);
  *  ...
- *  onion_request_get_query(req, "1") == ".html"
+ *  onion_request_get_path_param(req, "1") == ".html"
+ * @endcode
+ *
+ * Groups can also be named, as (?<name>...), and got by name. Named groups are still numbered:
+ *
+ * @code
+ *  onion_url_add(url, "^users/(?<user>[^/]*)/(?<item>[0-9]+)$", user_item);
+ *  ...
+ *  onion_request_get_path_param(req, "user") == onion_request_get_path_param_n(req, 1)
  * @endcode
  *
+ * Captures are kept as slices of the path, and only copied when asked for. For compatibility
+ * they are also at the request query, as "1", "2"..., when the query is used.
+ *
  * Be careful as . means every character, and dots in URLs must be with a backslash \ (double because of
  * C escaping), if using regexps.
  *
@@ -177,8 +562,10 @@ void onion_url_free_data(onion_url_data ** d) {
  * how to create proper regular expressions. They are compiled as REG_EXTENDED.
  */
 onion_url *onion_url_new() {
-  onion_url_data **priv_data = onion_low_calloc(1, sizeof(onion_url_data *));
-  *priv_data = NULL;
+  onion_url_routes *priv_data = onion_low_calloc(1, sizeof(onion_url_routes));
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&priv_data->mutex, NULL);
+#endif
 
   onion_handler *ret =
       onion_handler_new((onion_handler_handler) onion_url_handler,
@@ -205,37 +592,63 @@ void onion_url_free(onion_url * url) {
  */
 int onion_url_add_handler(onion_url * url, const char *regexp,
                           onion_handler * next) {
-  onion_url_data **w = ((onion_url_data **)
-                        onion_handler_get_private_data((onion_handler *) url));
-  while (*w) {
-    w = &(*w)->next;
-  }
-  //ONION_DEBUG("Adding handler at %p",w);
-  *w = onion_low_malloc(sizeof(onion_url_data));
-  onion_url_data *data = *w;
+  onion_url_routes *routes = (onion_url_routes *)
+      onion_handler_get_private_data((onion_handler *) url);
+  onion_url_data *data = onion_low_malloc(sizeof(onion_url_data));
+  char *prefix = onion_low_scalar_malloc(strlen(regexp) + 1);
 
   data->flags = (regexp[0] == '^') ? OUD_REGEXP : OUD_STRCMP;
+  data->names = NULL;
 
   if (data->flags & OUD_REGEXP) {
-    int err = regcomp(&data->regexp, regexp, REG_EXTENDED);     // empty regexp, always true. should be fast enough.
+    char *clean = onion_low_scalar_malloc(strlen(regexp) + 1);
+    data->names = onion_url_group_names(regexp, clean);
+    int err = regcomp(&data->regexp, clean, REG_EXTENDED);      // empty regexp, always true. should be fast enough.
     if (err) {
       char buffer[1024];
       regerror(err, &data->regexp, buffer, sizeof(buffer));
       ONION_ERROR("Error analyzing regular expression '%s': %s.\n", regexp,
                   buffer);
+      onion_url_free_names(data->names);
+      onion_low_free(clean);
+      onion_low_free(prefix);
       onion_low_free(data);
-      *w = NULL;
       return 1;
     }
+    data->prefix_len =
+        onion_url_literal_prefix(clean + 1, prefix, &data->flags);
+    onion_low_free(clean);
   } else {
     data->str = onion_low_strdup(regexp);
+    strcpy(prefix, regexp);
+    data->prefix_len = strlen(regexp);
+    data->flags |= OUD_LITERAL | OUD_EXACT;
   }
+  data->prefix = prefix;
   data->next = NULL;
   data->inside = next;
 #ifdef __DEBUG__
   data->orig = onion_low_strdup(regexp);
 #endif
 
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&routes->mutex);
+#endif
+  onion_url_data **w = &routes->first;
+  while (*w) {
+    w = &(*w)->next;
+  }
+  *w = data;
+  routes->count++;
+  if (routes->trie) {           // Will be compiled again at next request
+    routes->trie->retired_next = routes->retired;
+    routes->retired = routes->trie;
+    __atomic_store_n(&routes->trie, NULL, __ATOMIC_RELEASE);
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&routes->mutex);
+#endif
+
   return 0;
 }
 
@@ -29,13 +29,23 @@
 #include "codecs.h"
 #include "random.h"
 #include "low.h"
+#include "poller.h"
+#include "websocket_hub.h"
 
 #include <poll.h>
+#include <sys/socket.h>
+#include <ctype.h>
 #include <errno.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 /// @defgroup websocket Websockets. Basic websockets support.
 
@@ -43,8 +53,17 @@
 enum onion_websocket_flags_e {
   WS_FIN = 1,
   WS_MASK = 2,
+  WS_RSV1 = 4,                  ///< Compressed message, with permessage-deflate.
+  WS_INFLATED = 8,              ///< Frame payload is read from the inflate buffer.
 };
 
+/// RSV1 bit at the first header byte, that marks compressed messages.
+#define ONION_WEBSOCKET_RSV1 0x40
+/// Internal flag along the opcode to onion_websocket_write_frame, to compress the payload.
+#define ONION_WEBSOCKET_DEFLATE 0x100
+/// Messages smaller than this are not compressed on their own, as they would grow.
+#define ONION_WEBSOCKET_DEFLATE_MIN 64
+
 // signature of writer in listen point.
 /// @ingroup websocket
 typedef ssize_t(lpwriter_sig_t) (onion_request * req, const char *data,
@@ -55,6 +74,19 @@ typedef ssize_t(lpwriter_sig_t) (onion_request * req, const char *data,
 typedef ssize_t(lpreader_sig_t) (onion_request * req, char *data, size_t len);
 
 static int onion_websocket_read_packet_header(onion_websocket * ws);
+static void onion_websocket_out_lock(onion_websocket * ws);
+static void onion_websocket_out_unlock(onion_websocket * ws);
+static void onion_websocket_out_clear(onion_websocket * ws);
+static struct onion_websocket_deflate_t
+*onion_websocket_deflate_negotiate(onion_request * req, char *response,
+                                  size_t size);
+static void onion_websocket_deflate_free(struct onion_websocket_deflate_t *d);
+#ifdef HAVE_ZLIB
+static char *onion_websocket_deflate(onion_websocket * ws, const char *data,
+                                     size_t len, int fin, size_t *outlen);
+static onion_websocket_frame
+*onion_websocket_frame_get_deflated(onion_websocket_frame * frame);
+#endif
 
 const static char *websocket_magic_13 = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 const static int websocket_magic_13_length = 36;
@@ -124,6 +156,11 @@ onion_websocket *onion_websocket_new(onion_request * req, onion_response * res)
     onion_response_set_header(res, "Sec-Websocket-Procotol", ws_protocol);
   onion_response_set_header(res, "Sec-Websocket-Accept", key_answer);
   onion_low_free(key_answer);
+  char extensions[128];
+  struct onion_websocket_deflate_t *deflate =
+      onion_websocket_deflate_negotiate(req, extensions, sizeof(extensions));
+  if (deflate)
+    onion_response_set_header(res, "Sec-Websocket-Extensions", extensions);
 
   onion_response_write_headers(res);
   onion_response_write(res, "", 0);     // AKA flush
@@ -136,6 +173,22 @@ onion_websocket *onion_websocket_new(onion_request * req, onion_response * res)
   ret->user_data = req->data;
   ret->free_user_data = NULL;
   ret->opcode = OWS_TEXT;
+  ret->out_fragmented = false;
+  ret->polled = false;
+  ret->in = NULL;
+  ret->in_size = ret->in_len = ret->in_pos = ret->in_need = 0;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&ret->out_mutex, NULL);
+#endif
+  ret->out = NULL;
+  ret->out_first = ret->out_count = ret->out_size = 0;
+  ret->out_bytes = 0;
+  ret->out_held = NULL;
+  ret->out_nheld = ret->out_held_size = 0;
+  ret->out_writing = ret->out_closed = ret->out_armed = ret->busy = false;
+  ret->hubs = NULL;
+  ret->nhubs = 0;
+  ret->deflate = deflate;
 
   req->websocket = ret;
 
@@ -159,83 +212,1111 @@ void onion_websocket_free(onion_websocket * ws) {
   if (ws->free_user_data)
     ws->free_user_data(ws->user_data);
 
+  onion_websocket_out_lock(ws);
+  while (ws->nhubs) {           // So no more publishes to it
+    onion_websocket_hub *hub = ws->hubs[ws->nhubs - 1];
+    onion_websocket_out_unlock(ws);
+    onion_websocket_hub_unsubscribe(hub, NULL, ws);
+    onion_websocket_out_lock(ws);
+  }
+  onion_websocket_out_clear(ws);
+  onion_websocket_out_unlock(ws);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&ws->out_mutex);
+#endif
+  onion_low_free(ws->out);
+  onion_low_free(ws->out_held);
+  onion_low_free(ws->hubs);
+  if (ws->deflate)
+    onion_websocket_deflate_free(ws->deflate);
+
   onion_random_free();
+  onion_low_free(ws->in);
 
   ws->req->websocket = NULL;    // To avoid double free on stupid programs that call this directly.
   onion_low_free(ws);
 }
 
+/// Servers do not mask, so headers are at most 2 + 8 bytes.
+#define ONION_WEBSOCKET_MAX_HEADER 10
+/// Without writev, frames up to this size are copied after the header to send them at once.
+#define ONION_WEBSOCKET_SMALL_FRAME 512
+
+/**
+ * @short Encodes an unmasked frame header.
+ *
+ * Lengths from 126 to 65535 use the 16 bit form, and longer ones the 64 bit form.
+ *
+ * @param header At least ONION_WEBSOCKET_MAX_HEADER bytes.
+ * @returns the header length.
+ */
+static int onion_websocket_frame_header(char *header, int opcode, int fin,
+                                        uint64_t len) {
+  header[0] = (fin ? 0x80 : 0x00) | (opcode & (ONION_WEBSOCKET_RSV1 | 0x0F));
+  if (len < 126) {
+    header[1] = len;
+    return 2;
+  }
+  if (len <= 0x0FFFF) {
+    header[1] = 126;
+    header[2] = (len >> 8) & 0x0FF;
+    header[3] = len & 0x0FF;
+    return 4;
+  }
+  header[1] = 127;
+  int i;
+  for (i = 0; i < 8; i++) {
+    header[9 - i] = len & 0x0FF;
+    len >>= 8;
+  }
+  return 10;
+}
+
+/**
+ * @short Writes all the iovecs, with the listen point writev if any, or write, and flushes.
+ *
+ * iov is modified as data is written.
+ *
+ * @returns 0 if all was written, or <0 on error.
+ */
+static int onion_websocket_write_iov(onion_request * req, struct iovec *iov,
+                                     int n) {
+  onion_listen_point *lp = req->connection.listen_point;
+  while (n) {
+    ssize_t w;
+    if (lp->writev)
+      w = lp->writev(req, iov, n);
+    else
+      w = lp->write(req, iov->iov_base, iov->iov_len);
+    if (w <= 0) {
+      ONION_DEBUG("Error writing to websocket (%s)", strerror(errno));
+      return -1;
+    }
+    while (n && w >= iov->iov_len) {
+      w -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n) {
+      iov->iov_base = (char *)iov->iov_base + w;
+      iov->iov_len -= w;
+    }
+  }
+  if (lp->flush && lp->flush(req) < 0) {
+    ONION_DEBUG("Error writing to websocket (%s)", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * @short permessage-deflate state of a websocket (RFC 7692).
+ *
+ * Streams are initialized when first needed, as the compressor is big.
+ */
+struct onion_websocket_deflate_t {
+  int window_bits;              ///< Max window to compress, as negotiated.
+  int flags;                    ///< onion_websocket_deflate_flags, as negotiated.
+  z_stream out;
+  bool out_init;
+  bool out_reset;               ///< Reset out before next message. The client window does not have what out thinks.
+  bool out_message;             ///< Current outgoing message is compressed.
+  z_stream in;
+  bool in_init;
+  bool in_message;              ///< Current incoming message is compressed.
+  char *data;                   ///< Current inflated frame.
+  size_t size;
+  size_t len;
+  size_t pos;                   ///< Next byte to read at data.
+  size_t message_len;           ///< Inflated bytes of the current incoming message, to limit it.
+};
+#endif
+
+struct onion_websocket_frame_t {
+  int refcount;                 ///< Atomically changed.
+  size_t length;                ///< Of header and payload.
+  int hlen;                     ///< Of header.
+  bool shared;                  ///< A whole message from onion_websocket_frame_new, that may be compressed.
+  onion_websocket_frame *deflated;      ///< Compressed version, if already done. May be this same frame.
+  char data[];
+};
+
+/// Entry at the output queue: a frame, and how much of it is already sent.
+struct onion_websocket_out_t {
+  onion_websocket_frame *frame;
+  size_t pos;
+};
+
+/// Max frames per send of the output queue.
+#define ONION_WEBSOCKET_OUT_IOV 16
+
+ssize_t onion_http_write(onion_request * req, const char *data, size_t len);      // At http.c
+
+static void onion_websocket_out_lock(onion_websocket * ws) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&ws->out_mutex);
+#endif
+}
+
+static void onion_websocket_out_unlock(onion_websocket * ws) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&ws->out_mutex);
+#endif
+}
+
+static onion_websocket_frame *onion_websocket_frame_new_fragment(int opcode,
+                                                                 int fin,
+                                                                 const char
+                                                                 *data,
+                                                                 size_t len) {
+  char header[ONION_WEBSOCKET_MAX_HEADER];
+  int hlen = onion_websocket_frame_header(header, opcode, fin, len);
+  onion_websocket_frame *frame =
+      onion_low_malloc(sizeof(onion_websocket_frame) + hlen + len);
+  frame->refcount = 1;
+  frame->length = hlen + len;
+  frame->hlen = hlen;
+  frame->shared = false;
+  frame->deflated = NULL;
+  memcpy(frame->data, header, hlen);
+  memcpy(&frame->data[hlen], data, len);
+  return frame;
+}
+
+/**
+ * @short Encodes a whole message as a frame, to send it to several websockets
+ * @memberof onion_websocket_frame_t
+ * @ingroup websocket
+ *
+ * The header is encoded and the payload copied only once, and then each websocket
+ * (onion_websocket_write_shared) just keeps a reference until sent. For websockets with
+ * permessage-deflate it is also compressed once, on its own, when first needed.
+ *
+ * @returns the frame. Release it with onion_websocket_frame_free.
+ */
+onion_websocket_frame *onion_websocket_frame_new(onion_websocket_opcode opcode,
+                                                 const char *data, size_t len) {
+  onion_websocket_frame *frame =
+      onion_websocket_frame_new_fragment(opcode, 1, data, len);
+  frame->shared = (opcode == OWS_TEXT || opcode == OWS_BINARY);
+  return frame;
+}
+
+/**
+ * @short Releases a reference to the frame. Frees it when there are no more.
+ * @memberof onion_websocket_frame_t
+ * @ingroup websocket
+ */
+void onion_websocket_frame_free(onion_websocket_frame * frame) {
+  if (__sync_sub_and_fetch(&frame->refcount, 1) == 0) {
+    if (frame->deflated && frame->deflated != frame)
+      onion_websocket_frame_free(frame->deflated);
+    onion_low_free(frame);
+  }
+}
+
+/// Adds the frame to the output queue, keeping a reference.
+static void onion_websocket_out_push(onion_websocket * ws,
+                                     onion_websocket_frame * frame) {
+  if (ws->out_first + ws->out_count == ws->out_size) {
+    if (ws->out_first) {
+      memmove(ws->out, &ws->out[ws->out_first],
+              ws->out_count * sizeof(struct onion_websocket_out_t));
+      ws->out_first = 0;
+    } else {
+      ws->out_size = ws->out_size ? ws->out_size * 2 : 8;
+      ws->out = onion_low_realloc(ws->out,
+                                  ws->out_size *
+                                  sizeof(struct onion_websocket_out_t));
+    }
+  }
+  __sync_add_and_fetch(&frame->refcount, 1);
+  struct onion_websocket_out_t *o = &ws->out[ws->out_first + ws->out_count];
+  o->frame = frame;
+  o->pos = 0;
+  ws->out_count++;
+  ws->out_bytes += frame->length;
+}
+
+/// Removes sent data from the output queue.
+static void onion_websocket_out_consume(onion_websocket * ws, size_t len) {
+  ws->out_bytes -= len;
+  while (len) {
+    struct onion_websocket_out_t *o = &ws->out[ws->out_first];
+    size_t left = o->frame->length - o->pos;
+    if (len < left) {
+      o->pos += len;
+      return;
+    }
+    len -= left;
+    onion_websocket_frame_free(o->frame);
+    ws->out_first++;
+    ws->out_count--;
+  }
+  if (!ws->out_count)
+    ws->out_first = 0;
+}
+
+/// Drops all the output queue, and the held frames.
+static void onion_websocket_out_clear(onion_websocket * ws) {
+  while (ws->out_count) {
+    onion_websocket_frame_free(ws->out[ws->out_first].frame);
+    ws->out_first++;
+    ws->out_count--;
+  }
+  ws->out_first = 0;
+  while (ws->out_nheld)
+    onion_websocket_frame_free(ws->out_held[--ws->out_nheld]);
+  ws->out_bytes = 0;
+}
+
+/// Keeps a shared frame, keeping a reference, until the fragmented message being written ends.
+static void onion_websocket_out_hold(onion_websocket * ws,
+                                     onion_websocket_frame * frame) {
+  if (ws->out_nheld == ws->out_held_size) {
+    ws->out_held_size = ws->out_held_size ? ws->out_held_size * 2 : 8;
+    ws->out_held = onion_low_realloc(ws->out_held,
+                                     ws->out_held_size *
+                                     sizeof(onion_websocket_frame *));
+  }
+  __sync_add_and_fetch(&frame->refcount, 1);
+  ws->out_held[ws->out_nheld++] = frame;
+  ws->out_bytes += frame->length;
+}
+
+/// Queues the shared frames held while a fragmented message was written.
+static void onion_websocket_out_release(onion_websocket * ws) {
+  int i;
+  for (i = 0; i < ws->out_nheld; i++) {
+    onion_websocket_frame *frame = ws->out_held[i];
+#ifdef HAVE_ZLIB
+    if (frame->data[0] & ONION_WEBSOCKET_RSV1)  // The client window gets what our compressor did not see
+      ws->deflate->out_reset = true;
+#endif
+    ws->out_bytes -= frame->length;
+    onion_websocket_out_push(ws, frame);
+    onion_websocket_frame_free(frame);
+  }
+  ws->out_nheld = 0;
+}
+
+/**
+ * @short Sends data, if possible without blocking.
+ *
+ * Only plain sockets, or HTTPS with kTLS, can be written without blocking. Other listen
+ * points write as usual.
+ *
+ * @returns the bytes written, 0 if it would block, or <0 on error.
+ */
+static ssize_t onion_websocket_send_iov(onion_websocket * ws,
+                                        struct iovec *iov, int n, bool block) {
+  onion_request *req = ws->req;
+  onion_listen_point *lp = req->connection.listen_point;
+  ssize_t w;
+  if (!block && (lp->write == onion_http_write || req->connection.fd_plaintext)
+      && req->connection.fd >= 0) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+    w = sendmsg(req->connection.fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      return 0;
+  } else {
+    if (lp->writev)
+      w = lp->writev(req, iov, n);
+    else
+      w = lp->write(req, iov->iov_base, iov->iov_len);
+    if (w > 0 && lp->flush && lp->flush(req) < 0)
+      w = -1;
+  }
+  if (w <= 0) {
+    ONION_DEBUG("Error writing to websocket (%s)", strerror(errno));
+    return -1;
+  }
+  return w;
+}
+
+/// Marks the output as failed, and shuts down the connection so its thread closes it.
+static void onion_websocket_out_abort(onion_websocket * ws) {
+  ws->out_closed = true;
+  onion_websocket_out_clear(ws);
+  if (ws->req->connection.fd >= 0)
+    shutdown(ws->req->connection.fd, SHUT_RDWR);
+}
+
+/**
+ * @short Sends the output queue. Must be called with the output lock.
+ *
+ * Only one thread sends at a time. If another is at it, it also sends what is queued now, so
+ * this returns at once. The lock is released while sending, so other threads can queue more.
+ *
+ * @param block If it may block; else it stops when the connection would block.
+ * @returns 0 if ok, maybe with data still queued, or <0 if the connection failed.
+ */
+static int onion_websocket_out_flush(onion_websocket * ws, bool block) {
+  if (ws->out_closed)
+    return -1;
+  if (ws->out_writing)
+    return 0;
+  ws->out_writing = true;
+  int ret = 0;
+  while (ws->out_count) {
+    struct iovec iov[ONION_WEBSOCKET_OUT_IOV];
+    int n;
+    for (n = 0; n < ws->out_count && n < ONION_WEBSOCKET_OUT_IOV; n++) {
+      struct onion_websocket_out_t *o = &ws->out[ws->out_first + n];
+      iov[n].iov_base = &o->frame->data[o->pos];
+      iov[n].iov_len = o->frame->length - o->pos;
+    }
+    onion_websocket_out_unlock(ws);
+    ssize_t w = onion_websocket_send_iov(ws, iov, n, block);
+    onion_websocket_out_lock(ws);
+    if (w < 0) {
+      onion_websocket_out_abort(ws);
+      ret = -1;
+      break;
+    }
+    if (w == 0)
+      break;
+    onion_websocket_out_consume(ws, w);
+  }
+  ws->out_writing = false;
+  return ret;
+}
+
 /**
- * @short Writes a fragment to the websocket
+ * @short If there is output queued, waits for the connection to be writable to send it.
+ *
+ * Must be called with the output lock. If the thread of the connection is busy, it does it
+ * when it finishes. Else the poller is rearmed from this thread; if the connection thread is
+ * still returning from its handler, the poller applies the type when it returns.
+ */
+static void onion_websocket_out_wait(onion_websocket * ws) {
+  onion_poller_slot *slot = ws->req->connection.slot;
+  if (!ws->polled || !slot || !ws->out_count || ws->out_armed || ws->busy
+      || ws->out_closed)
+    return;
+  ws->out_armed = true;
+  onion_poller_slot_set_type(slot, O_POLL_READ | O_POLL_WRITE);
+  onion_poller_rearm(ws->req->connection.listen_point->server->poller, slot);
+}
+
+/**
+ * @short Queues a shared frame for sending, and sends what is possible without blocking
  * @memberof onion_websocket_t
  * @ingroup websocket
  *
- * @param ws The Websocket
- * @param buffer Data to write
- * @param _len Length of data to write
- * @returns Bytes written or <0 if error writting.
+ * It can be called from any thread. Data that can not be sent now stays at the output queue
+ * of the websocket, and is sent when the connection is writable. Normally used through
+ * onion_websocket_hub_publish.
+ *
+ * If a fragmented message is being written (onion_websocket_write_fragment), the frame is
+ * held until its last fragment, as frames of other messages can not go in between.
+ *
+ * Over plain HTTP it never blocks. Other listen points, as HTTPS, may block to write.
+ *
+ * @param ws The websocket
+ * @param frame The frame, from onion_websocket_frame_new. A reference is kept until sent.
+ * @param max_backlog Max bytes at the output queue. If the frame does not fit it is not
+ *   queued. 0 for no limit.
+ * @returns 0 if sent or queued, -1 if it does not fit at the backlog, -2 if the connection
+ *   is failing.
+ */
+int onion_websocket_write_shared(onion_websocket * ws,
+                                 onion_websocket_frame * frame,
+                                 size_t max_backlog) {
+  int ret = 0;
+  onion_websocket_out_lock(ws);
+#ifdef HAVE_ZLIB
+  // Only if the client window is big enough for a frame compressed with a 32KB window
+  if (ws->deflate && ws->deflate->window_bits == 15 && !ws->out_closed)
+    frame = onion_websocket_frame_get_deflated(frame);
+#endif
+  if (ws->out_closed)
+    ret = -2;
+  else if (max_backlog && (ws->out_count || ws->out_nheld)
+           && ws->out_bytes + frame->length > max_backlog)
+    ret = -1;
+  else if (ws->out_fragmented)
+    onion_websocket_out_hold(ws, frame);
+  else {
+#ifdef HAVE_ZLIB
+    if (frame->data[0] & ONION_WEBSOCKET_RSV1)  // The client window gets what our compressor did not see
+      ws->deflate->out_reset = true;
+#endif
+    onion_websocket_out_push(ws, frame);
+    if (onion_websocket_out_flush(ws, false) < 0)
+      ret = -2;
+    else
+      onion_websocket_out_wait(ws);
+  }
+  onion_websocket_out_unlock(ws);
+  return ret;
+}
+
+/// Notes that the websocket is subscribed at the hub, so it unsubscribes when freed. Used by websocket_hub.c.
+void onion_websocket_add_hub(onion_websocket * ws, onion_websocket_hub * hub) {
+  onion_websocket_out_lock(ws);
+  int i;
+  for (i = 0; i < ws->nhubs && ws->hubs[i] != hub; i++) ;
+  if (i == ws->nhubs) {
+    ws->hubs =
+        onion_low_realloc(ws->hubs,
+                          (ws->nhubs + 1) * sizeof(onion_websocket_hub *));
+    ws->hubs[ws->nhubs++] = hub;
+  }
+  onion_websocket_out_unlock(ws);
+}
+
+/// Notes that the websocket is not at the hub anymore. Used by websocket_hub.c.
+void onion_websocket_remove_hub(onion_websocket * ws, onion_websocket_hub * hub) {
+  onion_websocket_out_lock(ws);
+  int i;
+  for (i = 0; i < ws->nhubs; i++) {
+    if (ws->hubs[i] == hub) {
+      ws->hubs[i] = ws->hubs[--ws->nhubs];
+      break;
+    }
+  }
+  onion_websocket_out_unlock(ws);
+}
+
+/**
+ * @short Closes the websocket connection from any thread
+ * @memberof onion_websocket_t
+ * @ingroup websocket
+ *
+ * Discards the output queue and shuts the connection down, so its own thread closes it and
+ * frees the websocket.
  */
-int onion_websocket_write(onion_websocket * ws, const char *buffer, size_t _len) {
+void onion_websocket_abort(onion_websocket * ws) {
+  onion_websocket_out_lock(ws);
+  if (!ws->out_closed)
+    onion_websocket_out_abort(ws);
+  onion_websocket_out_unlock(ws);
+}
+
+/**
+ * @short Bytes queued to send at the websocket
+ * @memberof onion_websocket_t
+ * @ingroup websocket
+ */
+size_t onion_websocket_backlog(onion_websocket * ws) {
+  onion_websocket_out_lock(ws);
+  size_t ret = ws->out_bytes;
+  onion_websocket_out_unlock(ws);
+  return ret;
+}
+
+/**
+ * @short Writes a whole frame.
+ *
+ * Header and payload go out with a single writev, with no copies. If the listen point has no
+ * writev small frames are copied after the header, and big ones are written with a write for
+ * the header and another for the payload.
+ *
+ * If there is output queued, the frame is queued after it, and all is sent.
+ *
+ * If opcode has ONION_WEBSOCKET_DEFLATE, the payload is compressed first.
+ *
+ * @returns len, or <0 on error.
+ */
+static ssize_t onion_websocket_write_frame(onion_websocket * ws, int opcode,
+                                           int fin, const char *buffer,
+                                           size_t len) {
   if (!ws->req) {               // should not happen....
     ONION_DEBUG("no request in websocket@%p", ws);
     return -1;
   }
-  lpwriter_sig_t *lpwriter = ws->req->connection.listen_point->write;
-  ssize_t len = _len;           // I need it signed here
-  if (!lpwriter) {
+  onion_listen_point *lp = ws->req->connection.listen_point;
+  if (!lp->write) {
     ONION_DEBUG("no listen point writer for websocket@%p", ws);
     return -1;
   }
-  //ONION_DEBUG("Write %d bytes",len);
-  {
-    char header[16];
-    int hlen = 2;
-    header[0] = 0x80 | (ws->opcode & 0x0F);     // Also final in fragment.
-    header[1] = 0x00;           // Do not mask on send
-    if (len < 126)
-      header[1] |= len;
-    else if (len < 0x0FFFF) {
-      header[1] |= 126;
-      header[2] = (len >> 8) & 0x0FF;
-      header[3] = (len) & 0x0FF;
-      hlen += 2;
-    } else {
-      header[1] |= 127;
-      int i;
-      int tlen = len;
-      for (i = 0; i < 8; i++) {
-        header[3 + 8 - i] = tlen & 0x0FF;
-        tlen >>= 8;
+  ssize_t ret = len;
+  char *deflated = NULL;
+  onion_websocket_out_lock(ws);
+  if (ws->out_closed) {
+    onion_websocket_out_unlock(ws);
+    return -1;
+  }
+#ifdef HAVE_ZLIB
+  if (opcode & ONION_WEBSOCKET_DEFLATE) {       // Under the lock, so compressed in the order sent
+    opcode &= ~ONION_WEBSOCKET_DEFLATE;
+    deflated = onion_websocket_deflate(ws, buffer, len, fin, &len);
+    if (!deflated) {
+      onion_websocket_out_unlock(ws);
+      return -1;
+    }
+    buffer = deflated;
+  }
+#endif
+  if ((opcode & 0x0F) < OWS_CONNECTION_CLOSE)  // Data, not control frames in between
+    ws->out_fragmented = !fin;
+  if (ws->out_count || ws->out_writing || ws->out_nheld) {      // Keep the order with the queued frames
+    onion_websocket_frame *frame =
+        onion_websocket_frame_new_fragment(opcode, fin, buffer, len);
+    onion_websocket_out_push(ws, frame);
+    onion_websocket_frame_free(frame);
+    if (!ws->out_fragmented)
+      onion_websocket_out_release(ws);
+    int r = onion_websocket_out_flush(ws, true);
+    onion_websocket_out_unlock(ws);
+    onion_low_free(deflated);
+    return r < 0 ? -1 : ret;
+  }
+  ws->out_writing = true;
+  onion_websocket_out_unlock(ws);
+
+  char header[ONION_WEBSOCKET_MAX_HEADER + ONION_WEBSOCKET_SMALL_FRAME];
+  int hlen = onion_websocket_frame_header(header, opcode, fin, len);
+  struct iovec iov[2];
+  int n = 2;
+  iov[0].iov_base = header;
+  iov[0].iov_len = hlen;
+  iov[1].iov_base = (char *)buffer;
+  iov[1].iov_len = len;
+  if (len == 0)
+    n = 1;
+  else if (!lp->writev && len <= ONION_WEBSOCKET_SMALL_FRAME) {
+    memcpy(&header[hlen], buffer, len);
+    iov[0].iov_len += len;
+    n = 1;
+  }
+  int r = onion_websocket_write_iov(ws->req, iov, n);
+
+  onion_websocket_out_lock(ws);
+  ws->out_writing = false;
+  if (r < 0)
+    onion_websocket_out_abort(ws);
+  else if (ws->out_count) {     // Queued by others meanwhile
+    onion_websocket_out_flush(ws, false);
+    onion_websocket_out_wait(ws);
+  }
+  onion_websocket_out_unlock(ws);
+  onion_low_free(deflated);
+  if (r < 0)
+    return -1;
+  return ret;
+}
+
+/**
+ * @short Writes a message to the websocket, as a single frame
+ * @memberof onion_websocket_t
+ * @ingroup websocket
+ *
+ * It uses the current opcode (see onion_websocket_set_opcode). If a fragmented message was
+ * started with onion_websocket_write_fragment, this is its last fragment.
+ *
+ * @param ws The Websocket
+ * @param buffer Data to write
+ * @param len Length of data to write
+ * @returns Bytes written or <0 if error writting.
+ */
+int onion_websocket_write(onion_websocket * ws, const char *buffer, size_t len) {
+  return onion_websocket_write_fragment(ws, buffer, len, 1);
+}
+
+/**
+ * @short Writes a fragment of a message to the websocket
+ * @memberof onion_websocket_t
+ * @ingroup websocket
+ *
+ * Allows streaming messages of unknown or big size, without having them whole in memory. The
+ * first fragment is sent with the current opcode, and next ones as continuations, until one
+ * is written with fin set. Ping, pong and close frames may be sent in between, as the
+ * protocol allows.
+ *
+ * With permessage-deflate each fragment is compressed and flushed, so it arrives at once.
+ *
+ * @code
+ *   onion_websocket_write_fragment(ws, part1, len1, 0);
+ *   onion_websocket_write_fragment(ws, part2, len2, 0);
+ *   onion_websocket_write_fragment(ws, part3, len3, 1);
+ * @endcode
+ *
+ * @param ws The Websocket
+ * @param buffer Data to write
+ * @param len Length of data to write
+ * @param fin If this is the last fragment of the message.
+ * @returns Bytes written or <0 if error writting.
+ */
+int onion_websocket_write_fragment(onion_websocket * ws, const char *buffer,
+                                   size_t len, int fin) {
+  int opcode = ws->out_fragmented ? OWS_CONTINUATION : ws->opcode;
+#ifdef HAVE_ZLIB
+  struct onion_websocket_deflate_t *d = ws->deflate;
+  if (d && (opcode == OWS_TEXT || opcode == OWS_BINARY))        // Small messages only get smaller with the previous ones as context
+    d->out_message = !fin || len >= ONION_WEBSOCKET_DEFLATE_MIN
+        || !(d->flags & OWD_SERVER_NO_CONTEXT_TAKEOVER);
+  if (d && d->out_message && opcode < OWS_CONNECTION_CLOSE) {
+    opcode |= ONION_WEBSOCKET_DEFLATE;
+    if (opcode != (OWS_CONTINUATION | ONION_WEBSOCKET_DEFLATE))
+      opcode |= ONION_WEBSOCKET_RSV1;
+  }
+#endif
+  return onion_websocket_write_frame(ws, opcode, fin, buffer, len);
+}
+
+/// Initial space at the input buffer.
+#define ONION_WEBSOCKET_READ_SIZE 4096
+
+/**
+ * @short Parses the frame header at the input buffer.
+ *
+ * @returns the header length, or 0 if it is not complete yet. At payload the payload length.
+ */
+static int onion_websocket_parse_header(onion_websocket * ws,
+                                        uint64_t * payload) {
+  const unsigned char *p = (const unsigned char *)&ws->in[ws->in_pos];
+  size_t avail = ws->in_len - ws->in_pos;
+  if (avail < 2)
+    return 0;
+  int hlen = 2;
+  uint64_t len = p[1] & 0x7F;
+  if (len == 126) {
+    hlen = 4;
+    if (avail < hlen)
+      return 0;
+    len = (p[2] << 8) | p[3];
+  } else if (len == 127) {
+    hlen = 10;
+    if (avail < hlen)
+      return 0;
+    len = 0;
+    int i;
+    for (i = 0; i < 8; i++)
+      len = (len << 8) | p[2 + i];
+  }
+  if (p[1] & 0x80)
+    hlen += 4;
+  if (avail < hlen)
+    return 0;
+  *payload = len;
+  return hlen;
+}
+
+/**
+ * @short Unmasks the data in place, continuing at ws->mask_pos.
+ *
+ * The mask is rotated to mask_pos and repeated to 16 bytes. As that is a multiple of 4 the
+ * rotation holds for every block, so most data is XORed with SSE2 vectors or 64 bit words.
+ */
+static void onion_websocket_unmask(onion_websocket * ws, char *data,
+                                   size_t len) {
+  unsigned char m[16];
+  size_t i = 0;
+  for (i = 0; i < sizeof(m); i++)
+    m[i] = ws->mask[(ws->mask_pos + i) & 3];
+  i = 0;
+#if defined(__SSE2__)
+  const __m128i vm = _mm_loadu_si128((const __m128i *)m);
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)&data[i]);
+    _mm_storeu_si128((__m128i *) & data[i], _mm_xor_si128(x, vm));
+  }
+#endif
+  uint64_t wm;
+  memcpy(&wm, m, sizeof(wm));
+  for (; i + 8 <= len; i += 8) {
+    uint64_t x;
+    memcpy(&x, &data[i], sizeof(x));
+    x ^= wm;
+    memcpy(&data[i], &x, sizeof(x));
+  }
+  for (; i < len; i++)
+    data[i] ^= m[i & 3];
+  ws->mask_pos = (ws->mask_pos + len) & 3;
+}
+
+/**
+ * @short Does one read into the input buffer.
+ *
+ * Processed data is discarded first, and there is room for at least need bytes from in_pos,
+ * so a read may get many small frames at once.
+ *
+ * @returns the bytes read, or <=0 if closed or on error.
+ */
+static ssize_t onion_websocket_fill(onion_websocket * ws, size_t need) {
+  lpreader_sig_t *lpreader = ws->req->connection.listen_point->read;
+  if (ws->in_pos) {
+    memmove(ws->in, &ws->in[ws->in_pos], ws->in_len - ws->in_pos);
+    ws->in_len -= ws->in_pos;
+    ws->in_pos = 0;
+  }
+  size_t want = ws->in_len + ONION_WEBSOCKET_READ_SIZE;
+  if (need > want)
+    want = need;
+  if (ws->in_size < want) {
+    ws->in = onion_low_realloc(ws->in, want);
+    ws->in_size = want;
+  }
+  ssize_t r = (*lpreader) (ws->req, &ws->in[ws->in_len],
+                           ws->in_size - ws->in_len);
+  if (r > 0)
+    ws->in_len += r;
+  return r;
+}
+
+/**
+ * @short Starts the frame whose header, of hlen bytes, is at the input buffer.
+ *
+ * @returns the frame opcode. Continuations and control frames keep the message opcode at
+ * ws->opcode.
+ */
+static onion_websocket_opcode onion_websocket_start_frame(onion_websocket * ws,
+                                                          int hlen,
+                                                          uint64_t payload) {
+  const unsigned char *p = (const unsigned char *)&ws->in[ws->in_pos];
+  onion_websocket_opcode opcode = p[0] & 0x0F;
+  ws->flags = 0;
+  if (p[0] & 0x80)
+    ws->flags |= WS_FIN;
+  if (p[0] & ONION_WEBSOCKET_RSV1)
+    ws->flags |= WS_RSV1;
+  if (p[1] & 0x80) {
+    ws->flags |= WS_MASK;
+    memcpy(ws->mask, &p[hlen - 4], 4);
+  }
+  ws->mask_pos = 0;
+  ws->in_pos += hlen;
+  ws->data_left = payload;
+  if (opcode == OWS_TEXT || opcode == OWS_BINARY)
+    ws->opcode = opcode;
+  return opcode;
+}
+
+#ifdef HAVE_ZLIB
+/// Parses a window bits parameter value. Returns -1 if not valid.
+static int onion_websocket_deflate_bits(const char *value) {
+  if (!value || !value[0] || strlen(value) > 2 || !isdigit(value[0])
+      || (value[1] && !isdigit(value[1])))
+    return -1;
+  int bits = atoi(value);
+  return (bits >= 8 && bits <= 15) ? bits : -1;
+}
+
+/// Removes spaces and quotes around str, in place.
+static char *onion_websocket_deflate_trim(char *str) {
+  while (*str == ' ' || *str == '\t' || *str == '"')
+    str++;
+  char *end = str + strlen(str);
+  while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '"'))
+    end--;
+  *end = 0;
+  return str;
+}
+
+/**
+ * @short Accepts the first permessage-deflate offer at Sec-Websocket-Extensions that fits.
+ *
+ * Offers with unknown or repeated parameters are declined, and also the ones that need a
+ * 256 bytes window at the server, as zlib can not compress with it.
+ *
+ * @param response Gets the value of the extensions header of the response.
+ * @returns the state, or NULL if disabled, not offered, or no offer fits.
+ */
+static struct onion_websocket_deflate_t
+*onion_websocket_deflate_negotiate(onion_request * req, char *response,
+                                  size_t size) {
+  onion_listen_point *lp = req->connection.listen_point;
+  if (!lp || !lp->server || !lp->server->websocket_deflate_bits)
+    return NULL;
+  const char *header =
+      onion_request_get_header(req, "Sec-Websocket-Extensions");
+  if (!header)
+    return NULL;
+
+  struct onion_websocket_deflate_t *d = NULL;
+  char *offers = onion_low_strdup(header);
+  char *save_offer = NULL, *offer;
+  for (offer = strtok_r(offers, ",", &save_offer); offer && !d;
+       offer = strtok_r(NULL, ",", &save_offer)) {
+    char *save_param = NULL;
+    char *param = strtok_r(offer, ";", &save_param);
+    if (!param
+        || strcmp(onion_websocket_deflate_trim(param),
+                  "permessage-deflate") != 0)
+      continue;
+    int bits = lp->server->websocket_deflate_bits;
+    int flags = lp->server->websocket_deflate_flags;
+    int seen = 0;               // Bit for each parameter, as they can not repeat.
+    bool bits_offered = false, ok = true;
+    while (ok && (param = strtok_r(NULL, ";", &save_param))) {
+      char *value = strchr(param, '=');
+      if (value) {
+        *value++ = 0;
+        value = onion_websocket_deflate_trim(value);
       }
-      hlen += 8;
+      param = onion_websocket_deflate_trim(param);
+      int n = onion_websocket_deflate_bits(value);
+      if (strcmp(param, "server_no_context_takeover") == 0 && !value
+          && !(seen & 1)) {
+        seen |= 1;
+        flags |= OWD_SERVER_NO_CONTEXT_TAKEOVER;
+      } else if (strcmp(param, "client_no_context_takeover") == 0 && !value
+                 && !(seen & 2)) {
+        seen |= 2;
+        flags |= OWD_CLIENT_NO_CONTEXT_TAKEOVER;
+      } else if (strcmp(param, "server_max_window_bits") == 0 && n > 0
+                 && !(seen & 4)) {
+        seen |= 4;
+        bits_offered = true;
+        if (n < 9)
+          ok = false;
+        else if (n < bits)
+          bits = n;
+      } else if (strcmp(param, "client_max_window_bits") == 0
+                 && (!value || n > 0) && !(seen & 8)) {
+        seen |= 8;              // Inflate always uses 32KB, so any is fine.
+      } else
+        ok = false;
+    }
+    if (!ok)
+      continue;
+
+    snprintf(response, size, "permessage-deflate%s%s",
+             (flags & OWD_SERVER_NO_CONTEXT_TAKEOVER) ?
+             "; server_no_context_takeover" : "",
+             (flags & OWD_CLIENT_NO_CONTEXT_TAKEOVER) ?
+             "; client_no_context_takeover" : "");
+    if (bits_offered) {
+      size_t l = strlen(response);
+      snprintf(&response[l], size - l, "; server_max_window_bits=%d", bits);
     }
+    d = onion_low_calloc(1, sizeof(struct onion_websocket_deflate_t));
+    d->window_bits = bits;
+    d->flags = flags;
+  }
+  onion_low_free(offers);
+  if (d)
+    ONION_DEBUG("Websocket permessage-deflate: %s", response);
+  return d;
+}
 
-    /*
-       int i;
-       for(i=0;i<hlen;i++){
-       ONION_DEBUG("%d: %02X", i, header[i]&0x0FF);
-       }
-     */
+static void onion_websocket_deflate_free(struct onion_websocket_deflate_t *d) {
+  if (d->out_init)
+    deflateEnd(&d->out);
+  if (d->in_init)
+    inflateEnd(&d->in);
+  onion_low_free(d->data);
+  onion_low_free(d);
+}
 
-    (*lpwriter) (ws->req, header, hlen);
+/**
+ * @short Compresses the data with a sync flush, so all can be decompressed at the other side.
+ *
+ * At the end of a message the 0x00 0x00 0xFF 0xFF that the flush leaves is removed, as the
+ * receiver adds it back.
+ *
+ * @returns a new buffer with the compressed data, of *outlen bytes.
+ */
+static char *onion_websocket_deflate_data(z_stream * z, const char *data,
+                                          size_t len, int fin,
+                                          size_t *outlen) {
+  size_t size = len + len / 8 + 64, n = 0;
+  char *out = onion_low_scalar_malloc(size);
+  z->next_in = (Bytef *) data;
+  z->avail_in = len;
+  for (;;) {
+    z->next_out = (Bytef *) & out[n];
+    z->avail_out = size - n;
+    deflate(z, Z_SYNC_FLUSH);
+    n = size - z->avail_out;
+    if (z->avail_out)
+      break;
+    size *= 2;
+    out = onion_low_realloc(out, size);
   }
-  /// FIXME! powerup using int32_t as basic type.
-  int ret = 0;
-  int i, j;
-  char tout[1024];
-  for (i = 0; i < len - 1024; i += 1024) {
-    for (j = 0; j < sizeof(tout); j++) {
-      //ONION_DEBUG("At %d, %02X ^ %02X = %02X", (i+j)&1023, buffer[i+j]&0x0FF, mask[j&3]&0x0FF, (buffer[i]^mask[j&3])&0x0FF);
-      tout[j] = buffer[i + j];
+  if (fin && n >= 4 && memcmp(&out[n - 4], "\x00\x00\xff\xff", 4) == 0)
+    n -= 4;
+  *outlen = n;
+  return out;
+}
+
+/**
+ * @short Compresses a fragment of the current outgoing message. Must be called with the output lock.
+ *
+ * The lock keeps the compression order the same as the sending order, so the client
+ * window is what the compressor expects.
+ *
+ * @returns a new buffer with the compressed data, or NULL on error.
+ */
+static char *onion_websocket_deflate(onion_websocket * ws, const char *data,
+                                     size_t len, int fin, size_t *outlen) {
+  struct onion_websocket_deflate_t *d = ws->deflate;
+  if (!d->out_init) {
+    if (deflateInit2(&d->out, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     -d->window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      ONION_ERROR("Could not init websocket compression");
+      return NULL;
+    }
+    d->out_init = true;
+  } else if (d->out_reset)
+    deflateReset(&d->out);
+  d->out_reset = false;
+  char *ret = onion_websocket_deflate_data(&d->out, data, len, fin, outlen);
+  if (fin && (d->flags & OWD_SERVER_NO_CONTEXT_TAKEOVER))
+    d->out_reset = true;
+  return ret;
+}
+
+/// Inflates data at the end of the inflate buffer. Returns 0 if ok, <0 on error or if over max.
+static int onion_websocket_inflate_data(struct onion_websocket_deflate_t *d,
+                                        const char *data, size_t len,
+                                        size_t max) {
+  d->in.next_in = (Bytef *) data;
+  d->in.avail_in = len;
+  for (;;) {
+    if (d->len == d->size) {
+      d->size = d->size ? d->size * 2 : ONION_WEBSOCKET_READ_SIZE;
+      d->data = onion_low_realloc(d->data, d->size);
+    }
+    d->in.next_out = (Bytef *) & d->data[d->len];
+    d->in.avail_out = d->size - d->len;
+    int r = inflate(&d->in, Z_SYNC_FLUSH);
+    d->len = d->size - d->in.avail_out;
+    if (d->message_len + d->len > max) {
+      ONION_ERROR("Websocket message too big once inflated. Limit %lu bytes.",
+                  (unsigned long)max);
+      return -1;
     }
-    ret += (*lpwriter) (ws->req, tout, sizeof(tout));
+    if (r == Z_STREAM_END) {    // Ended with a final block. Next data starts a new stream.
+      inflateReset(&d->in);
+      if (!d->in.avail_in)
+        break;
+      continue;
+    }
+    if (r != Z_OK && r != Z_BUF_ERROR) {
+      ONION_ERROR("Error inflating websocket message (%d)", r);
+      return -1;
+    }
+    if (d->in.avail_out)        // All input used
+      break;
+  }
+  return 0;
+}
+
+/**
+ * @short Inflates the payload of the current frame, that must be whole at the input buffer.
+ *
+ * Then reads get the inflated data, and data_left is its length.
+ *
+ * @returns 0 if ok, <0 on error.
+ */
+static int onion_websocket_inflate_frame(onion_websocket * ws) {
+  struct onion_websocket_deflate_t *d = ws->deflate;
+  if (!d->in_init) {
+    if (inflateInit2(&d->in, -15) != Z_OK) {
+      ONION_ERROR("Could not init websocket decompression");
+      return -1;
+    }
+    d->in_init = true;
   }
-  for (; i < len; i++) {
-    //ONION_DEBUG("At %d, %02X ^ %02X = %02X", i&1023, buffer[i]&0x0FF, mask[i&3]&0x0FF, (buffer[i]^mask[i&3])&0x0FF);
-    tout[i & 1023] = buffer[i];
+  char *payload = &ws->in[ws->in_pos];
+  size_t len = ws->data_left;
+  if (ws->flags & WS_MASK) {
+    onion_websocket_unmask(ws, payload, len);
+    ws->flags &= ~WS_MASK;
   }
+  size_t max = ws->req->connection.listen_point->server->max_post_size;
+  d->len = d->pos = 0;
+  int r = onion_websocket_inflate_data(d, payload, len, max);
+  if (r == 0 && (ws->flags & WS_FIN))
+    r = onion_websocket_inflate_data(d, "\x00\x00\xff\xff", 4, max);
+  ws->in_pos += len;
+  if (r < 0)
+    return r;
+  d->message_len += d->len;
+  ws->flags |= WS_INFLATED;
+  ws->data_left = d->len;
+  return 0;
+}
+
+/**
+ * @short The shared frame compressed on its own, to send it to websockets with permessage-deflate.
+ *
+ * It is compressed once, when first needed, and kept with the frame. If it does not get
+ * smaller, or the frame is small or not a whole message, it is the frame itself.
+ */
+static onion_websocket_frame
+*onion_websocket_frame_get_deflated(onion_websocket_frame * frame) {
+  onion_websocket_frame *d = frame->deflated;
+  if (d)
+    return d;
+  d = frame;
+  size_t len = frame->length - frame->hlen;
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if (frame->shared && len >= ONION_WEBSOCKET_DEFLATE_MIN
+      && deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                      Z_DEFAULT_STRATEGY) == Z_OK) {
+    size_t n;
+    char *data =
+        onion_websocket_deflate_data(&z, &frame->data[frame->hlen], len, 1,
+                                     &n);
+    deflateEnd(&z);
+    if (n < len)
+      d = onion_websocket_frame_new_fragment((frame->data[0] & 0x0F) |
+                                             ONION_WEBSOCKET_RSV1, 1, data,
+                                             n);
+    onion_low_free(data);
+  }
+  if (!__sync_bool_compare_and_swap(&frame->deflated, NULL, d)) {       // Another thread did it meanwhile
+    if (d != frame)
+      onion_websocket_frame_free(d);
+    d = frame->deflated;
+  }
+  return d;
+}
+
+/// Reads from the inflated frame.
+static size_t onion_websocket_read_inflated(onion_websocket * ws,
+                                            char *buffer, size_t len) {
+  struct onion_websocket_deflate_t *d = ws->deflate;
+  if (len > ws->data_left)
+    len = ws->data_left;
+  memcpy(buffer, &d->data[d->pos], len);
+  d->pos += len;
+  ws->data_left -= len;
+  return len;
+}
+#else
+static struct onion_websocket_deflate_t
+*onion_websocket_deflate_negotiate(onion_request * req, char *response,
+                                  size_t size) {
+  return NULL;
+}
 
-  return (*lpwriter) (ws->req, tout, len & 1023);
+static void onion_websocket_deflate_free(struct onion_websocket_deflate_t *d) {
+}
+#endif
+
+/**
+ * @short Checks if the data frame just started is compressed.
+ *
+ * @returns 1 if it is, 0 if not, or <0 if it can not be: it is marked so but compression
+ *   was not negotiated, or it is a continuation.
+ */
+static int onion_websocket_frame_is_deflated(onion_websocket * ws,
+                                             onion_websocket_opcode opcode) {
+#ifdef HAVE_ZLIB
+  struct onion_websocket_deflate_t *d = ws->deflate;
+  if (d && (opcode == OWS_TEXT || opcode == OWS_BINARY)) {
+    d->in_message = (ws->flags & WS_RSV1) != 0;
+    d->message_len = 0;
+    return d->in_message;
+  }
+  if (!(ws->flags & WS_RSV1))
+    return (d && opcode == OWS_CONTINUATION) ? d->in_message : 0;
+#else
+  if (!(ws->flags & WS_RSV1))
+    return 0;
+#endif
+  ONION_ERROR("Websocket frame with RSV1 set, but it can not be compressed");
+  return -1;
 }
 
 /**
@@ -264,40 +1345,65 @@ int onion_websocket_read(onion_websocket * ws, char *buffer, size_t len) {
     return -1;
   }
   //ONION_DEBUG("Please, read %d bytes, %d ready", len, ws->data_left);
-  if (ws->data_left == 0) {
-    onion_connection_status status;
-    if ((status = onion_websocket_read_packet_header(ws)) < 0) {
-      if (status == -2)
-        return -2;
-      ONION_ERROR("Error reading websocket header (%i)", status);
-      return -1;
-    }
+  if (ws->polled) {             // Only from the current frame, that is already at the input buffer. Never blocks.
+#ifdef HAVE_ZLIB
+    if (ws->flags & WS_INFLATED)
+      return onion_websocket_read_inflated(ws, buffer, len);
+#endif
+    if (len > ws->data_left)
+      len = ws->data_left;
+    memcpy(buffer, &ws->in[ws->in_pos], len);
+    if (ws->flags & WS_MASK)
+      onion_websocket_unmask(ws, buffer, len);
+    ws->in_pos += len;
+    ws->data_left -= len;
+    return len;
   }
-
-  size_t left_len = 0;
-  if (len > ws->data_left) {
-    left_len = len - ws->data_left;
-    len = ws->data_left;
-    //ONION_DEBUG("Read %d bytes now, %d bytes later", len, left_len);
-  }
-  int r = (*lpreader) (ws->req, buffer, len);
-  if (ws->flags & WS_MASK) {
-    char *p = buffer;
-    int i;
-    for (i = 0; i < r; i++) {
-      *p = *p ^ ws->mask[(ws->mask_pos++) & 3];
-      p++;
+  size_t done = 0;
+  while (done < len) {
+    if (ws->data_left == 0) {
+      onion_connection_status status;
+      if ((status = onion_websocket_read_packet_header(ws)) < 0) {
+        if (done)
+          return done;
+        if (status == -2)
+          return -2;
+        ONION_ERROR("Error reading websocket header (%i)", status);
+        return -1;
+      }
+      if (ws->data_left == 0)   // Empty or control frame
+        continue;
     }
+#ifdef HAVE_ZLIB
+    if (ws->flags & WS_INFLATED) {
+      done += onion_websocket_read_inflated(ws, &buffer[done], len - done);
+      continue;
+    }
+#endif
+    size_t n = len - done;
+    if (n > ws->data_left)
+      n = ws->data_left;
+    ssize_t r;
+    size_t avail = ws->in_len - ws->in_pos;
+    if (avail) {
+      r = n < avail ? n : avail;
+      memcpy(&buffer[done], &ws->in[ws->in_pos], r);
+      ws->in_pos += r;
+    } else {                    // Nothing buffered, big reads go directly to the user buffer
+      r = (*lpreader) (ws->req, &buffer[done], n);
+      if (r < 0 || (r == 0 && errno != 0)) {
+        ws->callback = NULL;    // Easy way to force close of websocket, which is ok as it closed.
+        return done ? done : r;
+      }
+    }
+    if (ws->flags & WS_MASK)
+      onion_websocket_unmask(ws, &buffer[done], r);
+    ws->data_left -= r;
+    done += r;
+    if (r < n)
+      break;
   }
-  ws->data_left -= r;
-
-  if (left_len && r == len)
-    r += onion_websocket_read(ws, &buffer[len], left_len);
-
-  if (r < 0 || (r == 0 && errno != 0)) {
-    ws->callback = NULL;        // Easy way to force close of websocket, which is ok as it closed.
-  }
-  return r;
+  return done;
 }
 
  /**
@@ -367,6 +1473,10 @@ int onion_websocket_printf(onion_websocket * ws, const char *fmt, ...) {
  * internal data, and the lenght of data ready to be read. In this callback the callback can be changed, so that next calls will
  * call that callback. If not all data is used, it will be called inmediatly on exit.
  *
+ * When the handler returns OCS_WEBSOCKET on a connection of the poller, the websocket is polled:
+ * no thread waits for it, and the callback is called when a full frame has arrived, with its
+ * length. Reads at the callback then return data of that frame only, and never block.
+ *
  * @param ws Websocket
  * @param cb The callback function to call: onion_connection_status callback_signature(void *data, onion_websocket *ws, size_t data_ready_len);
  */
@@ -401,107 +1511,112 @@ void onion_websocket_set_userdata(onion_websocket * ws, void *userdata,
 
 /**
  * @short Reads a packet header.
+ *
+ * It is read through the input buffer, so usually the same read gets the payload, and maybe
+ * next frames. Pings are answered, and pongs skipped.
  */
 static onion_connection_status
 onion_websocket_read_packet_header(onion_websocket * ws) {
-  char tmp[8];
-  unsigned char *utmp = (unsigned char *)tmp;
   if (!ws->req) {               // should not happen....
     ONION_DEBUG("no request in websocket@%p", ws);
     return OCS_CLOSE_CONNECTION;
   }
-  lpreader_sig_t *lpreader = ws->req->connection.listen_point->read;
-  if (!lpreader) {
+  if (!ws->req->connection.listen_point->read) {
     ONION_DEBUG("no listen point reader in websocket@%p", ws);
     return OCS_CLOSE_CONNECTION;
   }
-  int r = (*lpreader) (ws->req, tmp, 2);
-  //ONION_DEBUG("reading input r = %i", r);
-  if (r != 2) {
-    ONION_DEBUG("Error reading header");
-    return OCS_CLOSE_CONNECTION;
+  uint64_t payload;
+  int hlen;
+  while (!(hlen = onion_websocket_parse_header(ws, &payload))) {
+    if (onion_websocket_fill(ws, 0) <= 0) {
+      ONION_DEBUG("Error reading header");
+      return OCS_CLOSE_CONNECTION;
+    }
   }
+  onion_websocket_opcode opcode =
+      onion_websocket_start_frame(ws, hlen, payload);
+  ONION_DEBUG("Data left %d", (int)ws->data_left);
 
-  ws->flags = 0;
-  if (tmp[0] & 0x80)
-    ws->flags |= WS_FIN;
-  if (tmp[1] & 0x80)
-    ws->flags |= WS_MASK;
-  ws->opcode = tmp[0] & 0x0F;
-  ws->data_left = tmp[1] & 0x7F;
-  if (ws->data_left == 126) {
-    r = (*lpreader) (ws->req, tmp, 2);
-    if (r != 2) {
-      ONION_DEBUG("Error reading header");
+  if (opcode == OWS_PING || opcode == OWS_PONG
+      || opcode == OWS_CONNECTION_CLOSE) {
+    char data[125];
+    if (payload > sizeof(data)) {
+      ONION_ERROR("Websocket control frame too big (%lu bytes)",
+                  (unsigned long)payload);
       return OCS_CLOSE_CONNECTION;
     }
-    ONION_DEBUG("%d %d", utmp[0], utmp[1]);
-    ws->data_left = utmp[1] + utmp[0] * 256;
-  } else if (ws->data_left == 127) {
-    r = (*lpreader) (ws->req, tmp, 8);
-    //ONION_DEBUG("%d %d %d %d %d %d %d", utmp[0], utmp[1], utmp[2], utmp[3], utmp[4], utmp[5], utmp[6], utmp[7]);
-    if (r != 8) {
-      ONION_DEBUG("Error reading header");
+    int n = onion_websocket_read(ws, data, payload);
+    if (n != payload) {
+      ONION_DEBUG("Error reading control frame");
       return OCS_CLOSE_CONNECTION;
     }
-    ws->data_left = 0;
-    int i;
-    for (i = 0; i < 8; i++)
-      ws->data_left += ((uint64_t) utmp[i]) << ((7 - i) * 8);   // Maybe problematic on 32bits systems
-  }
-  ONION_DEBUG("Data left %d", ws->data_left);
-  if (ws->flags & WS_MASK) {
-    r = (*lpreader) (ws->req, ws->mask, 4);
-    //ONION_DEBUG("bytes read=%i", r);
-    if (r != 4) {
-      ONION_DEBUG("Error reading header (4)");
+    if (opcode == OWS_CONNECTION_CLOSE) {
+      ONION_DEBUG("Connection closed by client");
+      onion_websocket_close(ws, n >= 2 ? data : "\x03\xe8");
       return OCS_CLOSE_CONNECTION;
     }
-    ws->mask_pos = 0;
+    if (opcode == OWS_PING)     // I do answer ping myself.
+      onion_websocket_write_frame(ws, OWS_PONG, 1, data, n);
+    return OCS_NEED_MORE_DATA;
   }
 
-  if (ws->opcode == OWS_PING) { // I do answer ping myself.
-    onion_websocket_set_opcode(ws, OWS_PONG);
-    char *data = onion_low_scalar_malloc(ws->data_left);
-    ssize_t r = onion_websocket_read(ws, data, ws->data_left);
-
-    onion_websocket_write(ws, data, r);
-  }
-  if (ws->opcode == OWS_CONNECTION_CLOSE) {     // Closing connection
-    r = (*lpreader) (ws->req, tmp, 2);
-    if (r != 2) {
-      ONION_DEBUG("Error reading status code");
+  int deflated = onion_websocket_frame_is_deflated(ws, opcode);
+  if (deflated < 0)
+    return OCS_CLOSE_CONNECTION;
+#ifdef HAVE_ZLIB
+  if (deflated) {               // Needs the whole frame to inflate it
+    size_t max = ws->req->connection.listen_point->server->max_post_size;
+    if (payload > max) {
+      ONION_ERROR("Websocket frame too big (%lu bytes). Limit %lu bytes.",
+                  (unsigned long)payload, (unsigned long)max);
       return OCS_CLOSE_CONNECTION;
     }
-    char status[2];
-    status[0] = utmp[0] ^ ws->mask[0];
-    status[1] = utmp[1] ^ ws->mask[1];
-    ONION_DEBUG("Connection closed by client, status=%u",
-                (status[0] << 8) + status[1]);
-    onion_websocket_close(ws, (const char *)&status);
-    return OCS_CLOSE_CONNECTION;
+    while (ws->in_len - ws->in_pos < payload) {
+      if (onion_websocket_fill(ws, payload) <= 0) {
+        ONION_DEBUG("Error reading compressed frame");
+        return OCS_CLOSE_CONNECTION;
+      }
+    }
+    if (onion_websocket_inflate_frame(ws) < 0)
+      return OCS_CLOSE_CONNECTION;
   }
+#endif
   return OCS_NEED_MORE_DATA;
-  //ONION_DEBUG("Mask %02X %02X %02X %02X", ws->mask[0]&0x0FF, ws->mask[1]&0x0FF, ws->mask[2]&0x0FF, ws->mask[3]&0x0FF);
 }
 
 /**
  * @short Used internally when new data is ready on the websocket file descriptor.
  * @memberof onion_websocket_t
  * @ingroup websocket
+ *
+ * Blocks the thread until the websocket is closed. Only used when the connection is not at the
+ * poller, as with O_ONE; else onion_websocket_read_ready is called as data arrives.
  */
 onion_connection_status onion_websocket_call(onion_websocket * ws) {
   onion_connection_status ret = OCS_NEED_MORE_DATA;
   while (ret == OCS_NEED_MORE_DATA) {
-    if (ws->req->connection.fd > 0) {
+    if (ws->in_pos < ws->in_len) {
+      // Already read, for example several frames at once
+    } else if (ws->req->connection.fd > 0) {
       struct pollfd pfd;
       pfd.events = POLLIN;
       pfd.fd = ws->req->connection.fd;
+      onion_websocket_out_lock(ws);
+      if (ws->out_count)        // Also wait to send what hubs queued
+        pfd.events |= POLLOUT;
+      onion_websocket_out_unlock(ws);
       //ONION_DEBUG("Wait for data");
       int r = poll(&pfd, 1, -1);
       if (r == 0)
         return OCS_INTERNAL_ERROR;
       //ONION_DEBUG("waited for data fd %d -- res %d -- events %d", ws->req->fd, r, pfd.events);
+      if (pfd.revents & POLLOUT) {
+        onion_websocket_out_lock(ws);
+        onion_websocket_out_flush(ws, false);
+        onion_websocket_out_unlock(ws);
+        if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+          continue;
+      }
     } else
       sleep(1);                 // FIXME Worst possible solution. But solution anyway to the problem of not know when new data is available.
     if (ws->callback) {
@@ -531,12 +1646,167 @@ onion_connection_status onion_websocket_call(onion_websocket * ws) {
   return OCS_INTERNAL_ERROR;
 }
 
+/**
+ * @short Passes the complete frames at the input buffer to the callback.
+ *
+ * Ping and close frames are answered here.
+ *
+ * @returns OCS_NEED_MORE_DATA to keep waiting for data, or the status to close the connection.
+ */
+static onion_connection_status
+onion_websocket_process_input(onion_websocket * ws) {
+  for (;;) {
+    if (ws->data_left == 0) {   // Next frame
+      uint64_t payload;
+      int hlen = onion_websocket_parse_header(ws, &payload);
+      if (!hlen) {
+        ws->in_need = 0;
+        return OCS_NEED_MORE_DATA;
+      }
+      size_t max = ws->req->connection.listen_point->server->max_post_size;
+      if (payload > max) {
+        ONION_ERROR("Websocket frame too big (%lu bytes). Limit %lu bytes.",
+                    (unsigned long)payload, (unsigned long)max);
+        return OCS_CLOSE_CONNECTION;
+      }
+      if (ws->in_len - ws->in_pos < hlen + payload) {
+        ws->in_need = hlen + payload;
+        return OCS_NEED_MORE_DATA;
+      }
+      ws->in_need = 0;
+
+      onion_websocket_opcode opcode =
+          onion_websocket_start_frame(ws, hlen, payload);
+
+      if (opcode == OWS_PING || opcode == OWS_CONNECTION_CLOSE) {
+        char data[125];
+        if (payload > sizeof(data)) {
+          ONION_ERROR("Websocket control frame too big (%lu bytes)",
+                      (unsigned long)payload);
+          return OCS_CLOSE_CONNECTION;
+        }
+        int n = onion_websocket_read(ws, data, payload);
+        if (opcode == OWS_CONNECTION_CLOSE) {
+          ONION_DEBUG("Connection closed by client");
+          onion_websocket_close(ws, n >= 2 ? data : "\x03\xe8");
+          return OCS_CLOSE_CONNECTION;
+        }
+        onion_websocket_write_frame(ws, OWS_PONG, 1, data, n);
+        continue;
+      }
+      if (opcode == OWS_PONG) {
+        ws->in_pos += payload;
+        ws->data_left = 0;
+        continue;
+      }
+      int deflated = onion_websocket_frame_is_deflated(ws, opcode);
+      if (deflated < 0)
+        return OCS_CLOSE_CONNECTION;
+#ifdef HAVE_ZLIB
+      if (deflated && onion_websocket_inflate_frame(ws) < 0)
+        return OCS_CLOSE_CONNECTION;
+#endif
+    }
+
+    if (!ws->callback)
+      return OCS_CLOSE_CONNECTION;
+    onion_connection_status ret;
+    int64_t last_d_l;
+    do {
+      last_d_l = ws->data_left;
+      ret = ws->callback(ws->user_data, ws, ws->data_left);
+    } while (ret == OCS_NEED_MORE_DATA && ws->data_left != 0
+             && last_d_l != ws->data_left && ws->callback);
+    if (ret != OCS_NEED_MORE_DATA)
+      return ret == OCS_CLOSE_CONNECTION ? ret : OCS_INTERNAL_ERROR;
+    if (!ws->callback)
+      return OCS_CLOSE_CONNECTION;
+    if (ws->data_left != 0)     // Not consumed, try again when there is new data.
+      return OCS_NEED_MORE_DATA;
+    if (ws->in_pos == ws->in_len)
+      return OCS_NEED_MORE_DATA;
+  }
+}
+
+/**
+ * @short Used internally by the poller when there is data at a polled websocket.
+ * @memberof onion_websocket_t
+ * @ingroup websocket
+ *
+ * Reads what is available into the input buffer, and passes the complete frames to the
+ * callback. Data the listen point already has, as the rest of a TLS record, is read too, as
+ * the poller will not wake for it. It never waits for more data, so the thread goes back to the poller, and idle
+ * websockets only use their poller slot. The input buffer is freed when there is nothing
+ * pending at it.
+ *
+ * @returns OCS_PROCESSED to keep on polling, or <0 to close the connection.
+ */
+int onion_websocket_read_ready(onion_websocket * ws) {
+  onion_websocket_out_lock(ws);
+  if (ws->busy) {               // Woken for output while another thread is at it. It will send.
+    onion_websocket_out_unlock(ws);
+    return OCS_PROCESSED;
+  }
+  ws->busy = true;
+  bool armed = ws->out_armed;
+  ws->out_armed = false;
+  onion_websocket_out_flush(ws, false);
+  onion_websocket_out_unlock(ws);
+
+  onion_listen_point *lp = ws->req->connection.listen_point;
+  onion_connection_status ret = OCS_NEED_MORE_DATA;
+  bool readable = true;
+  if (armed && ws->req->connection.fd >= 0) {   // May be woken just to write
+    struct pollfd pfd;
+    pfd.fd = ws->req->connection.fd;
+    pfd.events = POLLIN;
+    readable = poll(&pfd, 1, 0) > 0 || (lp->pending && lp->pending(ws->req));
+  }
+  if (ws->out_closed)
+    ret = OCS_CLOSE_CONNECTION;
+  else if (readable) {
+    do {                        // Data kept by the listen point does not wake the poller
+      if (onion_websocket_fill(ws, ws->in_need) <= 0) {
+        ret = OCS_CLOSE_CONNECTION;
+        break;
+      }
+      ret = onion_websocket_process_input(ws);
+    } while (ret == OCS_NEED_MORE_DATA && lp->pending && lp->pending(ws->req));
+  }
+  if (ret != OCS_NEED_MORE_DATA) {
+    ONION_DEBUG("Websocket connection closed (%d)", ret);
+    return ret;
+  }
+  if (ws->in_pos == ws->in_len && ws->data_left == 0) {
+    onion_low_free(ws->in);
+    ws->in = NULL;
+    ws->in_size = ws->in_len = ws->in_pos = 0;
+#ifdef HAVE_ZLIB
+    if (ws->deflate) {
+      onion_low_free(ws->deflate->data);
+      ws->deflate->data = NULL;
+      ws->deflate->size = ws->deflate->len = ws->deflate->pos = 0;
+    }
+#endif
+  }
+
+  onion_websocket_out_lock(ws);
+  ws->busy = false;
+  if (ws->req->connection.slot) {       // Applied by the poller when this returns
+    ws->out_armed = ws->out_count != 0;
+    onion_poller_slot_set_type(ws->req->connection.slot,
+                               ws->out_armed ? O_POLL_READ | O_POLL_WRITE :
+                               O_POLL_READ);
+  }
+  onion_websocket_out_unlock(ws);
+  return OCS_PROCESSED;
+}
+
 /**
  * @short Closes the websocket sending the close opcode (8)
  */
 void onion_websocket_close(onion_websocket * ws, const char *status) {
-  onion_websocket_set_opcode(ws, OWS_CONNECTION_CLOSE);
-  onion_websocket_write(ws, status, 2);
+  onion_websocket_write_frame(ws, OWS_CONNECTION_CLOSE, 1, status, 2);
 }
 
 /**
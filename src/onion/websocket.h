@@ -46,12 +46,29 @@ extern "C" {
   int onion_websocket_read(onion_websocket * ws, char *buffer, size_t len);
   int onion_websocket_write(onion_websocket * ws, const char *buffer,
                             size_t len);
+/// Writes a fragment of a message. The one with fin set ends it.
+  int onion_websocket_write_fragment(onion_websocket * ws, const char *buffer,
+                                     size_t len, int fin);
+/// Encodes a message once, to send it to several websockets.
+  onion_websocket_frame *onion_websocket_frame_new(onion_websocket_opcode
+                                                   opcode, const char *data,
+                                                   size_t len);
+  void onion_websocket_frame_free(onion_websocket_frame * frame);
+/// Sends the frame without blocking, or queues it. From any thread.
+  int onion_websocket_write_shared(onion_websocket * ws,
+                                   onion_websocket_frame * frame,
+                                   size_t max_backlog);
+/// Bytes queued to send.
+  size_t onion_websocket_backlog(onion_websocket * ws);
+/// Closes the connection from any thread.
+  void onion_websocket_abort(onion_websocket * ws);
   int onion_websocket_vprintf(onion_websocket * ws, const char *fmt,
                               va_list args)
       __attribute__ ((format(printf, 2, 0)));
   int onion_websocket_printf(onion_websocket * ws, const char *str, ...)
       __attribute__ ((format(printf, 2, 3)));
   onion_connection_status onion_websocket_call(onion_websocket * ws);
+  int onion_websocket_read_ready(onion_websocket * ws);
   void onion_websocket_set_opcode(onion_websocket * ws,
                                   onion_websocket_opcode opcode);
   onion_websocket_opcode onion_websocket_get_opcode(onion_websocket * ws);
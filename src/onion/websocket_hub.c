@@ -0,0 +1,346 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include <string.h>
+
+#include "websocket_hub.h"
+#include "websocket.h"
+#include "types_internal.h"
+#include "dict.h"
+#include "log.h"
+#include "low.h"
+
+/**
+ * @defgroup websocket_hub Websocket hub. Publish messages to many websockets.
+ *
+ * Websockets subscribe to topics, and each message published to a topic is sent to all its
+ * subscribers. The frame is encoded once, and each subscriber keeps a reference at its output
+ * queue until sent, so a slow client never blocks the publisher nor the others:
+ *
+ * @code
+ *   // At the websocket handler
+ *   onion_websocket_hub_subscribe(hub, "prices", ws);
+ *
+ *   // From any thread
+ *   onion_websocket_hub_publish(hub, "prices", OWS_TEXT, json, strlen(json));
+ * @endcode
+ *
+ * Clients whose output queue would grow above the backlog limit lose the message, or are
+ * disconnected, as set with onion_websocket_hub_set_backlog. Websockets are unsubscribed when
+ * freed.
+ */
+
+/// Default max bytes queued per subscriber.
+#define ONION_WEBSOCKET_HUB_BACKLOG (1024 * 1024)
+
+void onion_websocket_add_hub(onion_websocket * ws, onion_websocket_hub * hub);  // At websocket.c
+void onion_websocket_remove_hub(onion_websocket * ws, onion_websocket_hub * hub);       // At websocket.c
+
+struct onion_websocket_hub_t {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;
+#endif
+  onion_dict *topics;           ///< Topic name to its onion_websocket_hub_topic
+  size_t max_backlog;
+  onion_websocket_hub_overflow overflow;
+};
+
+/// Subscribers of a topic.
+typedef struct onion_websocket_hub_topic_t {
+  onion_websocket **ws;
+  int count;
+  int size;
+} onion_websocket_hub_topic;
+
+static void onion_websocket_hub_lock(onion_websocket_hub * hub) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&hub->mutex);
+#endif
+}
+
+static void onion_websocket_hub_unlock(onion_websocket_hub * hub) {
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&hub->mutex);
+#endif
+}
+
+/**
+ * @short Creates a hub.
+ * @memberof onion_websocket_hub_t
+ * @ingroup websocket_hub
+ */
+onion_websocket_hub *onion_websocket_hub_new() {
+  onion_websocket_hub *hub = onion_low_calloc(1, sizeof(onion_websocket_hub));
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&hub->mutex, NULL);
+#endif
+  hub->topics = onion_dict_new();
+  hub->max_backlog = ONION_WEBSOCKET_HUB_BACKLOG;
+  hub->overflow = OWH_DROP;
+  return hub;
+}
+
+static void onion_websocket_hub_free_topic(onion_websocket_hub * hub,
+                                           const char *name,
+                                           onion_websocket_hub_topic * t,
+                                           int flags) {
+  int i;
+  for (i = 0; i < t->count; i++)
+    onion_websocket_remove_hub(t->ws[i], hub);
+  onion_low_free(t->ws);
+  onion_low_free(t);
+}
+
+/**
+ * @short Frees the hub.
+ * @memberof onion_websocket_hub_t
+ * @ingroup websocket_hub
+ *
+ * All subscribers are unsubscribed. No other thread may be using the hub.
+ */
+void onion_websocket_hub_free(onion_websocket_hub * hub) {
+  onion_websocket_hub_lock(hub);
+  onion_dict_preorder(hub->topics, onion_websocket_hub_free_topic, hub);
+  onion_dict_free(hub->topics);
+  onion_websocket_hub_unlock(hub);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&hub->mutex);
+#endif
+  onion_low_free(hub);
+}
+
+/**
+ * @short Sets the limit of bytes queued for each subscriber.
+ * @memberof onion_websocket_hub_t
+ * @ingroup websocket_hub
+ *
+ * A message is always queued if nothing else is, so bigger messages can still be sent.
+ *
+ * @param hub The hub
+ * @param max_backlog Max bytes, or 0 for no limit. Default is 1MB.
+ * @param overflow What to do when a message does not fit: OWH_DROP (default) skips it for
+ *   that subscriber, OWH_CLOSE closes its connection.
+ */
+void onion_websocket_hub_set_backlog(onion_websocket_hub * hub,
+                                     size_t max_backlog,
+                                     onion_websocket_hub_overflow overflow) {
+  onion_websocket_hub_lock(hub);
+  hub->max_backlog = max_backlog;
+  hub->overflow = overflow;
+  onion_websocket_hub_unlock(hub);
+}
+
+/**
+ * @short Subscribes the websocket to the topic.
+ * @memberof onion_websocket_hub_t
+ * @ingroup websocket_hub
+ *
+ * @returns 0 if subscribed, 1 if it already was.
+ */
+int onion_websocket_hub_subscribe(onion_websocket_hub * hub,
+                                  const char *topic, onion_websocket * ws) {
+  onion_websocket_hub_lock(hub);
+  onion_websocket_hub_topic *t =
+      (onion_websocket_hub_topic *) onion_dict_get(hub->topics, topic);
+  if (!t) {
+    t = onion_low_calloc(1, sizeof(onion_websocket_hub_topic));
+    onion_dict_add(hub->topics, topic, t, OD_DUP_KEY);
+  }
+  int i;
+  for (i = 0; i < t->count; i++) {
+    if (t->ws[i] == ws) {
+      onion_websocket_hub_unlock(hub);
+      return 1;
+    }
+  }
+  if (t->count == t->size) {
+    t->size = t->size ? t->size * 2 : 8;
+    t->ws = onion_low_realloc(t->ws, t->size * sizeof(onion_websocket *));
+  }
+  t->ws[t->count++] = ws;
+  onion_websocket_add_hub(ws, hub);
+  onion_websocket_hub_unlock(hub);
+  return 0;
+}
+
+/// Removes the websocket from the topic. Returns if it was there.
+static int onion_websocket_hub_topic_remove(onion_websocket_hub_topic * t,
+                                            onion_websocket * ws) {
+  int i;
+  for (i = 0; i < t->count; i++) {
+    if (t->ws[i] == ws) {
+      memmove(&t->ws[i], &t->ws[i + 1],
+              (t->count - i - 1) * sizeof(onion_websocket *));
+      t->count--;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+struct onion_websocket_hub_unsubscribe_t {
+  onion_websocket *ws;
+  int removed;
+  const char **empty;           ///< Topics left empty, to remove after the walk.
+  int nempty;
+};
+
+static void onion_websocket_hub_unsubscribe_topic(struct
+                                                  onion_websocket_hub_unsubscribe_t
+                                                  *u, const char *name,
+                                                  onion_websocket_hub_topic * t,
+                                                  int flags) {
+  if (!onion_websocket_hub_topic_remove(t, u->ws))
+    return;
+  u->removed++;
+  if (t->count == 0) {
+    u->empty =
+        onion_low_realloc(u->empty, (u->nempty + 1) * sizeof(const char *));
+    u->empty[u->nempty++] = name;
+  }
+}
+
+/// Frees and removes the topic, if it has no subscribers.
+static void onion_websocket_hub_remove_empty(onion_websocket_hub * hub,
+                                             const char *topic) {
+  onion_websocket_hub_topic *t =
+      (onion_websocket_hub_topic *) onion_dict_get(hub->topics, topic);
+  if (!t || t->count)
+    return;
+  onion_low_free(t->ws);
+  onion_low_free(t);
+  onion_dict_remove(hub->topics, topic);
+}
+
+/**
+ * @short Unsubscribes the websocket from the topic, or from all topics at this hub.
+ * @memberof onion_websocket_hub_t
+ * @ingroup websocket_hub
+ *
+ * It is done automatically when the websocket is freed.
+ *
+ * @param hub The hub
+ * @param topic The topic, or NULL for all.
+ * @param ws The websocket
+ * @returns the number of topics it was unsubscribed from.
+ */
+int onion_websocket_hub_unsubscribe(onion_websocket_hub * hub,
+                                    const char *topic, onion_websocket * ws) {
+  int removed = 0;
+  onion_websocket_hub_lock(hub);
+  if (topic) {
+    onion_websocket_hub_topic *t =
+        (onion_websocket_hub_topic *) onion_dict_get(hub->topics, topic);
+    if (t && onion_websocket_hub_topic_remove(t, ws)) {
+      removed = 1;
+      onion_websocket_hub_remove_empty(hub, topic);
+    }
+  } else {
+    struct onion_websocket_hub_unsubscribe_t u;
+    memset(&u, 0, sizeof(u));
+    u.ws = ws;
+    onion_dict_preorder(hub->topics, onion_websocket_hub_unsubscribe_topic,
+                        &u);
+    int i;
+    for (i = 0; i < u.nempty; i++)
+      onion_websocket_hub_remove_empty(hub, u.empty[i]);
+    onion_low_free(u.empty);
+    removed = u.removed;
+    onion_websocket_remove_hub(ws, hub);
+  }
+  onion_websocket_hub_unlock(hub);
+  return removed;
+}
+
+/**
+ * @short Returns the number of subscribers of the topic.
+ * @memberof onion_websocket_hub_t
+ * @ingroup websocket_hub
+ */
+int onion_websocket_hub_count(onion_websocket_hub * hub, const char *topic) {
+  onion_websocket_hub_lock(hub);
+  onion_websocket_hub_topic *t =
+      (onion_websocket_hub_topic *) onion_dict_get(hub->topics, topic);
+  int count = t ? t->count : 0;
+  onion_websocket_hub_unlock(hub);
+  return count;
+}
+
+/**
+ * @short Publishes the message to all the subscribers of the topic.
+ * @memberof onion_websocket_hub_t
+ * @ingroup websocket_hub
+ *
+ * The message is encoded as one frame, shared by all subscribers. It can be called from any
+ * thread, and over plain HTTP it does not block: what can not be sent now is queued at each
+ * subscriber, up to the backlog limit.
+ *
+ * @param hub The hub
+ * @param topic The topic
+ * @param opcode OWS_TEXT or OWS_BINARY
+ * @param data The message
+ * @param len Its length
+ * @returns the number of subscribers that got it, sent or queued.
+ */
+int onion_websocket_hub_publish(onion_websocket_hub * hub, const char *topic,
+                                onion_websocket_opcode opcode,
+                                const char *data, size_t len) {
+  onion_websocket_frame *frame = onion_websocket_frame_new(opcode, data, len);
+  int n = onion_websocket_hub_publish_frame(hub, topic, frame);
+  onion_websocket_frame_free(frame);
+  return n;
+}
+
+/**
+ * @short Publishes an already encoded frame to all the subscribers of the topic.
+ * @memberof onion_websocket_hub_t
+ * @ingroup websocket_hub
+ *
+ * As onion_websocket_hub_publish, to send the same frame to several topics or hubs.
+ *
+ * @returns the number of subscribers that got it, sent or queued.
+ */
+int onion_websocket_hub_publish_frame(onion_websocket_hub * hub,
+                                      const char *topic,
+                                      onion_websocket_frame * frame) {
+  int n = 0;
+  onion_websocket_hub_lock(hub);
+  onion_websocket_hub_topic *t =
+      (onion_websocket_hub_topic *) onion_dict_get(hub->topics, topic);
+  int i;
+  for (i = 0; t && i < t->count; i++) {
+    onion_websocket *ws = t->ws[i];
+    int r = onion_websocket_write_shared(ws, frame, hub->max_backlog);
+    if (r == 0)
+      n++;
+    else if (r == -1) {
+      if (hub->overflow == OWH_CLOSE) {
+        ONION_DEBUG("Websocket backlog full, closing connection");
+        onion_websocket_abort(ws);
+      } else
+        ONION_DEBUG0("Websocket backlog full, message dropped");
+    }
+  }
+  onion_websocket_hub_unlock(hub);
+  return n;
+}
@@ -0,0 +1,61 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#ifndef ONION_WEBSOCKET_HUB_H
+#define ONION_WEBSOCKET_HUB_H
+
+#include <stddef.h>
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  onion_websocket_hub *onion_websocket_hub_new();
+/// Frees the hub. Its subscribers are unsubscribed.
+  void onion_websocket_hub_free(onion_websocket_hub * hub);
+/// Max bytes queued per subscriber, and what to do when a message does not fit. Default 1MB and OWH_DROP.
+  void onion_websocket_hub_set_backlog(onion_websocket_hub * hub,
+                                       size_t max_backlog,
+                                       onion_websocket_hub_overflow overflow);
+
+  int onion_websocket_hub_subscribe(onion_websocket_hub * hub,
+                                    const char *topic, onion_websocket * ws);
+/// Unsubscribes from the topic, or from all if topic is NULL.
+  int onion_websocket_hub_unsubscribe(onion_websocket_hub * hub,
+                                      const char *topic, onion_websocket * ws);
+/// Number of subscribers to the topic.
+  int onion_websocket_hub_count(onion_websocket_hub * hub, const char *topic);
+
+/// Sends the message to all subscribers of the topic. Returns how many got it.
+  int onion_websocket_hub_publish(onion_websocket_hub * hub, const char *topic,
+                                  onion_websocket_opcode opcode,
+                                  const char *data, size_t len);
+  int onion_websocket_hub_publish_frame(onion_websocket_hub * hub,
+                                        const char *topic,
+                                        onion_websocket_frame * frame);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
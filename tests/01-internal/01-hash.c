@@ -33,6 +33,8 @@
 
 #ifdef HAVE_PTHREADS
 #include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
 #endif
 
 void t01_create_add_free() {
@@ -811,6 +813,357 @@ void t18_json_escape_codes() {
   END_LOCAL();
 }
 
+void t19_hash() {
+  INIT_LOCAL();
+  onion_dict *dict = onion_dict_new();
+  onion_dict_set_flags(dict, OD_HASH);
+
+  onion_dict_add(dict, "S", "T", 0);
+  onion_dict_add(dict, "A", "B", OD_DUP_ALL);
+  onion_dict_add(dict, "C", "D", 0);
+  onion_dict_add(dict, "A", "B2", OD_DUP_ALL);
+  onion_dict_add(dict, "this is a long key, not inlined at the slot", "X",
+                 OD_DUP_ALL);
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(dict), 5);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "C"), "D");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get
+                        (dict, "this is a long key, not inlined at the slot"),
+                        "X");
+  FAIL_IF_NOT_EQUAL(onion_dict_get(dict, "c"), NULL);
+
+  // Sorted, and repeated keys in insertion order.
+  char buffer[4096];
+  memset(buffer, 0, sizeof(buffer));
+  onion_dict_preorder(dict, append_as_headers, buffer);
+  FAIL_IF_NOT_EQUAL_STR(buffer,
+                        "A: B\nA: B2\nC: D\nS: T\nthis is a long key, not inlined at the slot: X\n");
+
+  onion_dict_add(dict, "C", "D2", OD_REPLACE);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "C"), "D2");
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(dict), 5);
+
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_remove(dict, "S"), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_remove(dict, "S"), 0);
+  FAIL_IF_NOT_EQUAL(onion_dict_get(dict, "S"), NULL);
+
+  // Hashes are calculated again
+  onion_dict_set_flags(dict, OD_ICASE);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "c"), "D2");
+
+  onion_dict_free(dict);
+  END_LOCAL();
+}
+
+void t20_hash_threshold() {
+  INIT_LOCAL();
+  onion_dict *dict = onion_dict_new();
+  int i;
+  char key[32], val[32];
+  char removed[1000];
+  memset(removed, 0, sizeof(removed));
+  // Starts as a tree, changes to hash table on the way, and reuses deleted slots.
+  for (i = 0; i < 1000; i++) {
+    sprintf(key, "key %d", i);
+    sprintf(val, "val %d", i);
+    onion_dict_add(dict, key, val, OD_DUP_ALL);
+    if (i % 3 == 0) {
+      sprintf(key, "key %d", i / 2);
+      onion_dict_remove(dict, key);
+      removed[i / 2] = 1;
+    }
+  }
+  int ok = 1, count = 0;
+  for (i = 0; i < 1000; i++) {
+    sprintf(key, "key %d", i);
+    sprintf(val, "val %d", i);
+    const char *v = onion_dict_get(dict, key);
+    if (removed[i] ? v != NULL : (!v || strcmp(v, val) != 0))
+      ok = 0;
+    if (!removed[i])
+      count++;
+  }
+  FAIL_IF_NOT(ok);
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(dict), count);
+
+  // Still sorted
+  onion_dict *small = onion_dict_new();
+  for (i = 99; i >= 0; i--) {
+    sprintf(key, "%02d", i);
+    onion_dict_add(small, key, "x", OD_DUP_KEY);
+  }
+  char buffer[1024];
+  memset(buffer, 0, sizeof(buffer));
+  onion_dict_preorder(small, append_as_headers, buffer);
+  FAIL_IF_NOT_STRSTR(buffer, "00: x\n01: x\n02: x\n");
+  FAIL_IF_NOT_STRSTR(buffer, "97: x\n98: x\n99: x\n");
+
+  onion_dict_free(small);
+  onion_dict_free(dict);
+  END_LOCAL();
+}
+
+void t21_no_lock() {
+  INIT_LOCAL();
+  onion_dict *dict = onion_dict_new_with_flags(OD_NO_LOCK | OD_ICASE);
+  onion_dict_lock_write(dict);  // Do nothing
+  onion_dict_add(dict, "Content-Type", "text/plain", 0);
+  onion_dict_unlock(dict);
+  onion_dict_lock_read(dict);
+  onion_dict_lock_read(dict);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "content-type"), "text/plain");
+  onion_dict_unlock(dict);
+  onion_dict_unlock(dict);
+  onion_dict *dup = onion_dict_dup(dict);
+  onion_dict_free(dict);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dup, "CONTENT-TYPE"), "text/plain");
+  onion_dict_free(dup);
+  END_LOCAL();
+}
+
+void t23_small() {
+  INIT_LOCAL();
+  onion_dict *dict = onion_dict_new();
+  char buffer[1024];
+
+  // Sorted, repeated keys in insertion order.
+  onion_dict_add(dict, "b", "1", 0);
+  onion_dict_add(dict, "a", "2", 0);
+  onion_dict_add(dict, "b", "3", 0);
+  onion_dict_add(dict, "B", "4", 0);
+  memset(buffer, 0, sizeof(buffer));
+  onion_dict_preorder(dict, append_as_headers, buffer);
+  FAIL_IF_NOT_EQUAL_STR(buffer, "B: 4\na: 2\nb: 1\nb: 3\n");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "b"), "1");
+  onion_dict_add(dict, "b", "5", OD_REPLACE);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "b"), "5");
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(dict), 4);
+  FAIL_IF_NOT(onion_dict_remove(dict, "b"));
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "b"), "3");
+  FAIL_IF(onion_dict_remove(dict, "c"));
+
+  // Case insensitive reorders
+  onion_dict_set_flags(dict, OD_ICASE);
+  memset(buffer, 0, sizeof(buffer));
+  onion_dict_preorder(dict, append_as_headers, buffer);
+  FAIL_IF_NOT_EQUAL_STR(buffer, "a: 2\nB: 4\nb: 3\n");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "A"), "2");
+
+  // Grows to tree and keeps everything
+  int i;
+  char key[16];
+  for (i = 0; i < 20; i++) {
+    snprintf(key, sizeof(key), "k%02d", i);
+    onion_dict_add(dict, key, "x", OD_DUP_KEY);
+  }
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(dict), 23);
+  memset(buffer, 0, sizeof(buffer));
+  onion_dict_preorder(dict, append_as_headers, buffer);
+  FAIL_IF_NOT_STRSTR(buffer, "a: 2\nB: 4\nb: 3\nk00: x\nk01: x\n");
+  FAIL_IF_NOT_STRSTR(buffer, "k18: x\nk19: x\n");
+
+  onion_dict_free(dict);
+  END_LOCAL();
+}
+
+void t24_snapshot() {
+  INIT_LOCAL();
+  onion_dict *dict = onion_dict_new();
+  FAIL_IF(onion_dict_is_changed(dict));
+  onion_dict_add(dict, "a", "1", 0);
+  onion_dict_add(dict, "b", "2", OD_DUP_VALUE);
+  FAIL_IF_NOT(onion_dict_is_changed(dict));
+
+  onion_dict *s1 = onion_dict_snapshot(dict);
+  onion_dict *s2 = onion_dict_snapshot(s1);
+  FAIL_IF(onion_dict_is_changed(dict));
+  FAIL_IF(onion_dict_is_changed(s1));
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s1, "a"), "1");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s2, "b"), "2");
+
+  // Removing what is not there is not a change, and does not copy
+  FAIL_IF(onion_dict_remove(s1, "c"));
+  FAIL_IF(onion_dict_is_changed(s1));
+
+  // Changes on any are not seen by the others
+  onion_dict_add(s1, "a", "3", OD_REPLACE);
+  FAIL_IF_NOT(onion_dict_is_changed(s1));
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s1, "a"), "3");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s1, "b"), "2");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(dict, "a"), "1");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s2, "a"), "1");
+  FAIL_IF_NOT(onion_dict_remove(dict, "b"));
+  FAIL_IF_NOT(onion_dict_is_changed(dict));
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s2, "b"), "2");
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(dict), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(s2), 2);
+
+  // Original content lives until the last snapshot is freed
+  onion_dict_free(dict);
+  onion_dict_free(s1);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s2, "b"), "2");
+  onion_dict_free(s2);
+
+  // Hashes, subdicts and JSON
+  int i;
+  char key[16];
+  dict = onion_dict_from_json("{\"sub\":{\"x\":\"y\"}, \"k\":\"v\"}");
+  FAIL_IF(onion_dict_is_changed(dict));
+  for (i = 0; i < 100; i++) {
+    snprintf(key, sizeof(key), "k%02d", i);
+    onion_dict_add(dict, key, key, OD_DUP_ALL);
+  }
+  s1 = onion_dict_snapshot(dict);
+  onion_dict_free(dict);
+  s2 = onion_dict_snapshot(s1);
+  onion_dict_add(s2, "k", "w", OD_REPLACE);
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(s1), 102);
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(s2), 102);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s1, "k"), "v");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s2, "k"), "w");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(s2, "k42"), "k42");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(s1, "sub", "x", NULL), "y");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(s2, "sub", "x", NULL), "y");
+
+  // Subdicts are copied on write too, and their changes are changes of the parent
+  onion_dict *s3 = onion_dict_snapshot(s1);
+  onion_dict *sub = onion_dict_get_dict(s3, "sub");
+  FAIL_IF(onion_dict_is_changed(s3));
+  onion_dict_add(sub, "x", "z", OD_REPLACE);
+  FAIL_IF_NOT(onion_dict_is_changed(s3));
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(s3, "sub", "x", NULL), "z");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(s1, "sub", "x", NULL), "y");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(s2, "sub", "x", NULL), "y");
+  onion_dict *s4 = onion_dict_snapshot(s3);
+  FAIL_IF(onion_dict_is_changed(s3));
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(s4, "sub", "x", NULL), "z");
+  onion_dict_free(s3);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(s4, "sub", "x", NULL), "z");
+  onion_dict_free(s4);
+
+  onion_dict_free(s1);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(s2, "sub", "x", NULL), "y");
+  onion_dict_free(s2);
+
+  END_LOCAL();
+}
+
+#ifdef HAVE_PTHREADS
+#define RCU_READERS 8
+#define RCU_LOOPS 20000
+
+static int t22_rcu_running;
+
+/// Values are always "key=value", so a reader seeing freed data fails.
+static void *t22_rcu_reader(onion_dict * d) {
+  long bad = 0;
+  char key[16], prefix[16];
+  int i = 0;
+  while (__atomic_load_n(&t22_rcu_running, __ATOMIC_ACQUIRE)) {
+    snprintf(key, sizeof(key), "%d", i % 200);
+    snprintf(prefix, sizeof(prefix), "%d=", i % 200);
+    onion_dict_lock_read(d);
+    onion_dict_lock_read(d);    // Nested is fine
+    const char *v = onion_dict_get(d, key);
+    if (v && strncmp(v, prefix, strlen(prefix)) != 0)
+      bad++;
+    onion_dict *sub = onion_dict_get_dict(d, "sub");
+    if (sub)
+      sub = onion_dict_dup(sub);
+    onion_dict_unlock(d);
+    onion_dict_unlock(d);
+    if (sub) {
+      if (strcmp(onion_dict_get(sub, "a"), "b") != 0)
+        bad++;
+      onion_dict_free(sub);
+    }
+    i++;
+  }
+  return (void *)bad;
+}
+
+void t22_rcu() {
+  INIT_LOCAL();
+  onion_dict *d = onion_dict_new_with_flags(OD_RCU);
+  pthread_t thread[RCU_READERS];
+  int i;
+  t22_rcu_running = 1;
+  for (i = 0; i < RCU_READERS; i++)
+    pthread_create(&thread[i], NULL, (void *)t22_rcu_reader, d);
+
+  char key[16], value[32];
+  for (i = 0; i < RCU_LOOPS; i++) {
+    int k = (i * 7) % 200;
+    snprintf(key, sizeof(key), "%d", k);
+    snprintf(value, sizeof(value), "%d=%d", k, i);
+    onion_dict_lock_write(d);
+    if (i % 5 == 0)
+      onion_dict_remove(d, key);
+    else
+      onion_dict_add(d, key, value, OD_DUP_ALL | OD_REPLACE);
+    if (i % 100 == 0) {
+      onion_dict *sub = onion_dict_new();
+      onion_dict_add(sub, "a", "b", 0);
+      onion_dict_add(d, "sub", sub, OD_DICT | OD_FREE_VALUE | OD_REPLACE);
+    }
+    onion_dict_unlock(d);
+  }
+  __atomic_store_n(&t22_rcu_running, 0, __ATOMIC_RELEASE);
+  long bad = 0;
+  for (i = 0; i < RCU_READERS; i++) {
+    void *r;
+    pthread_join(thread[i], &r);
+    bad += (long)r;
+  }
+  FAIL_IF_NOT_EQUAL_INT(bad, 0);
+
+  // Same contents as a normal dict would have
+  int count = 0, ok = 1;
+  for (i = 0; i < 200; i++) {
+    snprintf(key, sizeof(key), "%d", i);
+    const char *v = onion_dict_get(d, key);
+    if (v) {
+      count++;
+      snprintf(value, sizeof(value), "%d=", i);
+      if (strncmp(v, value, strlen(value)) != 0)
+        ok = 0;
+    }
+  }
+  FAIL_IF_NOT(ok);
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(d), count + 1);
+  onion_dict_free(d);
+  END_LOCAL();
+}
+
+/// A write lock while reading would wait for itself forever, so it aborts.
+void t25_rcu_write_while_reading() {
+  INIT_LOCAL();
+  onion_dict *d = onion_dict_new_with_flags(OD_RCU);
+  onion_dict *other = onion_dict_new_with_flags(OD_RCU);
+
+  // Reading another one is fine
+  onion_dict_lock_read(other);
+  onion_dict_lock_write(d);
+  onion_dict_add(d, "a", "b", 0);
+  onion_dict_unlock(d);
+  onion_dict_unlock(other);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "a"), "b");
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    onion_dict_lock_read(d);
+    onion_dict_lock_write(d);
+    exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  FAIL_IF_NOT(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+  onion_dict_free(other);
+  onion_dict_free(d);
+  END_LOCAL();
+}
+#endif
+
 int main(int argc, char **argv) {
   START();
   t01_create_add_free();
@@ -834,6 +1187,15 @@ int main(int argc, char **argv) {
   t16_soft_dup_dict_in_dict();
   t17_merge();
   t18_json_escape_codes();
+  t19_hash();
+  t20_hash_threshold();
+  t21_no_lock();
+#ifdef HAVE_PTHREADS
+  t22_rcu();
+  t25_rcu_write_while_reading();
+#endif
+  t23_small();
+  t24_snapshot();
 
   END();
 }
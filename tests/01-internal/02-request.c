@@ -139,10 +139,11 @@ void t03_create_add_free_full_flow() {
   onion_request_process(req);   // this should set the req->path.
   FAIL_IF_NOT_EQUAL_STR(req->path, "myurl /is/very/deeply/nested");
 
-  FAIL_IF_EQUAL(req->GET, NULL);
-  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "test"), "test");
-  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "query2"), "query 2");
-  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "more_query"),
+  const onion_dict *get = onion_request_get_query_dict(req);
+  FAIL_IF_EQUAL(get, NULL);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "test"), "test");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "query2"), "query 2");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "more_query"),
                         " more query 10");
   FAIL_IF_EQUAL(onion_request_get_query(req, "empty"), NULL);
   FAIL_IF_EQUAL(onion_request_get_query(req, "empty2"), NULL);
@@ -189,10 +190,12 @@ void t04_create_add_free_GET() {
     onion_request_polish(req);
     FAIL_IF_NOT_EQUAL_STR(req->path, "myurl /is/very/deeply/nested");
 
-    FAIL_IF_EQUAL(req->GET, NULL);
-    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "test"), "test");
-    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "query2"), "query 2");
-    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "more_query"),
+    FAIL_IF_NOT_EQUAL(req->GET, NULL);  // Parsed at first use
+    const onion_dict *get = onion_request_get_query_dict(req);
+    FAIL_IF_EQUAL(get, NULL);
+    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "test"), "test");
+    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "query2"), "query 2");
+    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "more_query"),
                           " more query 10");
 
     onion_request_clean(req);
@@ -237,10 +240,12 @@ void t05_create_add_free_POST() {
     onion_request_polish(req);
     FAIL_IF_NOT_EQUAL_STR(req->path, "myurl /is/very/deeply/nested");
 
-    FAIL_IF_EQUAL(req->GET, NULL);
-    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "test"), "test");
-    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "query2"), "query 2");
-    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(req->GET, "more_query"),
+    FAIL_IF_NOT_EQUAL(req->GET, NULL);  // Parsed at first use
+    const onion_dict *get = onion_request_get_query_dict(req);
+    FAIL_IF_EQUAL(get, NULL);
+    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "test"), "test");
+    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "query2"), "query 2");
+    FAIL_IF_NOT_EQUAL_STR(onion_dict_get(get, "more_query"),
                           " more query 10");
 
     const onion_dict *post = onion_request_get_post_dict(req);
@@ -538,6 +543,39 @@ void t11_cookies() {
   END_LOCAL();
 }
 
+void t12_lazy_query() {
+  INIT_LOCAL();
+  onion_request *req;
+  int ok;
+
+  req = onion_request_new(custom_io);
+  const char *query =
+      "POST /path%3f?a=1&&b=%3D&=x&c&utm=a+b HTTP/1.1\n"
+      "Content-Length: 11\nContent-Type: application/x-www-form-urlencoded\n\n"
+      "p=1&q=%26&r";
+  ok = REQ_WRITE(req, query);
+  FAIL_IF_NOT_EQUAL_INT(ok, OCS_REQUEST_READY);
+  FAIL_IF_NOT_EQUAL_STR(req->fullpath, "/path?");
+  FAIL_IF_NOT_EQUAL(req->GET, NULL);
+  FAIL_IF_NOT_EQUAL(req->POST, NULL);
+
+  FAIL_IF_NOT_EQUAL_STR(onion_request_get_query(req, "a"), "1");
+  FAIL_IF_NOT_EQUAL_STR(onion_request_get_query(req, "b"), "=");
+  FAIL_IF_NOT_EQUAL_STR(onion_request_get_query(req, ""), "x");
+  FAIL_IF_NOT_EQUAL_STR(onion_request_get_query(req, "c"), "");
+  FAIL_IF_NOT_EQUAL_STR(onion_request_get_query(req, "utm"), "a b");
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(onion_request_get_query_dict(req)),
+                        5);
+  FAIL_IF_NOT_EQUAL(req->POST, NULL);
+
+  FAIL_IF_NOT_EQUAL_STR(onion_request_get_post(req, "p"), "1");
+  FAIL_IF_NOT_EQUAL_STR(onion_request_get_post(req, "q"), "&");
+  FAIL_IF_NOT_EQUAL_STR(onion_request_get_post(req, "r"), "");
+
+  onion_request_free(req);
+  END_LOCAL();
+}
+
 int main(int argc, char **argv) {
   START();
 
@@ -553,6 +591,7 @@ int main(int argc, char **argv) {
   t09_very_long_header();
   t10_repeated_header();
   t11_cookies();
+  t12_lazy_query();
 
   teardown();
   END();
@@ -32,6 +32,7 @@
 #include <onion/response.h>
 #include <onion/types_internal.h>
 #include <onion/onion.h>
+#include <onion/block.h>
 #include <onion/http.h>
 
 #include "../ctest.h"
@@ -339,6 +340,38 @@ void t07_large_printf() {
   END_LOCAL();
 }
 
+void t08_write_block() {
+  INIT_LOCAL();
+  onion *server = onion_new(0);
+  onion_add_listen_point(server, NULL, NULL, onion_buffer_listen_point_new());
+  onion_request *request = onion_request_new(server->listen_points[0]);
+  onion_response *response = onion_response_new(request);
+
+  onion_block *block = onion_block_new_segmented();
+  int i;
+  for (i = 0; i < 10000; i++)
+    onion_block_add_str(block, "0123456789");
+  onion_response_set_length(response, onion_block_size(block));
+  FAIL_IF_NOT_EQUAL_INT(onion_response_write_block(response, block), 100000);
+  onion_block_free(block);
+  onion_response_free(response);
+
+  onion_block *out = onion_buffer_listen_point_get_buffer(request);
+  const char *data = onion_block_data(out);
+  FAIL_IF_NOT_STRSTR(data, "Content-Length: 100000\r\n");
+  const char *body = strstr(data, "\r\n\r\n");
+  FAIL_IF_EQUAL(body, NULL);
+  if (body) {
+    body += 4;
+    FAIL_IF_NOT_EQUAL_INT(onion_block_size(out) - (body - data), 100000);
+    FAIL_IF_NOT_EQUAL_INT(strncmp(body + 99990, "0123456789", 10), 0);
+  }
+
+  onion_request_free(request);
+  onion_free(server);
+  END_LOCAL();
+}
+
 int main(int argc, char **argv) {
   START();
 
@@ -349,6 +382,7 @@ int main(int argc, char **argv) {
   t05_printf();
   t06_empty();
   t07_large_printf();
+  t08_write_block();
 
   END();
 }
@@ -28,9 +28,16 @@
 #include <stdio.h>
 #include <curl/curl.h>
 #include <errno.h>
+#include <sys/time.h>
+
+#include <gnutls/gnutls.h>
 
 #include <onion/onion.h>
 #include <onion/poller.h>
+#include <onion/https.h>
+#include <onion/listen_point.h>
+#include <onion/shortcuts.h>
+#include <onion/block.h>
 
 #include "../ctest.h"
 #include <pthread.h>
@@ -412,6 +419,329 @@ void t06_timeouts() {
   END_LOCAL();
 }
 
+void t07_server_https_slow_handshake() {
+  INIT_LOCAL();
+  CURL *curl = prepare_curl("https://localhost:8083");
+
+  o = onion_new(O_POOL | O_DETACH_LISTEN);
+  onion_set_max_threads(o, 1);
+  onion_set_timeout(o, 5000);
+  onion_set_root_handler(o,
+                         onion_handler_new((void *)process_request, NULL,
+                                           NULL));
+  FAIL_IF_NOT_EQUAL_INT(onion_set_certificate
+                        (o, O_SSL_CERTIFICATE_KEY, "mycert.pem", "mycert.pem"),
+                        0);
+  onion_set_port(o, "8083");
+  onion_listen(o);
+  sleep(1);
+
+  // Clients that never finish the handshake must not block the only thread.
+  int fd[3];
+  int i;
+  for (i = 0; i < 3; i++)
+    fd[i] = connect_to("localhost", "8083");
+  FAIL_IF_NOT_EQUAL_INT(write(fd[0], "\x16\x03\x01\x00", 4), 4);
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  FAIL_IF_NOT_EQUAL_INT(curl_get(curl, "https://localhost:8083"), HTTP_OK);
+  gettimeofday(&end, NULL);
+  int ms =
+      (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+  ONION_DEBUG("Request done in %d ms", ms);
+  FAIL_IF(ms > 2000);
+
+  for (i = 0; i < 3; i++)
+    close(fd[i]);
+
+  onion_free(o);
+
+  curl_easy_cleanup(curl);
+  END_LOCAL();
+}
+
+/// Does a GET over a new TLS connection. Returns if the session was resumed, or -1 on error.
+int https_get(const char *port, const char *priority, int flags,
+              gnutls_datum_t * session_data) {
+  gnutls_certificate_credentials_t cred;
+  gnutls_session_t session;
+  gnutls_certificate_allocate_credentials(&cred);
+  gnutls_init(&session, GNUTLS_CLIENT | flags);
+  gnutls_priority_set_direct(session, priority, NULL);
+  gnutls_credentials_set(session, GNUTLS_CRD_CERTIFICATE, cred);
+  if (session_data->data)
+    gnutls_session_set_data(session, session_data->data, session_data->size);
+
+  int fd = connect_to("localhost", port);
+  gnutls_transport_set_int(session, fd);
+  int ret;
+  do {
+    ret = gnutls_handshake(session);
+  } while (ret < 0 && !gnutls_error_is_fatal(ret));
+  if (ret < 0) {
+    ONION_ERROR("Handshake failed: %s", gnutls_strerror(ret));
+    ret = -1;
+  } else {
+    const char *get = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    FAIL_IF_NOT_EQUAL_INT(gnutls_record_send(session, get, strlen(get)),
+                          strlen(get));
+    char buffer[1024];
+    size_t l = 0;
+    buffer[0] = 0;
+    // TLS 1.3 tickets come after the handshake, so get the data once read.
+    while (!strstr(buffer, "Done") && l < sizeof(buffer) - 1) {
+      ssize_t r = gnutls_record_recv(session, buffer + l, sizeof(buffer) - 1 - l);
+      if (r < 0 && !gnutls_error_is_fatal(r))
+        continue;
+      if (r <= 0) {
+        ONION_ERROR("Read failed: %s", gnutls_strerror(r));
+        break;
+      }
+      l += r;
+      buffer[l] = 0;
+    }
+    FAIL_IF_NOT(strstr(buffer, "Done"));
+    ret = gnutls_session_is_resumed(session);
+    if (session_data->data)
+      gnutls_free(session_data->data);
+    gnutls_session_get_data2(session, session_data);
+    gnutls_bye(session, GNUTLS_SHUT_WR);
+  }
+  close(fd);
+  gnutls_deinit(session);
+  gnutls_certificate_free_credentials(cred);
+  return ret;
+}
+
+void t08_server_https_resume() {
+  INIT_LOCAL();
+  gnutls_datum_t data = { NULL, 0 };
+  const char *tls12 = "NORMAL:-VERS-TLS1.3";
+
+  o = onion_new(O_POOL | O_DETACH_LISTEN);
+  onion_set_root_handler(o,
+                         onion_handler_new((void *)process_request, NULL,
+                                           NULL));
+  onion_listen_point *lp = onion_https_new();
+  FAIL_IF_NOT_EQUAL_INT(onion_https_set_certificate
+                        (lp, O_SSL_CERTIFICATE_KEY, "mycert.pem", "mycert.pem"),
+                        0);
+  onion_add_listen_point(o, "localhost", "8084", lp);
+  onion_listen(o);
+  sleep(1);
+
+  // Session tickets, by default.
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", "NORMAL", 0, &data), 0);
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", "NORMAL", 0, &data), 1);
+  gnutls_free(data.data);
+  data.data = NULL;
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", tls12, 0, &data), 0);
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", tls12, 0, &data), 1);
+  // No cache, so no resumption by session id.
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", tls12, GNUTLS_NO_TICKETS, &data), 0);
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", tls12, GNUTLS_NO_TICKETS, &data), 0);
+
+  FAIL_IF_NOT_EQUAL_INT(onion_https_set_session_tickets(lp, 0), 0);
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", "NORMAL", 0, &data), 0);
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", "NORMAL", 0, &data), 0);
+  onion_free(o);
+  gnutls_free(data.data);
+  data.data = NULL;
+
+  // Session cache, one entry per shard, so most are evicted.
+  o = onion_new(O_POOL | O_DETACH_LISTEN);
+  onion_set_root_handler(o,
+                         onion_handler_new((void *)process_request, NULL,
+                                           NULL));
+  lp = onion_https_new();
+  FAIL_IF_NOT_EQUAL_INT(onion_https_set_certificate
+                        (lp, O_SSL_CERTIFICATE_KEY, "mycert.pem", "mycert.pem"),
+                        0);
+  FAIL_IF_NOT_EQUAL_INT(onion_https_set_session_tickets(lp, 0), 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_https_set_session_cache(lp, 16), 0);
+  onion_add_listen_point(o, "localhost", "8084", lp);
+  onion_listen(o);
+  sleep(1);
+
+  int i;
+  for (i = 0; i < 40; i++) {
+    gnutls_free(data.data);
+    data.data = NULL;
+    FAIL_IF_NOT_EQUAL_INT(https_get("8084", tls12, GNUTLS_NO_TICKETS, &data),
+                          0);
+  }
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", tls12, GNUTLS_NO_TICKETS, &data), 1);
+  FAIL_IF_NOT_EQUAL_INT(https_get("8084", tls12, GNUTLS_NO_TICKETS, &data), 1);
+  onion_free(o);
+  gnutls_free(data.data);
+
+  END_LOCAL();
+}
+
+#define KTLS_FILE "06-onion-ktls.data"
+#define KTLS_FILE_SIZE (100 * 1024)
+
+onion_connection_status send_ktls_file(void *_, onion_request * req,
+                                       onion_response * res) {
+  return onion_shortcut_response_file(KTLS_FILE, req, res);
+}
+
+/// Checks the file contents as it arrives.
+size_t check_ktls_file(char *data, size_t size, size_t nmemb, size_t * offset) {
+  size_t i;
+  for (i = 0; i < size * nmemb; i++) {
+    if ((unsigned char)data[i] != (*offset + i) % 251) {
+      FAIL("File contents differ");
+      return 0;
+    }
+  }
+  *offset += size * nmemb;
+  return size * nmemb;
+}
+
+void t09_server_https_ktls_file() {
+  INIT_LOCAL();
+  FILE *f = fopen(KTLS_FILE, "w");
+  int i;
+  for (i = 0; i < KTLS_FILE_SIZE; i++)
+    fputc(i % 251, f);
+  fclose(f);
+
+  o = onion_new(O_POOL | O_DETACH_LISTEN);
+  onion_set_root_handler(o,
+                         onion_handler_new((void *)send_ktls_file, NULL, NULL));
+  onion_listen_point *lp = onion_https_new();
+  FAIL_IF_NOT_EQUAL_INT(onion_https_set_certificate
+                        (lp, O_SSL_CERTIFICATE_KEY, "mycert.pem", "mycert.pem"),
+                        0);
+  // Sent by the kernel if it has TLS support, else by gnutls.
+  FAIL_IF_NOT_EQUAL_INT(onion_https_set_ktls(lp, 1), 0);
+  onion_add_listen_point(o, "localhost", "8084", lp);
+  onion_listen(o);
+  sleep(1);
+
+  CURL *curl = prepare_curl("https://localhost:8084");
+  size_t offset = 0;
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, check_ktls_file);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &offset);
+  for (i = 0; i < 3; i++) {
+    offset = 0;
+    FAIL_IF_NOT_EQUAL_INT(curl_get(curl, "https://localhost:8084"), HTTP_OK);
+    FAIL_IF_NOT_EQUAL_INT(offset, KTLS_FILE_SIZE);
+  }
+  curl_easy_cleanup(curl);
+
+  onion_free(o);
+  unlink(KTLS_FILE);
+  END_LOCAL();
+}
+
+/// Writes 64KB in small pieces, with no length, so chunked.
+onion_connection_status write_small_pieces(void *_, onion_request * req,
+                                           onion_response * res) {
+  const onion_block *post = onion_request_get_data(req);
+  if (post) {
+    onion_response_printf(res, "%ld", (long)onion_block_size(post));
+    return OCS_PROCESSED;
+  }
+  char piece[100];
+  int i;
+  for (i = 0; i < 64 * 1024; i += sizeof(piece)) {
+    memset(piece, 'a' + (i / sizeof(piece)) % 26, sizeof(piece));
+    onion_response_write(res, piece, sizeof(piece));
+  }
+  return OCS_PROCESSED;
+}
+
+/// Sends the request over a new TLS connection and reads until the text is found. Returns the TLS records read.
+int https_exchange(const char *port, const char *request, size_t length,
+                   const char *until, char *response, size_t size) {
+  gnutls_certificate_credentials_t cred;
+  gnutls_session_t session;
+  gnutls_certificate_allocate_credentials(&cred);
+  gnutls_init(&session, GNUTLS_CLIENT);
+  gnutls_set_default_priority(session);
+  gnutls_credentials_set(session, GNUTLS_CRD_CERTIFICATE, cred);
+  int fd = connect_to("localhost", port);
+  gnutls_transport_set_int(session, fd);
+  int ret;
+  do {
+    ret = gnutls_handshake(session);
+  } while (ret < 0 && !gnutls_error_is_fatal(ret));
+  int records = 0;
+  size_t l = 0;
+  response[0] = 0;
+  if (ret >= 0) {
+    size_t sent = 0;
+    while (sent < length) {
+      ssize_t w = gnutls_record_send(session, request + sent, length - sent);
+      if (w <= 0)
+        break;
+      sent += w;
+    }
+    FAIL_IF_NOT_EQUAL_INT(sent, length);
+    // Each recv returns data of one record at most.
+    while (!strstr(response, until) && l < size - 1) {
+      ssize_t r = gnutls_record_recv(session, response + l, size - 1 - l);
+      if (r < 0 && !gnutls_error_is_fatal(r))
+        continue;
+      if (r <= 0)
+        break;
+      records++;
+      l += r;
+      response[l] = 0;
+    }
+    gnutls_bye(session, GNUTLS_SHUT_WR);
+  }
+  close(fd);
+  gnutls_deinit(session);
+  gnutls_certificate_free_credentials(cred);
+  return records;
+}
+
+void t10_server_https_records() {
+  INIT_LOCAL();
+  o = onion_new(O_POOL | O_DETACH_LISTEN);
+  onion_set_root_handler(o,
+                         onion_handler_new((void *)write_small_pieces, NULL,
+                                           NULL));
+  onion_listen_point *lp = onion_https_new();
+  FAIL_IF_NOT_EQUAL_INT(onion_https_set_certificate
+                        (lp, O_SSL_CERTIFICATE_KEY, "mycert.pem", "mycert.pem"),
+                        0);
+  onion_add_listen_point(o, "localhost", "8084", lp);
+  onion_listen(o);
+  sleep(1);
+
+  size_t size = 128 * 1024;
+  char *response = malloc(size);
+  const char *get = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  int records = https_exchange("8084", get, strlen(get), "\r\n0\r\n\r\n",
+                               response, size);
+  ONION_DEBUG("64KB in small writes sent in %d records", records);
+  FAIL_IF(records > 10);
+  FAIL_IF_NOT(strstr(response, "Transfer-Encoding: chunked"));
+  FAIL_IF_NOT(strstr(response, "zzzzzzzzzz"));
+
+  // Big POST, read in full records.
+  size_t post_size = 100 * 1024;
+  char *post = malloc(post_size + 256);
+  int l = snprintf(post, 256,
+                   "POST / HTTP/1.1\r\nHost: localhost\r\n"
+                   "Content-Type: application/octet-stream\r\n"
+                   "Content-Length: %ld\r\n\r\n", (long)post_size);
+  memset(post + l, 'x', post_size);
+  https_exchange("8084", post, l + post_size, "\r\n\r\n102400", response,
+                 size);
+  FAIL_IF_NOT(strstr(response, "\r\n\r\n102400"));
+  free(post);
+  free(response);
+
+  onion_free(o);
+  END_LOCAL();
+}
+
 int main(int argc, char **argv) {
   START();
   pthread_t watchdog_thread;
@@ -423,6 +753,10 @@ int main(int argc, char **argv) {
   t04_server_timeout_threaded();
   t05_server_timeout_threaded_ssl();
   t06_timeouts();
+  t07_server_https_slow_handshake();
+  t08_server_https_resume();
+  t09_server_https_ktls_file();
+  t10_server_https_records();
 
   okexit = 1;
   pthread_cancel(watchdog_thread);
@@ -242,6 +242,29 @@ void t07_codecs_html() {
   FAIL_IF_NOT_EQUAL(encoded, NULL);
   free(encoded);
 
+  const char *dup = onion_html_quote_dup("foo");
+  FAIL_IF_NOT_EQUAL_STR(dup, "foo");
+  free((char *)dup);
+
+  END_LOCAL();
+}
+
+void t07b_codecs_unquote() {
+  INIT_LOCAL();
+
+  char str[64];
+  strcpy(str, "a+b%20c%2fd%2Fe");
+  onion_unquote_inplace(str);
+  FAIL_IF_NOT_EQUAL_STR(str, "a b c/d/e");
+
+  // Not valid %XX are kept as they are, and never read after the end
+  strcpy(str, "100%zz%4");
+  onion_unquote_inplace(str);
+  FAIL_IF_NOT_EQUAL_STR(str, "100%zz%4");
+  strcpy(str, "end%");
+  onion_unquote_inplace(str);
+  FAIL_IF_NOT_EQUAL_STR(str, "end%");
+
   END_LOCAL();
 }
 
@@ -292,6 +315,7 @@ int main(int argc, char **argv) {
   t05_codecs_base64_decode_trash();
   t06_codecs_c_unicode();
   t07_codecs_html();
+  t07b_codecs_unquote();
   t08_codecs_utf16();
   t09_minimal_payload();
 
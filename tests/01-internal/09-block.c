@@ -21,6 +21,8 @@
   <http://www.apache.org/licenses/LICENSE-2.0>.
 */
 
+#include <string.h>
+
 #include <onion/block.h>
 #include <onion/log.h>
 
@@ -78,11 +80,79 @@ void t02_several_add_methods() {
   END_TEST();
 }
 
+void t03_segmented() {
+  INIT_TEST();
+
+  onion_block *block = onion_block_new_segmented();
+  onion_block *check = onion_block_new();
+  char data[1000];
+  int i;
+  for (i = 0; i < 100; i++) {
+    memset(data, 'a' + (i % 26), sizeof(data));
+    onion_block_add_data(block, data, sizeof(data));
+    onion_block_add_data(check, data, sizeof(data));
+    onion_block_add_char(block, '.');
+    onion_block_add_char(check, '.');
+  }
+  FAIL_IF_NOT_EQUAL_INT(onion_block_size(block), 100100);
+
+  // Chunks are exported in order, and all of them
+  struct iovec iov[64];
+  size_t total = 0;
+  int n, ok = 1;
+  while ((n = onion_block_iovec(block, total, iov, 2))) {
+    for (i = 0; i < n; i++) {
+      if (memcmp(iov[i].iov_base, onion_block_data(check) + total,
+                 iov[i].iov_len) != 0)
+        ok = 0;
+      total += iov[i].iov_len;
+    }
+  }
+  FAIL_IF_NOT(ok);
+  FAIL_IF_NOT_EQUAL_INT(total, 100100);
+  FAIL_IF_NOT(onion_block_iovec(block, 0, iov, 64) > 1);
+
+  onion_block_rewind(block, 60050);
+  onion_block_rewind(check, 60050);
+  FAIL_IF_NOT_EQUAL_INT(onion_block_size(block), 40050);
+
+  onion_block *copy = onion_block_new();
+  onion_block_add_block(copy, block);
+  FAIL_IF_NOT_EQUAL_INT(onion_block_size(copy), 40050);
+  FAIL_IF_NOT(memcmp(onion_block_data(copy), onion_block_data(check), 40050) ==
+              0);
+  onion_block_free(copy);
+
+  // Now contiguous
+  FAIL_IF_NOT(memcmp(onion_block_data(block), onion_block_data(check), 40050)
+              == 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_block_iovec(block, 0, iov, 64), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_block_iovec(block, 40050, iov, 64), 0);
+
+  onion_block_clear(block);
+  onion_block_add_str(block, "hello");
+  FAIL_IF_NOT_EQUAL_STR(onion_block_data(block), "hello");
+
+  onion_block_free(check);
+  onion_block_free(block);
+
+  block = onion_block_new_segmented();
+  onion_block_add_str(block, "again");
+  onion_block_clear(block);
+  onion_block_add_str(block, "hello");
+  onion_block_add_block(block, block);
+  FAIL_IF_NOT_EQUAL_STR(onion_block_data(block), "hellohello");
+  onion_block_free(block);
+
+  END_TEST();
+}
+
 int main(int argc, char **argv) {
   START();
 
   t01_create_and_free();
   t02_several_add_methods();
+  t03_segmented();
 
   END();
 }
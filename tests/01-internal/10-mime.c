@@ -22,6 +22,7 @@
 */
 
 #include <onion/mime.h>
+#include <onion/dict.h>
 #include "../ctest.h"
 
 void t01_test_mime() {
@@ -37,10 +38,42 @@ void t01_test_mime() {
   END_LOCAL();
 }
 
+void t02_user_mime() {
+  INIT_LOCAL();
+
+  FAIL_IF_NOT_EQUAL_STR("image/png", onion_mime_get("FILE.PNG"));
+  FAIL_IF_NOT_EQUAL_STR
+      ("application/vnd.openxmlformats-officedocument.wordprocessingml.document",
+       onion_mime_get("a.docx"));
+
+  int generation = onion_mime_generation();
+  onion_mime_update("png", "image/x-png");
+  onion_mime_update("onion", "application/x-onion");
+  onion_mime_update("html", NULL);
+  FAIL_IF_EQUAL(generation, onion_mime_generation());
+  FAIL_IF_NOT_EQUAL_STR("image/x-png", onion_mime_get("file.png"));
+  FAIL_IF_NOT_EQUAL_STR("application/x-onion", onion_mime_get("file.onion"));
+  FAIL_IF_NOT_EQUAL_STR("text/plain", onion_mime_get("file.html"));
+  FAIL_IF_NOT_EQUAL_STR("text/css", onion_mime_get("file.css"));
+
+  // User dicts are on top of the builtin ones
+  onion_dict *d = onion_dict_new();
+  onion_dict_add(d, "css", "text/x-css", 0);
+  onion_mime_set(d);
+  FAIL_IF_NOT_EQUAL_STR("text/x-css", onion_mime_get("file.css"));
+  FAIL_IF_NOT_EQUAL_STR("image/png", onion_mime_get("file.png"));
+  FAIL_IF_NOT_EQUAL_STR("text/html", onion_mime_get("file.html"));
+
+  onion_mime_set(NULL);
+  FAIL_IF_NOT_EQUAL_STR("text/css", onion_mime_get("file.css"));
+  END_LOCAL();
+}
+
 int main(int argc, char **argv) {
   START();
 
   t01_test_mime();
+  t02_user_mime();
 
   END();
 }
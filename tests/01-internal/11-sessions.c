@@ -41,26 +41,34 @@ void t01_test_session() {
   ses = onion_sessions_get(sessions, s01);
   FAIL_IF_EQUAL(ses, NULL);     // It does not auto create the sessions, to avoid problems
 
-  // get another pointer to the same session
+  // get another snapshot of the same session
   onion_dict *ses2 = onion_sessions_get(sessions, s01);
-  FAIL_IF_NOT_EQUAL(ses, ses2);
+  FAIL_IF_EQUAL(ses2, NULL);
+  FAIL_IF_EQUAL(ses, ses2);
 
-  //Check it is really the same
+  // Changes are not seen by others until saved
   onion_dict_add(ses, "foo", "bar", 0);
-
-  FAIL_IF_NOT_EQUAL_STR("bar", onion_dict_get(ses2, "foo"));
+  FAIL_IF_NOT(onion_dict_is_changed(ses));
+  FAIL_IF(onion_dict_is_changed(ses2));
+  FAIL_IF_NOT_EQUAL(onion_dict_get(ses2, "foo"), NULL);
   onion_sessions_save(sessions, s01, ses);
+  FAIL_IF(onion_dict_is_changed(ses));
+  FAIL_IF_NOT_EQUAL(onion_dict_get(ses2, "foo"), NULL);
 
-  // When removed, it should refcount--
   onion_dict_free(ses2);
   ses2 = onion_sessions_get(sessions, s01);
-  FAIL_IF_NOT_EQUAL(ses, ses2);
+  FAIL_IF_NOT_EQUAL_STR("bar", onion_dict_get(ses2, "foo"));
+
+  // Later changes need another save
+  onion_dict_add(ses, "foo2", "bar2", 0);
+  FAIL_IF_NOT_EQUAL(onion_dict_get(ses2, "foo2"), NULL);
 
   // also all removal, should stay at the sessions
   onion_dict_free(ses);
   onion_dict_free(ses2);
   ses2 = onion_sessions_get(sessions, s01);
   FAIL_IF_NOT_EQUAL_STR("bar", onion_dict_get(ses2, "foo"));
+  FAIL_IF_NOT_EQUAL(onion_dict_get(ses2, "foo2"), NULL);
   onion_dict_free(ses2);
 
   // Create a second session
@@ -216,7 +224,7 @@ void t03_bug_empty_session_is_new_session() {
   onion_url *url = onion_root_url(o);
   onion_url_add(url, "^.*", ask_session);
   char sessionid[256];
-  char tmp[256];
+  char tmp[512];
 
   set_data_on_session = 1;
   onion_request *req = onion_request_new(lp);
@@ -335,6 +343,102 @@ void t04_lot_of_sessionid() {
   END_LOCAL();
 }
 
+static int saves = 0;
+static void (*mem_save) (onion_sessions * sessions, const char *sessionid,
+                         onion_dict * data);
+
+static void counting_save(onion_sessions * sessions, const char *sessionid,
+                          onion_dict * data) {
+  saves++;
+  mem_save(sessions, sessionid, data);
+}
+
+// Sessions are saved only when changed
+void t05_save_only_changed() {
+  INIT_LOCAL();
+
+  onion *o = onion_new(O_ONE_LOOP);
+  onion_listen_point *lp = onion_buffer_listen_point_new();
+  lp->write = empty_write;
+  onion_add_listen_point(o, NULL, NULL, lp);
+  mem_save = o->sessions->save;
+  o->sessions->save = counting_save;
+
+  onion_url *url = onion_root_url(o);
+  onion_url_add(url, "^.*", ask_session);
+  char tmp[512];
+  onion_request *req;
+
+  // New session: created, and saved with the data
+  set_data_on_session = 1;
+  req = onion_request_new(lp);
+  req->fullpath = "/";
+  onion_request_process(req);
+  req->fullpath = NULL;
+  onion_request_free(req);
+  FAIL_IF_NOT_EQUAL_INT(saves, 2);
+  snprintf(tmp, sizeof(tmp), "sessionid=%s", lastsessionid);
+
+  // Only read, many times
+  int i;
+  set_data_on_session = 0;
+  for (i = 0; i < 10; i++) {
+    req = onion_request_new(lp);
+    req->fullpath = "/";
+    onion_dict_add(req->headers, "Cookie", tmp, 0);
+    onion_request_process(req);
+    req->fullpath = NULL;
+    onion_request_free(req);
+  }
+  FAIL_IF_NOT_EQUAL_INT(saves, 2);
+
+  // A change is saved, and seen later
+  set_data_on_session = 1;
+  req = onion_request_new(lp);
+  req->fullpath = "/";
+  onion_dict_add(req->headers, "Cookie", tmp, 0);
+  onion_request_process(req);
+  req->fullpath = NULL;
+  onion_request_free(req);
+  FAIL_IF_NOT_EQUAL_INT(saves, 3);
+
+  req = onion_request_new(lp);
+  onion_dict_add(req->headers, "Cookie", tmp, 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(onion_request_get_session_dict(req)),
+                        2);
+  onion_request_free(req);
+  FAIL_IF_NOT_EQUAL_INT(saves, 3);
+
+  // Changes on nested dicts are saved too
+  req = onion_request_new(lp);
+  onion_dict_add(req->headers, "Cookie", tmp, 0);
+  onion_dict_add(onion_request_get_session_dict(req), "sub", onion_dict_new(),
+                 OD_DICT | OD_FREE_VALUE);
+  onion_request_free(req);
+  FAIL_IF_NOT_EQUAL_INT(saves, 4);
+
+  req = onion_request_new(lp);
+  onion_dict_add(req->headers, "Cookie", tmp, 0);
+  onion_dict *sub =
+      onion_dict_get_dict(onion_request_get_session_dict(req), "sub");
+  FAIL_IF_EQUAL(sub, NULL);
+  onion_dict_add(sub, "a", "b", 0);
+  onion_request_free(req);
+  FAIL_IF_NOT_EQUAL_INT(saves, 5);
+
+  req = onion_request_new(lp);
+  onion_dict_add(req->headers, "Cookie", tmp, 0);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget
+                        (onion_request_get_session_dict(req), "sub", "a", NULL),
+                        "b");
+  onion_request_free(req);
+  FAIL_IF_NOT_EQUAL_INT(saves, 5);
+
+  onion_free(o);
+
+  END_LOCAL();
+}
+
 int main(int argc, char **argv) {
   START();
 
@@ -342,6 +446,7 @@ int main(int argc, char **argv) {
   t02_cookies();
   t03_bug_empty_session_is_new_session();
   t04_lot_of_sessionid();
+  t05_save_only_changed();
 
   END();
 }
@@ -23,10 +23,22 @@
 
 #include <onion/onion.h>
 #include <onion/http.h>
+#include <onion/poller.h>
 #include <onion/websocket.h>
+#include <onion/websocket_hub.h>
 #include <onion/types_internal.h>
 #include "../ctest.h"
 #include "buffer_listen_point.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 struct ws_status_t {
   int connected;
@@ -41,34 +53,47 @@ typedef ssize_t(lpreader_sig_t) (onion_request * req, char *data, size_t len);
 typedef ssize_t(lpwriter_sig_t) (onion_request * req, const char *data,
                                  size_t len);
 
-void websocket_data_buffer_write(onion_request * req, const char *data,
-                                 size_t len) {
+ssize_t websocket_data_buffer_write(onion_request * req, const char *data,
+                                    size_t len) {
   if (!ws_data_tmp) {
     ws_data_length = len;
     ws_data_tmp = malloc(ws_data_length);
-    strncpy(ws_data_tmp, data, ws_data_length);
+    memcpy(ws_data_tmp, data, ws_data_length);
   } else {
     char *tmp = malloc(ws_data_length + len);
-    strncpy(tmp, ws_data_tmp, ws_data_length);
-    strncpy(tmp + ws_data_length, data, len);
+    memcpy(tmp, ws_data_tmp, ws_data_length);
+    memcpy(tmp + ws_data_length, data, len);
     ws_data_length += len;
     free(ws_data_tmp);
     ws_data_tmp = tmp;
   }
+  return len;
 }
 
+/// Writes at most 7 bytes each time, so callers must handle partial writes.
+ssize_t websocket_data_buffer_writev(onion_request * req,
+                                     const struct iovec *iov, int iovcnt) {
+  ssize_t w = 0;
+  int i;
+  for (i = 0; i < iovcnt && w < 7; i++) {
+    size_t n = iov[i].iov_len < 7 - w ? iov[i].iov_len : 7 - w;
+    websocket_data_buffer_write(req, iov[i].iov_base, n);
+    w += n;
+  }
+  return w;
+}
+
+int ws_data_reads = 0;
+
 int websocket_data_buffer_read(onion_request * req, char *data, size_t len) {
+  ws_data_reads++;
   if (!ws_data_tmp || !ws_data_length || !data)
     return 0;
-  int i;
-  for (i = 0; i < ws_data_length; i++) {
-    data[i] = ws_data_tmp[i];
-    if (i == len - 1)
-      break;
-  }
-  strncpy(ws_data_tmp, ws_data_tmp + i + 1, ws_data_length - i);
-  ws_data_length -= i + 1;
-  return i + 1;
+  size_t n = len < ws_data_length ? len : ws_data_length;
+  memcpy(data, ws_data_tmp, n);
+  memmove(ws_data_tmp, ws_data_tmp + n, ws_data_length - n);
+  ws_data_length -= n;
+  return n;
 }
 
 onion_connection_status ws_callback(void *privadata, onion_websocket * ws,
@@ -256,6 +281,875 @@ void t04_websocket_server_close_handshake() {
   END_LOCAL();
 }
 
+/// Checks the frame at the written data, and removes it.
+int ws_check_frame(int byte0, const char *payload, size_t len) {
+  size_t hlen = len < 126 ? 2 : len <= 0x0FFFF ? 4 : 10;
+  if (ws_data_length < hlen + len)
+    return 0;
+  unsigned char *h = (unsigned char *)ws_data_tmp;
+  if (h[0] != byte0)
+    return 0;
+  uint64_t l = h[1];
+  if (hlen == 4)
+    l = h[1] == 126 ? (h[2] << 8) | h[3] : 0;
+  else if (hlen == 10) {
+    int i;
+    l = 0;
+    if (h[1] != 127)
+      return 0;
+    for (i = 0; i < 8; i++)
+      l = (l << 8) | h[2 + i];
+  }
+  if (l != len || memcmp(ws_data_tmp + hlen, payload, len) != 0)
+    return 0;
+  memmove(ws_data_tmp, ws_data_tmp + hlen + len,
+          ws_data_length - hlen - len);
+  ws_data_length -= hlen + len;
+  return 1;
+}
+
+void t06_websocket_write_frames() {
+  INIT_LOCAL();
+  onion *o = websocket_server_new();
+  onion_request *req = websocket_start_handshake(o);
+  onion_listen_point *lp = req->connection.listen_point;
+  lp->write = websocket_data_buffer_write;
+  onion_response *res = onion_response_new(req);
+  onion_websocket *ws = onion_websocket_new(req, res);
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+
+  size_t big = 70000;
+  char *data = malloc(big + 1);
+  size_t i;
+  for (i = 0; i < big; i++)
+    data[i] = i * 7;
+
+  int pass;
+  for (pass = 0; pass < 2; pass++) {    // With write, and with a writev that writes little each time
+    lp->writev = pass ? websocket_data_buffer_writev : NULL;
+    onion_websocket_set_opcode(ws, OWS_TEXT);
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_write(ws, data, 100), 100);
+    FAIL_IF_NOT(ws_check_frame(0x81, data, 100));
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_write(ws, data, 300), 300);
+    FAIL_IF_NOT(ws_check_frame(0x81, data, 300));
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_write(ws, data, 65535), 65535);
+    FAIL_IF_NOT(ws_check_frame(0x81, data, 65535));
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_write(ws, data, big), big);
+    FAIL_IF_NOT(ws_check_frame(0x81, data, big));
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_write(ws, data, 0), 0);
+    FAIL_IF_NOT(ws_check_frame(0x81, data, 0));
+
+    onion_websocket_set_opcode(ws, OWS_BINARY);
+    onion_websocket_write_fragment(ws, "ab", 2, 0);
+    onion_websocket_write_fragment(ws, data, 1000, 0);
+    onion_websocket_close(ws, "\x03\xe8");   // Control frames may go in between
+    onion_websocket_write_fragment(ws, "ef", 2, 1);
+    onion_websocket_write(ws, "gh", 2);
+    FAIL_IF_NOT(ws_check_frame(0x02, "ab", 2));
+    FAIL_IF_NOT(ws_check_frame(0x00, data, 1000));
+    FAIL_IF_NOT(ws_check_frame(0x88, "\x03\xe8", 2));
+    FAIL_IF_NOT(ws_check_frame(0x80, "ef", 2));
+    FAIL_IF_NOT(ws_check_frame(0x82, "gh", 2));
+    FAIL_IF_NOT_EQUAL_INT(ws_data_length, 0);
+  }
+
+  free(data);
+  onion_websocket_free(ws);
+  onion_response_free(res);
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+  onion_request_free(req);
+  onion_free(o);
+  END_LOCAL();
+}
+
+/// Echoes each frame, as is.
+onion_connection_status ws_echo(void *privadata, onion_websocket * ws,
+                                ssize_t nbytes_ready) {
+  if (nbytes_ready < 0)
+    return OCS_CLOSE_CONNECTION;
+  char *data = malloc(nbytes_ready + 1);
+  int r = onion_websocket_read(ws, data, nbytes_ready);
+  onion_websocket_write(ws, data, r);
+  free(data);
+  return OCS_NEED_MORE_DATA;
+}
+
+onion_connection_status ws_echo_handler(void *priv, onion_request * req,
+                                        onion_response * res) {
+  onion_websocket *ws = onion_websocket_new(req, res);
+  if (!ws)
+    return OCS_NOT_IMPLEMENTED;
+  onion_websocket_set_callback(ws, ws_echo);
+  return OCS_WEBSOCKET;
+}
+
+void *ws_listen_thread(void *o) {
+  onion_listen(o);
+  return NULL;
+}
+
+/// Connects and does the handshake, with some more headers. Returns the fd, or -1.
+int ws_client_connect_headers(const char *port, const char *headers) {
+  int fd = connect_to("localhost", port);
+  if (fd < 0)
+    return -1;
+  struct timeval tv = { 5, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  char hs[512];
+  snprintf(hs, sizeof(hs),
+           "GET / HTTP/1.1\r\nUpgrade: websocket\r\nSec-Websocket-Version: 13\r\nSec-Websocket-Key: My-key\r\n%s\r\n",
+           headers);
+  send(fd, hs, strlen(hs), 0);
+  char prev[4] = { 0, 0, 0, 0 }, c;
+  while (recv(fd, &c, 1, 0) == 1) {
+    memmove(prev, prev + 1, 3);
+    prev[3] = c;
+    if (memcmp(prev, "\r\n\r\n", 4) == 0)
+      return fd;
+  }
+  close(fd);
+  return -1;
+}
+
+/// Connects and does the handshake. Returns the fd, or -1.
+int ws_client_connect(const char *port) {
+  return ws_client_connect_headers(port, "");
+}
+
+/// Forges a masked text frame at out. Returns its length.
+int ws_client_frame(char *out, const char *data, int len) {
+  const char mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+  int h = 2, i;
+  out[0] = 0x81;
+  if (len < 126)
+    out[1] = 0x80 | len;
+  else {
+    out[1] = 0x80 | 126;
+    out[2] = len >> 8;
+    out[3] = len & 0xFF;
+    h = 4;
+  }
+  memcpy(out + h, mask, 4);
+  h += 4;
+  for (i = 0; i < len; i++)
+    out[h + i] = data[i] ^ mask[i & 3];
+  return h + len;
+}
+
+/// First byte of the last frame read with ws_client_read
+unsigned char ws_client_byte0;
+
+/// Reads a server frame payload into data. Returns its length, or -1.
+int ws_client_read(int fd, char *data) {
+  unsigned char h[4];
+  if (recv(fd, h, 2, MSG_WAITALL) != 2)
+    return -1;
+  ws_client_byte0 = h[0];
+  int len = h[1] & 0x7F;
+  if (len == 126) {
+    if (recv(fd, h + 2, 2, MSG_WAITALL) != 2)
+      return -1;
+    len = (h[2] << 8) | h[3];
+  }
+  if (len && recv(fd, data, len, MSG_WAITALL) != len)
+    return -1;
+  data[len] = 0;
+  return len;
+}
+
+void t05_websocket_polled() {
+  INIT_LOCAL();
+  const int nclients = 20;
+  int fds[nclients], i;
+  char frame[1024], data[1024];
+
+  onion *o = onion_new(O_POOL);
+  onion_set_max_threads(o, 2);
+  onion_set_timeout(o, 1000);
+  onion_set_port(o, "8093");
+  onion_set_root_handler(o, onion_handler_new(ws_echo_handler, NULL, NULL));
+  pthread_t th;
+  pthread_create(&th, NULL, ws_listen_thread, o);
+  sleep(1);
+
+  // More websockets than threads, all open at the same time.
+  for (i = 0; i < nclients; i++) {
+    fds[i] = ws_client_connect("8093");
+    FAIL_IF(fds[i] < 0);
+  }
+  sleep(2);                     // Longer than the timeout; websockets have none.
+  for (i = nclients - 1; i >= 0; i--) {
+    if (fds[i] < 0)
+      continue;
+    char msg[32];
+    int l = snprintf(msg, sizeof(msg), "hello %d", i);
+    int fl = ws_client_frame(frame, msg, l);
+    FAIL_IF_NOT_EQUAL_INT(send(fds[i], frame, fl, 0), fl);
+    FAIL_IF_NOT_EQUAL_INT(ws_client_read(fds[i], data), l);
+    FAIL_IF_NOT_EQUAL_STR(data, msg);
+  }
+
+  if (fds[0] >= 0) {            // Several frames in one send, and one frame in several.
+    int fl = ws_client_frame(frame, "one", 3);
+    fl += ws_client_frame(frame + fl, "two", 3);
+    frame[fl++] = 0x89;         // Ping, answered by the server
+    frame[fl++] = 0x80 | 2;
+    memset(frame + fl, 0, 4);
+    fl += 4;
+    frame[fl++] = 'p';
+    frame[fl++] = 'i';
+    int half = fl + 4;
+    memset(data, 'x', 300);
+    fl += ws_client_frame(frame + fl, data, 300);
+    FAIL_IF_NOT_EQUAL_INT(send(fds[0], frame, half, 0), half);
+    usleep(100000);
+    FAIL_IF_NOT_EQUAL_INT(send(fds[0], frame + half, fl - half, 0),
+                          fl - half);
+    FAIL_IF_NOT_EQUAL_INT(ws_client_read(fds[0], data), 3);
+    FAIL_IF_NOT_EQUAL_STR(data, "one");
+    FAIL_IF_NOT_EQUAL_INT(ws_client_read(fds[0], data), 3);
+    FAIL_IF_NOT_EQUAL_STR(data, "two");
+    FAIL_IF_NOT_EQUAL_INT(ws_client_read(fds[0], data), 2);
+    FAIL_IF_NOT_EQUAL_STR(data, "pi");
+    FAIL_IF_NOT_EQUAL_INT(ws_client_read(fds[0], data), 300);
+    FAIL_IF_NOT_EQUAL_INT(data[299], 'x');
+  }
+
+  for (i = 0; i < nclients; i++)
+    if (fds[i] >= 0)
+      close(fds[i]);
+
+  onion_listen_stop(o);
+  pthread_join(th, NULL);
+  onion_free(o);
+  END_LOCAL();
+}
+
+void t07_websocket_buffered_read() {
+  INIT_LOCAL();
+  onion *o = websocket_server_new();
+  onion_request *req = websocket_start_handshake(o);
+  onion_listen_point *lp = req->connection.listen_point;
+  lp->read = (lpreader_sig_t *) websocket_data_buffer_read;
+  lp->write = websocket_data_buffer_write;
+  onion_response *res = onion_response_new(req);
+  onion_websocket *ws = onion_websocket_new(req, res);
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+
+  char frame[1100], data[1000], msg[16];
+  int i, l;
+  for (i = 0; i < 50; i++) {    // Many small frames, all read at once
+    l = snprintf(msg, sizeof(msg), "frame %d", i);
+    websocket_data_buffer_write(req, frame, ws_client_frame(frame, msg, l));
+  }
+  ws_data_reads = 0;
+  for (i = 0; i < 50; i++) {
+    l = snprintf(msg, sizeof(msg), "frame %d", i);
+    memset(data, 0, sizeof(data));
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_read(ws, data, l), l);
+    FAIL_IF_NOT_EQUAL_STR(data, msg);
+  }
+  FAIL_IF_NOT_EQUAL_INT(ws_data_reads, 1);
+
+  char payload[1000];
+  for (i = 0; i < sizeof(payload); i++)
+    payload[i] = i * 13;
+  websocket_data_buffer_write(req, frame,
+                              ws_client_frame(frame, payload,
+                                              sizeof(payload)));
+  int pos = 0, chunk = 1;       // Unmasked at all offsets and sizes
+  while (pos < sizeof(payload)) {
+    int n = sizeof(payload) - pos < chunk ? sizeof(payload) - pos : chunk;
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_read(ws, &data[pos], n), n);
+    pos += n;
+    chunk++;
+  }
+  FAIL_IF_NOT(memcmp(data, payload, sizeof(payload)) == 0);
+
+  onion_websocket_free(ws);
+  onion_response_free(res);
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+  onion_request_free(req);
+  onion_free(o);
+  END_LOCAL();
+}
+
+void t08_websocket_hub() {
+  INIT_LOCAL();
+  onion *o = websocket_server_new();
+  onion_websocket_hub *hub = onion_websocket_hub_new();
+  onion_request *req[3];
+  onion_websocket *ws[3];
+  int i;
+  for (i = 0; i < 3; i++) {
+    req[i] = websocket_start_handshake(o);
+    onion_response *res = onion_response_new(req[i]);
+    ws[i] = onion_websocket_new(req[i], res);
+    onion_response_free(res);
+  }
+  onion_listen_point *lp = req[0]->connection.listen_point;
+  lp->write = websocket_data_buffer_write;
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_subscribe(hub, "a", ws[0]), 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_subscribe(hub, "a", ws[0]), 1);
+  onion_websocket_hub_subscribe(hub, "a", ws[1]);
+  onion_websocket_hub_subscribe(hub, "b", ws[1]);
+  onion_websocket_hub_subscribe(hub, "b", ws[2]);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_count(hub, "a"), 2);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_count(hub, "b"), 2);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_count(hub, "c"), 0);
+
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_publish
+                        (hub, "a", OWS_TEXT, "hello", 5), 2);
+  FAIL_IF_NOT(ws_check_frame(0x81, "hello", 5));
+  FAIL_IF_NOT(ws_check_frame(0x81, "hello", 5));
+  FAIL_IF_NOT_EQUAL_INT(ws_data_length, 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_publish
+                        (hub, "c", OWS_TEXT, "nobody", 6), 0);
+
+  onion_websocket_frame *frame =
+      onion_websocket_frame_new(OWS_BINARY, "shared", 6);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_publish_frame(hub, "b", frame),
+                        2);
+  onion_websocket_frame_free(frame);
+  FAIL_IF_NOT(ws_check_frame(0x82, "shared", 6));
+  FAIL_IF_NOT(ws_check_frame(0x82, "shared", 6));
+
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_unsubscribe(hub, "b", ws[1]), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_unsubscribe(hub, "b", ws[1]), 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_count(hub, "b"), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_unsubscribe(hub, NULL, ws[0]), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_count(hub, "a"), 1);
+
+  onion_request_free(req[1]);   // Freeing unsubscribes
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_count(hub, "a"), 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_publish
+                        (hub, "a", OWS_TEXT, "gone", 4), 0);
+  FAIL_IF_NOT_EQUAL_INT(ws_data_length, 0);
+
+  // Not in between the fragments of a message, but after it
+  onion_websocket_hub_subscribe(hub, "a", ws[0]);
+  onion_websocket_set_opcode(ws[0], OWS_TEXT);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_write_fragment(ws[0], "one", 3, 0), 3);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_publish
+                        (hub, "a", OWS_TEXT, "news", 4), 1);
+  FAIL_IF_NOT(ws_check_frame(0x01, "one", 3));
+  FAIL_IF_NOT_EQUAL_INT(ws_data_length, 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_backlog(ws[0]), 6);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_write_fragment(ws[0], "two", 3, 1), 3);
+  FAIL_IF_NOT(ws_check_frame(0x80, "two", 3));
+  FAIL_IF_NOT(ws_check_frame(0x81, "news", 4));
+  FAIL_IF_NOT_EQUAL_INT(ws_data_length, 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_backlog(ws[0]), 0);
+
+  onion_websocket_hub_free(hub);        // And freeing the hub too
+  onion_request_free(req[0]);
+  onion_request_free(req[2]);
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+  onion_free(o);
+  END_LOCAL();
+}
+
+onion_websocket_hub *ws_hub = NULL;
+
+/// Subscribes to "news", and ignores any input.
+onion_connection_status ws_hub_handler(void *priv, onion_request * req,
+                                       onion_response * res) {
+  onion_websocket *ws = onion_websocket_new(req, res);
+  if (!ws)
+    return OCS_NOT_IMPLEMENTED;
+  onion_websocket_set_callback(ws, ws_callback);
+  onion_websocket_hub_subscribe(ws_hub, "news", ws);
+  return OCS_WEBSOCKET;
+}
+
+/// Waits up to 5 seconds for the topic to have count subscribers.
+int ws_hub_wait_count(const char *topic, int count) {
+  int i;
+  for (i = 0; i < 50; i++) {
+    if (onion_websocket_hub_count(ws_hub, topic) == count)
+      return 1;
+    usleep(100000);
+  }
+  return 0;
+}
+
+void t09_websocket_hub_server() {
+  INIT_LOCAL();
+  const int nclients = 10;
+  const int big = 60000;
+  int fds[nclients], i, j;
+  char *data = malloc(big + 1);
+
+  ws_hub = onion_websocket_hub_new();
+  onion *o = onion_new(O_POOL);
+  onion_set_max_threads(o, 2);
+  onion_set_port(o, "8094");
+  onion_set_root_handler(o, onion_handler_new(ws_hub_handler, NULL, NULL));
+  pthread_t th;
+  pthread_create(&th, NULL, ws_listen_thread, o);
+  sleep(1);
+
+  for (i = 0; i < nclients; i++) {
+    fds[i] = ws_client_connect("8094");
+    FAIL_IF(fds[i] < 0);
+  }
+  FAIL_IF_NOT(ws_hub_wait_count("news", nclients));
+
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_publish
+                        (ws_hub, "news", OWS_TEXT, "hello", 5), nclients);
+  for (i = 0; i < nclients; i++) {
+    FAIL_IF_NOT_EQUAL_INT(ws_client_read(fds[i], data), 5);
+    FAIL_IF_NOT(memcmp(data, "hello", 5) == 0);
+  }
+
+  // Much more than the socket buffers, while nobody reads. Must not block, and all is sent
+  // later, as clients read.
+  char *msg = malloc(big);
+  onion_websocket_hub_set_backlog(ws_hub, 0, OWH_DROP);
+  for (j = 0; j < 100; j++) {
+    memset(msg, 'a' + (j % 26), big);
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_publish
+                          (ws_hub, "news", OWS_BINARY, msg, big), nclients);
+  }
+  for (i = 0; i < nclients; i++) {
+    for (j = 0; j < 100; j++) {
+      FAIL_IF_NOT_EQUAL_INT(ws_client_read(fds[i], data), big);
+      if (data[0] != 'a' + (j % 26) || data[big - 1] != 'a' + (j % 26)) {
+        FAIL("Bad data");
+        break;
+      }
+    }
+  }
+
+  // Slow client over the backlog loses messages
+  onion_websocket_hub_set_backlog(ws_hub, 4 * big, OWH_DROP);
+  int sent = 0;
+  for (j = 0; j < 100; j++)
+    sent += onion_websocket_hub_publish(ws_hub, "news", OWS_BINARY, msg, big);
+  FAIL_IF(sent == 100 * nclients);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_hub_count(ws_hub, "news"), nclients);
+  for (i = 0; i < nclients; i++) {      // Reconnect, to start clean
+    close(fds[i]);
+    fds[i] = -1;
+  }
+  FAIL_IF_NOT(ws_hub_wait_count("news", 0));
+
+  // Or is disconnected
+  onion_websocket_hub_set_backlog(ws_hub, 4 * big, OWH_CLOSE);
+  fds[0] = ws_client_connect("8094");
+  fds[1] = ws_client_connect("8094");
+  FAIL_IF_NOT(ws_hub_wait_count("news", 2));
+  for (j = 0; j < 100; j++) {
+    onion_websocket_hub_publish(ws_hub, "news", OWS_BINARY, msg, big);
+    ws_client_read(fds[1], data);       // This one reads
+  }
+  FAIL_IF_NOT(ws_hub_wait_count("news", 1));
+  while (ws_client_read(fds[0], data) > 0) ;      // Gets some, then closed
+  for (i = 0; i < 2; i++)
+    close(fds[i]);
+  FAIL_IF_NOT(ws_hub_wait_count("news", 0));
+
+  onion_listen_stop(o);
+  pthread_join(th, NULL);
+  onion_free(o);
+  onion_websocket_hub_free(ws_hub);
+  ws_hub = NULL;
+  free(msg);
+  free(data);
+  END_LOCAL();
+}
+
+#ifdef HAVE_ZLIB
+/// Compresses as a permessage-deflate client, with the context of previous calls. Returns the length.
+int ws_deflate(z_stream * z, const char *data, int len, int fin, char *out) {
+  z->next_in = (Bytef *) data;
+  z->avail_in = len;
+  z->next_out = (Bytef *) out;
+  z->avail_out = len + 1024;
+  deflate(z, Z_SYNC_FLUSH);
+  return len + 1024 - z->avail_out - (fin ? 4 : 0);
+}
+
+/// Inflates a message, or part of it, adding the tail removed at the end of messages.
+int ws_inflate(z_stream * z, const char *data, int len, int fin, char *out,
+               int size) {
+  z->next_out = (Bytef *) out;
+  z->avail_out = size;
+  z->next_in = (Bytef *) data;
+  z->avail_in = len;
+  if (inflate(z, Z_SYNC_FLUSH) < 0 && len)
+    return -1;
+  if (fin) {
+    z->next_in = (Bytef *) "\x00\x00\xff\xff";
+    z->avail_in = 4;
+    if (inflate(z, Z_SYNC_FLUSH) < 0)
+      return -1;
+  }
+  return size - z->avail_out;
+}
+
+/// Does the handshake at the buffer listen point. Returns the extensions answered, or "" if none.
+const char *ws_deflate_handshake(onion * o, const char *extensions,
+                                 onion_request ** req) {
+  static char answer[256];
+  char hs[512];
+  snprintf(hs, sizeof(hs),
+           "GET /\nUpgrade: websocket\nSec-Websocket-Version: 13\nSec-Websocket-Key: My-key\nSec-Websocket-Extensions: %s\n\n",
+           extensions);
+  *req = onion_request_new(onion_get_listen_point(o, 0));
+  onion_request_write0(*req, hs);
+  onion_request_process(*req);
+  answer[0] = 0;
+  const char *h = strstr(onion_buffer_listen_point_get_buffer_data(*req),
+                         "Sec-Websocket-Extensions: ");
+  if (h) {
+    h += strlen("Sec-Websocket-Extensions: ");
+    int l = strcspn(h, "\r\n");
+    memcpy(answer, h, l);
+    answer[l] = 0;
+  }
+  return answer;
+}
+
+/// Checks the answer to the extensions offered.
+int ws_deflate_check(onion * o, const char *extensions, const char *expected) {
+  onion_request *req;
+  const char *answer = ws_deflate_handshake(o, extensions, &req);
+  int ok = strcmp(answer, expected) == 0;
+  if (!ok)
+    ERROR("Offered %s, answered '%s', expected '%s'", extensions,
+                answer, expected);
+  onion_request_free(req);
+  return ok;
+}
+
+void t10_websocket_deflate_negotiation() {
+  INIT_LOCAL();
+  onion *o = websocket_server_new();
+  FAIL_IF_NOT(ws_deflate_check(o, "permessage-deflate", ""));   // Disabled by default
+
+  onion_set_websocket_deflate(o, 15, 0);
+  FAIL_IF_NOT(ws_deflate_check(o, "permessage-deflate", "permessage-deflate"));
+  FAIL_IF_NOT(ws_deflate_check
+              (o, "permessage-deflate; client_max_window_bits",
+               "permessage-deflate"));
+  FAIL_IF_NOT(ws_deflate_check
+              (o, "permessage-deflate; client_max_window_bits=10",
+               "permessage-deflate"));
+  FAIL_IF_NOT(ws_deflate_check
+              (o, "permessage-deflate;server_max_window_bits=\"10\"",
+               "permessage-deflate; server_max_window_bits=10"));
+  FAIL_IF_NOT(ws_deflate_check
+              (o,
+               "permessage-deflate; server_max_window_bits=8, permessage-deflate; server_no_context_takeover",
+               "permessage-deflate; server_no_context_takeover"));
+  FAIL_IF_NOT(ws_deflate_check
+              (o, "x-webkit-deflate-frame, permessage-deflate; unknown=1",
+               ""));
+  FAIL_IF_NOT(ws_deflate_check
+              (o,
+               "permessage-deflate; client_no_context_takeover; client_no_context_takeover",
+               ""));
+  FAIL_IF_NOT(ws_deflate_check
+              (o, "permessage-deflate; server_max_window_bits=16", ""));
+  FAIL_IF_NOT(ws_deflate_check(o, "other", ""));
+
+  onion_set_websocket_deflate(o, 12, OWD_CLIENT_NO_CONTEXT_TAKEOVER);
+  FAIL_IF_NOT(ws_deflate_check
+              (o, "permessage-deflate",
+               "permessage-deflate; client_no_context_takeover"));
+  FAIL_IF_NOT(ws_deflate_check
+              (o, "permessage-deflate; server_max_window_bits=15",
+               "permessage-deflate; client_no_context_takeover; server_max_window_bits=12"));
+
+  onion_free(o);
+  END_LOCAL();
+}
+
+/// Reads the next frame written to the buffer, and removes it. Returns the payload length, or -1.
+int ws_pop_frame(int *byte0, char *payload) {
+  if (ws_data_length < 2)
+    return -1;
+  unsigned char *h = (unsigned char *)ws_data_tmp;
+  int hlen = 2, len = h[1];
+  if (len == 126) {
+    hlen = 4;
+    len = (h[2] << 8) | h[3];
+  }
+  if (len == 127 || ws_data_length < hlen + len)
+    return -1;
+  *byte0 = h[0];
+  memcpy(payload, ws_data_tmp + hlen, len);
+  memmove(ws_data_tmp, ws_data_tmp + hlen + len,
+          ws_data_length - hlen - len);
+  ws_data_length -= hlen + len;
+  return len;
+}
+
+void t11_websocket_deflate_messages() {
+  INIT_LOCAL();
+  onion *o = websocket_server_new();
+  onion_set_websocket_deflate(o, 15, 0);
+  onion_request *req;
+  const char *answer = ws_deflate_handshake(o, "permessage-deflate", &req);
+  FAIL_IF_NOT_EQUAL_STR(answer, "permessage-deflate");
+  onion_websocket *ws = req->websocket;
+  FAIL_IF_NOT(ws);
+  onion_listen_point *lp = req->connection.listen_point;
+  lp->write = websocket_data_buffer_write;
+  lp->read = (lpreader_sig_t *) websocket_data_buffer_read;
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+
+  char msg[1000], frame[4096], data[4096];
+  int i, byte0, len;
+  for (i = 0; i < sizeof(msg); i++)
+    msg[i] = "{\"price\": 10, \"name\": \"onion\"}, "[i % 32];
+  z_stream client_in;
+  memset(&client_in, 0, sizeof(client_in));
+  inflateInit2(&client_in, -15);
+
+  // Compressed, and the second time smaller, as the first is the context.
+  onion_websocket_set_opcode(ws, OWS_TEXT);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_write(ws, msg, sizeof(msg)),
+                        sizeof(msg));
+  len = ws_pop_frame(&byte0, frame);
+  FAIL_IF_NOT_EQUAL_INT(byte0, 0xC1);
+  FAIL_IF_NOT(len > 0 && len < 200);
+  FAIL_IF_NOT_EQUAL_INT(ws_inflate
+                        (&client_in, frame, len, 1, data, sizeof(data)),
+                        sizeof(msg));
+  FAIL_IF_NOT(memcmp(data, msg, sizeof(msg)) == 0);
+  int first = len;
+  onion_websocket_write(ws, msg, sizeof(msg));
+  len = ws_pop_frame(&byte0, frame);
+  FAIL_IF_NOT(len > 0 && len < first / 2);
+  FAIL_IF_NOT_EQUAL_INT(ws_inflate
+                        (&client_in, frame, len, 1, data, sizeof(data)),
+                        sizeof(msg));
+  FAIL_IF_NOT(memcmp(data, msg, sizeof(msg)) == 0);
+
+  // Fragments: only the first one marked, each can be inflated as it arrives.
+  onion_websocket_write_fragment(ws, msg, 500, 0);
+  onion_websocket_write_fragment(ws, msg + 500, 500, 1);
+  len = ws_pop_frame(&byte0, frame);
+  FAIL_IF_NOT_EQUAL_INT(byte0, 0x41);
+  FAIL_IF_NOT_EQUAL_INT(ws_inflate
+                        (&client_in, frame, len, 0, data, sizeof(data)), 500);
+  len = ws_pop_frame(&byte0, frame);
+  FAIL_IF_NOT_EQUAL_INT(byte0, 0x80);
+  FAIL_IF_NOT_EQUAL_INT(ws_inflate
+                        (&client_in, frame, len, 1, data + 500,
+                         sizeof(data) - 500), 500);
+  FAIL_IF_NOT(memcmp(data, msg, sizeof(msg)) == 0);
+
+  // Shared frames are compressed on their own, and then own messages are still right.
+  onion_websocket_frame *shared =
+      onion_websocket_frame_new(OWS_TEXT, msg + 1, sizeof(msg) - 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_write_shared(ws, shared, 0), 0);
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_write_shared(ws, shared, 0), 0);
+  onion_websocket_frame_free(shared);
+  for (i = 0; i < 2; i++) {
+    len = ws_pop_frame(&byte0, frame);
+    FAIL_IF_NOT_EQUAL_INT(byte0, 0xC1);
+    FAIL_IF_NOT_EQUAL_INT(ws_inflate
+                          (&client_in, frame, len, 1, data, sizeof(data)),
+                          sizeof(msg) - 1);
+    FAIL_IF_NOT(memcmp(data, msg + 1, sizeof(msg) - 1) == 0);
+  }
+  onion_websocket_write(ws, msg, sizeof(msg));
+  len = ws_pop_frame(&byte0, frame);
+  FAIL_IF_NOT_EQUAL_INT(ws_inflate
+                        (&client_in, frame, len, 1, data, sizeof(data)),
+                        sizeof(msg));
+  FAIL_IF_NOT(memcmp(data, msg, sizeof(msg)) == 0);
+  shared = onion_websocket_frame_new(OWS_TEXT, "small", 5);    // Not worth it
+  onion_websocket_write_shared(ws, shared, 0);
+  onion_websocket_frame_free(shared);
+  FAIL_IF_NOT(ws_check_frame(0x81, "small", 5));
+
+  // Control frames are never compressed
+  onion_websocket_close(ws, "\x03\xe8");
+  FAIL_IF_NOT(ws_check_frame(0x88, "\x03\xe8", 2));
+  FAIL_IF_NOT_EQUAL_INT(ws_data_length, 0);
+  inflateEnd(&client_in);
+
+  // Reading compressed messages, with context, fragmented, and not compressed.
+  z_stream client_out;
+  memset(&client_out, 0, sizeof(client_out));
+  deflateInit2(&client_out, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+               Z_DEFAULT_STRATEGY);
+  for (i = 0; i < 2; i++) {
+    len = ws_deflate(&client_out, msg, sizeof(msg), 1, data);
+    len = ws_client_frame(frame, data, len);
+    frame[0] |= 0x40;
+    websocket_data_buffer_write(req, frame, len);
+  }
+  len = ws_deflate(&client_out, msg, 300, 0, data);
+  len = ws_client_frame(frame, data, len);
+  frame[0] = 0x41;
+  websocket_data_buffer_write(req, frame, len);
+  len = ws_deflate(&client_out, msg + 300, 700, 1, data);
+  len = ws_client_frame(frame, data, len);
+  frame[0] = 0x80;
+  websocket_data_buffer_write(req, frame, len);
+  len = ws_client_frame(frame, "plain", 5);
+  websocket_data_buffer_write(req, frame, len);
+  deflateEnd(&client_out);
+
+  for (i = 0; i < 3; i++) {
+    memset(data, 0, sizeof(data));
+    FAIL_IF_NOT_EQUAL_INT(onion_websocket_read(ws, data, sizeof(msg)),
+                          sizeof(msg));
+    FAIL_IF_NOT(memcmp(data, msg, sizeof(msg)) == 0);
+  }
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_read(ws, data, 5), 5);
+  FAIL_IF_NOT(memcmp(data, "plain", 5) == 0);
+
+  // RSV1 at a continuation is an error
+  len = ws_client_frame(frame, "bad", 3);
+  frame[0] = 0xC0;
+  websocket_data_buffer_write(req, frame, len);
+  FAIL_IF(onion_websocket_read(ws, data, 3) >= 0);
+
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+  onion_request_free(req);
+  onion_free(o);
+  END_LOCAL();
+}
+
+void t12_websocket_deflate_polled() {
+  INIT_LOCAL();
+  char msg[1000], frame[4096], data[4096];
+  int i, len;
+  for (i = 0; i < sizeof(msg); i++)
+    msg[i] = "{\"price\": 10, \"name\": \"onion\"}, "[i % 32];
+
+  onion *o = onion_new(O_POOL);
+  onion_set_max_threads(o, 2);
+  onion_set_port(o, "8095");
+  onion_set_websocket_deflate(o, 15, 0);
+  onion_set_root_handler(o, onion_handler_new(ws_echo_handler, NULL, NULL));
+  pthread_t th;
+  pthread_create(&th, NULL, ws_listen_thread, o);
+  sleep(1);
+
+  int fd = ws_client_connect_headers("8095",
+                                     "Sec-Websocket-Extensions: permessage-deflate; client_max_window_bits\r\n");
+  FAIL_IF(fd < 0);
+  z_stream client_in, client_out;
+  memset(&client_in, 0, sizeof(client_in));
+  memset(&client_out, 0, sizeof(client_out));
+  inflateInit2(&client_in, -15);
+  deflateInit2(&client_out, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+               Z_DEFAULT_STRATEGY);
+  for (i = 0; i < 4; i++) {     // Echo of compressed and plain messages is compressed
+    if (i == 2)
+      len = ws_client_frame(frame, msg, sizeof(msg));
+    else {
+      len = ws_deflate(&client_out, msg, sizeof(msg), 1, data);
+      len = ws_client_frame(frame, data, len);
+      frame[0] |= 0x40;
+    }
+    FAIL_IF_NOT_EQUAL_INT(send(fd, frame, len, 0), len);
+    len = ws_client_read(fd, frame);
+    FAIL_IF_NOT_EQUAL_INT(ws_client_byte0, 0xC1);
+    FAIL_IF_NOT(len > 0 && len < sizeof(msg) / 2);
+    FAIL_IF_NOT_EQUAL_INT(ws_inflate
+                          (&client_in, frame, len, 1, data, sizeof(data)),
+                          sizeof(msg));
+    FAIL_IF_NOT(memcmp(data, msg, sizeof(msg)) == 0);
+  }
+  inflateEnd(&client_in);
+  deflateEnd(&client_out);
+  close(fd);
+
+  onion_listen_stop(o);
+  pthread_join(th, NULL);
+  onion_free(o);
+  END_LOCAL();
+}
+#endif
+
+int ws_pending_frames = 0;
+
+onion_connection_status ws_pending_callback(void *privadata,
+                                            onion_websocket * ws,
+                                            ssize_t nbytes_ready) {
+  char data[64];
+  if (onion_websocket_read(ws, data, nbytes_ready) == nbytes_ready)
+    ws_pending_frames++;
+  return OCS_NEED_MORE_DATA;
+}
+
+/// As a TLS record, gives at most 100 bytes at each read, and keeps the rest.
+ssize_t websocket_data_record_read(onion_request * req, char *data,
+                                   size_t len) {
+  return websocket_data_buffer_read(req, data, len < 100 ? len : 100);
+}
+
+size_t websocket_data_record_pending(onion_request * req) {
+  return ws_data_length;
+}
+
+void t13_websocket_polled_pending() {
+  INIT_LOCAL();
+  onion *o = websocket_server_new();
+  onion_request *req = websocket_start_handshake(o);
+  onion_listen_point *lp = req->connection.listen_point;
+  lp->read = websocket_data_record_read;
+  lp->write = websocket_data_buffer_write;
+  lp->pending = websocket_data_record_pending;
+  onion_response *res = onion_response_new(req);
+  onion_websocket *ws = onion_websocket_new(req, res);
+  onion_websocket_set_callback(ws, ws_pending_callback);
+  req->connection.slot = onion_poller_slot_new(0, NULL, NULL);  // Only its type is set
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+
+  char frame[64], msg[16];
+  int i, l;
+  for (i = 0; i < 50; i++) {
+    l = snprintf(msg, sizeof(msg), "frame %d", i);
+    websocket_data_buffer_write(req, frame, ws_client_frame(frame, msg, l));
+  }
+  ws_data_reads = 0;
+  // One poller event, but all the data kept by the listen point is read.
+  FAIL_IF_NOT_EQUAL_INT(onion_websocket_read_ready(ws), OCS_PROCESSED);
+  FAIL_IF_NOT_EQUAL_INT(ws_pending_frames, 50);
+  FAIL_IF_NOT_EQUAL_INT(ws_data_length, 0);
+  FAIL_IF_NOT(ws_data_reads > 1);
+
+  onion_poller_slot_free(req->connection.slot);
+  req->connection.slot = NULL;
+  onion_websocket_free(ws);
+  onion_response_free(res);
+  free(ws_data_tmp);
+  ws_data_tmp = NULL;
+  ws_data_length = 0;
+  onion_request_free(req);
+  onion_free(o);
+  END_LOCAL();
+}
+
 int main(int argc, char **argv) {
   START();
 
@@ -263,6 +1157,17 @@ int main(int argc, char **argv) {
   t02_websocket_server_w_ws();
   t03_websocket_server_receive_small_packet();
   t04_websocket_server_close_handshake();
+  t05_websocket_polled();
+  t06_websocket_write_frames();
+  t07_websocket_buffered_read();
+  t08_websocket_hub();
+  t09_websocket_hub_server();
+#ifdef HAVE_ZLIB
+  t10_websocket_deflate_negotiation();
+  t11_websocket_deflate_messages();
+  t12_websocket_deflate_polled();
+#endif
+  t13_websocket_polled_pending();
 
   END();
 }
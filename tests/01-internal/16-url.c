@@ -112,6 +112,205 @@ void t01_url() {
   END_LOCAL();
 }
 
+/// Sets handler_called to the route number at p.
+int handler_n(int *p, onion_request * r, onion_response * res) {
+  handler_called = *p;
+  free(urltxt);
+  urltxt = strdup(onion_request_get_path(r));
+  return OCS_PROCESSED;
+}
+
+/// Requests the path, and returns the route number that handled it, or 0.
+int check_route(onion_url * url, const char *path) {
+  char tmp[512];
+  handler_called = 0;
+  onion_set_root_handler(server, onion_url_to_handler(url));
+  onion_request *req = onion_request_new(onion_get_listen_point(server, 0));
+  int l = snprintf(tmp, sizeof(tmp), "GET /%s HTTP/1.1\n\n", path);
+  onion_request_write(req, tmp, l);
+  onion_request_process(req);
+  onion_request_free(req);
+  onion_set_root_handler(server, NULL);
+  return handler_called;
+}
+
+int route_numbers[512];
+
+void add_route(onion_url * url, const char *regexp, int n) {
+  route_numbers[n] = n;
+  onion_url_add_with_data(url, regexp, handler_n, &route_numbers[n], NULL);
+}
+
+void t02_many_routes() {
+  INIT_LOCAL();
+  onion_url *url = onion_url_new();
+  char tmp[64];
+  int i;
+  for (i = 1; i < 400; i++) {
+    snprintf(tmp, sizeof(tmp), "^api/v1/item%d/([0-9]+)$", i);
+    add_route(url, tmp, i);
+  }
+  add_route(url, "^api/v1/", 400);
+  add_route(url, "", 401);
+
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "api/v1/item1/12"), 1);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "api/v1/item12/12"), 12);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "api/v1/item399/1"), 399);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "api/v1/item399/a"), 400);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "api/v1/item400/1"), 400);
+  FAIL_IF_NOT_EQUAL_STR(urltxt, "item400/1");
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "api/v2/"), 0);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, ""), 401);
+
+  onion_url_free(url);
+  END_LOCAL();
+}
+
+void t03_first_match() {
+  INIT_LOCAL();
+  onion_url *url = onion_url_new();
+  add_route(url, "^a", 1);
+  add_route(url, "^abc", 2);
+  add_route(url, "abc", 3);
+  add_route(url, "^ab(c|d)", 4);
+  add_route(url, "^x(.*)$", 5);
+  add_route(url, "^xyz", 6);
+
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "abc"), 1);
+  FAIL_IF_NOT_EQUAL_STR(urltxt, "bc");
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "b"), 0);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "xyz"), 5);
+  FAIL_IF_NOT_EQUAL_STR(urltxt, "");
+
+  onion_url_free(url);
+
+  url = onion_url_new();
+  add_route(url, "^ab(c|d)", 1);
+  add_route(url, "abc", 2);
+  add_route(url, "^abc", 3);
+  add_route(url, "^ab", 4);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "abd"), 1);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "abc"), 1);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "abe"), 4);
+  FAIL_IF_NOT_EQUAL_STR(urltxt, "e");
+  onion_url_free(url);
+
+  END_LOCAL();
+}
+
+void t04_add_after_requests() {
+  INIT_LOCAL();
+  onion_url *url = onion_url_new();
+  add_route(url, "^users/", 1);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "users/me"), 1);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "groups/me"), 0);
+
+  add_route(url, "^groups/", 2);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "groups/me"), 2);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "users/me"), 1);
+
+  add_route(url, "^", 3);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "other"), 3);
+  FAIL_IF_NOT_EQUAL_STR(urltxt, "other");
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "users/me"), 1);
+
+  onion_url_free(url);
+  END_LOCAL();
+}
+
+void t05_prefixes() {
+  INIT_LOCAL();
+  onion_url *url = onion_url_new();
+  add_route(url, "^file\\.txt$", 1);
+  add_route(url, "^colou?r$", 2);
+  add_route(url, "^go+gle$", 3);
+  add_route(url, "^ab{2}c$", 4);
+  add_route(url, "^a.c$", 5);
+  add_route(url, "^(x|y)z$", 6);
+  add_route(url, "^x[0-9]$", 7);
+  add_route(url, "^static/", 8);
+
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "file.txt"), 1);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "fileatxt"), 0);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "file.txt2"), 0);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "color"), 2);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "colour"), 2);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "gogle"), 3);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "gooogle"), 3);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "ggle"), 0);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "abbc"), 4);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "abc"), 5);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "yz"), 6);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "x7"), 7);
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "static/css/a.css"), 8);
+  FAIL_IF_NOT_EQUAL_STR(urltxt, "css/a.css");
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "stati"), 0);
+
+  onion_url_free(url);
+  END_LOCAL();
+}
+
+char *param_user, *param_item, *param_1, *query_1, *query_2;
+
+/// Keeps some path params, and the legacy query values.
+int handler_params(void *p, onion_request * r, onion_response * res) {
+  handler_called = 10;
+  param_user = strdup(onion_request_get_path_param(r, "user") ? : "(null)");
+  param_item = strdup(onion_request_get_path_param(r, "item") ? : "(null)");
+  param_1 = strdup(onion_request_get_path_param_n(r, 1) ? : "(null)");
+  query_1 = strdup(onion_request_get_query(r, "1") ? : "(null)");
+  query_2 = strdup(onion_request_get_query(r, "2") ? : "(null)");
+  return OCS_PROCESSED;
+}
+
+void free_params() {
+  free(param_user);
+  free(param_item);
+  free(param_1);
+  free(query_1);
+  free(query_2);
+}
+
+void t06_path_params() {
+  INIT_LOCAL();
+  onion_url *url = onion_url_new();
+  onion_url_add(url, "^users/(?<user>[^/]*)/(?<item>[0-9]+)$", handler_params);
+  onion_url_add(url, "^g([(]?)(?P<user>[a-z]*)$", handler_params);
+  onion_url *inner = onion_url_new();
+  onion_url_add(inner, "^items/(?<item>[0-9]+)$", handler_params);
+  onion_url_add_url(url, "^nested/(?<user>[^/]*)/(x)/", inner);
+
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "users/me/12"), 10);
+  FAIL_IF_NOT_EQUAL_STR(param_user, "me");
+  FAIL_IF_NOT_EQUAL_STR(param_item, "12");
+  FAIL_IF_NOT_EQUAL_STR(param_1, "me");
+  FAIL_IF_NOT_EQUAL_STR(query_1, "me");
+  FAIL_IF_NOT_EQUAL_STR(query_2, "12");
+  free_params();
+
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "users/me/a"), 0);
+
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "g(abc"), 10);  // Bracket and groups count
+  FAIL_IF_NOT_EQUAL_STR(param_user, "abc");
+  FAIL_IF_NOT_EQUAL_STR(param_1, "(");
+  free_params();
+
+  FAIL_IF_NOT_EQUAL_INT(check_route(url, "nested/you/x/items/34"), 10);
+  FAIL_IF_NOT_EQUAL_STR(param_user, "you");
+  FAIL_IF_NOT_EQUAL_STR(param_item, "34");
+  FAIL_IF_NOT_EQUAL_STR(param_1, "34");
+  FAIL_IF_NOT_EQUAL_STR(query_1, "34");
+  FAIL_IF_NOT_EQUAL_STR(query_2, "x");
+  free_params();
+
+  onion_handler *bad = onion_handler_new(handler_params, NULL, NULL);
+  FAIL_IF_NOT_EQUAL_INT(onion_url_add_handler(url, "^bad(?<name>", bad), 1);
+  onion_handler_free(bad);
+
+  onion_url_free(url);
+  END_LOCAL();
+}
+
 void init() {
   server = onion_new(0);
   onion_add_listen_point(server, NULL, NULL, onion_buffer_listen_point_new());
@@ -119,6 +318,7 @@ void init() {
 
 void end() {
   onion_free(server);
+  free(urltxt);
 }
 
 int main(int argc, char **argv) {
@@ -126,6 +326,11 @@ int main(int argc, char **argv) {
 
   init();
   t01_url();
+  t02_many_routes();
+  t03_first_match();
+  t04_add_after_requests();
+  t05_prefixes();
+  t06_path_params();
 
   end();
   END();
@@ -0,0 +1,278 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <pthread.h>
+
+#include <onion/log.h>
+#include <onion/onion.h>
+#include <onion/request.h>
+#include <onion/response.h>
+#include <onion/shortcuts.h>
+#include <onion/file_cache.h>
+#include <onion/types_internal.h>
+
+#include "../ctest.h"
+#include "buffer_listen_point.h"
+#include "utils.h"
+
+#define TMPFILE "/tmp/onion-22-file_cache.txt"
+
+void t01_get_same_entry() {
+  INIT_LOCAL();
+
+  write_file(TMPFILE, "Hello world");
+  onion_file_cache_entry *a = onion_file_cache_get(TMPFILE);
+  onion_file_cache_entry *b = onion_file_cache_get(TMPFILE);
+  FAIL_IF_EQUAL(a, NULL);
+  FAIL_IF_NOT_EQUAL(a, b);
+  FAIL_IF_NOT_EQUAL_INT((int)onion_file_cache_entry_stat(a)->st_size, 11);
+  FAIL_IF_NOT_EQUAL_STR(onion_file_cache_entry_mime(a), "text/plain");
+  char etag[32];
+  struct stat st;
+  stat(TMPFILE, &st);
+  onion_shortcut_etag(&st, etag);
+  FAIL_IF_NOT_EQUAL_STR(onion_file_cache_entry_etag(a), etag);
+
+  onion_file_cache_entry_free(a);
+  onion_file_cache_entry_free(b);
+
+  FAIL_IF_NOT_EQUAL(onion_file_cache_get("/tmp"), NULL);
+  FAIL_IF_NOT_EQUAL(onion_file_cache_get("/this/file/does/not/exist"), NULL);
+
+  onion_file_cache_clean();
+  END_LOCAL();
+}
+
+void t02_file_changed() {
+  INIT_LOCAL();
+
+  onion_file_cache_set_ttl(0);
+  write_file(TMPFILE, "Hello world");
+  onion_file_cache_entry *a = onion_file_cache_get(TMPFILE);
+  // Replaced, as most editors and deploys do.
+  unlink(TMPFILE);
+  write_file(TMPFILE, "Hello world, again");
+  onion_file_cache_entry *b = onion_file_cache_get(TMPFILE);
+  FAIL_IF_EQUAL(a, b);
+  FAIL_IF_NOT_EQUAL_INT((int)onion_file_cache_entry_stat(a)->st_size, 11);
+  FAIL_IF_NOT_EQUAL_INT((int)onion_file_cache_entry_stat(b)->st_size, 18);
+  onion_file_cache_entry_free(a);
+  onion_file_cache_entry_free(b);
+
+  unlink(TMPFILE);
+  FAIL_IF_NOT_EQUAL(onion_file_cache_get(TMPFILE), NULL);
+
+  onion_file_cache_set_ttl(1);
+  onion_file_cache_clean();
+  END_LOCAL();
+}
+
+void t03_disabled() {
+  INIT_LOCAL();
+
+  onion_file_cache_set_max_entries(0);
+  write_file(TMPFILE, "Hello world");
+  onion_file_cache_entry *a = onion_file_cache_get(TMPFILE);
+  onion_file_cache_entry *b = onion_file_cache_get(TMPFILE);
+  FAIL_IF_EQUAL(a, NULL);
+  FAIL_IF_EQUAL(a, b);
+  onion_file_cache_entry_free(a);
+  onion_file_cache_entry_free(b);
+  unlink(TMPFILE);
+
+  onion_file_cache_set_max_entries(256);
+  END_LOCAL();
+}
+
+static const char *response_file(onion * server, const char *range) {
+  onion_request *req = onion_request_new(server->listen_points[0]);
+  onion_request_write(req, "GET / HTTP/1.1\n", 15);
+  if (range) {
+    onion_request_write(req, "Range: ", 7);
+    onion_request_write(req, range, strlen(range));
+    onion_request_write(req, "\n", 1);
+  }
+  onion_request_write(req, "\n", 1);
+  onion_response *res = onion_response_new(req);
+  onion_shortcut_response_file(TMPFILE, req, res);
+  onion_response_free(res);
+
+  static char buffer[1024];
+  strncpy(buffer, onion_buffer_listen_point_get_buffer_data(req),
+          sizeof(buffer) - 1);
+  buffer[sizeof(buffer) - 1] = 0;
+  onion_request_free(req);
+  return buffer;
+}
+
+void t04_response_file() {
+  INIT_LOCAL();
+
+  onion *server = onion_new(0);
+  onion_add_listen_point(server, NULL, NULL, onion_buffer_listen_point_new());
+  write_file(TMPFILE, "0123456789");
+
+  // Twice, second from cache.
+  const char *data = response_file(server, NULL);
+  FAIL_IF_NOT_STRSTR(data, "Content-Length: 10\r\n");
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\n0123456789");
+  data = response_file(server, NULL);
+  FAIL_IF_NOT_STRSTR(data, "Content-Length: 10\r\n");
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\n0123456789");
+
+  // Ranges do not move the shared file position.
+  data = response_file(server, "bytes=2-4");
+  FAIL_IF_NOT_STRSTR(data, "Content-Range: bytes 2-4/10\r\n");
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\n234");
+  data = response_file(server, "bytes=5-");
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\n56789");
+  data = response_file(server, NULL);
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\n0123456789");
+
+  unlink(TMPFILE);
+  onion_free(server);
+  END_LOCAL();
+}
+
+static onion_connection_status serve_tmpfile(void *_, onion_request * req,
+                                             onion_response * res) {
+  return onion_shortcut_response_file(TMPFILE, req, res);
+}
+
+static void *listen_thread_f(void *o) {
+  onion_listen(o);
+  return NULL;
+}
+
+/// Reads a full response of a file with the given size. Returns bytes of body ok, or -1.
+static ssize_t read_response(int fd, size_t size) {
+  char buffer[16 * 1024];
+  ssize_t r;
+  size_t header = 0, body = 0;
+  char prev[4] = { 0, 0, 0, 0 };
+  while (header == 0 && (r = recv(fd, buffer, 1, 0)) == 1) {   // Byte by byte to find the end of the headers
+    memmove(prev, prev + 1, 3);
+    prev[3] = buffer[0];
+    if (memcmp(prev, "\r\n\r\n", 4) == 0)
+      header = 1;
+  }
+  while (body < size) {
+    size_t n = size - body < sizeof(buffer) ? size - body : sizeof(buffer);
+    r = recv(fd, buffer, n, 0);
+    if (r <= 0)
+      return -1;
+    ssize_t i;
+    for (i = 0; i < r; i++)
+      if (buffer[i] != (char)((body + i) % 251))
+        return -1;
+    body += r;
+    usleep(100);                // Slow client, so server socket buffer fills.
+  }
+  return body;
+}
+
+void t05_slow_client_sendfile() {
+  INIT_LOCAL();
+
+  const size_t size = 8 * 1024 * 1024;
+  FILE *f = fopen(TMPFILE, "w");
+  size_t i;
+  for (i = 0; i < size; i++)
+    fputc((char)(i % 251), f);
+  fclose(f);
+
+  onion *o = onion_new(O_POOL);
+  onion_set_port(o, "8092");
+  onion_set_root_handler(o, onion_handler_new(serve_tmpfile, NULL, NULL));
+  pthread_t th;
+  pthread_create(&th, NULL, listen_thread_f, o);
+  sleep(1);
+
+  int fd = connect_to("localhost", "8092");
+  FAIL_IF(fd < 0);
+  if (fd >= 0) {
+    int rcvbuf = 16 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    // Twice, to check the connection is kept alive and reading after the transfer.
+    const char *req = "GET / HTTP/1.1\r\n\r\n";
+    FAIL_IF_NOT_EQUAL_INT(send(fd, req, strlen(req), 0), strlen(req));
+    FAIL_IF_NOT_EQUAL_INT(read_response(fd, size), size);
+    FAIL_IF_NOT_EQUAL_INT(send(fd, req, strlen(req), 0), strlen(req));
+    FAIL_IF_NOT_EQUAL_INT(read_response(fd, size), size);
+    close(fd);
+  }
+
+  onion_listen_stop(o);
+  pthread_join(th, NULL);
+  onion_free(o);
+  unlink(TMPFILE);
+
+  END_LOCAL();
+}
+
+void t06_rewritten_same_second() {
+  INIT_LOCAL();
+
+  onion_file_cache_set_ttl(0);
+  struct timespec now;
+  do {                          // Start early in a second, so both writes are in it
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (now.tv_nsec > 500000000)
+      usleep((1000000000 - now.tv_nsec) / 1000 + 1000);
+  } while (now.tv_nsec > 500000000);
+  write_file(TMPFILE, "Hello world");
+  onion_file_cache_entry *a = onion_file_cache_get(TMPFILE);
+  usleep(50000);                // More than the filesystem time granularity
+  write_file(TMPFILE, "Hello WORLD");   // Same inode and size
+  onion_file_cache_entry *b = onion_file_cache_get(TMPFILE);
+  FAIL_IF_NOT_EQUAL_INT((int)onion_file_cache_entry_stat(a)->st_mtime,
+                        (int)onion_file_cache_entry_stat(b)->st_mtime);
+  FAIL_IF_EQUAL(a, b);
+  onion_file_cache_entry_free(a);
+  onion_file_cache_entry_free(b);
+
+  unlink(TMPFILE);
+  onion_file_cache_set_ttl(1);
+  onion_file_cache_clean();
+  END_LOCAL();
+}
+
+int main(int argc, char **argv) {
+  START();
+
+  t01_get_same_entry();
+  t02_file_changed();
+  t03_disabled();
+  t04_response_file();
+  t05_slow_client_sendfile();
+  t06_rewritten_same_second();
+
+  END();
+}
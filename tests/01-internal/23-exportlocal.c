@@ -0,0 +1,303 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <onion/log.h>
+#include <onion/onion.h>
+#include <onion/request.h>
+#include <onion/response.h>
+#include <onion/handler.h>
+#include <onion/block.h>
+#include <onion/handlers/exportlocal.h>
+#include <onion/shortcuts.h>
+#include <onion/types_internal.h>
+
+#include "../ctest.h"
+#include "buffer_listen_point.h"
+#include "utils.h"
+
+#define TMPDIR "/tmp/onion-23-exportlocal"
+
+/// Does the request with the given extra headers, and returns the full response.
+static const char *do_request(onion * server, onion_handler * handler,
+                              const char *path, const char *headers) {
+  onion_request *req = onion_request_new(server->listen_points[0]);
+  char tmp[512];
+  snprintf(tmp, sizeof(tmp), "GET %s HTTP/1.1\n%s\n", path, headers);
+  onion_request_write(req, tmp, strlen(tmp));
+  onion_request_polish(req);
+  onion_response *res = onion_response_new(req);
+  onion_handler_handle(handler, req, res);
+  onion_response_free(res);
+
+  static char buffer[16 * 1024];
+  onion_block *block = onion_buffer_listen_point_get_buffer(req);
+  size_t size = onion_block_size(block);
+  if (size >= sizeof(buffer))
+    size = sizeof(buffer) - 1;
+  memcpy(buffer, onion_block_data(block), size);
+  buffer[size] = 0;
+  onion_request_free(req);
+  return buffer;
+}
+
+void t01_cached_file() {
+  INIT_LOCAL();
+
+  onion *server = onion_new(0);
+  onion_add_listen_point(server, NULL, NULL, onion_buffer_listen_point_new());
+  mkdir(TMPDIR, 0700);
+  write_file(TMPDIR "/a.txt", "Hello world");
+  onion_handler *handler = onion_handler_export_local_new(TMPDIR);
+  onion_handler_export_local_set_cache(handler, 1024 * 1024, 64 * 1024);
+
+  const char *data = do_request(server, handler, "/a.txt", "");
+  FAIL_IF_NOT_STRSTR(data, "HTTP/1.1 200 OK\r\n");
+  FAIL_IF_NOT_STRSTR(data, "Content-Length: 11\r\n");
+  FAIL_IF_NOT_STRSTR(data, "Content-Type: text/plain\r\n");
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\nHello world");
+  char etag[64];
+  const char *e = strstr(data, "Etag: ");
+  FAIL_IF_EQUAL(e, NULL);
+  if (e) {
+    e += 6;
+    size_t l = strcspn(e, "\r");
+    memcpy(etag, e, l);
+    etag[l] = 0;
+  }
+  // Same etag as when served by onion_shortcut_response_file
+  struct stat st;
+  char shortcut_etag[32];
+  stat(TMPDIR "/a.txt", &st);
+  onion_shortcut_etag(&st, shortcut_etag);
+  FAIL_IF_NOT_EQUAL_STR(etag, shortcut_etag);
+
+  // From cache, and revalidated by the etag
+  data = do_request(server, handler, "/a.txt", "");
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\nHello world");
+  char headers[128];
+  snprintf(headers, sizeof(headers), "If-None-Match: %s\n", etag);
+  data = do_request(server, handler, "/a.txt", headers);
+  FAIL_IF_NOT_STRSTR(data, "HTTP/1.1 304 ");
+  FAIL_IF_STRSTR(data, "Hello world");
+
+  // Ranges are still honored
+  data = do_request(server, handler, "/a.txt", "Range: bytes=6-\n");
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\nworld");
+
+  // Changes are seen at next request.
+  unlink(TMPDIR "/a.txt");
+  write_file(TMPDIR "/a.txt", "Hello again, world");
+  data = do_request(server, handler, "/a.txt", headers);
+  FAIL_IF_NOT_STRSTR(data, "HTTP/1.1 200 OK\r\n");
+  FAIL_IF_NOT_STRSTR(data, "\r\n\r\nHello again, world");
+
+  onion_handler_free(handler);
+  unlink(TMPDIR "/a.txt");
+  rmdir(TMPDIR);
+  onion_free(server);
+  END_LOCAL();
+}
+
+void t02_gzip_and_eviction() {
+  INIT_LOCAL();
+
+  onion *server = onion_new(0);
+  onion_add_listen_point(server, NULL, NULL, onion_buffer_listen_point_new());
+  mkdir(TMPDIR, 0700);
+  char text[4096];
+  int i;
+  for (i = 0; i < sizeof(text) - 1; i++)
+    text[i] = 'a' + (i % 7);
+  text[i] = 0;
+  write_file(TMPDIR "/b.html", text);
+  write_file(TMPDIR "/c.html", text);
+  onion_handler *handler = onion_handler_export_local_new(TMPDIR);
+  // max_file_size can not be bigger than max_size
+  onion_handler_export_local_set_cache(handler, 6000, 8 * 1024);
+  FAIL_IF_NOT_STRSTR(do_request(server, handler, "/b.html",
+                                "Accept-Encoding: gzip\n"), text);
+  // Only room for one of them.
+  onion_handler_export_local_set_cache(handler, 6000, 4 * 1024);
+
+  const char *data = do_request(server, handler, "/b.html", "");
+  FAIL_IF_NOT_STRSTR(data, "Content-Length: 4095\r\n");
+  FAIL_IF_STRSTR(data, "Content-Encoding: gzip");
+  FAIL_IF_NOT_STRSTR(data, text);
+#ifdef HAVE_ZLIB
+  FAIL_IF_NOT_STRSTR(data, "Vary: Accept-Encoding\r\n");
+  data = do_request(server, handler, "/b.html", "Accept-Encoding: gzip\n");
+  FAIL_IF_NOT_STRSTR(data, "Content-Encoding: gzip\r\n");
+  FAIL_IF_STRSTR(data, "Content-Length: 4095\r\n");
+  FAIL_IF_STRSTR(data, text);
+  data = do_request(server, handler, "/b.html",
+                    "Accept-Encoding: gzip;q=0, identity\n");
+  FAIL_IF_STRSTR(data, "Content-Encoding: gzip");
+  FAIL_IF_NOT_STRSTR(data, text);
+  data = do_request(server, handler, "/b.html",
+                    "Accept-Encoding: deflate, GZIP; q=0.5\n");
+  FAIL_IF_NOT_STRSTR(data, "Content-Encoding: gzip\r\n");
+#endif
+
+  data = do_request(server, handler, "/c.html", "");
+  FAIL_IF_NOT_STRSTR(data, text);
+  data = do_request(server, handler, "/b.html", "");
+  FAIL_IF_NOT_STRSTR(data, text);
+
+  onion_handler_free(handler);
+  unlink(TMPDIR "/b.html");
+  unlink(TMPDIR "/c.html");
+  rmdir(TMPDIR);
+  onion_free(server);
+  END_LOCAL();
+}
+
+/// Sets the directory mtime, so it can be cached, and changes can keep the same mtime.
+static void set_dir_mtime(time_t t) {
+  struct timespec times[2] = { {t, 0}, {t, 0} };
+  utimensat(AT_FDCWD, TMPDIR, times, 0);
+}
+
+void t03_listing() {
+  INIT_LOCAL();
+
+  onion *server = onion_new(0);
+  onion_add_listen_point(server, NULL, NULL, onion_buffer_listen_point_new());
+  mkdir(TMPDIR, 0700);
+  mkdir(TMPDIR "/sub", 0700);
+  write_file(TMPDIR "/b.txt", "b");
+  write_file(TMPDIR "/a<b>.txt", "ab");
+  set_dir_mtime(1000000);
+  onion_handler *handler = onion_handler_export_local_new(TMPDIR);
+  onion_handler_export_local_set_listing_cache(handler, 4);
+
+  const char *data = do_request(server, handler, "/", "");
+  FAIL_IF_NOT_STRSTR(data, "Content-Type: text/html");
+  FAIL_IF_NOT_STRSTR(data, "[\"sub/\",");
+  FAIL_IF_NOT_STRSTR(data, "[\"b.txt\",1,");
+  FAIL_IF_NOT_STRSTR(data, "[\"a\\u003cb>.txt\",2,");
+  FAIL_IF_STRSTR(data, "a<b>");
+
+  data = do_request(server, handler, "/?format=json&offset=1&limit=1", "");
+  FAIL_IF_NOT_STRSTR(data, "Content-Type: application/json");
+  FAIL_IF_NOT_STRSTR(data,
+                     "{\"path\":\"\",\"total\":3,\"offset\":1,\"files\":[{\"name\":\"b.txt\",\"size\":1,");
+  FAIL_IF_STRSTR(data, "sub");
+
+  // Same mtime, so the cached listing is used.
+  write_file(TMPDIR "/c.txt", "c");
+  set_dir_mtime(1000000);
+  data = do_request(server, handler, "/?format=json", "");
+  FAIL_IF_NOT_STRSTR(data, "\"total\":3,");
+  FAIL_IF_STRSTR(data, "c.txt");
+
+  // Changed, read again.
+  set_dir_mtime(1000001);
+  data = do_request(server, handler, "/?format=json", "");
+  FAIL_IF_NOT_STRSTR(data, "\"total\":4,");
+  FAIL_IF_NOT_STRSTR(data, "{\"name\":\"c.txt\",\"size\":1,");
+  FAIL_IF_NOT_STRSTR(data, "{\"name\":\"sub\",\"size\":");
+  FAIL_IF_NOT_STRSTR(data, "\"type\":\"dir\"}]}");
+
+  onion_handler_free(handler);
+  unlink(TMPDIR "/a<b>.txt");
+  unlink(TMPDIR "/b.txt");
+  unlink(TMPDIR "/c.txt");
+  rmdir(TMPDIR "/sub");
+  rmdir(TMPDIR);
+  onion_free(server);
+  END_LOCAL();
+}
+
+struct t04_serving_t {
+  onion *server;
+  onion_handler *handler;
+  int done;
+  int bad;
+};
+
+static void *t04_serve(struct t04_serving_t *t) {
+  int i;
+  for (i = 0; i < 5000; i++) {
+    onion_request *req = onion_request_new(t->server->listen_points[0]);
+    const char *get = "GET /a.txt HTTP/1.1\n\n";
+    onion_request_write(req, get, strlen(get));
+    onion_request_polish(req);
+    onion_response *res = onion_response_new(req);
+    onion_handler_handle(t->handler, req, res);
+    onion_response_free(res);
+    onion_block *block = onion_buffer_listen_point_get_buffer(req);
+    if (!strstr(onion_block_data(block), "\r\n\r\nHello world"))
+      t->bad++;
+    onion_request_free(req);
+  }
+  __atomic_store_n(&t->done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+void t04_set_cache_while_serving() {
+  INIT_LOCAL();
+
+  struct t04_serving_t t;
+  memset(&t, 0, sizeof(t));
+  t.server = onion_new(0);
+  onion_add_listen_point(t.server, NULL, NULL,
+                         onion_buffer_listen_point_new());
+  mkdir(TMPDIR, 0700);
+  write_file(TMPDIR "/a.txt", "Hello world");
+  t.handler = onion_handler_export_local_new(TMPDIR);
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, (void *)t04_serve, &t);
+  int i = 0;
+  while (!__atomic_load_n(&t.done, __ATOMIC_ACQUIRE))   // Old caches are freed when the last request is done
+    onion_handler_export_local_set_cache(t.handler,
+                                         (i++ % 3) ? 1024 * 1024 : 0,
+                                         64 * 1024);
+  pthread_join(thread, NULL);
+  FAIL_IF_NOT_EQUAL_INT(t.bad, 0);
+
+  onion_handler_free(t.handler);
+  unlink(TMPDIR "/a.txt");
+  rmdir(TMPDIR);
+  onion_free(t.server);
+  END_LOCAL();
+}
+
+int main(int argc, char **argv) {
+  START();
+
+  t01_cached_file();
+  t02_gzip_and_eviction();
+  t03_listing();
+  t04_set_cache_while_serving();
+
+  END();
+}
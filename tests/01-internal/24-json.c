@@ -0,0 +1,236 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+#include <string.h>
+#include <math.h>
+
+#include <onion/log.h>
+#include <onion/onion.h>
+#include <onion/dict.h>
+#include <onion/block.h>
+#include <onion/json.h>
+#include <onion/codecs.h>
+#include <onion/shortcuts.h>
+#include <onion/types_internal.h>
+
+#include "../ctest.h"
+#include "buffer_listen_point.h"
+
+void t01_writer() {
+  INIT_LOCAL();
+  onion_block *block = onion_block_new();
+  onion_json_writer *w = onion_json_writer_new_block(block);
+  onion_json_object_start(w);
+  onion_json_key(w, "n");
+  onion_json_int(w, -12);
+  onion_json_key(w, "list");
+  onion_json_array_start(w);
+  onion_json_double(w, 0.5);
+  onion_json_bool(w, 1);
+  onion_json_bool(w, 0);
+  onion_json_null(w);
+  onion_json_double(w, NAN);
+  onion_json_string(w, "a\"b\\c\n\x01");
+  onion_json_array_start(w);
+  onion_json_array_end(w);
+  onion_json_array_end(w);
+  onion_json_key(w, "empty");
+  onion_json_object_start(w);
+  onion_json_object_end(w);
+  onion_json_object_end(w);
+  FAIL_IF_NOT_EQUAL_INT(onion_json_writer_size(w), onion_block_size(block));
+  FAIL_IF_NOT_EQUAL_INT(onion_json_writer_free(w), 0);
+  FAIL_IF_NOT_EQUAL_STR(onion_block_data(block),
+                        "{\"n\":-12, \"list\":[0.5, true, false, null, null, \"a\\\"b\\\\c\\n\\u0001\", []], \"empty\":{}}");
+
+  // Long strings, with escapes at any position of the vector scans, as onion_json_quote_add
+  char str[200];
+  int i;
+  for (i = 0; i < sizeof(str) - 1; i++)
+    str[i] = "abcdefghijklmnopqrstuvwxyz\"\\\n\x7f\x01"[(i * 7) % 31];
+  str[sizeof(str) - 1] = 0;
+  onion_block *quoted = onion_block_new();
+  onion_block_add_char(quoted, '"');
+  onion_json_quote_add(quoted, str);
+  onion_block_add_char(quoted, '"');
+  onion_block_clear(block);
+  w = onion_json_writer_new_block(block);
+  onion_json_string(w, str);
+  FAIL_IF_NOT_EQUAL_INT(onion_json_writer_free(w), 0);
+  FAIL_IF_NOT_EQUAL_STR(onion_block_data(block), onion_block_data(quoted));
+  onion_block_free(quoted);
+
+  // Wrong uses are detected
+  onion_block_clear(block);
+  w = onion_json_writer_new_block(block);
+  onion_json_object_start(w);
+  onion_json_int(w, 1);         // No key
+  FAIL_IF_NOT_EQUAL_INT(onion_json_writer_free(w), -1);
+  w = onion_json_writer_new_block(block);
+  onion_json_array_start(w);
+  onion_json_object_end(w);
+  FAIL_IF_NOT_EQUAL_INT(onion_json_writer_free(w), -1);
+  w = onion_json_writer_new_block(block);
+  onion_json_array_start(w);
+  FAIL_IF_NOT_EQUAL_INT(onion_json_writer_free(w), -1);
+
+  onion_block_free(block);
+  END_LOCAL();
+}
+
+void t02_dict() {
+  INIT_LOCAL();
+  onion_dict *d = onion_dict_new();
+  onion_dict *sub = onion_dict_new();
+  onion_dict *subsub = onion_dict_new();
+  onion_dict_add(subsub, "deep", "yes", 0);
+  onion_dict_add(sub, "x", "1", 0);
+  onion_dict_add(sub, "in", subsub, OD_DICT | OD_FREE_VALUE);
+  onion_dict_add(d, "a", "b\"", 0);
+  onion_dict_add(d, "sub", sub, OD_DICT | OD_FREE_VALUE);
+
+  // Same as onion_dict_to_json
+  onion_block *json = onion_dict_to_json(d);
+  FAIL_IF_NOT_EQUAL_STR(onion_block_data(json),
+                        "{\"a\":\"b\\\"\", \"sub\":{\"in\":{\"deep\":\"yes\"}, \"x\":\"1\"}}");
+  onion_block *block = onion_block_new();
+  onion_json_writer *w = onion_json_writer_new_block(block);
+  onion_json_dict(w, d);
+  onion_json_writer_free(w);
+  FAIL_IF_NOT_EQUAL_STR(onion_block_data(block), onion_block_data(json));
+
+  // And to a response, with length
+  onion *server = onion_new(0);
+  onion_add_listen_point(server, NULL, NULL, onion_buffer_listen_point_new());
+  onion_request *req = onion_request_new(server->listen_points[0]);
+  onion_request_write(req, "GET / HTTP/1.1\n\n", 16);
+  onion_response *res = onion_response_new(req);
+  onion_shortcut_response_json(d, req, res);
+  onion_response_free(res);
+  const char *data = onion_block_data(onion_buffer_listen_point_get_buffer(req));
+  char length[64];
+  snprintf(length, sizeof(length), "Content-Length: %d\r\n",
+           (int)onion_block_size(json));
+  FAIL_IF_NOT_STRSTR(data, length);
+  FAIL_IF_NOT_STRSTR(data, "Content-Type: application/json\r\n");
+  FAIL_IF_NOT_STRSTR(data, onion_block_data(json));
+  FAIL_IF_STRSTR(data, "Transfer-Encoding: chunked");
+  onion_request_free(req);
+  onion_free(server);
+
+  onion_block_free(block);
+  onion_block_free(json);
+  END_LOCAL();
+}
+
+void t03_parse() {
+  INIT_LOCAL();
+  const char *json =
+      "{ \"n\": -1.5e3, \"zero\":0, \"t\": true, \"f\":false, \"none\": null,"
+      " \"list\": [1, \"two\", [], {\"k\": \"v\"}, null, 6],"
+      " \"long\": \"a long string with no escapes at all, to check the fast scan\","
+      " \"esc\": \"\\t\\u00e9\\uD83D\\uDE02/end\", \"empty\": {} }";
+  onion_dict *d = onion_dict_from_json(json);
+  FAIL_IF_EQUAL(d, NULL);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "n"), "-1.5e3");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "zero"), "0");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "t"), "true");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "f"), "false");
+  FAIL_IF_NOT_EQUAL(onion_dict_get(d, "none"), NULL);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(d, "list", "0", NULL), "1");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(d, "list", "1", NULL), "two");
+  FAIL_IF_NOT_EQUAL(onion_dict_count(onion_dict_get_dict(onion_dict_get_dict(d, "list"), "2")), 0);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(d, "list", "3", "k", NULL), "v");
+  FAIL_IF_NOT_EQUAL(onion_dict_rget(d, "list", "4", NULL), NULL);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(d, "list", "5", NULL), "6");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "long"),
+                        "a long string with no escapes at all, to check the fast scan");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "esc"), "\t\xc3\xa9\xf0\x9f\x98\x82/end");
+  FAIL_IF_EQUAL(onion_dict_get_dict(d, "empty"), NULL);
+
+  // Subdicts keep the parsed data alive
+  onion_dict *sub = onion_dict_dup(onion_dict_get_dict(d, "list"));
+  onion_dict_free(d);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(sub, "1"), "two");
+  onion_dict_free(sub);
+
+  // Not null terminated
+  d = onion_dict_from_json_length("{\"a\":\"b\"}garbage", 9);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "a"), "b");
+  onion_dict_free(d);
+
+  const char *invalid[] = {
+    "", "[]", "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "{\"a\":[1,]}",
+    "{\"a\":01}", "{\"a\":1.}", "{\"a\":-}", "{\"a\":tru}", "{\"a\":\"\\x\"}",
+    "{\"a\":\"\n\"}", "{\"a\":[}", "{\"a\":[1}", "{\"a\":1} x", "{\"a\":\"b",
+    "{\"a\":\"\\uD83D\"}", NULL
+  };
+  const char **i;
+  for (i = invalid; *i; i++) {
+    d = onion_dict_from_json(*i);
+    FAIL_IF_NOT_EQUAL(d, NULL);
+    if (d) {
+      ONION_ERROR("Parsed invalid JSON: %s", *i);
+      onion_dict_free(d);
+    }
+  }
+
+  // Too deep
+  char deep[256] = "{\"a\":";
+  for (int j = 0; j < 100; j++)
+    strcat(deep, "[");
+  d = onion_dict_from_json(deep);
+  FAIL_IF_NOT_EQUAL(d, NULL);
+
+  END_LOCAL();
+}
+
+void t04_request_json() {
+  INIT_LOCAL();
+  onion *server = onion_new(0);
+  onion_listen_point *lp = onion_buffer_listen_point_new();
+  onion_add_listen_point(server, NULL, NULL, lp);
+  onion_request *req = onion_request_new(lp);
+  const char *query =
+      "POST / HTTP/1.1\r\nContent-Type: application/json\r\nContent-Length: 22\r\n\r\n"
+      "{\"method\":\"x\",\"p\":[2]}";
+  onion_request_write(req, query, strlen(query));
+  onion_dict *json = onion_request_get_json(req);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(json, "method"), "x");
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_rget(json, "p", "0", NULL), "2");
+  FAIL_IF_NOT_EQUAL(onion_request_get_json(req), json);
+  onion_request_free(req);
+  onion_free(server);
+  END_LOCAL();
+}
+
+int main(int argc, char **argv) {
+  START();
+
+  t01_writer();
+  t02_dict();
+  t03_parse();
+  t04_request_json();
+
+  END();
+}
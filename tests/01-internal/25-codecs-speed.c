@@ -0,0 +1,266 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/*
+ * Compares the codecs with the plain byte at a time versions they replaced, both for
+ * correctness with strings of many lengths and alignments, and for speed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <onion/codecs.h>
+#include <onion/block.h>
+#include <onion/log.h>
+#include <onion/low.h>
+
+#include "../ctest.h"
+
+/// Previous onion_html_quote
+static char *ref_html_quote(const char *str) {
+  int size = 0;
+  const char *p = str;
+  while ((*p)) {
+    size += onion_html_encoding_size(*p);
+    p++;
+  }
+  if (size == (p - str))
+    return NULL;
+  char *ret = onion_low_scalar_malloc(size + 1);
+  memset(ret, 0, size + 1);
+  p = str;
+  char *t = ret;
+  while ((*p)) {
+    t = onion_html_add_enc(*p, t);
+    p++;
+  }
+  *t = '\0';
+  return ret;
+}
+
+/// Previous onion_json_quote_add
+static void ref_json_quote_add(onion_block * block, const char *str) {
+  while (*str) {
+    unsigned char c = *str;
+    switch (c) {
+    case '\b':
+      onion_block_add_data(block, "\\b", 2);
+      break;
+    case '\f':
+      onion_block_add_data(block, "\\f", 2);
+      break;
+    case '\n':
+      onion_block_add_data(block, "\\n", 2);
+      break;
+    case '\r':
+      onion_block_add_data(block, "\\r", 2);
+      break;
+    case '\t':
+      onion_block_add_data(block, "\\t", 2);
+      break;
+    case '"':
+      onion_block_add_data(block, "\\\"", 2);
+      break;
+    case '\\':
+      onion_block_add_data(block, "\\\\", 2);
+      break;
+    default:
+      if (c < 32 || c == 127) {
+        char codestr[6] = "\\u0000";
+        const char *hex = "0123456789ABCDEF";
+        codestr[4] = hex[((c & 0x0F0) >> 4) & 0x0F];
+        codestr[5] = hex[(c & 0x0F)];
+        onion_block_add_data(block, codestr, 6);
+      } else
+        onion_block_add_char(block, c);
+    }
+    str++;
+  }
+}
+
+/// Previous onion_unquote_inplace. Only valid for well formed %XX.
+static void ref_unquote_inplace(char *str) {
+  char *r = str;
+  char *w = str;
+  char tmp[3] = { 0, 0, 0 };
+  while (*r) {
+    if (*r == '%') {
+      r++;
+      tmp[0] = *r++;
+      tmp[1] = *r;
+      *w = strtol(tmp, (char **)NULL, 16);
+    } else if (*r == '+') {
+      *w = ' ';
+    } else {
+      *w = *r;
+    }
+    r++;
+    w++;
+  }
+  *w = '\0';
+}
+
+/// Random string of length l, with about one special char every `every` chars.
+static void random_string(char *str, int l, int every) {
+  const char special[] = "<>&\"'\\\n\t\x01\x7f+";
+  int i;
+  for (i = 0; i < l; i++) {
+    if (every && rand() % every == 0)
+      str[i] = special[rand() % (sizeof(special) - 1)];
+    else if (every && rand() % every == 0) {     // Well formed url quote
+      str[i] = '%';
+      if (i + 2 < l) {
+        str[++i] = 'a' + rand() % 6;
+        str[++i] = '0' + rand() % 10;
+      }
+    } else
+      str[i] = 'a' + rand() % 26;
+    if (str[i] == '%' && i + 2 >= l)
+      str[i] = 'x';
+  }
+  str[l] = 0;
+}
+
+void t01_same_results() {
+  INIT_LOCAL();
+  char *buffer = onion_low_scalar_malloc(256);
+  int l, offset, errors = 0;
+  onion_block *a = onion_block_new(), *b = onion_block_new();
+  srand(1);
+  for (l = 0; l < 150; l++) {
+    for (offset = 0; offset < 40; offset++) {
+      char *str = buffer + offset;
+      random_string(str, l, (l + offset) % 4 == 0 ? 0 : 1 + (l % 20));
+
+      char *q = onion_html_quote(str), *rq = ref_html_quote(str);
+      if ((q == NULL) != (rq == NULL) || (q && strcmp(q, rq) != 0))
+        errors++;
+      onion_low_free(q);
+      onion_low_free(rq);
+
+      onion_block_clear(a);
+      onion_block_clear(b);
+      onion_json_quote_add(a, str);
+      ref_json_quote_add(b, str);
+      if (strcmp(onion_block_data(a), onion_block_data(b)) != 0)
+        errors++;
+
+      char u1[256], u2[256];
+      strcpy(u1, str);
+      strcpy(u2, str);
+      onion_unquote_inplace(u1);
+      ref_unquote_inplace(u2);
+      if (strcmp(u1, u2) != 0)
+        errors++;
+    }
+  }
+  FAIL_IF_NOT_EQUAL_INT(errors, 0);
+  onion_block_free(a);
+  onion_block_free(b);
+  onion_low_free(buffer);
+  END_LOCAL();
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/// Runs both versions on the same strings, and shows the times.
+static void bench(const char *name, int length, int every) {
+  const int count = 64, rounds = 200000 / (length + 16);
+  char *strs[count];
+  char tmp[4096];
+  int i, r;
+  for (i = 0; i < count; i++) {
+    strs[i] = onion_low_scalar_malloc(length + 1);
+    random_string(strs[i], length, every);
+  }
+  onion_block *block = onion_block_new();
+  double t_ref = 0, t_new = 0, t;
+
+  t = now();
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < count; i++) {
+      if (name[0] == 'h')
+        onion_low_free(ref_html_quote(strs[i]));
+      else if (name[0] == 'j') {
+        onion_block_clear(block);
+        ref_json_quote_add(block, strs[i]);
+      } else {
+        strcpy(tmp, strs[i]);
+        ref_unquote_inplace(tmp);
+      }
+    }
+  }
+  t_ref = now() - t;
+
+  t = now();
+  for (r = 0; r < rounds; r++) {
+    for (i = 0; i < count; i++) {
+      if (name[0] == 'h')
+        onion_low_free(onion_html_quote(strs[i]));
+      else if (name[0] == 'j') {
+        onion_block_clear(block);
+        onion_json_quote_add(block, strs[i]);
+      } else {
+        strcpy(tmp, strs[i]);
+        onion_unquote_inplace(tmp);
+      }
+    }
+  }
+  t_new = now() - t;
+
+  ONION_INFO("%-6s %5d bytes, special every %-4d: before %7.1f ns, now %7.1f ns (x%.1f)",
+             name, length, every, t_ref * 1e9 / (rounds * count),
+             t_new * 1e9 / (rounds * count), t_ref / t_new);
+  onion_block_free(block);
+  for (i = 0; i < count; i++)
+    onion_low_free(strs[i]);
+}
+
+void t02_speed() {
+  INIT_LOCAL();
+  int lengths[] = { 16, 64, 1024 };
+  int i;
+  for (i = 0; i < 3; i++) {
+    bench("html", lengths[i], 0);
+    bench("html", lengths[i], 100);
+    bench("json", lengths[i], 0);
+    bench("json", lengths[i], 100);
+    bench("url", lengths[i], 0);
+    bench("url", lengths[i], 100);
+  }
+  END_LOCAL();
+}
+
+int main(int argc, char **argv) {
+  START();
+
+  t01_same_results();
+  t02_speed();
+
+  END();
+}
@@ -28,6 +28,7 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <string.h>
+#include <stdio.h>
 
 #include <onion/log.h>
 
@@ -76,3 +77,9 @@ int connect_to(const char *addr, const char *port) {
   freeaddrinfo(server);
   return -1;
 }
+
+void write_file(const char *filename, const char *data) {
+  FILE *fd = fopen(filename, "w");
+  fwrite(data, 1, strlen(data), fd);
+  fclose(fd);
+}
@@ -27,4 +27,7 @@
 //Returns an open TCP socket to the given address, or <0
 int connect_to(const char *address, const char *port);
 
+//Writes the data to the file, replacing it
+void write_file(const char *filename, const char *data);
+
 #endif
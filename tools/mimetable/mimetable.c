@@ -0,0 +1,216 @@
+/**
+  Onion HTTP server library
+  Copyright (C) 2010-2018 David Moreno Montero and others
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of, at your choice:
+
+  a. the Apache License Version 2.0.
+
+  b. the GNU General Public License as published by the
+  Free Software Foundation; either version 2.0 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of both licenses, if not see
+  <http://www.gnu.org/licenses/> and
+  <http://www.apache.org/licenses/LICENSE-2.0>.
+*/
+
+/**
+ * @short Generates the mime perfect hash table from a mime.types file.
+ *
+ * Uses hash and displace: each extension goes to a bucket by onion_mime_hash(ext, 0), and each
+ * bucket gets a seed so that onion_mime_hash(ext, seed) sends all its extensions to free slots.
+ * Lookup is then two hashes and one compare.
+ *
+ * Usage: mimetable mime.types mime_table.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include <onion/mime_hash.h>
+
+#define MAX_SEED (1 << 20)
+
+typedef struct {
+  char *extension;
+  int type;                     ///< Index at types
+} mime_entry;
+
+static char **types = NULL;
+static int ntypes = 0;
+static mime_entry *entries = NULL;
+static int nentries = 0;
+
+static int add_type(const char *type) {
+  if (ntypes && strcmp(types[ntypes - 1], type) == 0)
+    return ntypes - 1;
+  types = realloc(types, sizeof(char *) * (ntypes + 1));
+  types[ntypes] = strdup(type);
+  return ntypes++;
+}
+
+static void add_extension(const char *extension, const char *type) {
+  int i;
+  for (i = 0; i < nentries; i++) {
+    if (strcasecmp(entries[i].extension, extension) == 0)       // First wins
+      return;
+  }
+  entries = realloc(entries, sizeof(mime_entry) * (nentries + 1));
+  entries[nentries].extension = strdup(extension);
+  char *c;
+  for (c = entries[nentries].extension; *c; c++)
+    *c = tolower(*c);
+  entries[nentries].type = add_type(type);
+  nentries++;
+}
+
+static void parse(FILE * fd) {
+  char line[4096];
+  while (fgets(line, sizeof(line), fd)) {
+    char *hash = strchr(line, '#');
+    if (hash)
+      *hash = 0;
+    char *save = NULL;
+    char *type = strtok_r(line, " \t\r\n", &save);
+    if (!type)
+      continue;
+    char *extension;
+    while ((extension = strtok_r(NULL, " \t\r\n", &save)))
+      add_extension(extension, type);
+  }
+}
+
+static void write_string(FILE * out, const char *str) {
+  fputc('"', out);
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      fputc('\\', out);
+    fputc(*str, out);
+  }
+  fputc('"', out);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s mime.types mime_table.h\n", argv[0]);
+    return 1;
+  }
+  FILE *fd = fopen(argv[1], "r");
+  if (!fd) {
+    perror(argv[1]);
+    return 1;
+  }
+  parse(fd);
+  fclose(fd);
+  if (nentries == 0) {
+    fprintf(stderr, "No mime types at %s\n", argv[1]);
+    return 1;
+  }
+
+  int nbuckets = (nentries + 3) / 4;
+  int size = nentries + nentries / 4 + 1;
+  int i, j, k;
+
+  // Buckets as lists of entries, to place the biggest first.
+  int *bucket_size = calloc(nbuckets, sizeof(int));
+  int **bucket = calloc(nbuckets, sizeof(int *));
+  for (i = 0; i < nentries; i++) {
+    int b = onion_mime_hash(entries[i].extension, 0) % nbuckets;
+    bucket[b] = realloc(bucket[b], sizeof(int) * (bucket_size[b] + 1));
+    bucket[b][bucket_size[b]++] = i;
+  }
+  int *order = malloc(sizeof(int) * nbuckets);
+  for (i = 0; i < nbuckets; i++)
+    order[i] = i;
+  for (i = 1; i < nbuckets; i++) {      // Insertion sort, biggest first
+    int o = order[i];
+    for (j = i; j > 0 && bucket_size[order[j - 1]] < bucket_size[o]; j--)
+      order[j] = order[j - 1];
+    order[j] = o;
+  }
+
+  int *slots = malloc(sizeof(int) * size);
+  for (i = 0; i < size; i++)
+    slots[i] = -1;
+  unsigned int *seeds = calloc(nbuckets, sizeof(unsigned int));
+  int *tried = malloc(sizeof(int) * 64);
+  for (i = 0; i < nbuckets; i++) {
+    int b = order[i];
+    if (bucket_size[b] == 0)
+      break;
+    if (bucket_size[b] > 64) {
+      fprintf(stderr, "Too many collisions, can not build the table\n");
+      return 1;
+    }
+    unsigned int seed;
+    for (seed = 1; seed < MAX_SEED; seed++) {
+      for (j = 0; j < bucket_size[b]; j++) {
+        tried[j] = onion_mime_hash(entries[bucket[b][j]].extension, seed) % size;
+        if (slots[tried[j]] != -1)
+          break;
+        for (k = 0; k < j; k++)
+          if (tried[k] == tried[j])
+            break;
+        if (k != j)
+          break;
+      }
+      if (j == bucket_size[b])
+        break;
+    }
+    if (seed == MAX_SEED) {
+      fprintf(stderr, "Could not find a seed for bucket %d\n", b);
+      return 1;
+    }
+    seeds[b] = seed;
+    for (j = 0; j < bucket_size[b]; j++)
+      slots[tried[j]] = bucket[b][j];
+  }
+
+  FILE *out = fopen(argv[2], "w");
+  if (!out) {
+    perror(argv[2]);
+    return 1;
+  }
+  fprintf(out, "/* Generated by tools/mimetable from mime.types. Do not edit, regenerate with make mime_table. */\n\n");
+  fprintf(out, "#define ONION_MIME_TABLE_BUCKETS %d\n", nbuckets);
+  fprintf(out, "#define ONION_MIME_TABLE_SIZE %d\n\n", size);
+  fprintf(out, "static const unsigned int onion_mime_table_seeds[%d] = {",
+          nbuckets);
+  for (i = 0; i < nbuckets; i++)
+    fprintf(out, "%s%u", i == 0 ? "\n  " : i % 16 ? ", " : ",\n  ",
+            seeds[i]);
+  fprintf(out, "\n};\n\n");
+  fprintf(out, "static const char *const onion_mime_table_types[%d] = {\n",
+          ntypes);
+  for (i = 0; i < ntypes; i++) {
+    fprintf(out, "  ");
+    write_string(out, types[i]);
+    fprintf(out, ",\n");
+  }
+  fprintf(out, "};\n\n");
+  fprintf(out, "static const struct {\n  const char *extension;\n"
+          "  unsigned short type;\n} onion_mime_table[%d] = {\n", size);
+  for (i = 0; i < size; i++) {
+    if (slots[i] < 0)
+      fprintf(out, "  {NULL, 0},\n");
+    else {
+      fprintf(out, "  {");
+      write_string(out, entries[slots[i]].extension);
+      fprintf(out, ", %d},\n", entries[slots[i]].type);
+    }
+  }
+  fprintf(out, "};\n");
+  fclose(out);
+
+  return 0;
+}